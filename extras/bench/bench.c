@@ -0,0 +1,139 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file bench.c
+ * @brief Micro-benchmark harness of the host build
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+#define BENCH_RUNS 3
+#define BENCH_NAME_LEN 96
+#define BENCH_MAX_ITERATIONS 10000000000ULL
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static uint64_t allocations = 0;
+static volatile uintptr_t keptValue;
+static const char *pFilter = NULL;
+static bool isHeaderPrinted = false;
+
+void *__wrap_malloc(size_t size) {
+	allocations++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+	allocations++;
+	return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+	__real_free(ptr);
+}
+
+uint64_t bench_now_ns(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+uint64_t bench_duration_ns(void) {
+	const char *pMinMs = getenv("IOT_BENCH_MIN_MS");
+	long minMs = (NULL != pMinMs) ? strtol(pMinMs, NULL, 10) : 0;
+
+	return (uint64_t) ((minMs > 0) ? minMs : 200) * 1000000ULL;
+}
+
+void bench_init(int argc, char **argv) {
+	pFilter = (argc > 1) ? argv[1] : NULL;
+}
+
+bool bench_is_selected(const char *pName) {
+	return NULL == pFilter || NULL != strstr(pName, pFilter);
+}
+
+uint64_t bench_allocations(void) {
+	return allocations;
+}
+
+void bench_keep(uintptr_t value) {
+	keptValue = value;
+}
+
+void bench_run(pBenchFunction_t function, void *pContext, const char *pName, ...) {
+	char name[BENCH_NAME_LEN];
+	uint64_t minNs = bench_duration_ns();
+	uint64_t iterations = 1;
+	uint64_t elapsed = 0;
+	uint64_t best = UINT64_MAX;
+	uint64_t allocated = 0;
+	uint64_t allocationsBefore;
+	uint64_t start;
+	va_list args;
+	int run;
+
+	va_start(args, pName);
+	vsnprintf(name, sizeof(name), pName, args);
+	va_end(args);
+
+	if(!bench_is_selected(name)) {
+		return;
+	}
+	if(!isHeaderPrinted) {
+		printf("%-48s %12s %12s %10s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+		isHeaderPrinted = true;
+	}
+
+	/* grow the iteration count until a run is long enough to be timed */
+	while(elapsed < minNs / 10 && iterations < BENCH_MAX_ITERATIONS) {
+		iterations *= 10;
+		start = bench_now_ns();
+		function(pContext, iterations);
+		elapsed = bench_now_ns() - start;
+	}
+	iterations = (uint64_t) ((double) iterations * (double) minNs / (double) elapsed) + 1;
+
+	for(run = 0; run < BENCH_RUNS; run++) {
+		allocationsBefore = allocations;
+		start = bench_now_ns();
+		function(pContext, iterations);
+		elapsed = bench_now_ns() - start;
+		if(elapsed < best) {
+			best = elapsed;
+			allocated = allocations - allocationsBefore;
+		}
+	}
+
+	printf("%-48s %12llu %12.1f %10.2f\n", name, (unsigned long long) iterations,
+		   (double) best / (double) iterations, (double) allocated / (double) iterations);
+	fflush(stdout);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file bench.h
+ * @brief Minimal micro-benchmark harness of the host build
+ *
+ * Each benchmark is a function running its body a given number of times.
+ * bench_run calibrates the iteration count until one run lasts at least
+ * IOT_BENCH_MIN_MS (environment variable, 200 ms by default), keeps the
+ * fastest of three runs and prints one line: name, iterations, ns/op and
+ * heap allocations per operation. Allocations are counted by wrapping
+ * malloc, calloc, realloc and free at link time (see bench/CMakeLists.txt).
+ *
+ * The first command line argument, if any, only runs the benchmarks whose
+ * name contains it.
+ */
+
+#ifndef AWS_IOT_SDK_EXTRAS_BENCH_H
+#define AWS_IOT_SDK_EXTRAS_BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Benchmark body
+ *
+ * @param pContext Context given to bench_run
+ * @param iterations Number of operations to run
+ */
+typedef void (*pBenchFunction_t)(void *pContext, uint64_t iterations);
+
+/**
+ * @brief Parse the command line filter
+ */
+void bench_init(int argc, char **argv);
+
+/**
+ * @brief Run and report one benchmark
+ *
+ * @param pName Name printed in the report, printf format
+ * @param function Benchmark body
+ * @param pContext Passed back to the body
+ */
+void bench_run(pBenchFunction_t function, void *pContext, const char *pName, ...)
+#ifdef __GNUC__
+	__attribute__((format(printf, 3, 4)))
+#endif
+;
+
+/**
+ * @brief Whether a benchmark name passes the command line filter
+ */
+bool bench_is_selected(const char *pName);
+
+/**
+ * @brief Monotonic clock, in nanoseconds
+ */
+uint64_t bench_now_ns(void);
+
+/**
+ * @brief Minimum duration of a measured run, IOT_BENCH_MIN_MS in nanoseconds
+ */
+uint64_t bench_duration_ns(void);
+
+/**
+ * @brief Heap allocations (malloc, calloc, realloc) since the start of the process
+ */
+uint64_t bench_allocations(void);
+
+/**
+ * @brief Compiler barrier, put it in benchmark loops so that loop invariant
+ * calls are not hoisted out of them
+ */
+#define BENCH_CLOBBER() __asm__ __volatile__("" : : : "memory")
+
+/**
+ * @brief Keep a result alive so the compiler cannot drop the measured code
+ */
+void bench_keep(uintptr_t value);
+
+#endif /* AWS_IOT_SDK_EXTRAS_BENCH_H */
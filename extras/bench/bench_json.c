@@ -0,0 +1,526 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file bench_json.c
+ * @brief Micro-benchmarks of the shadow, jobs and discovery JSON paths
+ *
+ * Usage: iot_bench_json [filter]
+ *
+ * Every benchmark is swept over synthetic documents of growing key count:
+ * shadow deltas with their metadata, jobs execution documents and discovery
+ * responses with several groups and cores. Number conversions are measured
+ * on their own with telemetry-like values. The host build raises
+ * MAX_JSON_TOKEN_EXPECTED and ggdconfigJSON_MAX_TOKENS so the largest
+ * documents fit in the token arrays.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "aws_iot_config.h"
+#include "aws_iot_shadow_json.h"
+#include "aws_iot_json_utils.h"
+#include "aws_iot_json_number.h"
+#include "aws_iot_jobs_json.h"
+#include "aws_ggd_types.h"
+#include "aws_greengrass_discovery.h"
+
+#include "bench.h"
+
+#define BENCH_DOC_LEN (64 * 1024)
+#define BENCH_MAX_KEYS 200
+#define BENCH_KEY_LEN 16
+#define BENCH_JOBS_TOKENS 1024
+
+/* defined by aws_iot_shadow_records.c on the device */
+char mqttClientID[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES] = "bench-client";
+
+static const unsigned int shadowKeyCounts[] = {4, 16, 64, BENCH_MAX_KEYS};
+static const unsigned int reportedKeyCounts[] = {1, 4, 16, 64};
+static const unsigned int discoveryGroups[] = {1, 4, 16};
+static const unsigned int discoveryCores[] = {1, 4};
+
+/* readings with a few decimals, and values that need all 17 digits */
+static const double numberValues[] = {21.5, -3.25, 1013.25, 0.001, 65535, 98.6, 1.0 / 3, 0.1 + 0.2};
+#define BENCH_NUMBER_COUNT (sizeof(numberValues) / sizeof(numberValues[0]))
+
+typedef struct {
+	char document[BENCH_DOC_LEN];
+	size_t documentLen;
+	char work[BENCH_DOC_LEN];
+	char keys[BENCH_MAX_KEYS][BENCH_KEY_LEN];
+	int32_t values[BENCH_MAX_KEYS];
+	jsonStruct_t handlers[BENCH_MAX_KEYS];
+	unsigned int keyCount;
+	int32_t tokenCount;
+	HostParameters_t hostParameters;
+	char groupName[BENCH_KEY_LEN];
+	char coreArn[64];
+} JsonContext_t;
+
+static JsonContext_t context;
+static jsmntok_t jobsTokens[BENCH_JOBS_TOKENS];
+
+static size_t _bench_append(char *pBuffer, size_t len, const char *pFormat, ...) {
+	va_list args;
+	int written;
+
+	va_start(args, pFormat);
+	written = vsnprintf(pBuffer + len, BENCH_DOC_LEN - len, pFormat, args);
+	va_end(args);
+	if(written < 0 || (size_t) written >= BENCH_DOC_LEN - len) {
+		fprintf(stderr, "benchmark document too large\n");
+		exit(1);
+	}
+	return len + (size_t) written;
+}
+
+static void _bench_make_keys(unsigned int keyCount) {
+	unsigned int itr;
+
+	context.keyCount = keyCount;
+	for(itr = 0; itr < keyCount; itr++) {
+		snprintf(context.keys[itr], BENCH_KEY_LEN, "key%u", itr);
+		context.values[itr] = (int32_t) itr;
+		context.handlers[itr].pKey = context.keys[itr];
+		context.handlers[itr].pData = &context.values[itr];
+		context.handlers[itr].dataLength = sizeof(int32_t);
+		context.handlers[itr].type = SHADOW_JSON_INT32;
+		context.handlers[itr].cb = NULL;
+	}
+}
+
+/* delta as sent on .../shadow/update/delta, clientToken last so that lookups scan it all */
+static void _bench_make_shadow_delta(unsigned int keyCount) {
+	size_t len = 0;
+	unsigned int itr;
+
+	_bench_make_keys(keyCount);
+	len = _bench_append(context.document, len, "{\"version\":1234,\"timestamp\":1600000000,\"state\":{");
+	for(itr = 0; itr < keyCount; itr++) {
+		len = _bench_append(context.document, len, "%s\"%s\":%u", (0 == itr) ? "" : ",", context.keys[itr], itr * 7);
+	}
+	len = _bench_append(context.document, len, "},\"metadata\":{");
+	for(itr = 0; itr < keyCount; itr++) {
+		len = _bench_append(context.document, len, "%s\"%s\":{\"timestamp\":1600000000}", (0 == itr) ? "" : ",",
+							context.keys[itr]);
+	}
+	context.documentLen = _bench_append(context.document, len, "},\"clientToken\":\"bench-client-42\"}");
+}
+
+/* job execution as received on .../jobs/notify-next, the job document has keyCount keys */
+static void _bench_make_job_execution(unsigned int keyCount) {
+	size_t len = 0;
+	unsigned int itr;
+
+	_bench_make_keys(keyCount);
+	len = _bench_append(context.document, len, "{\"timestamp\":1600000000,\"execution\":{\"jobId\":\"job-1\","
+						"\"status\":\"QUEUED\",\"statusDetails\":{\"step\":\"download\"},\"queuedAt\":1600000000,"
+						"\"lastUpdatedAt\":1600000000,\"versionNumber\":1,\"executionNumber\":1,\"jobDocument\":{");
+	for(itr = 0; itr < keyCount; itr++) {
+		len = _bench_append(context.document, len, "%s\"%s\":\"value-%u\"", (0 == itr) ? "" : ",", context.keys[itr],
+							itr);
+	}
+	context.documentLen = _bench_append(context.document, len, "}}}");
+}
+
+/* status details object with keyCount keys, for the update request */
+static void _bench_make_status_details(unsigned int keyCount) {
+	size_t len = 0;
+	unsigned int itr;
+
+	_bench_make_keys(keyCount);
+	len = _bench_append(context.work, len, "{");
+	for(itr = 0; itr < keyCount; itr++) {
+		len = _bench_append(context.work, len, "%s\"%s\":\"value-%u\"", (0 == itr) ? "" : ",", context.keys[itr], itr);
+	}
+	_bench_append(context.work, len, "}");
+}
+
+/* discovery response, every core has a loopback and a LAN address */
+static void _bench_make_discovery(unsigned int groups, unsigned int cores) {
+	size_t len = 0;
+	unsigned int group;
+	unsigned int core;
+	unsigned int line;
+
+	len = _bench_append(context.document, len, "{\"GGGroups\":[");
+	for(group = 0; group < groups; group++) {
+		len = _bench_append(context.document, len, "%s{\"GGGroupId\":\"group-%u\",\"Cores\":[", (0 == group) ? "" : ",",
+							group);
+		for(core = 0; core < cores; core++) {
+			len = _bench_append(context.document, len,
+								"%s{\"thingArn\":\"arn:aws:iot:us-east-1:123456789012:thing/core-%u-%u\","
+								"\"Connectivity\":[{\"Id\":\"lo\",\"HostAddress\":\"127.0.0.1\",\"PortNumber\":8883,"
+								"\"Metadata\":\"\"},{\"Id\":\"eth0\",\"HostAddress\":\"10.0.%u.%u\",\"PortNumber\":8883,"
+								"\"Metadata\":\"\"}]}", (0 == core) ? "" : ",", group, core, group, core + 1);
+		}
+		len = _bench_append(context.document, len, "],\"CAs\":[\"-----BEGIN CERTIFICATE-----\\n");
+		/* roughly the size of a real group CA */
+		for(line = 0; line < 20; line++) {
+			len = _bench_append(context.document, len,
+								"MIIEFTCCAv2gAwIBAgIVAKTv9wCtsdr5YdOsJXa0SNKYUNEMA0GCSqGSIb3DQEBCwUA\\n");
+		}
+		len = _bench_append(context.document, len, "-----END CERTIFICATE-----\\n\"]}");
+	}
+	context.documentLen = _bench_append(context.document, len, "]}");
+
+	snprintf(context.groupName, sizeof(context.groupName), "group-%u", groups - 1);
+	snprintf(context.coreArn, sizeof(context.coreArn), "arn:aws:iot:us-east-1:123456789012:thing/core-%u-%u",
+			 groups - 1, cores - 1);
+	context.hostParameters.pcGroupName = context.groupName;
+	context.hostParameters.pcCoreAddress = context.coreArn;
+	context.hostParameters.ucInterface = 1;
+}
+
+static void bench_shadow_parse(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		isJsonValidAndParse(pJson->document, pJson->documentLen, NULL, &pJson->tokenCount);
+	}
+	bench_keep((uintptr_t) pJson->tokenCount);
+}
+
+static void bench_shadow_lookup_last(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	jsonStruct_t *pLast = &pJson->handlers[pJson->keyCount - 1];
+	uint32_t dataLength = 0;
+	int32_t dataPosition = 0;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		isJsonKeyMatchingAndUpdateValue(pJson->document, NULL, pJson->tokenCount, pLast, &dataLength, &dataPosition);
+	}
+	bench_keep(dataLength);
+}
+
+/* what the shadow delta callback does: one lookup per registered key */
+static void bench_shadow_update_all(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	uint32_t dataLength = 0;
+	int32_t dataPosition = 0;
+	unsigned int itr;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		for(itr = 0; itr < pJson->keyCount; itr++) {
+			isJsonKeyMatchingAndUpdateValue(pJson->document, NULL, pJson->tokenCount, &pJson->handlers[itr],
+											&dataLength, &dataPosition);
+		}
+	}
+	bench_keep(dataLength);
+}
+
+/* the same work through the hashed delta dispatcher */
+static void bench_shadow_dispatch_all(void *pContext, uint64_t iterations) {
+	static ShadowDeltaKeyIndex_t keyIndex;
+	static int32_t valueTokens[BENCH_MAX_KEYS];
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	uint32_t dataLength = 0;
+	int32_t dataPosition = 0;
+	unsigned int itr;
+	uint64_t i;
+
+	resetDeltaKeyIndex(&keyIndex);
+	for(itr = 0; itr < pJson->keyCount; itr++) {
+		addDeltaKey(&keyIndex, pJson->handlers[itr].pKey);
+	}
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		matchDeltaKeys(pJson->document, pJson->tokenCount, &keyIndex, valueTokens);
+		for(itr = 0; itr < pJson->keyCount; itr++) {
+			if(valueTokens[itr] >= 0) {
+				updateValueFromToken(pJson->document, valueTokens[itr], &pJson->handlers[itr], &dataLength,
+									 &dataPosition);
+			}
+		}
+	}
+	bench_keep(dataLength);
+}
+
+static void bench_shadow_client_token(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	char clientToken[MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE];
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		extractClientToken(pJson->document, pJson->documentLen, clientToken, sizeof(clientToken));
+	}
+	bench_keep((uintptr_t) clientToken[0]);
+}
+
+#define BENCH_H1(p, o) &(p)[o]
+#define BENCH_H4(p, o) BENCH_H1(p, o), BENCH_H1(p, (o) + 1), BENCH_H1(p, (o) + 2), BENCH_H1(p, (o) + 3)
+#define BENCH_H16(p, o) BENCH_H4(p, o), BENCH_H4(p, (o) + 4), BENCH_H4(p, (o) + 8), BENCH_H4(p, (o) + 12)
+#define BENCH_H64(p, o) BENCH_H16(p, o), BENCH_H16(p, (o) + 16), BENCH_H16(p, (o) + 32), BENCH_H16(p, (o) + 48)
+
+static void bench_shadow_add_reported(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	jsonStruct_t *pHandlers = pJson->handlers;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		aws_iot_shadow_init_json_document(pJson->work, sizeof(pJson->work));
+		switch(pJson->keyCount) {
+			case 1:
+				aws_iot_shadow_add_reported(pJson->work, sizeof(pJson->work), 1, BENCH_H1(pHandlers, 0));
+				break;
+			case 4:
+				aws_iot_shadow_add_reported(pJson->work, sizeof(pJson->work), 4, BENCH_H4(pHandlers, 0));
+				break;
+			case 16:
+				aws_iot_shadow_add_reported(pJson->work, sizeof(pJson->work), 16, BENCH_H16(pHandlers, 0));
+				break;
+			default:
+				aws_iot_shadow_add_reported(pJson->work, sizeof(pJson->work), 64, BENCH_H64(pHandlers, 0));
+				break;
+		}
+		aws_iot_finalize_json_document(pJson->work, sizeof(pJson->work));
+	}
+	bench_keep((uintptr_t) pJson->work[0]);
+}
+
+static void bench_jobs_parse_find(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	const char *pLastKey = pJson->keys[pJson->keyCount - 1];
+	jsmntok_t *pToken = NULL;
+	jsmn_parser parser;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		jsmn_init(&parser);
+		if(jsmn_parse(&parser, pJson->document, pJson->documentLen, jobsTokens, BENCH_JOBS_TOKENS) < 0) {
+			continue;
+		}
+		pToken = findToken("execution", pJson->document, jobsTokens);
+		if(NULL != pToken) {
+			pToken = findToken("jobDocument", pJson->document, pToken);
+		}
+		if(NULL != pToken) {
+			pToken = findToken(pLastKey, pJson->document, pToken);
+		}
+	}
+	bench_keep((uintptr_t) pToken);
+}
+
+static void bench_jobs_serialize_update(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	AwsIotJobExecutionUpdateRequest request;
+	int len = 0;
+	uint64_t i;
+
+	memset(&request, 0, sizeof(request));
+	request.status = JOB_EXECUTION_IN_PROGRESS;
+	request.statusDetails = pJson->work;
+	request.expectedVersion = 3;
+	request.executionNumber = 1;
+	request.clientToken = "bench-client-42";
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		len = aws_iot_jobs_json_serialize_update_job_execution_request(pJson->document, sizeof(pJson->document),
+																		&request);
+	}
+	bench_keep((uintptr_t) len);
+}
+
+/* the discovery parser edits the document in place, each operation starts from a fresh copy */
+static void bench_discovery_copy(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		memcpy(pJson->work, pJson->document, pJson->documentLen + 1);
+	}
+	bench_keep((uintptr_t) pJson->work[0]);
+}
+
+static void bench_discovery_auto(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	GGD_HostAddressData_t hostAddressData;
+	BaseType_t status = pdFAIL;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		memcpy(pJson->work, pJson->document, pJson->documentLen + 1);
+		status = GGD_GetIPandCertificateFromJSON(pJson->work, (uint32_t) pJson->documentLen, NULL, &hostAddressData,
+												 pdTRUE);
+	}
+	bench_keep((uintptr_t) status);
+}
+
+static void bench_discovery_manual_last(void *pContext, uint64_t iterations) {
+	JsonContext_t *pJson = (JsonContext_t *) pContext;
+	GGD_HostAddressData_t hostAddressData;
+	BaseType_t status = pdFAIL;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		memcpy(pJson->work, pJson->document, pJson->documentLen + 1);
+		status = GGD_GetIPandCertificateFromJSON(pJson->work, (uint32_t) pJson->documentLen, &pJson->hostParameters,
+												 &hostAddressData, pdFALSE);
+	}
+	bench_keep((uintptr_t) status);
+}
+
+static void bench_number_format_double(void *pContext, uint64_t iterations) {
+	char text[JSON_NUMBER_TEXT_SIZE];
+	size_t len = 0;
+	uint64_t i;
+
+	(void) pContext;
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		len += jsonNumberFormatDouble(text, numberValues[i % BENCH_NUMBER_COUNT]);
+	}
+	bench_keep((uintptr_t) len);
+}
+
+static void bench_number_format_float(void *pContext, uint64_t iterations) {
+	char text[JSON_NUMBER_TEXT_SIZE];
+	size_t len = 0;
+	uint64_t i;
+
+	(void) pContext;
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		len += jsonNumberFormatFloat(text, (float) numberValues[i % BENCH_NUMBER_COUNT]);
+	}
+	bench_keep((uintptr_t) len);
+}
+
+static void bench_number_parse_double(void *pContext, uint64_t iterations) {
+	static char texts[BENCH_NUMBER_COUNT][JSON_NUMBER_TEXT_SIZE];
+	static size_t lengths[BENCH_NUMBER_COUNT];
+	double value = 0.0;
+	double sum = 0.0;
+	uint64_t i;
+
+	(void) pContext;
+	for(i = 0; i < BENCH_NUMBER_COUNT; i++) {
+		lengths[i] = jsonNumberFormatDouble(texts[i], numberValues[i]);
+	}
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		jsonNumberParseDouble(texts[i % BENCH_NUMBER_COUNT], lengths[i % BENCH_NUMBER_COUNT], &value);
+		sum += value;
+	}
+	bench_keep((uintptr_t) sum);
+}
+
+static void bench_number_parse_integer(void *pContext, uint64_t iterations) {
+	static const char *texts[] = {"0", "42", "-17", "1600000000", "65535", "-2147483648"};
+	const char *pText;
+	int64_t value = 0;
+	int64_t sum = 0;
+	uint64_t i;
+
+	(void) pContext;
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		pText = texts[i % (sizeof(texts) / sizeof(texts[0]))];
+		jsonNumberParseInteger(pText, strlen(pText), INT32_MIN, INT32_MAX, &value);
+		sum += value;
+	}
+	bench_keep((uintptr_t) sum);
+}
+
+static void run_number_benchmarks(void) {
+	bench_run(bench_number_format_double, NULL, "number_format_double");
+	bench_run(bench_number_format_float, NULL, "number_format_float");
+	bench_run(bench_number_parse_double, NULL, "number_parse_double");
+	bench_run(bench_number_parse_integer, NULL, "number_parse_integer");
+}
+
+static void run_shadow_benchmarks(void) {
+	size_t itr;
+	unsigned int keys;
+
+	for(itr = 0; itr < sizeof(shadowKeyCounts) / sizeof(shadowKeyCounts[0]); itr++) {
+		keys = shadowKeyCounts[itr];
+		_bench_make_shadow_delta(keys);
+		if(!isJsonValidAndParse(context.document, context.documentLen, NULL, &context.tokenCount)) {
+			fprintf(stderr, "shadow delta with %u keys does not parse\n", keys);
+			exit(1);
+		}
+		bench_run(bench_shadow_parse, &context, "shadow_parse/keys=%u/bytes=%zu", keys, context.documentLen);
+		bench_run(bench_shadow_lookup_last, &context, "shadow_lookup_last/keys=%u", keys);
+		bench_run(bench_shadow_update_all, &context, "shadow_update_all/keys=%u", keys);
+		bench_run(bench_shadow_dispatch_all, &context, "shadow_dispatch_all/keys=%u", keys);
+		bench_run(bench_shadow_client_token, &context, "shadow_client_token/keys=%u", keys);
+	}
+	for(itr = 0; itr < sizeof(reportedKeyCounts) / sizeof(reportedKeyCounts[0]); itr++) {
+		_bench_make_keys(reportedKeyCounts[itr]);
+		bench_run(bench_shadow_add_reported, &context, "shadow_add_reported/keys=%u", reportedKeyCounts[itr]);
+	}
+}
+
+static void run_jobs_benchmarks(void) {
+	size_t itr;
+	unsigned int keys;
+
+	for(itr = 0; itr < sizeof(shadowKeyCounts) / sizeof(shadowKeyCounts[0]); itr++) {
+		keys = shadowKeyCounts[itr];
+		_bench_make_job_execution(keys);
+		bench_run(bench_jobs_parse_find, &context, "jobs_parse_find/keys=%u/bytes=%zu", keys, context.documentLen);
+		_bench_make_status_details(keys);
+		bench_run(bench_jobs_serialize_update, &context, "jobs_serialize_update/keys=%u", keys);
+	}
+}
+
+static void run_discovery_benchmarks(void) {
+	size_t groupItr;
+	size_t coreItr;
+	unsigned int groups;
+	unsigned int cores;
+
+	for(groupItr = 0; groupItr < sizeof(discoveryGroups) / sizeof(discoveryGroups[0]); groupItr++) {
+		for(coreItr = 0; coreItr < sizeof(discoveryCores) / sizeof(discoveryCores[0]); coreItr++) {
+			groups = discoveryGroups[groupItr];
+			cores = discoveryCores[coreItr];
+			_bench_make_discovery(groups, cores);
+			bench_run(bench_discovery_copy, &context, "discovery_copy/groups=%u/cores=%u/bytes=%zu", groups, cores,
+					  context.documentLen);
+			bench_run(bench_discovery_auto, &context, "discovery_auto/groups=%u/cores=%u", groups, cores);
+			bench_run(bench_discovery_manual_last, &context, "discovery_manual_last/groups=%u/cores=%u", groups,
+					  cores);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	bench_init(argc, argv);
+
+	run_number_benchmarks();
+	run_shadow_benchmarks();
+	run_jobs_benchmarks();
+	run_discovery_benchmarks();
+	return 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file bench_mqtt_codec.c
+ * @brief Micro-benchmarks of the MQTT packet codec and of the topic matching
+ *
+ * Usage: iot_bench_mqtt [filter]
+ *
+ * The serializer, the topic matcher and the dispatcher are static, so this file
+ * includes the two sources defining them. The rest of the client comes from the
+ * aws_iot_mqtt archive: its publish and common_internal members only define
+ * symbols that are already defined here, so the linker never pulls them in.
+ */
+
+#include "../../src/aws_iot_mqtt_client_common_internal.c"
+#include "../../src/aws_iot_mqtt_client_publish.c"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define BENCH_TOPIC_LEN 256
+#define BENCH_PACKET_LEN (AWS_IOT_MQTT_TX_BUF_LEN)
+
+static const size_t payloadSizes[] = {16, 256, 1024, 3072};
+static const unsigned int topicDepths[] = {1, 4, 8};
+static const uint32_t remainingLengths[] = {100, 10000, 1000000, 100000000};
+static const unsigned int handlerCounts[] = {1, 8, 32, AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS};
+
+typedef struct {
+	char topic[BENCH_TOPIC_LEN];
+	uint16_t topicLen;
+	unsigned char payload[BENCH_PACKET_LEN];
+	size_t payloadLen;
+	unsigned char packet[BENCH_PACKET_LEN];
+	uint32_t packetLen;
+} PublishContext_t;
+
+typedef struct {
+	unsigned char encoded[4];
+	uint32_t length;
+} RemainingLengthContext_t;
+
+typedef struct {
+	char filter[BENCH_TOPIC_LEN];
+	char topic[BENCH_TOPIC_LEN];
+	uint16_t topicLen;
+} TopicMatchContext_t;
+
+typedef struct {
+	AWS_IoT_Client client;
+	char filters[AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS][BENCH_TOPIC_LEN];
+	char topic[BENCH_TOPIC_LEN];
+	uint16_t topicLen;
+	IoT_Publish_Message_Params params;
+	uint64_t calls;
+} DeliverContext_t;
+
+static PublishContext_t publishContext;
+static DeliverContext_t deliverContext;
+
+/* "device/level1/level2/..." with depth levels */
+static uint16_t _bench_make_topic(char *pTopic, unsigned int depth, const char *pLast) {
+	int len = snprintf(pTopic, BENCH_TOPIC_LEN, "device");
+	unsigned int level;
+
+	for(level = 1; level < depth; level++) {
+		len += snprintf(pTopic + len, (size_t) (BENCH_TOPIC_LEN - len), "/level%u", level);
+	}
+	if(NULL != pLast) {
+		len += snprintf(pTopic + len, (size_t) (BENCH_TOPIC_LEN - len), "/%s", pLast);
+	}
+	return (uint16_t) len;
+}
+
+static void bench_serialize_publish(void *pContext, uint64_t iterations) {
+	PublishContext_t *pPublish = (PublishContext_t *) pContext;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		_aws_iot_mqtt_internal_serialize_publish(pPublish->packet, sizeof(pPublish->packet), 0, QOS1, 0,
+												 (uint16_t) i, pPublish->topic, pPublish->topicLen,
+												 pPublish->payload, pPublish->payloadLen, &pPublish->packetLen);
+	}
+	bench_keep(pPublish->packetLen);
+}
+
+static void bench_deserialize_publish(void *pContext, uint64_t iterations) {
+	PublishContext_t *pPublish = (PublishContext_t *) pContext;
+	uint8_t dup, retained;
+	QoS qos;
+	uint16_t packetId, topicLen;
+	char *pTopic;
+	unsigned char *pPayload;
+	size_t payloadLen = 0;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		aws_iot_mqtt_internal_deserialize_publish(&dup, &qos, &retained, &packetId, &pTopic, &topicLen,
+												  &pPayload, &payloadLen, pPublish->packet, pPublish->packetLen);
+	}
+	bench_keep(payloadLen);
+}
+
+static void bench_encode_remaining_length(void *pContext, uint64_t iterations) {
+	RemainingLengthContext_t *pLength = (RemainingLengthContext_t *) pContext;
+	size_t len = 0;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		len += aws_iot_mqtt_internal_write_len_to_buffer(pLength->encoded, pLength->length);
+	}
+	bench_keep(len);
+}
+
+static void bench_decode_remaining_length(void *pContext, uint64_t iterations) {
+	RemainingLengthContext_t *pLength = (RemainingLengthContext_t *) pContext;
+	uint32_t decodedLen = 0;
+	uint32_t readBytesLen = 0;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		aws_iot_mqtt_internal_decode_remaining_length_from_buffer(pLength->encoded, &decodedLen, &readBytesLen);
+	}
+	bench_keep(decodedLen + readBytesLen);
+}
+
+static void bench_topic_match(void *pContext, uint64_t iterations) {
+	TopicMatchContext_t *pMatch = (TopicMatchContext_t *) pContext;
+	uint64_t matches = 0;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		matches += _aws_iot_mqtt_internal_is_topic_matched(pMatch->filter, pMatch->topic, pMatch->topicLen);
+	}
+	bench_keep(matches);
+}
+
+static void bench_deliver_handler(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+								  IoT_Publish_Message_Params *pParams, void *pData) {
+	(void) pClient;
+	(void) pTopicName;
+	(void) topicNameLen;
+	(void) pParams;
+	((DeliverContext_t *) pData)->calls++;
+}
+
+static void bench_deliver_message(void *pContext, uint64_t iterations) {
+	DeliverContext_t *pDeliver = (DeliverContext_t *) pContext;
+	uint64_t i;
+
+	for(i = 0; i < iterations; i++) {
+		BENCH_CLOBBER();
+		_aws_iot_mqtt_internal_deliver_message(&pDeliver->client, pDeliver->topic, pDeliver->topicLen,
+											   &pDeliver->params, false);
+	}
+	bench_keep(pDeliver->calls);
+}
+
+static void run_publish_benchmarks(void) {
+	size_t sizeItr;
+	size_t depthItr;
+
+	memset(publishContext.payload, 'x', sizeof(publishContext.payload));
+	for(depthItr = 0; depthItr < sizeof(topicDepths) / sizeof(topicDepths[0]); depthItr++) {
+		for(sizeItr = 0; sizeItr < sizeof(payloadSizes) / sizeof(payloadSizes[0]); sizeItr++) {
+			publishContext.topicLen = _bench_make_topic(publishContext.topic, topicDepths[depthItr], NULL);
+			publishContext.payloadLen = payloadSizes[sizeItr];
+			bench_run(bench_serialize_publish, &publishContext, "serialize_publish/depth=%u/payload=%zu",
+					  topicDepths[depthItr], payloadSizes[sizeItr]);
+			bench_run(bench_deserialize_publish, &publishContext, "deserialize_publish/depth=%u/payload=%zu",
+					  topicDepths[depthItr], payloadSizes[sizeItr]);
+		}
+	}
+}
+
+static void run_remaining_length_benchmarks(void) {
+	RemainingLengthContext_t lengthContext;
+	size_t itr;
+	size_t len;
+
+	for(itr = 0; itr < sizeof(remainingLengths) / sizeof(remainingLengths[0]); itr++) {
+		lengthContext.length = remainingLengths[itr];
+		len = aws_iot_mqtt_internal_write_len_to_buffer(lengthContext.encoded, lengthContext.length);
+		bench_run(bench_encode_remaining_length, &lengthContext, "remaining_length_encode/bytes=%zu", len);
+		bench_run(bench_decode_remaining_length, &lengthContext, "remaining_length_decode/bytes=%zu", len);
+	}
+}
+
+static void run_topic_match_benchmarks(void) {
+	TopicMatchContext_t matchContext;
+	size_t depthItr;
+	unsigned int depth;
+
+	for(depthItr = 0; depthItr < sizeof(topicDepths) / sizeof(topicDepths[0]); depthItr++) {
+		depth = topicDepths[depthItr];
+		matchContext.topicLen = _bench_make_topic(matchContext.topic, depth, "last");
+
+		_bench_make_topic(matchContext.filter, depth, "last");
+		bench_run(bench_topic_match, &matchContext, "topic_match/depth=%u/exact", depth + 1);
+
+		_bench_make_topic(matchContext.filter, depth, "+");
+		bench_run(bench_topic_match, &matchContext, "topic_match/depth=%u/plus", depth + 1);
+
+		snprintf(matchContext.filter, sizeof(matchContext.filter), "device/#");
+		bench_run(bench_topic_match, &matchContext, "topic_match/depth=%u/hash", depth + 1);
+
+		_bench_make_topic(matchContext.filter, depth, "other");
+		bench_run(bench_topic_match, &matchContext, "topic_match/depth=%u/miss", depth + 1);
+	}
+}
+
+static int run_deliver_benchmarks(void) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	DeliverContext_t *pDeliver = &deliverContext;
+	size_t countItr;
+	size_t depthItr;
+	unsigned int handlers;
+	unsigned int itr;
+
+	initParams.pHostURL = "localhost";
+	initParams.port = 8883;
+	initParams.pRootCALocation = "";
+	initParams.pDeviceCertLocation = "";
+	initParams.pDevicePrivateKeyLocation = "";
+	if(SUCCESS != aws_iot_mqtt_init(&pDeliver->client, &initParams)) {
+		fprintf(stderr, "aws_iot_mqtt_init failed\n");
+		return 1;
+	}
+	pDeliver->client.clientStatus.clientState = CLIENT_STATE_CONNECTED_IDLE;
+	pDeliver->params.qos = QOS0;
+	pDeliver->params.payload = publishContext.payload;
+	pDeliver->params.payloadLen = 16;
+
+	for(depthItr = 0; depthItr < sizeof(topicDepths) / sizeof(topicDepths[0]); depthItr++) {
+		pDeliver->topicLen = _bench_make_topic(pDeliver->topic, topicDepths[depthItr], "last");
+		for(countItr = 0; countItr < sizeof(handlerCounts) / sizeof(handlerCounts[0]); countItr++) {
+			handlers = handlerCounts[countItr];
+			/* handlers - 1 filters that do not match, and the matching wildcard filter last */
+			for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; itr++) {
+				ClientData *pData = &pDeliver->client.clientData;
+
+				if(itr + 1 < handlers) {
+					snprintf(pDeliver->filters[itr], BENCH_TOPIC_LEN, "device/other%u/+", itr);
+				} else if(itr + 1 == handlers) {
+					_bench_make_topic(pDeliver->filters[itr], topicDepths[depthItr], "+");
+				}
+				pData->messageHandlers[itr].topicName = (itr < handlers) ? pDeliver->filters[itr] : NULL;
+				pData->messageHandlers[itr].topicNameLen = (itr < handlers) ?
+														   (uint16_t) strlen(pDeliver->filters[itr]) : 0;
+				pData->messageHandlers[itr].pApplicationHandler = bench_deliver_handler;
+				pData->messageHandlers[itr].pApplicationHandlerData = pDeliver;
+			}
+			bench_run(bench_deliver_message, pDeliver, "deliver_message/depth=%u/handlers=%u",
+					  topicDepths[depthItr] + 1, handlers);
+		}
+	}
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	bench_init(argc, argv);
+
+	run_publish_benchmarks();
+	run_remaining_length_benchmarks();
+	run_topic_match_benchmarks();
+	return run_deliver_benchmarks();
+}
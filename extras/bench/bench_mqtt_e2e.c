@@ -0,0 +1,204 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file bench_mqtt_e2e.c
+ * @brief End-to-end MQTT benchmark over the loopback Network and the fake broker
+ *
+ * Usage: iot_bench_mqtt_e2e [filter]
+ *
+ * One client connects to an in-process broker, subscribes to a topic and
+ * publishes to it in a loop, each publish followed by a yield. The payload
+ * carries the send time, the subscription callback records the latency. For
+ * every QoS and payload size the run lasts IOT_BENCH_MIN_MS (200 ms by
+ * default) and reports messages per second, p50/p99 publish-to-callback
+ * latency and heap allocations per message. No TLS and no socket are
+ * involved: this is the cost of the client code itself.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "network_loopback.h"
+
+#include "bench.h"
+
+#define BENCH_MAX_SAMPLES (1024 * 1024)
+#define BENCH_MIN_MESSAGES 1000
+
+static const size_t payloadSizes[] = {16, 256, 1024, 3072};
+static const QoS qosLevels[] = {QOS0, QOS1};
+
+typedef struct {
+	AWS_IoT_Client client;
+	IoT_Fake_Broker broker;
+	unsigned char payload[AWS_IOT_MQTT_TX_BUF_LEN];
+	uint64_t *pLatencies;
+	size_t latencyCount;
+	uint64_t delivered;
+} E2EContext_t;
+
+static E2EContext_t context;
+
+static int _bench_compare_u64(const void *pA, const void *pB) {
+	uint64_t a = *(const uint64_t *) pA;
+	uint64_t b = *(const uint64_t *) pB;
+
+	return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+static double _bench_percentile_us(uint64_t *pSorted, size_t count, unsigned int percent) {
+	size_t index;
+
+	if(0 == count) {
+		return 0.0;
+	}
+	index = (count * percent) / 100;
+	if(index >= count) {
+		index = count - 1;
+	}
+	return (double) pSorted[index] / 1000.0;
+}
+
+static void bench_e2e_callback(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+							   IoT_Publish_Message_Params *pParams, void *pData) {
+	E2EContext_t *pContext = (E2EContext_t *) pData;
+	uint64_t sentAt;
+
+	(void) pClient;
+	(void) pTopicName;
+	(void) topicNameLen;
+
+	pContext->delivered++;
+	if(pParams->payloadLen < sizeof(sentAt) || pContext->latencyCount == BENCH_MAX_SAMPLES) {
+		return;
+	}
+	memcpy(&sentAt, pParams->payload, sizeof(sentAt));
+	pContext->pLatencies[pContext->latencyCount++] = bench_now_ns() - sentAt;
+}
+
+static IoT_Error_t _bench_connect(E2EContext_t *pContext, const char *pTopic, QoS qos) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Error_t rc;
+
+	initParams.pHostURL = "loopback";
+	initParams.port = 8883;
+	initParams.pRootCALocation = "";
+	initParams.pDeviceCertLocation = "";
+	initParams.pDevicePrivateKeyLocation = "";
+	initParams.mqttCommandTimeout_ms = 1000;
+
+	connectParams.pClientID = "bench-e2e";
+	connectParams.clientIDLen = (uint16_t) strlen(connectParams.pClientID);
+	connectParams.keepAliveIntervalInSec = 600;
+
+	aws_iot_fake_broker_init(&pContext->broker);
+	rc = aws_iot_mqtt_init(&pContext->client, &initParams);
+	if(SUCCESS == rc) {
+		rc = aws_iot_loopback_network_init(&pContext->client.networkStack, &pContext->broker);
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_connect(&pContext->client, &connectParams);
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_subscribe(&pContext->client, pTopic, (uint16_t) strlen(pTopic), qos, bench_e2e_callback,
+									pContext);
+	}
+	return rc;
+}
+
+static void run_e2e(QoS qos, size_t payloadLen) {
+	E2EContext_t *pContext = &context;
+	IoT_Publish_Message_Params params;
+	char name[64];
+	char topic[32];
+	uint64_t sent = 0;
+	uint64_t allocationsBefore;
+	uint64_t start;
+	uint64_t elapsed;
+	uint64_t sentAt;
+	IoT_Error_t rc;
+
+	snprintf(name, sizeof(name), "e2e/qos=%d/payload=%zu", (int) qos, payloadLen);
+	if(!bench_is_selected(name)) {
+		return;
+	}
+	snprintf(topic, sizeof(topic), "bench/e2e/qos%d", (int) qos);
+
+	rc = _bench_connect(pContext, topic, qos);
+	if(SUCCESS != rc) {
+		fprintf(stderr, "%s: connect/subscribe failed, rc %d\n", name, rc);
+		exit(1);
+	}
+
+	memset(&params, 0, sizeof(params));
+	params.qos = qos;
+	params.payload = pContext->payload;
+	params.payloadLen = payloadLen;
+	memset(pContext->payload, 'x', payloadLen);
+	pContext->latencyCount = 0;
+	pContext->delivered = 0;
+
+	allocationsBefore = bench_allocations();
+	start = bench_now_ns();
+	do {
+		sentAt = bench_now_ns();
+		memcpy(pContext->payload, &sentAt, sizeof(sentAt));
+		rc = aws_iot_mqtt_publish(&pContext->client, topic, (uint16_t) strlen(topic), &params);
+		if(SUCCESS == rc) {
+			rc = aws_iot_mqtt_yield(&pContext->client, 1);
+		}
+		if(SUCCESS != rc) {
+			fprintf(stderr, "%s: publish/yield failed, rc %d\n", name, rc);
+			exit(1);
+		}
+		sent++;
+		elapsed = bench_now_ns() - start;
+	} while(elapsed < bench_duration_ns() || sent < BENCH_MIN_MESSAGES);
+
+	qsort(pContext->pLatencies, pContext->latencyCount, sizeof(uint64_t), _bench_compare_u64);
+	printf("%-32s %12.0f %10.2f %10.2f %10.2f %8llu\n", name, (double) pContext->delivered * 1e9 / (double) elapsed,
+		   _bench_percentile_us(pContext->pLatencies, pContext->latencyCount, 50),
+		   _bench_percentile_us(pContext->pLatencies, pContext->latencyCount, 99),
+		   (double) (bench_allocations() - allocationsBefore) / (double) sent,
+		   (unsigned long long) (sent - pContext->delivered));
+
+	aws_iot_mqtt_disconnect(&pContext->client);
+	aws_iot_mqtt_free(&pContext->client);
+}
+
+int main(int argc, char **argv) {
+	size_t qosItr;
+	size_t sizeItr;
+
+	bench_init(argc, argv);
+	context.pLatencies = (uint64_t *) malloc(BENCH_MAX_SAMPLES * sizeof(uint64_t));
+	if(NULL == context.pLatencies) {
+		return 1;
+	}
+
+	printf("%-32s %12s %10s %10s %10s %8s\n", "benchmark", "msgs/s", "p50 us", "p99 us", "allocs/msg", "lost");
+	for(qosItr = 0; qosItr < sizeof(qosLevels) / sizeof(qosLevels[0]); qosItr++) {
+		for(sizeItr = 0; sizeItr < sizeof(payloadSizes) / sizeof(payloadSizes[0]); sizeItr++) {
+			run_e2e(qosLevels[qosItr], payloadSizes[sizeItr]);
+		}
+	}
+
+	free(context.pLatencies);
+	return 0;
+}
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file bench_mqtt_impaired.c
+ * @brief MQTT client behavior over an impaired link: throughput, reconnects, keep-alive
+ *
+ * Usage: iot_bench_mqtt_impaired [filter]
+ *
+ * One client talks to the in-process fake broker through the loopback
+ * Network wrapped by the impairment decorator, for a few link profiles from
+ * a clean link to a lossy Wi-Fi one. For each profile:
+ *
+ * - qos1: QoS 1 publishes to a subscribed topic for IOT_BENCH_MIN_MS (2 s at
+ *   least), each followed by a short yield. Reports acknowledged publishes per
+ *   second, p50/p99 publish-to-callback latency and failed publishes;
+ * - reconnect: the broker drops the connection, the client reconnects on its
+ *   own from yield. Reports the mean and worst time to be connected again;
+ * - keepalive: an idle client with a 1 s keep-alive yields for 5 s. Reports
+ *   the pings sent and answered and the disconnections they caused.
+ *
+ * The impairments are seeded, a run is reproducible up to the scheduling of
+ * the host. This runs in real time, about 10 s per profile.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "network_impaired.h"
+#include "network_loopback.h"
+#include "timer_host.h"
+
+#include "bench.h"
+
+#define BENCH_MAX_SAMPLES (64 * 1024)
+#define BENCH_MIN_DURATION_NS 2000000000ULL
+#define BENCH_RECONNECTS 5
+#define BENCH_RECONNECT_LIMIT_NS 30000000000ULL
+#define BENCH_KEEPALIVE_NS 5000000000ULL
+#define BENCH_PAYLOAD_LEN 256
+#define BENCH_PINGREQ 12
+#define BENCH_PINGRESP 13
+
+typedef struct {
+	const char *pName;
+	IoT_Impairment_Params params;
+} ImpairmentProfile_t;
+
+/* seed, latency, jitter, bandwidth, stall chance and length, partial writes, read and write errors */
+static const ImpairmentProfile_t profiles[] = {
+	{"clean", {1, 0, 0, 0, 0, 0, 0, 0, 0}},
+	{"wifi-good", {1, 10, 10, 250000, 0, 0, 0, 0, 0}},
+	{"wifi-busy", {1, 40, 60, 60000, 5, 200, 50, 0, 0}},
+	{"wifi-bad", {1, 80, 120, 20000, 20, 500, 100, 10, 10}},
+};
+
+typedef struct {
+	AWS_IoT_Client client;
+	IoT_Fake_Broker broker;
+	IoT_Impaired_Network impaired;
+	unsigned char payload[BENCH_PAYLOAD_LEN];
+	uint64_t latencies[BENCH_MAX_SAMPLES];
+	size_t latencyCount;
+	uint64_t delivered;
+} ImpairedContext_t;
+
+static ImpairedContext_t context;
+
+static int _bench_compare_u64(const void *pA, const void *pB) {
+	uint64_t a = *(const uint64_t *) pA;
+	uint64_t b = *(const uint64_t *) pB;
+
+	return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+static double _bench_percentile_ms(uint64_t *pSorted, size_t count, unsigned int percent) {
+	size_t index;
+
+	if(0 == count) {
+		return 0.0;
+	}
+	index = (count * percent) / 100;
+	if(index >= count) {
+		index = count - 1;
+	}
+	return (double) pSorted[index] / 1e6;
+}
+
+static void bench_impaired_callback(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+									IoT_Publish_Message_Params *pParams, void *pData) {
+	ImpairedContext_t *pContext = (ImpairedContext_t *) pData;
+	uint64_t sentAt;
+
+	(void) pClient;
+	(void) pTopicName;
+	(void) topicNameLen;
+
+	pContext->delivered++;
+	if(pParams->payloadLen < sizeof(sentAt) || pContext->latencyCount == BENCH_MAX_SAMPLES) {
+		return;
+	}
+	memcpy(&sentAt, pParams->payload, sizeof(sentAt));
+	pContext->latencies[pContext->latencyCount++] = bench_now_ns() - sentAt;
+}
+
+static IoT_Error_t _bench_connect(ImpairedContext_t *pContext, const ImpairmentProfile_t *pProfile,
+								  uint16_t keepAliveSec, const char *pTopic) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Error_t rc;
+
+	initParams.enableAutoReconnect = false;
+	initParams.pHostURL = "loopback";
+	initParams.port = 8883;
+	initParams.pRootCALocation = "";
+	initParams.pDeviceCertLocation = "";
+	initParams.pDevicePrivateKeyLocation = "";
+	initParams.mqttCommandTimeout_ms = 2000;
+
+	connectParams.pClientID = "bench-impaired";
+	connectParams.clientIDLen = (uint16_t) strlen(connectParams.pClientID);
+	connectParams.keepAliveIntervalInSec = keepAliveSec;
+
+	aws_iot_fake_broker_init(&pContext->broker);
+	rc = aws_iot_mqtt_init(&pContext->client, &initParams);
+	if(SUCCESS == rc) {
+		rc = aws_iot_loopback_network_init(&pContext->client.networkStack, &pContext->broker);
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_impaired_network_init(&pContext->client.networkStack, &pContext->impaired, &pProfile->params);
+	}
+	/* the link is only impaired once the session is up, as with a device already on the network */
+	if(SUCCESS == rc) {
+		IoT_Impairment_Params clean;
+
+		memset(&clean, 0, sizeof(clean));
+		aws_iot_impaired_network_set_params(&pContext->impaired, &clean);
+		rc = aws_iot_mqtt_connect(&pContext->client, &connectParams);
+	}
+	if(SUCCESS == rc && NULL != pTopic) {
+		rc = aws_iot_mqtt_subscribe(&pContext->client, pTopic, (uint16_t) strlen(pTopic), QOS1,
+									bench_impaired_callback, pContext);
+	}
+	if(SUCCESS == rc) {
+		aws_iot_mqtt_autoreconnect_set_status(&pContext->client, true);
+		aws_iot_impaired_network_set_params(&pContext->impaired, &pProfile->params);
+	}
+	return rc;
+}
+
+static void _bench_close(ImpairedContext_t *pContext) {
+	aws_iot_mqtt_disconnect(&pContext->client);
+	aws_iot_mqtt_free(&pContext->client);
+}
+
+static void run_qos1(const ImpairmentProfile_t *pProfile) {
+	ImpairedContext_t *pContext = &context;
+	IoT_Publish_Message_Params params;
+	const char *pTopic = "bench/impaired";
+	uint64_t duration = bench_duration_ns();
+	uint64_t acked = 0;
+	uint64_t failed = 0;
+	uint64_t elapsed;
+	uint64_t start;
+	uint64_t sentAt;
+	char name[64];
+
+	snprintf(name, sizeof(name), "impaired/%s/qos1", pProfile->pName);
+	if(!bench_is_selected(name)) {
+		return;
+	}
+	if(SUCCESS != _bench_connect(pContext, pProfile, 600, pTopic)) {
+		fprintf(stderr, "%s: connect/subscribe failed\n", name);
+		exit(1);
+	}
+
+	memset(&params, 0, sizeof(params));
+	params.qos = QOS1;
+	params.payload = pContext->payload;
+	params.payloadLen = sizeof(pContext->payload);
+	memset(pContext->payload, 'x', sizeof(pContext->payload));
+	pContext->latencyCount = 0;
+	pContext->delivered = 0;
+	if(duration < BENCH_MIN_DURATION_NS) {
+		duration = BENCH_MIN_DURATION_NS;
+	}
+
+	start = bench_now_ns();
+	do {
+		sentAt = bench_now_ns();
+		memcpy(pContext->payload, &sentAt, sizeof(sentAt));
+		if(SUCCESS == aws_iot_mqtt_publish(&pContext->client, pTopic, (uint16_t) strlen(pTopic), &params)) {
+			acked++;
+		} else {
+			failed++;
+		}
+		/* also drives the reconnects after an injected error */
+		aws_iot_mqtt_yield(&pContext->client, 5);
+		elapsed = bench_now_ns() - start;
+	} while(elapsed < duration);
+
+	qsort(pContext->latencies, pContext->latencyCount, sizeof(uint64_t), _bench_compare_u64);
+	printf("%-32s %10.0f %10.2f %10.2f %8llu %8llu\n", name, (double) acked * 1e9 / (double) elapsed,
+		   _bench_percentile_ms(pContext->latencies, pContext->latencyCount, 50),
+		   _bench_percentile_ms(pContext->latencies, pContext->latencyCount, 99), (unsigned long long) failed,
+		   (unsigned long long) pContext->client.clientData.counterNetworkDisconnected);
+	_bench_close(pContext);
+}
+
+static void run_reconnect(const ImpairmentProfile_t *pProfile) {
+	ImpairedContext_t *pContext = &context;
+	uint64_t total = 0;
+	uint64_t worst = 0;
+	uint64_t elapsed;
+	uint64_t start;
+	uint32_t disconnects;
+	unsigned int reconnected = 0;
+	unsigned int i;
+	char name[64];
+
+	snprintf(name, sizeof(name), "impaired/%s/reconnect", pProfile->pName);
+	if(!bench_is_selected(name)) {
+		return;
+	}
+	if(SUCCESS != _bench_connect(pContext, pProfile, 600, NULL)) {
+		fprintf(stderr, "%s: connect failed\n", name);
+		exit(1);
+	}
+
+	for(i = 0; i < BENCH_RECONNECTS; i++) {
+		disconnects = pContext->client.clientData.counterNetworkDisconnected;
+		aws_iot_fake_broker_close_all(&pContext->broker);
+		start = bench_now_ns();
+		/* the drop is noticed on the next read, then the client reconnects from yield */
+		do {
+			aws_iot_mqtt_yield(&pContext->client, 10);
+			elapsed = bench_now_ns() - start;
+		} while((disconnects == pContext->client.clientData.counterNetworkDisconnected ||
+				 !aws_iot_mqtt_is_client_connected(&pContext->client)) &&
+				elapsed < BENCH_RECONNECT_LIMIT_NS);
+		if(aws_iot_mqtt_is_client_connected(&pContext->client)) {
+			reconnected++;
+			total += elapsed;
+			if(elapsed > worst) {
+				worst = elapsed;
+			}
+		}
+	}
+
+	printf("%-32s %10u %10.2f %10.2f\n", name, reconnected,
+		   (0 == reconnected) ? 0.0 : (double) total / 1e6 / reconnected, (double) worst / 1e6);
+	_bench_close(pContext);
+}
+
+static void run_keepalive(const ImpairmentProfile_t *pProfile) {
+	ImpairedContext_t *pContext = &context;
+	IoT_Client_Metrics metrics;
+	uint64_t start;
+	char name[64];
+
+	snprintf(name, sizeof(name), "impaired/%s/keepalive", pProfile->pName);
+	if(!bench_is_selected(name)) {
+		return;
+	}
+	if(SUCCESS != _bench_connect(pContext, pProfile, 1, NULL)) {
+		fprintf(stderr, "%s: connect failed\n", name);
+		exit(1);
+	}
+
+	start = bench_now_ns();
+	while(bench_now_ns() - start < BENCH_KEEPALIVE_NS) {
+		aws_iot_mqtt_yield(&pContext->client, 50);
+		/* an idle loopback read returns at once, do not spin */
+		aws_iot_host_sleep_ms(10);
+	}
+
+	aws_iot_mqtt_get_metrics(&pContext->client, &metrics);
+	printf("%-32s %10u %10u %10u\n", name, metrics.packetsOut[BENCH_PINGREQ], metrics.packetsIn[BENCH_PINGRESP],
+		   pContext->client.clientData.counterNetworkDisconnected);
+	_bench_close(pContext);
+}
+
+int main(int argc, char **argv) {
+	size_t i;
+
+	bench_init(argc, argv);
+
+	printf("%-32s %10s %10s %10s %8s %8s\n", "qos1", "acked/s", "p50 ms", "p99 ms", "failed", "drops");
+	for(i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+		run_qos1(&profiles[i]);
+	}
+	printf("\n%-32s %10s %10s %10s\n", "reconnect", "done", "mean ms", "worst ms");
+	for(i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+		run_reconnect(&profiles[i]);
+	}
+	printf("\n%-32s %10s %10s %10s\n", "keepalive", "pings", "answered", "drops");
+	for(i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+		run_keepalive(&profiles[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file bench_mqtt_virtual.c
+ * @brief Multi-hour MQTT client scenarios on the virtual clock
+ *
+ * Usage: iot_bench_mqtt_virtual [filter]
+ *
+ * One client talks to the in-process fake broker through the loopback
+ * Network while the host clock is virtual. The loop yields, then jumps to the
+ * next timer deadline, so simulated hours take milliseconds of CPU:
+ *
+ * - keepalive: an idle client with a 600 s keep-alive for 24 h. Reports the
+ *   pings sent and answered and the disconnections;
+ * - outage: the broker refuses sessions for 2 h then comes back. Reports the
+ *   reconnect attempts, the shortest and longest back-off wait and the time
+ *   to be connected again after the broker came back.
+ *
+ * Each scenario prints a digest of the simulated times of its events: it is
+ * the same on every run and every host.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "network_loopback.h"
+#include "timer_host.h"
+
+#include "bench.h"
+
+#define VIRTUAL_START_MS 1000
+#define VIRTUAL_DAY_MS (24U * 3600U * 1000U)
+#define VIRTUAL_OUTAGE_MS (2U * 3600U * 1000U)
+#define VIRTUAL_RECOVERY_LIMIT_MS (3600U * 1000U)
+#define VIRTUAL_PINGREQ 12
+#define VIRTUAL_PINGRESP 13
+
+typedef struct {
+	AWS_IoT_Client client;
+	IoT_Fake_Broker broker;
+	uint64_t digest;
+	uint32_t events;
+} VirtualContext_t;
+
+static VirtualContext_t context;
+
+/* FNV-1a over the simulated time and kind of each event */
+static void _virtual_record(VirtualContext_t *pContext, uint32_t kind) {
+	uint32_t words[2];
+	const unsigned char *pByte = (const unsigned char *) words;
+	size_t i;
+
+	words[0] = aws_iot_host_now_ms() - VIRTUAL_START_MS;
+	words[1] = kind;
+	for(i = 0; i < sizeof(words); i++) {
+		pContext->digest = (pContext->digest ^ pByte[i]) * 1099511628211ULL;
+	}
+	pContext->events++;
+}
+
+static IoT_Error_t _virtual_connect(VirtualContext_t *pContext, uint16_t keepAliveSec) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Error_t rc;
+
+	initParams.enableAutoReconnect = false;
+	initParams.pHostURL = "loopback";
+	initParams.port = 8883;
+	initParams.pRootCALocation = "";
+	initParams.pDeviceCertLocation = "";
+	initParams.pDevicePrivateKeyLocation = "";
+	initParams.mqttCommandTimeout_ms = 20000;
+
+	connectParams.pClientID = "bench-virtual";
+	connectParams.clientIDLen = (uint16_t) strlen(connectParams.pClientID);
+	connectParams.keepAliveIntervalInSec = keepAliveSec;
+
+	/* before aws_iot_mqtt_init, which arms the client timers */
+	aws_iot_host_clock_use_virtual(VIRTUAL_START_MS);
+	pContext->digest = 1469598103934665603ULL;
+	pContext->events = 0;
+
+	aws_iot_fake_broker_init(&pContext->broker);
+	rc = aws_iot_mqtt_init(&pContext->client, &initParams);
+	if(SUCCESS == rc) {
+		rc = aws_iot_loopback_network_init(&pContext->client.networkStack, &pContext->broker);
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_connect(&pContext->client, &connectParams);
+	}
+	if(SUCCESS == rc) {
+		aws_iot_mqtt_autoreconnect_set_status(&pContext->client, true);
+	}
+	return rc;
+}
+
+static void _virtual_close(VirtualContext_t *pContext) {
+	aws_iot_mqtt_disconnect(&pContext->client);
+	aws_iot_mqtt_free(&pContext->client);
+	aws_iot_host_clock_use_real();
+}
+
+/* one simulation step: let the client run, then jump to the next deadline */
+static void _virtual_step(VirtualContext_t *pContext) {
+	aws_iot_mqtt_yield(&pContext->client, 1);
+	if(0 == aws_iot_host_clock_skip_to_next_deadline()) {
+		aws_iot_host_clock_advance(1);
+	}
+}
+
+static void _virtual_report(const char *pName, const VirtualContext_t *pContext, uint32_t simulatedMs,
+							uint64_t wallNs) {
+	printf("%-24s %10.1f %10.1f %10.0f %8u %016llx\n", pName, (double) simulatedMs / 3600e3, (double) wallNs / 1e6,
+		   (double) simulatedMs * 1e6 / (double) (wallNs + 1), pContext->events,
+		   (unsigned long long) pContext->digest);
+}
+
+static void run_keepalive(void) {
+	VirtualContext_t *pContext = &context;
+	IoT_Client_Metrics metrics;
+	uint32_t pings = 0;
+	uint32_t answered = 0;
+	uint32_t simulatedMs;
+	uint64_t start;
+
+	if(!bench_is_selected("virtual/keepalive")) {
+		return;
+	}
+	if(SUCCESS != _virtual_connect(pContext, 600)) {
+		fprintf(stderr, "virtual/keepalive: connect failed\n");
+		exit(1);
+	}
+
+	start = bench_now_ns();
+	do {
+		_virtual_step(pContext);
+		aws_iot_mqtt_get_metrics(&pContext->client, &metrics);
+		if(metrics.packetsOut[VIRTUAL_PINGREQ] != pings) {
+			pings = metrics.packetsOut[VIRTUAL_PINGREQ];
+			_virtual_record(pContext, VIRTUAL_PINGREQ);
+		}
+		if(metrics.packetsIn[VIRTUAL_PINGRESP] != answered) {
+			answered = metrics.packetsIn[VIRTUAL_PINGRESP];
+			_virtual_record(pContext, VIRTUAL_PINGRESP);
+		}
+		simulatedMs = aws_iot_host_now_ms() - VIRTUAL_START_MS;
+	} while(simulatedMs < VIRTUAL_DAY_MS);
+
+	_virtual_report("virtual/keepalive", pContext, simulatedMs, bench_now_ns() - start);
+	printf("%-24s pings %u, answered %u, drops %u\n", "", pings, answered,
+		   pContext->client.clientData.counterNetworkDisconnected);
+	_virtual_close(pContext);
+}
+
+static void run_outage(void) {
+	VirtualContext_t *pContext = &context;
+	IoT_Reconnect_Status status;
+	Timer outage;
+	uint32_t attempts = 0;
+	uint32_t shortestWaitMs = UINT32_MAX;
+	uint32_t longestWaitMs = 0;
+	uint32_t backMs = 0;
+	uint32_t simulatedMs;
+	uint64_t start;
+
+	if(!bench_is_selected("virtual/outage")) {
+		return;
+	}
+	if(SUCCESS != _virtual_connect(pContext, 600)) {
+		fprintf(stderr, "virtual/outage: connect failed\n");
+		exit(1);
+	}
+
+	start = bench_now_ns();
+	aws_iot_fake_broker_refuse_sessions(&pContext->broker, true);
+	aws_iot_fake_broker_close_all(&pContext->broker);
+	/* a deadline of the harness itself, the clock stops there */
+	init_timer(&outage);
+	countdown_ms(&outage, VIRTUAL_OUTAGE_MS);
+	do {
+		_virtual_step(pContext);
+		aws_iot_mqtt_get_reconnect_status(&pContext->client, &status);
+		if(status.attempts != attempts && 0 != status.attempts) {
+			attempts = status.attempts;
+			_virtual_record(pContext, status.currentWaitMs);
+			if(status.currentWaitMs < shortestWaitMs) {
+				shortestWaitMs = status.currentWaitMs;
+			}
+			if(status.currentWaitMs > longestWaitMs) {
+				longestWaitMs = status.currentWaitMs;
+			}
+		}
+		if(0 == backMs && has_timer_expired(&outage)) {
+			aws_iot_fake_broker_refuse_sessions(&pContext->broker, false);
+			backMs = aws_iot_host_now_ms();
+		}
+		simulatedMs = aws_iot_host_now_ms() - VIRTUAL_START_MS;
+	} while((0 == backMs || !aws_iot_mqtt_is_client_connected(&pContext->client)) &&
+			simulatedMs < VIRTUAL_OUTAGE_MS + VIRTUAL_RECOVERY_LIMIT_MS);
+	_virtual_record(pContext, 0);
+
+	_virtual_report("virtual/outage", pContext, simulatedMs, bench_now_ns() - start);
+	printf("%-24s attempts %u, wait %u..%u ms, connected %.1f s after the broker came back\n", "", attempts,
+		   (0 == attempts) ? 0 : shortestWaitMs, longestWaitMs,
+		   aws_iot_mqtt_is_client_connected(&pContext->client) ?
+		   (double) (aws_iot_host_now_ms() - backMs) / 1e3 : -1.0);
+	_virtual_close(pContext);
+}
+
+int main(int argc, char **argv) {
+	bench_init(argc, argv);
+
+	printf("%-24s %10s %10s %10s %8s %16s\n", "scenario", "sim h", "wall ms", "speedup", "events", "digest");
+	run_keepalive();
+	run_outage();
+
+	return 0;
+}
@@ -0,0 +1,853 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file iot_fleet_sim.c
+ * @brief Simulates a fleet of devices against a broker, for capacity tests
+ *
+ * Usage: iot_fleet_sim [options]
+ *
+ *   -H host      broker address (127.0.0.1)
+ *   -p port      broker port (8883, 1883 with -L)
+ *   -C ca        root CA, PEM or path; TLS when given, plain TCP otherwise
+ *   -c cert      device certificate, PEM or path
+ *   -k key       device private key, PEM or path
+ *   -L           start the local stand-in broker on 127.0.0.1:port
+ *   -D seconds   with -L, drop every connection with this period
+ *   -n devices   number of devices of the command-line profile (100)
+ *   -i prefix    client id prefix, the device index is appended ("sim-")
+ *   -P ms        telemetry period of a device, 0 for none (1000)
+ *   -q qos       telemetry QoS (0)
+ *   -s ms        shadow update period of a device, 0 for none (0)
+ *   -K seconds   keep-alive interval (60)
+ *   -f file      device profiles, replaces -n/-i/-P/-q/-s
+ *   -d seconds   duration of the run once every device is connected (30)
+ *   -l loops     event loops, 0 for one per core (0)
+ *   -j threads   concurrent connects during the connect storm (64)
+ *   -r seconds   period of the progress lines (5)
+ *
+ * A profile file has one section per group of devices, keys take the rest
+ * of the line and default to the command-line values:
+ *
+ *   [sensors]
+ *   count = 500
+ *   id = sensor-
+ *   publish_ms = 1000
+ *   qos = 1
+ *   topic = fleet/{id}/telemetry
+ *   payload = {"id":"{id}","seq":{seq},"ts":{ts}}
+ *   subscribe = fleet/{id}/cmd
+ *   echo = 1
+ *   shadow_ms = 10000
+ *
+ * {id}, {seq} and {ts} (send time, monotonic us) are expanded in topics,
+ * payloads and subscriptions. With echo, the default, a device subscribes
+ * to its own telemetry topic. Every message received on a subscription whose
+ * payload carries the {ts} of its profile, after the same literal text, gives
+ * a publish-to-delivery latency sample; shadow updates carry their send time
+ * in the clientToken and are timed on update/accepted.
+ *
+ * All devices connect at once from -j threads (the connect storm), then are
+ * driven by the event engine of extras/gateway. Disconnections are reported by
+ * the disconnect handler, auto-reconnect is enabled and a reconnect is timed
+ * from the disconnection to the client being connected again, with the
+ * resolution of the 1 ms scheduler tick.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "aws_iot_event_engine.h"
+#include "iot_fleet_standin.h"
+
+#define FLEET_MAX_PROFILES 16
+#define FLEET_MAX_SUBSCRIPTIONS 4
+#define FLEET_TEMPLATE_LEN 256
+#define FLEET_TOPIC_LEN 128
+#define FLEET_ANCHOR_LEN 16
+#define FLEET_HIST_SUB 16
+#define FLEET_HIST_BUCKETS 1024
+#define FLEET_TICK_US 1000
+
+typedef struct {
+	char name[32];
+	uint32_t count;
+	char idPrefix[32];
+	uint32_t publishPeriodMs;
+	QoS qos;
+	char topic[FLEET_TEMPLATE_LEN];
+	char payload[FLEET_TEMPLATE_LEN];
+	char subscriptions[FLEET_MAX_SUBSCRIPTIONS][FLEET_TEMPLATE_LEN];
+	uint32_t subscriptionCount;
+	bool isEcho;
+	uint32_t shadowPeriodMs;
+	char tsAnchor[FLEET_ANCHOR_LEN];	///< Literal text before {ts} in the payload
+	size_t tsAnchorLen;
+	bool hasTs;
+} FleetProfile_t;
+
+typedef struct {
+	uint64_t counts[FLEET_HIST_BUCKETS];
+	uint64_t total;
+	uint64_t max;
+} FleetHistogram_t;
+
+typedef struct {
+	AWS_IoT_Client client;
+	const FleetProfile_t *pProfile;
+	uint32_t index;
+	char clientId[64];
+	char topic[FLEET_TOPIC_LEN];
+	char filters[FLEET_MAX_SUBSCRIPTIONS + 1][FLEET_TOPIC_LEN];	///< The SDK keeps pointers to the filters
+	char shadowTopic[FLEET_TOPIC_LEN];
+	char shadowAccepted[FLEET_TOPIC_LEN];
+	char shadowRejected[FLEET_TOPIC_LEN];
+	uint32_t seq;
+	uint64_t nextPublishUs;
+	uint64_t nextShadowUs;
+	uint64_t disconnectedAtUs;			///< Set by the disconnect handler, 0 once reconnected
+	bool isAdded;
+} FleetDevice_t;
+
+typedef struct {
+	uint64_t published;
+	uint64_t publishErrors;
+	uint64_t received;
+	uint64_t shadowUpdates;
+	uint64_t shadowAccepted;
+	uint64_t shadowRejected;
+	uint64_t disconnects;
+	uint64_t reconnects;
+	uint64_t connectFailures;
+} FleetCounters_t;
+
+static FleetProfile_t profiles[FLEET_MAX_PROFILES];
+static uint32_t profileCount = 0;
+static FleetProfile_t defaults = {
+	"cli", 100, "sim-", 1000, QOS0, "fleet/{id}/telemetry", "{\"id\":\"{id}\",\"seq\":{seq},\"ts\":{ts}}", {{0}},
+	0, true, 0, {0}, 0, false
+};
+
+static char *pHost = "127.0.0.1";
+static uint16_t port = 0;
+static char *pRootCA = "";
+static char *pCert = "";
+static char *pKey = "";
+static bool isLocal = false;
+static uint32_t dropPeriodS = 0;
+static uint16_t keepAliveS = 60;
+static uint32_t durationS = 30;
+static uint32_t loopCount = 0;
+static uint32_t connectThreads = 64;
+static uint32_t reportPeriodS = 5;
+
+static FleetDevice_t *pDevices = NULL;
+static uint32_t deviceCount = 0;
+static uint32_t nextToConnect = 0;
+static IoT_Event_Engine *pEngine = NULL;
+
+static FleetCounters_t counters;
+static FleetHistogram_t latencies;
+static FleetHistogram_t shadowLatencies;
+static FleetHistogram_t connectTimes;
+static FleetHistogram_t reconnectTimes;
+
+static uint64_t _fleet_now_us(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+}
+
+/* counters and histograms are updated from the loops and the connect threads */
+static void _fleet_count(uint64_t *pCounter) {
+	__atomic_fetch_add(pCounter, 1, __ATOMIC_RELAXED);
+}
+
+static uint64_t _fleet_read(const uint64_t *pCounter) {
+	return __atomic_load_n(pCounter, __ATOMIC_RELAXED);
+}
+
+/* log-linear buckets: exact below 16 us, 16 sub-buckets per power of two above */
+static uint32_t _fleet_hist_index(uint64_t us) {
+	uint32_t exponent;
+
+	if(us < FLEET_HIST_SUB) {
+		return (uint32_t) us;
+	}
+	exponent = 63 - (uint32_t) __builtin_clzll(us);
+	return (exponent - 3) * FLEET_HIST_SUB + (uint32_t) ((us >> (exponent - 4)) & (FLEET_HIST_SUB - 1));
+}
+
+static uint64_t _fleet_hist_value(uint32_t index) {
+	uint32_t exponent;
+
+	if(index < FLEET_HIST_SUB) {
+		return index;
+	}
+	exponent = index / FLEET_HIST_SUB + 3;
+	return (uint64_t) (FLEET_HIST_SUB + index % FLEET_HIST_SUB) << (exponent - 4);
+}
+
+static void _fleet_hist_add(FleetHistogram_t *pHistogram, uint64_t us) {
+	uint64_t max = __atomic_load_n(&pHistogram->max, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&pHistogram->counts[_fleet_hist_index(us)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&pHistogram->total, 1, __ATOMIC_RELAXED);
+	while(us > max && !__atomic_compare_exchange_n(&pHistogram->max, &max, us, true, __ATOMIC_RELAXED,
+												   __ATOMIC_RELAXED)) {
+	}
+}
+
+/* lower bound of the bucket holding the given fraction of the samples */
+static uint64_t _fleet_hist_percentile(const FleetHistogram_t *pHistogram, double fraction) {
+	uint64_t rank = (uint64_t) (fraction * (double) pHistogram->total);
+	uint64_t seen = 0;
+	uint32_t i;
+
+	for(i = 0; i < FLEET_HIST_BUCKETS; i++) {
+		seen += pHistogram->counts[i];
+		if(seen > rank) {
+			return _fleet_hist_value(i);
+		}
+	}
+	return pHistogram->max;
+}
+
+static void _fleet_print_hist(const char *pName, const FleetHistogram_t *pHistogram, double divider,
+							  const char *pUnit) {
+	if(0 == pHistogram->total) {
+		printf("%-16s no sample\n", pName);
+		return;
+	}
+	printf("%-16s p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f %s (%llu samples)\n", pName,
+		   (double) _fleet_hist_percentile(pHistogram, 0.50) / divider,
+		   (double) _fleet_hist_percentile(pHistogram, 0.90) / divider,
+		   (double) _fleet_hist_percentile(pHistogram, 0.99) / divider,
+		   (double) _fleet_hist_percentile(pHistogram, 0.999) / divider, (double) pHistogram->max / divider, pUnit,
+		   (unsigned long long) pHistogram->total);
+}
+
+/* expands {id}, {seq} and {ts}, returns the length or 0 if it does not fit */
+static size_t _fleet_expand(char *pOut, size_t outLen, const char *pTemplate, const FleetDevice_t *pDevice,
+							uint32_t seq, uint64_t ts) {
+	size_t len = 0;
+	int ret;
+
+	while('\0' != *pTemplate && len + 1 < outLen) {
+		ret = 0;
+		if(0 == strncmp(pTemplate, "{id}", 4)) {
+			ret = snprintf(&pOut[len], outLen - len, "%s", pDevice->clientId);
+			pTemplate += 4;
+		} else if(0 == strncmp(pTemplate, "{seq}", 5)) {
+			ret = snprintf(&pOut[len], outLen - len, "%u", seq);
+			pTemplate += 5;
+		} else if(0 == strncmp(pTemplate, "{ts}", 4)) {
+			ret = snprintf(&pOut[len], outLen - len, "%llu", (unsigned long long) ts);
+			pTemplate += 4;
+		} else {
+			pOut[len++] = *pTemplate++;
+		}
+		if(0 > ret || (size_t) ret >= outLen - len) {
+			return 0;
+		}
+		len += (size_t) ret;
+	}
+	if('\0' != *pTemplate) {
+		return 0;
+	}
+	pOut[len] = '\0';
+	return len;
+}
+
+/* parses the send time following the anchor, 0 if absent */
+static uint64_t _fleet_find_ts(const char *pPayload, size_t payloadLen, const char *pAnchor, size_t anchorLen) {
+	const char *pCur = pPayload;
+	const char *pEnd = pPayload + payloadLen;
+	uint64_t ts = 0;
+
+	if(0 != anchorLen) {
+		pCur = (const char *) memmem(pPayload, payloadLen, pAnchor, anchorLen);
+		if(NULL == pCur) {
+			return 0;
+		}
+		pCur += anchorLen;
+	}
+	while(pCur < pEnd && '0' <= *pCur && '9' >= *pCur) {
+		ts = ts * 10 + (uint64_t) (*pCur++ - '0');
+	}
+	return ts;
+}
+
+static void _fleet_record_latency(FleetHistogram_t *pHistogram, uint64_t ts) {
+	uint64_t now = _fleet_now_us();
+
+	if(0 != ts && ts <= now) {
+		_fleet_hist_add(pHistogram, now - ts);
+	}
+}
+
+static void _fleet_on_message(AWS_IoT_Client *pClient, char *pTopic, uint16_t topicLen,
+							  IoT_Publish_Message_Params *pParams, void *pData) {
+	const FleetDevice_t *pDevice = (const FleetDevice_t *) pData;
+	const FleetProfile_t *pProfile = pDevice->pProfile;
+
+	(void) pClient;
+	(void) pTopic;
+	(void) topicLen;
+
+	_fleet_count(&counters.received);
+	if(pProfile->hasTs) {
+		_fleet_record_latency(&latencies, _fleet_find_ts((const char *) pParams->payload, pParams->payloadLen,
+														 pProfile->tsAnchor, pProfile->tsAnchorLen));
+	}
+}
+
+static void _fleet_on_shadow_accepted(AWS_IoT_Client *pClient, char *pTopic, uint16_t topicLen,
+									  IoT_Publish_Message_Params *pParams, void *pData) {
+	static const char anchor[] = "\"clientToken\":\"";
+
+	(void) pClient;
+	(void) pTopic;
+	(void) topicLen;
+	(void) pData;
+
+	_fleet_count(&counters.shadowAccepted);
+	_fleet_record_latency(&shadowLatencies, _fleet_find_ts((const char *) pParams->payload, pParams->payloadLen,
+														   anchor, sizeof(anchor) - 1));
+}
+
+static void _fleet_on_shadow_rejected(AWS_IoT_Client *pClient, char *pTopic, uint16_t topicLen,
+									  IoT_Publish_Message_Params *pParams, void *pData) {
+	(void) pClient;
+	(void) pTopic;
+	(void) topicLen;
+	(void) pParams;
+	(void) pData;
+
+	_fleet_count(&counters.shadowRejected);
+}
+
+static void _fleet_on_disconnect(AWS_IoT_Client *pClient, void *pData) {
+	FleetDevice_t *pDevice = (FleetDevice_t *) pData;
+
+	(void) pClient;
+
+	_fleet_count(&counters.disconnects);
+	__atomic_store_n(&pDevice->disconnectedAtUs, _fleet_now_us(), __ATOMIC_RELAXED);
+}
+
+/* tasks run on the loop of the device */
+static void _fleet_publish_task(AWS_IoT_Client *pClient, void *pData) {
+	FleetDevice_t *pDevice = (FleetDevice_t *) pData;
+	IoT_Publish_Message_Params params;
+	char payload[2 * FLEET_TEMPLATE_LEN];
+	size_t len;
+
+	len = _fleet_expand(payload, sizeof(payload), pDevice->pProfile->payload, pDevice, pDevice->seq++,
+						_fleet_now_us());
+	memset(&params, 0, sizeof(params));
+	params.qos = pDevice->pProfile->qos;
+	params.payload = payload;
+	params.payloadLen = len;
+
+	if(SUCCESS == aws_iot_mqtt_publish(pClient, pDevice->topic, (uint16_t) strlen(pDevice->topic), &params)) {
+		_fleet_count(&counters.published);
+	} else {
+		_fleet_count(&counters.publishErrors);
+	}
+}
+
+static void _fleet_shadow_task(AWS_IoT_Client *pClient, void *pData) {
+	FleetDevice_t *pDevice = (FleetDevice_t *) pData;
+	IoT_Publish_Message_Params params;
+	char payload[128];
+	int len;
+
+	len = snprintf(payload, sizeof(payload), "{\"state\":{\"reported\":{\"seq\":%u}},\"clientToken\":\"%llu\"}",
+				   pDevice->seq, (unsigned long long) _fleet_now_us());
+	memset(&params, 0, sizeof(params));
+	params.qos = QOS0;
+	params.payload = payload;
+	params.payloadLen = (size_t) len;
+
+	if(SUCCESS == aws_iot_mqtt_publish(pClient, pDevice->shadowTopic, (uint16_t) strlen(pDevice->shadowTopic),
+									   &params)) {
+		_fleet_count(&counters.shadowUpdates);
+	} else {
+		_fleet_count(&counters.publishErrors);
+	}
+}
+
+static bool _fleet_subscribe(FleetDevice_t *pDevice, char *pFilter, pApplicationHandler_t handler) {
+	return SUCCESS == aws_iot_mqtt_subscribe(&pDevice->client, pFilter, (uint16_t) strlen(pFilter), QOS1, handler,
+											 pDevice);
+}
+
+static bool _fleet_connect_device(FleetDevice_t *pDevice) {
+	const FleetProfile_t *pProfile = pDevice->pProfile;
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	uint32_t filterCount = 0;
+	uint32_t i;
+
+	initParams.enableAutoReconnect = false;
+	initParams.pHostURL = pHost;
+	initParams.port = port;
+	initParams.pRootCALocation = pRootCA;
+	initParams.pDeviceCertLocation = pCert;
+	initParams.pDevicePrivateKeyLocation = pKey;
+	initParams.mqttCommandTimeout_ms = 20000;
+	initParams.tlsHandshakeTimeout_ms = 10000;
+	initParams.isSSLHostnameVerify = true;
+	initParams.disconnectHandler = _fleet_on_disconnect;
+	initParams.disconnectHandlerData = pDevice;
+	if(SUCCESS != aws_iot_mqtt_init(&pDevice->client, &initParams)) {
+		return false;
+	}
+
+	connectParams.keepAliveIntervalInSec = keepAliveS;
+	connectParams.isCleanSession = true;
+	connectParams.MQTTVersion = MQTT_3_1_1;
+	connectParams.pClientID = pDevice->clientId;
+	connectParams.clientIDLen = (uint16_t) strlen(pDevice->clientId);
+	if(SUCCESS != aws_iot_mqtt_connect(&pDevice->client, &connectParams)) {
+		return false;
+	}
+
+	for(i = 0; i < pProfile->subscriptionCount; i++) {
+		_fleet_expand(pDevice->filters[filterCount], FLEET_TOPIC_LEN, pProfile->subscriptions[i], pDevice, 0, 0);
+		if(!_fleet_subscribe(pDevice, pDevice->filters[filterCount++], _fleet_on_message)) {
+			return false;
+		}
+	}
+	if(pProfile->isEcho && 0 != pProfile->publishPeriodMs) {
+		strcpy(pDevice->filters[filterCount], pDevice->topic);
+		if(!_fleet_subscribe(pDevice, pDevice->filters[filterCount], _fleet_on_message)) {
+			return false;
+		}
+	}
+	if(0 != pProfile->shadowPeriodMs) {
+		if(!_fleet_subscribe(pDevice, pDevice->shadowAccepted, _fleet_on_shadow_accepted)) {
+			return false;
+		}
+		if(!_fleet_subscribe(pDevice, pDevice->shadowRejected, _fleet_on_shadow_rejected)) {
+			return false;
+		}
+	}
+
+	/* connected and subscribed: from now on the engine reconnects */
+	aws_iot_mqtt_autoreconnect_set_status(&pDevice->client, true);
+	return SUCCESS == aws_iot_event_engine_add(pEngine, &pDevice->client);
+}
+
+static void *_fleet_connect_thread(void *pArg) {
+	FleetDevice_t *pDevice;
+	uint64_t start;
+	uint32_t index;
+
+	(void) pArg;
+
+	while((index = __atomic_fetch_add(&nextToConnect, 1, __ATOMIC_RELAXED)) < deviceCount) {
+		pDevice = &pDevices[index];
+		start = _fleet_now_us();
+		if(_fleet_connect_device(pDevice)) {
+			_fleet_hist_add(&connectTimes, _fleet_now_us() - start);
+			pDevice->isAdded = true;
+		} else {
+			_fleet_count(&counters.connectFailures);
+			aws_iot_mqtt_disconnect(&pDevice->client);
+			aws_iot_mqtt_free(&pDevice->client);
+		}
+	}
+	return NULL;
+}
+
+static void _fleet_trim(char *pText) {
+	size_t len = strlen(pText);
+
+	while(0 < len && (' ' == pText[len - 1] || '\t' == pText[len - 1] || '\n' == pText[len - 1] ||
+					  '\r' == pText[len - 1])) {
+		pText[--len] = '\0';
+	}
+}
+
+static bool _fleet_copy(char *pDest, size_t destLen, const char *pValue) {
+	if(strlen(pValue) >= destLen) {
+		return false;
+	}
+	strcpy(pDest, pValue);
+	return true;
+}
+
+static bool _fleet_parse_key(FleetProfile_t *pProfile, const char *pKey, const char *pValue) {
+	if(0 == strcmp(pKey, "count")) {
+		pProfile->count = (uint32_t) strtoul(pValue, NULL, 10);
+	} else if(0 == strcmp(pKey, "id")) {
+		return _fleet_copy(pProfile->idPrefix, sizeof(pProfile->idPrefix), pValue);
+	} else if(0 == strcmp(pKey, "publish_ms")) {
+		pProfile->publishPeriodMs = (uint32_t) strtoul(pValue, NULL, 10);
+	} else if(0 == strcmp(pKey, "qos")) {
+		pProfile->qos = (0 == strtoul(pValue, NULL, 10)) ? QOS0 : QOS1;
+	} else if(0 == strcmp(pKey, "topic")) {
+		return _fleet_copy(pProfile->topic, sizeof(pProfile->topic), pValue);
+	} else if(0 == strcmp(pKey, "payload")) {
+		return _fleet_copy(pProfile->payload, sizeof(pProfile->payload), pValue);
+	} else if(0 == strcmp(pKey, "subscribe")) {
+		if(FLEET_MAX_SUBSCRIPTIONS == pProfile->subscriptionCount) {
+			return false;
+		}
+		return _fleet_copy(pProfile->subscriptions[pProfile->subscriptionCount++], FLEET_TEMPLATE_LEN, pValue);
+	} else if(0 == strcmp(pKey, "echo")) {
+		pProfile->isEcho = (0 != strtoul(pValue, NULL, 10));
+	} else if(0 == strcmp(pKey, "shadow_ms")) {
+		pProfile->shadowPeriodMs = (uint32_t) strtoul(pValue, NULL, 10);
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static bool _fleet_load_profiles(const char *pPath) {
+	FILE *pFile = fopen(pPath, "r");
+	FleetProfile_t *pProfile = NULL;
+	char line[2 * FLEET_TEMPLATE_LEN];
+	unsigned lineNumber = 0;
+	char *pKey;
+	char *pValue;
+
+	if(NULL == pFile) {
+		perror(pPath);
+		return false;
+	}
+
+	while(NULL != fgets(line, sizeof(line), pFile)) {
+		lineNumber++;
+		_fleet_trim(line);
+		pKey = line + strspn(line, " \t");
+		if('\0' == *pKey || '#' == *pKey) {
+			continue;
+		}
+		if('[' == *pKey) {
+			if(FLEET_MAX_PROFILES == profileCount) {
+				break;
+			}
+			pProfile = &profiles[profileCount++];
+			*pProfile = defaults;
+			snprintf(pProfile->name, sizeof(pProfile->name), "%.*s", (int) strcspn(pKey + 1, "]"), pKey + 1);
+			continue;
+		}
+		pValue = strchr(pKey, '=');
+		if(NULL == pProfile || NULL == pValue) {
+			break;
+		}
+		*pValue++ = '\0';
+		_fleet_trim(pKey);
+		pValue += strspn(pValue, " \t");
+		if(!_fleet_parse_key(pProfile, pKey, pValue)) {
+			break;
+		}
+		lineNumber = 0;
+	}
+
+	fclose(pFile);
+	if(0 != lineNumber) {
+		fprintf(stderr, "%s: invalid line or too many profiles near \"%s\"\n", pPath, line);
+		return false;
+	}
+	return true;
+}
+
+/* the anchor is the literal text right before {ts}, cut at the previous placeholder */
+static void _fleet_prepare_profile(FleetProfile_t *pProfile) {
+	const char *pTs = strstr(pProfile->payload, "{ts}");
+	const char *pStart;
+
+	pProfile->hasTs = (NULL != pTs);
+	if(!pProfile->hasTs) {
+		return;
+	}
+	pStart = pTs;
+	while(pStart > pProfile->payload && '}' != pStart[-1] && (size_t) (pTs - pStart) < FLEET_ANCHOR_LEN - 1) {
+		pStart--;
+	}
+	pProfile->tsAnchorLen = (size_t) (pTs - pStart);
+	memcpy(pProfile->tsAnchor, pStart, pProfile->tsAnchorLen);
+	pProfile->tsAnchor[pProfile->tsAnchorLen] = '\0';
+}
+
+static bool _fleet_create_devices(void) {
+	FleetDevice_t *pDevice;
+	uint64_t now = _fleet_now_us();
+	uint32_t index = 0;
+	uint32_t p;
+	uint32_t i;
+
+	for(p = 0; p < profileCount; p++) {
+		_fleet_prepare_profile(&profiles[p]);
+		deviceCount += profiles[p].count;
+	}
+	pDevices = (FleetDevice_t *) calloc(deviceCount, sizeof(FleetDevice_t));
+	if(NULL == pDevices) {
+		return false;
+	}
+
+	for(p = 0; p < profileCount; p++) {
+		for(i = 0; i < profiles[p].count; i++, index++) {
+			pDevice = &pDevices[index];
+			pDevice->pProfile = &profiles[p];
+			pDevice->index = index;
+			snprintf(pDevice->clientId, sizeof(pDevice->clientId), "%s%u", profiles[p].idPrefix, i);
+			if(0 == _fleet_expand(pDevice->topic, sizeof(pDevice->topic), profiles[p].topic, pDevice, 0, 0)) {
+				fprintf(stderr, "topic of profile %s too long\n", profiles[p].name);
+				return false;
+			}
+			snprintf(pDevice->shadowTopic, sizeof(pDevice->shadowTopic), "$aws/things/%s/shadow/update",
+					 pDevice->clientId);
+			snprintf(pDevice->shadowAccepted, sizeof(pDevice->shadowAccepted), "$aws/things/%s/shadow/update/accepted",
+					 pDevice->clientId);
+			snprintf(pDevice->shadowRejected, sizeof(pDevice->shadowRejected), "$aws/things/%s/shadow/update/rejected",
+					 pDevice->clientId);
+			/* spread the first messages over one period, devices do not tick in sync */
+			if(0 != profiles[p].publishPeriodMs) {
+				pDevice->nextPublishUs = now + (uint64_t) rand() % ((uint64_t) profiles[p].publishPeriodMs * 1000);
+			}
+			if(0 != profiles[p].shadowPeriodMs) {
+				pDevice->nextShadowUs = now + (uint64_t) rand() % ((uint64_t) profiles[p].shadowPeriodMs * 1000);
+			}
+		}
+	}
+	return true;
+}
+
+static uint64_t _fleet_schedule(FleetDevice_t *pDevice, uint64_t next, uint32_t periodMs, uint64_t now,
+								IoT_Event_Engine_Task task) {
+	if(0 == periodMs || now < next) {
+		return next;
+	}
+	aws_iot_event_engine_post(pEngine, &pDevice->client, task, pDevice);
+	next += (uint64_t) periodMs * 1000;
+	/* a saturated loop skips periods rather than bursting to catch up */
+	return (next <= now) ? now + (uint64_t) periodMs * 1000 : next;
+}
+
+static void _fleet_tick(uint64_t now) {
+	FleetDevice_t *pDevice;
+	uint64_t disconnectedAt;
+	uint32_t i;
+
+	for(i = 0; i < deviceCount; i++) {
+		pDevice = &pDevices[i];
+		if(!pDevice->isAdded) {
+			continue;
+		}
+		disconnectedAt = __atomic_load_n(&pDevice->disconnectedAtUs, __ATOMIC_RELAXED);
+		if(0 != disconnectedAt) {
+			/* benign race: the state is a plain field written by the loop */
+			if(!aws_iot_mqtt_is_client_connected(&pDevice->client)) {
+				continue;
+			}
+			__atomic_store_n(&pDevice->disconnectedAtUs, 0, __ATOMIC_RELAXED);
+			_fleet_count(&counters.reconnects);
+			_fleet_hist_add(&reconnectTimes, now - disconnectedAt);
+		}
+		pDevice->nextPublishUs = _fleet_schedule(pDevice, pDevice->nextPublishUs, pDevice->pProfile->publishPeriodMs,
+												 now, _fleet_publish_task);
+		pDevice->nextShadowUs = _fleet_schedule(pDevice, pDevice->nextShadowUs, pDevice->pProfile->shadowPeriodMs,
+												now, _fleet_shadow_task);
+	}
+}
+
+static void _fleet_usage(const char *pName) {
+	fprintf(stderr, "usage: %s [-H host] [-p port] [-C ca -c cert -k key] [-L [-D seconds]] [-n devices] "
+			"[-i prefix] [-P ms] [-q qos] [-s ms] [-K seconds] [-f profiles] [-d seconds] [-l loops] "
+			"[-j threads] [-r seconds]\n", pName);
+}
+
+static bool _fleet_parse_args(int argc, char **argv) {
+	const char *pProfiles = NULL;
+	int option;
+
+	while(-1 != (option = getopt(argc, argv, "H:p:C:c:k:LD:n:i:P:q:s:K:f:d:l:j:r:"))) {
+		switch(option) {
+			case 'H': pHost = optarg; break;
+			case 'p': port = (uint16_t) strtoul(optarg, NULL, 10); break;
+			case 'C': pRootCA = optarg; break;
+			case 'c': pCert = optarg; break;
+			case 'k': pKey = optarg; break;
+			case 'L': isLocal = true; break;
+			case 'D': dropPeriodS = (uint32_t) strtoul(optarg, NULL, 10); break;
+			case 'n': defaults.count = (uint32_t) strtoul(optarg, NULL, 10); break;
+			case 'i': snprintf(defaults.idPrefix, sizeof(defaults.idPrefix), "%s", optarg); break;
+			case 'P': defaults.publishPeriodMs = (uint32_t) strtoul(optarg, NULL, 10); break;
+			case 'q': defaults.qos = (0 == strtoul(optarg, NULL, 10)) ? QOS0 : QOS1; break;
+			case 's': defaults.shadowPeriodMs = (uint32_t) strtoul(optarg, NULL, 10); break;
+			case 'K': keepAliveS = (uint16_t) strtoul(optarg, NULL, 10); break;
+			case 'f': pProfiles = optarg; break;
+			case 'd': durationS = (uint32_t) strtoul(optarg, NULL, 10); break;
+			case 'l': loopCount = (uint32_t) strtoul(optarg, NULL, 10); break;
+			case 'j': connectThreads = (uint32_t) strtoul(optarg, NULL, 10); break;
+			case 'r': reportPeriodS = (uint32_t) strtoul(optarg, NULL, 10); break;
+			default: return false;
+		}
+	}
+
+	if(0 == port) {
+		port = isLocal ? 1883 : 8883;
+	}
+	if(isLocal) {
+		pHost = "127.0.0.1";
+		pRootCA = "";
+	}
+	if(0 == connectThreads) {
+		connectThreads = 1;
+	}
+	if(NULL != pProfiles) {
+		return _fleet_load_profiles(pProfiles);
+	}
+	profiles[profileCount++] = defaults;
+	return true;
+}
+
+static void _fleet_report_progress(uint64_t elapsedUs, FleetCounters_t *pLast, uint64_t periodUs) {
+	uint64_t published = _fleet_read(&counters.published);
+	uint64_t received = _fleet_read(&counters.received);
+
+	printf("[%6.1f s] pub/s %8.0f  rcv/s %8.0f  errors %llu  disconnects %llu  reconnects %llu\n",
+		   (double) elapsedUs / 1e6, (double) (published - pLast->published) * 1e6 / (double) periodUs,
+		   (double) (received - pLast->received) * 1e6 / (double) periodUs,
+		   (unsigned long long) _fleet_read(&counters.publishErrors),
+		   (unsigned long long) _fleet_read(&counters.disconnects),
+		   (unsigned long long) _fleet_read(&counters.reconnects));
+	fflush(stdout);
+	pLast->published = published;
+	pLast->received = received;
+}
+
+int main(int argc, char **argv) {
+	FleetCounters_t last;
+	struct rlimit limit;
+	pthread_t *pThreads;
+	uint64_t stormStart;
+	uint64_t stormUs;
+	uint64_t runStart;
+	uint64_t nextReport;
+	uint64_t now;
+	uint32_t connected = 0;
+	uint32_t i;
+
+	if(!_fleet_parse_args(argc, argv)) {
+		_fleet_usage(argv[0]);
+		return 2;
+	}
+	srand(1);
+
+	/* one socket per device */
+	if(0 == getrlimit(RLIMIT_NOFILE, &limit)) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	if(isLocal && !iot_fleet_standin_start(port, dropPeriodS * 1000)) {
+		fprintf(stderr, "cannot start the stand-in broker on port %u\n", port);
+		return 1;
+	}
+	if(!_fleet_create_devices()) {
+		return 1;
+	}
+	pEngine = aws_iot_event_engine_create(loopCount, deviceCount);
+	pThreads = (pthread_t *) calloc(connectThreads, sizeof(pthread_t));
+	if(NULL == pEngine || NULL == pThreads) {
+		fprintf(stderr, "cannot create the event engine\n");
+		return 1;
+	}
+
+	printf("%u devices, %u profiles, broker %s:%u%s, %u loops\n", deviceCount, profileCount, pHost, port,
+		   ('\0' != pRootCA[0]) ? " (TLS)" : "", aws_iot_event_engine_loop_count(pEngine));
+	fflush(stdout);
+
+	stormStart = _fleet_now_us();
+	for(i = 0; i < connectThreads; i++) {
+		pthread_create(&pThreads[i], NULL, _fleet_connect_thread, NULL);
+	}
+	for(i = 0; i < connectThreads; i++) {
+		pthread_join(pThreads[i], NULL);
+	}
+	stormUs = _fleet_now_us() - stormStart;
+	free(pThreads);
+	for(i = 0; i < deviceCount; i++) {
+		connected += pDevices[i].isAdded ? 1 : 0;
+	}
+	printf("connect storm: %u/%u connected in %.1f ms\n", connected, deviceCount, (double) stormUs / 1000.0);
+	fflush(stdout);
+
+	memset(&last, 0, sizeof(last));
+	runStart = _fleet_now_us();
+	nextReport = runStart + (uint64_t) reportPeriodS * 1000000;
+	while((now = _fleet_now_us()) < runStart + (uint64_t) durationS * 1000000) {
+		_fleet_tick(now);
+		if(0 != reportPeriodS && now >= nextReport) {
+			_fleet_report_progress(now - runStart, &last, (uint64_t) reportPeriodS * 1000000);
+			nextReport += (uint64_t) reportPeriodS * 1000000;
+		}
+		usleep(FLEET_TICK_US);
+	}
+	now = _fleet_now_us() - runStart;
+
+	/* stop producing, let the in-flight messages land */
+	usleep(500000);
+	for(i = 0; i < deviceCount; i++) {
+		if(pDevices[i].isAdded) {
+			aws_iot_event_engine_remove(pEngine, &pDevices[i].client);
+			aws_iot_mqtt_disconnect(&pDevices[i].client);
+			aws_iot_mqtt_free(&pDevices[i].client);
+		}
+	}
+	aws_iot_event_engine_destroy(pEngine);
+	if(isLocal) {
+		iot_fleet_standin_stop();
+	}
+
+	printf("\n%-16s %u/%u connected, %llu failed, storm %.1f ms\n", "devices", connected, deviceCount,
+		   (unsigned long long) counters.connectFailures, (double) stormUs / 1000.0);
+	_fleet_print_hist("connect", &connectTimes, 1000.0, "ms");
+	printf("%-16s %llu sent, %llu errors, %.0f msg/s\n", "publish", (unsigned long long) counters.published,
+		   (unsigned long long) counters.publishErrors, (double) counters.published * 1e6 / (double) now);
+	printf("%-16s %llu, %.0f msg/s\n", "received", (unsigned long long) counters.received,
+		   (double) counters.received * 1e6 / (double) now);
+	_fleet_print_hist("latency", &latencies, 1000.0, "ms");
+	if(0 != counters.shadowUpdates) {
+		printf("%-16s %llu sent, %llu accepted, %llu rejected\n", "shadow", (unsigned long long) counters.shadowUpdates,
+			   (unsigned long long) counters.shadowAccepted, (unsigned long long) counters.shadowRejected);
+		_fleet_print_hist("shadow latency", &shadowLatencies, 1000.0, "ms");
+	}
+	printf("%-16s %llu disconnects, %llu reconnects\n", "reconnect", (unsigned long long) counters.disconnects,
+		   (unsigned long long) counters.reconnects);
+	_fleet_print_hist("reconnect time", &reconnectTimes, 1000.0, "ms");
+	if(isLocal) {
+		printf("%-16s %u drops, %u publishes in, %u out, %u queue overflows\n", "stand-in", iot_fleet_standin_drops(),
+			   iot_fleet_standin_stats()->publishesIn, iot_fleet_standin_stats()->publishesOut,
+			   iot_fleet_standin_stats()->queueOverflows);
+	}
+
+	free(pDevices);
+	return 0;
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file iot_fleet_standin.c
+ * @brief epoll server feeding TCP connections to the fake broker
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "iot_fleet_standin.h"
+
+#define STANDIN_READ_LEN 16384
+#define STANDIN_MAX_EVENTS 64
+
+typedef struct {
+	int fd;						///< -1 when the session has no connection
+	bool isWatchingOut;			///< EPOLLOUT requested, outbound bytes are waiting
+	unsigned char *pOut;		///< Bytes taken from the broker, not written yet
+	size_t outLen;
+	size_t outCap;
+} StandinConnection_t;
+
+static IoT_Fake_Broker *pBroker = NULL;
+static StandinConnection_t connections[IOT_FAKE_BROKER_MAX_SESSIONS];
+static int listenFd = -1;
+static int epollFd = -1;
+static uint32_t dropPeriod = 0;
+static uint32_t drops = 0;
+static uint32_t liveConnections = 0;
+static volatile bool isStopping = false;
+static pthread_t thread;
+
+static uint64_t _standin_now_ms(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000;
+}
+
+static void _standin_close(int session) {
+	StandinConnection_t *pConnection = &connections[session];
+
+	if(0 > pConnection->fd) {
+		return;
+	}
+	close(pConnection->fd);
+	__atomic_sub_fetch(&liveConnections, 1, __ATOMIC_RELEASE);
+	pConnection->fd = -1;
+	pConnection->outLen = 0;
+	pConnection->isWatchingOut = false;
+	aws_iot_fake_broker_detach(pBroker, session);
+}
+
+static void _standin_watch(int session, bool isWatchingOut) {
+	StandinConnection_t *pConnection = &connections[session];
+	struct epoll_event event;
+
+	if(isWatchingOut == pConnection->isWatchingOut) {
+		return;
+	}
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | (isWatchingOut ? EPOLLOUT : 0);
+	event.data.u32 = (uint32_t) session;
+	epoll_ctl(epollFd, EPOLL_CTL_MOD, pConnection->fd, &event);
+	pConnection->isWatchingOut = isWatchingOut;
+}
+
+/* move the bytes queued by the broker to the socket, keep what does not fit */
+static void _standin_flush(int session) {
+	StandinConnection_t *pConnection = &connections[session];
+	size_t pending = aws_iot_fake_broker_pending(pBroker, session);
+	size_t written = 0;
+	ssize_t ret;
+
+	if(0 != pending) {
+		if(pConnection->outLen + pending > pConnection->outCap) {
+			size_t capacity = 2 * (pConnection->outLen + pending);
+			unsigned char *pOut = (unsigned char *) realloc(pConnection->pOut, capacity);
+
+			if(NULL == pOut) {
+				_standin_close(session);
+				return;
+			}
+			pConnection->pOut = pOut;
+			pConnection->outCap = capacity;
+		}
+		pConnection->outLen += aws_iot_fake_broker_take(pBroker, session, &pConnection->pOut[pConnection->outLen],
+														pending);
+	}
+
+	while(written < pConnection->outLen) {
+		ret = send(pConnection->fd, &pConnection->pOut[written], pConnection->outLen - written, MSG_NOSIGNAL);
+		if(0 > ret) {
+			if(EINTR == errno) {
+				continue;
+			}
+			if(EAGAIN != errno && EWOULDBLOCK != errno) {
+				_standin_close(session);
+				return;
+			}
+			break;
+		}
+		written += (size_t) ret;
+	}
+	pConnection->outLen -= written;
+	memmove(pConnection->pOut, &pConnection->pOut[written], pConnection->outLen);
+	_standin_watch(session, 0 != pConnection->outLen);
+}
+
+static void _standin_accept(void) {
+	struct epoll_event event;
+	int one = 1;
+	int session;
+	int fd;
+
+	while(0 <= (fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC))) {
+		session = aws_iot_fake_broker_attach(pBroker);
+		if(0 > session) {
+			close(fd);
+			continue;
+		}
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN;
+		event.data.u32 = (uint32_t) session;
+		if(0 != epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event)) {
+			close(fd);
+			aws_iot_fake_broker_detach(pBroker, session);
+			continue;
+		}
+		connections[session].fd = fd;
+		connections[session].outLen = 0;
+		connections[session].isWatchingOut = false;
+		__atomic_add_fetch(&liveConnections, 1, __ATOMIC_RELEASE);
+	}
+}
+
+static void _standin_receive(int session) {
+	unsigned char buffer[STANDIN_READ_LEN];
+	ssize_t ret;
+	int other;
+
+	for(;;) {
+		ret = recv(connections[session].fd, buffer, sizeof(buffer), 0);
+		if(0 > ret && EINTR == errno) {
+			continue;
+		}
+		if(0 > ret && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+			break;
+		}
+		if(0 >= ret || SUCCESS != aws_iot_fake_broker_receive(pBroker, session, buffer, (size_t) ret)) {
+			_standin_close(session);
+			break;
+		}
+	}
+
+	/* a publish is routed to other sessions as well */
+	for(other = 0; other < IOT_FAKE_BROKER_MAX_SESSIONS; other++) {
+		if(0 <= connections[other].fd && 0 != aws_iot_fake_broker_pending(pBroker, other)) {
+			_standin_flush(other);
+		}
+	}
+}
+
+static void _standin_drop_all(void) {
+	int session;
+
+	for(session = 0; session < IOT_FAKE_BROKER_MAX_SESSIONS; session++) {
+		_standin_close(session);
+	}
+	drops++;
+}
+
+static void *_standin_run(void *pArg) {
+	struct epoll_event events[STANDIN_MAX_EVENTS];
+	uint64_t nextDrop = _standin_now_ms() + dropPeriod;
+	int nbEvents;
+	int i;
+
+	(void) pArg;
+
+	while(!isStopping) {
+		nbEvents = epoll_wait(epollFd, events, STANDIN_MAX_EVENTS, 100);
+		for(i = 0; i < nbEvents; i++) {
+			if(UINT32_MAX == events[i].data.u32) {
+				_standin_accept();
+				continue;
+			}
+			if(0 > connections[events[i].data.u32].fd) {
+				continue;
+			}
+			if(events[i].events & EPOLLOUT) {
+				_standin_flush((int) events[i].data.u32);
+			}
+			if(0 <= connections[events[i].data.u32].fd && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+				_standin_receive((int) events[i].data.u32);
+			}
+		}
+		if(0 != dropPeriod && _standin_now_ms() >= nextDrop) {
+			_standin_drop_all();
+			nextDrop = _standin_now_ms() + dropPeriod;
+		}
+	}
+
+	return NULL;
+}
+
+bool iot_fleet_standin_start(uint16_t port, uint32_t dropPeriodMs) {
+	struct sockaddr_in address;
+	struct epoll_event event;
+	int one = 1;
+	int session;
+
+	pBroker = (IoT_Fake_Broker *) malloc(sizeof(IoT_Fake_Broker));
+	if(NULL == pBroker) {
+		return false;
+	}
+	aws_iot_fake_broker_init(pBroker);
+	for(session = 0; session < IOT_FAKE_BROKER_MAX_SESSIONS; session++) {
+		connections[session].fd = -1;
+	}
+	dropPeriod = dropPeriodMs;
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if(0 > listenFd || 0 > epollFd) {
+		return false;
+	}
+	setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if(0 != bind(listenFd, (struct sockaddr *) &address, sizeof(address)) || 0 != listen(listenFd, SOMAXCONN)) {
+		return false;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u32 = UINT32_MAX;
+	if(0 != epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event)) {
+		return false;
+	}
+
+	isStopping = false;
+	return 0 == pthread_create(&thread, NULL, _standin_run, NULL);
+}
+
+void iot_fleet_standin_stop(void) {
+	int session;
+
+	isStopping = true;
+	pthread_join(thread, NULL);
+	for(session = 0; session < IOT_FAKE_BROKER_MAX_SESSIONS; session++) {
+		_standin_close(session);
+		free(connections[session].pOut);
+		connections[session].pOut = NULL;
+		connections[session].outCap = 0;
+	}
+	close(epollFd);
+	close(listenFd);
+}
+
+const IoT_Fake_Broker_Stats *iot_fleet_standin_stats(void) {
+	return &pBroker->stats;
+}
+
+uint32_t iot_fleet_standin_drops(void) {
+	return drops;
+}
+
+uint32_t iot_fleet_standin_connections(void) {
+	return __atomic_load_n(&liveConnections, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file iot_fleet_standin.h
+ * @brief Local MQTT broker stand-in for the fleet simulator
+ *
+ * The fake broker of extras/loopback served over TCP by one thread: plain
+ * MQTT 3.1.1 on a local port, QoS 0/1 routing, no TLS, no retained messages
+ * and no shadow service (shadow updates are routed like any other publish).
+ * It lets the simulator run without a Greengrass core or Mosquitto at hand.
+ */
+
+#ifndef AWS_IOT_SDK_EXTRAS_FLEET_STANDIN_H
+#define AWS_IOT_SDK_EXTRAS_FLEET_STANDIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "aws_iot_fake_broker.h"
+
+/**
+ * @brief Start the stand-in thread
+ *
+ * @param port TCP port, bound on 127.0.0.1
+ * @param dropPeriodMs Close every connection with this period, as a broker
+ * restart would, to measure reconnects. 0 never drops
+ *
+ * @return bool false if the port could not be bound or the thread created
+ */
+bool iot_fleet_standin_start(uint16_t port, uint32_t dropPeriodMs);
+
+/**
+ * @brief Stop the stand-in thread and close its connections
+ */
+void iot_fleet_standin_stop(void);
+
+/**
+ * @brief Counters of the broker, read after iot_fleet_standin_stop
+ */
+const IoT_Fake_Broker_Stats *iot_fleet_standin_stats(void);
+
+/**
+ * @brief Number of times all the connections were dropped
+ */
+uint32_t iot_fleet_standin_drops(void);
+
+/**
+ * @brief Number of connections accepted and not closed yet, callable while the thread runs
+ */
+uint32_t iot_fleet_standin_connections(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_EXTRAS_FLEET_STANDIN_H */
@@ -0,0 +1,637 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_event_engine.c
+ * @brief epoll loops, one per core, each with a timer heap of client deadlines
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "aws_iot_event_engine.h"
+
+typedef IoT_Error_t (*IoT_Event_Read_t)(Network *, unsigned char *, size_t, Timer *, size_t *);
+
+typedef struct _IoT_Event_Loop IoT_Event_Loop;
+
+typedef struct {
+	AWS_IoT_Client *pClient;			///< NULL when the slot is free
+	IoT_Event_Loop *pLoop;
+	IoT_Event_Read_t read;				///< Read function of the network layer, called by the engine's one
+	uint32_t deadline;					///< Next service without I/O, ms of the loop clock
+	uint32_t heapIndex;
+	int fd;								///< Socket registered with epoll, -1 if none
+	uint32_t disconnects;				///< counterNetworkDisconnected when fd was registered
+	bool isServicing;					///< The loop is yielding the client
+} IoT_Event_Slot;
+
+typedef enum {
+	EVENT_COMMAND_ADD,
+	EVENT_COMMAND_REMOVE,
+	EVENT_COMMAND_POST,
+	EVENT_COMMAND_STOP
+} IoT_Event_Command_Type;
+
+typedef struct _IoT_Event_Command {
+	IoT_Event_Command_Type type;
+	AWS_IoT_Client *pClient;
+	IoT_Event_Engine_Task task;
+	void *pData;
+	IoT_Error_t rc;
+	bool isDone;
+	bool isOwned;						///< Allocated by the submitter, freed by the loop
+	struct _IoT_Event_Command *pNext;
+} IoT_Event_Command;
+
+struct _IoT_Event_Loop {
+	pthread_t thread;
+	bool isStarted;
+	int cpu;
+	int epollFd;
+	int wakeFd;							///< eventfd signalled when commands are queued
+	pthread_mutex_t lock;				///< Protects the command queue and nbAssigned
+	pthread_cond_t done;
+	IoT_Event_Command *pHead;
+	IoT_Event_Command *pTail;
+	uint32_t nbAssigned;				///< Clients added or being added, for the sharding
+	uint32_t capacity;
+	IoT_Event_Slot *pSlots;
+	IoT_Event_Slot **ppHeap;			///< Min-heap on deadline of the registered clients
+	uint32_t heapSize;
+};
+
+struct _IoT_Event_Engine {
+	IoT_Event_Loop *pLoops;
+	uint32_t nbLoops;
+};
+
+static uint32_t _engine_now_ms(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t) ((uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000);
+}
+
+/* deadlines are compared modulo 2^32 */
+static bool _engine_is_before(uint32_t a, uint32_t b) {
+	return (int32_t) (a - b) < 0;
+}
+
+static void _engine_heap_swap(IoT_Event_Slot **ppHeap, uint32_t i, uint32_t j) {
+	IoT_Event_Slot *pSlot = ppHeap[i];
+
+	ppHeap[i] = ppHeap[j];
+	ppHeap[j] = pSlot;
+	ppHeap[i]->heapIndex = i;
+	ppHeap[j]->heapIndex = j;
+}
+
+static void _engine_heap_fix(IoT_Event_Loop *pLoop, uint32_t index) {
+	IoT_Event_Slot **ppHeap = pLoop->ppHeap;
+	uint32_t child;
+
+	while(0 < index && _engine_is_before(ppHeap[index]->deadline, ppHeap[(index - 1) / 2]->deadline)) {
+		_engine_heap_swap(ppHeap, index, (index - 1) / 2);
+		index = (index - 1) / 2;
+	}
+	for(;;) {
+		child = 2 * index + 1;
+		if(child >= pLoop->heapSize) {
+			break;
+		}
+		if(child + 1 < pLoop->heapSize && _engine_is_before(ppHeap[child + 1]->deadline, ppHeap[child]->deadline)) {
+			child++;
+		}
+		if(!_engine_is_before(ppHeap[child]->deadline, ppHeap[index]->deadline)) {
+			break;
+		}
+		_engine_heap_swap(ppHeap, index, child);
+		index = child;
+	}
+}
+
+static void _engine_heap_remove(IoT_Event_Loop *pLoop, IoT_Event_Slot *pSlot) {
+	uint32_t index = pSlot->heapIndex;
+
+	pLoop->heapSize--;
+	if(index != pLoop->heapSize) {
+		_engine_heap_swap(pLoop->ppHeap, index, pLoop->heapSize);
+		_engine_heap_fix(pLoop, index);
+	}
+}
+
+static uint32_t _engine_min(uint32_t a, uint32_t b) {
+	return (a < b) ? a : b;
+}
+
+/* next time the client needs a yield without incoming data */
+static void _engine_schedule(IoT_Event_Loop *pLoop, IoT_Event_Slot *pSlot) {
+	AWS_IoT_Client *pClient = pSlot->pClient;
+	ClientState state = aws_iot_mqtt_get_client_state(pClient);
+	uint32_t wait = AWS_IOT_EVENT_ENGINE_MAX_SLEEP_MS;
+
+	if(CLIENT_STATE_PENDING_RECONNECT == state || CLIENT_STATE_CONNECTED_RESUBSCRIBE_IN_PROGRESS == state) {
+		wait = _engine_min(wait, left_ms(&(pClient->reconnectDelayTimer)));
+	} else if(aws_iot_mqtt_is_client_connected(pClient) && 0 != pClient->clientData.keepAliveInterval) {
+		wait = _engine_min(wait, left_ms(&(pClient->pingTimer)));
+		if(!pClient->clientStatus.isPingOutstanding) {
+			wait = _engine_min(wait, left_ms(&(pClient->sendDeadlineTimer)));
+		}
+	}
+
+	/* a deadline the last yield could not act on is retried, not spun on */
+	pSlot->deadline = _engine_now_ms() + ((0 == wait) ? 1 : wait);
+	_engine_heap_fix(pLoop, pSlot->heapIndex);
+}
+
+/* (re)register the socket of the client, it changes on every reconnect */
+static void _engine_watch(IoT_Event_Loop *pLoop, IoT_Event_Slot *pSlot, bool isForced) {
+	AWS_IoT_Client *pClient = pSlot->pClient;
+	int fd = pClient->networkStack.tlsDataParams.fd;
+	uint32_t disconnects = pClient->clientData.counterNetworkDisconnected;
+	struct epoll_event event;
+
+	if(!isForced && fd == pSlot->fd && disconnects == pSlot->disconnects) {
+		return;
+	}
+
+	/* a closed socket leaves the epoll set by itself: the previous descriptor is not
+	 * deleted, its number may already belong to another connection */
+	pSlot->fd = -1;
+	pSlot->disconnects = disconnects;
+	if(0 > fd) {
+		return;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = pSlot;
+	if(0 == epoll_ctl(pLoop->epollFd, EPOLL_CTL_ADD, fd, &event) ||
+	   (EEXIST == errno && 0 == epoll_ctl(pLoop->epollFd, EPOLL_CTL_MOD, fd, &event))) {
+		pSlot->fd = fd;
+	}
+}
+
+/*
+ * Read of the registered clients. During the engine's own yield the read does
+ * not wait: an empty socket expires the yield timer, which ends the yield.
+ * Anywhere else (callbacks, posted tasks, reconnects) it is the blocking read
+ * of the network layer, e.g. a QoS 1 publish waiting for its PUBACK.
+ */
+static IoT_Error_t _engine_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *read_len) {
+	IoT_Event_Slot *pSlot = (IoT_Event_Slot *) pNetwork->tlsDataParams.pContext;
+	Timer expired;
+	IoT_Error_t rc;
+
+	if(!pSlot->isServicing ||
+	   CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS != aws_iot_mqtt_get_client_state(pSlot->pClient)) {
+		return pSlot->read(pNetwork, pMsg, len, timer, read_len);
+	}
+
+	init_timer(&expired);
+	countdown_ms(&expired, 0);
+	rc = pSlot->read(pNetwork, pMsg, len, &expired, read_len);
+	if(SUCCESS != rc) {
+		countdown_ms(timer, 0);
+	}
+	return rc;
+}
+
+static IoT_Event_Slot *_engine_slot(AWS_IoT_Client *pClient) {
+	if(_engine_read != pClient->networkStack.read) {
+		return NULL;
+	}
+	return (IoT_Event_Slot *) pClient->networkStack.tlsDataParams.pContext;
+}
+
+static void _engine_service(IoT_Event_Loop *pLoop, IoT_Event_Slot *pSlot) {
+	AWS_IoT_Client *pClient = pSlot->pClient;
+
+	pSlot->isServicing = true;
+	(void) aws_iot_mqtt_yield(pClient, 1);
+	pSlot->isServicing = false;
+
+	/* a callback of the yield may have removed the client */
+	if(pSlot != _engine_slot(pClient)) {
+		return;
+	}
+	_engine_watch(pLoop, pSlot, false);
+	_engine_schedule(pLoop, pSlot);
+}
+
+static IoT_Error_t _engine_attach(IoT_Event_Loop *pLoop, AWS_IoT_Client *pClient) {
+	IoT_Event_Slot *pSlot = NULL;
+	uint32_t i;
+
+	for(i = 0; i < pLoop->capacity && NULL == pSlot; i++) {
+		if(NULL == pLoop->pSlots[i].pClient) {
+			pSlot = &(pLoop->pSlots[i]);
+		}
+	}
+	if(NULL == pSlot) {
+		return FAILURE;
+	}
+
+	pSlot->pClient = pClient;
+	pSlot->pLoop = pLoop;
+	pSlot->read = pClient->networkStack.read;
+	pSlot->fd = -1;
+	pSlot->isServicing = false;
+	pClient->networkStack.read = _engine_read;
+	pClient->networkStack.tlsDataParams.pContext = pSlot;
+
+	pSlot->heapIndex = pLoop->heapSize;
+	pLoop->ppHeap[pLoop->heapSize++] = pSlot;
+	_engine_watch(pLoop, pSlot, true);
+	_engine_schedule(pLoop, pSlot);
+
+	return SUCCESS;
+}
+
+static void _engine_detach(IoT_Event_Loop *pLoop, IoT_Event_Slot *pSlot) {
+	AWS_IoT_Client *pClient = pSlot->pClient;
+
+	_engine_heap_remove(pLoop, pSlot);
+	if(0 <= pSlot->fd && pSlot->fd == pClient->networkStack.tlsDataParams.fd) {
+		epoll_ctl(pLoop->epollFd, EPOLL_CTL_DEL, pSlot->fd, NULL);
+	}
+	pClient->networkStack.read = pSlot->read;
+	pClient->networkStack.tlsDataParams.pContext = NULL;
+	pSlot->pClient = NULL;
+}
+
+/* returns false when the loop must stop */
+static bool _engine_run_commands(IoT_Event_Loop *pLoop) {
+	IoT_Event_Command *pCommand;
+	IoT_Event_Command *pNext;
+	IoT_Event_Slot *pSlot;
+	uint64_t count;
+	bool isRunning = true;
+
+	if(0 > read(pLoop->wakeFd, &count, sizeof(count))) {
+		/* EAGAIN, the queue is looked at anyway */
+	}
+
+	pthread_mutex_lock(&(pLoop->lock));
+	pCommand = pLoop->pHead;
+	pLoop->pHead = NULL;
+	pLoop->pTail = NULL;
+	pthread_mutex_unlock(&(pLoop->lock));
+
+	for(; NULL != pCommand; pCommand = pNext) {
+		pNext = pCommand->pNext;
+		pCommand->rc = SUCCESS;
+		switch(pCommand->type) {
+			case EVENT_COMMAND_ADD:
+				pCommand->rc = _engine_attach(pLoop, pCommand->pClient);
+				break;
+			case EVENT_COMMAND_REMOVE:
+				pSlot = _engine_slot(pCommand->pClient);
+				if(NULL == pSlot || pLoop != pSlot->pLoop) {
+					pCommand->rc = FAILURE;
+				} else {
+					_engine_detach(pLoop, pSlot);
+				}
+				break;
+			case EVENT_COMMAND_POST:
+				/* the client may have been removed since the task was posted */
+				pSlot = _engine_slot(pCommand->pClient);
+				if(NULL != pSlot && pLoop == pSlot->pLoop) {
+					pCommand->task(pCommand->pClient, pCommand->pData);
+					pSlot = _engine_slot(pCommand->pClient);
+					if(NULL != pSlot) {
+						_engine_watch(pLoop, pSlot, true);
+						_engine_schedule(pLoop, pSlot);
+					}
+				}
+				break;
+			case EVENT_COMMAND_STOP:
+				isRunning = false;
+				break;
+		}
+
+		if(pCommand->isOwned) {
+			free(pCommand);
+		} else {
+			pthread_mutex_lock(&(pLoop->lock));
+			pCommand->isDone = true;
+			pthread_cond_broadcast(&(pLoop->done));
+			pthread_mutex_unlock(&(pLoop->lock));
+		}
+	}
+
+	return isRunning;
+}
+
+static void *_engine_loop(void *pArg) {
+	IoT_Event_Loop *pLoop = (IoT_Event_Loop *) pArg;
+	struct epoll_event events[AWS_IOT_EVENT_ENGINE_MAX_EVENTS];
+	cpu_set_t cpus;
+	IoT_Event_Slot *pSlot;
+	uint32_t now;
+	bool isRunning = true;
+	int timeout;
+	int nbEvents;
+	int i;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(pLoop->cpu, &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+
+	while(isRunning) {
+		timeout = -1;
+		if(0 < pLoop->heapSize) {
+			now = _engine_now_ms();
+			timeout = _engine_is_before(now, pLoop->ppHeap[0]->deadline) ? (int) (pLoop->ppHeap[0]->deadline - now) : 0;
+		}
+
+		nbEvents = epoll_wait(pLoop->epollFd, events, AWS_IOT_EVENT_ENGINE_MAX_EVENTS, timeout);
+		for(i = 0; i < nbEvents; i++) {
+			pSlot = (IoT_Event_Slot *) events[i].data.ptr;
+			if(NULL == pSlot) {
+				isRunning = _engine_run_commands(pLoop) && isRunning;
+			} else if(NULL != pSlot->pClient) {
+				_engine_service(pLoop, pSlot);
+			}
+		}
+
+		/* every service pushes the deadline of the client at least 1 ms ahead */
+		now = _engine_now_ms();
+		while(0 < pLoop->heapSize && !_engine_is_before(now, pLoop->ppHeap[0]->deadline)) {
+			_engine_service(pLoop, pLoop->ppHeap[0]);
+		}
+	}
+
+	return NULL;
+}
+
+static IoT_Error_t _engine_submit(IoT_Event_Loop *pLoop, IoT_Event_Command *pCommand) {
+	uint64_t one = 1;
+	bool isOwned = pCommand->isOwned;
+	IoT_Error_t rc = SUCCESS;
+
+	pCommand->isDone = false;
+	pCommand->pNext = NULL;
+
+	pthread_mutex_lock(&(pLoop->lock));
+	if(NULL == pLoop->pTail) {
+		pLoop->pHead = pCommand;
+	} else {
+		pLoop->pTail->pNext = pCommand;
+	}
+	pLoop->pTail = pCommand;
+	pthread_mutex_unlock(&(pLoop->lock));
+
+	/* the loop drains the eventfd, a failed write means it is already signalled */
+	if(0 > write(pLoop->wakeFd, &one, sizeof(one))) {
+		rc = SUCCESS;
+	}
+
+	if(!isOwned) {
+		if(pthread_equal(pthread_self(), pLoop->thread)) {
+			/* called from a task or callback of this loop */
+			_engine_run_commands(pLoop);
+		}
+		pthread_mutex_lock(&(pLoop->lock));
+		while(!pCommand->isDone) {
+			pthread_cond_wait(&(pLoop->done), &(pLoop->lock));
+		}
+		pthread_mutex_unlock(&(pLoop->lock));
+		rc = pCommand->rc;
+	}
+
+	return rc;
+}
+
+static void _engine_free_loop(IoT_Event_Loop *pLoop) {
+	if(0 <= pLoop->epollFd) {
+		close(pLoop->epollFd);
+	}
+	if(0 <= pLoop->wakeFd) {
+		close(pLoop->wakeFd);
+	}
+	pthread_mutex_destroy(&(pLoop->lock));
+	pthread_cond_destroy(&(pLoop->done));
+	free(pLoop->pSlots);
+	free(pLoop->ppHeap);
+}
+
+static bool _engine_init_loop(IoT_Event_Loop *pLoop, int cpu, uint32_t capacity) {
+	struct epoll_event event;
+
+	memset(pLoop, 0, sizeof(*pLoop));
+	pLoop->cpu = cpu;
+	pLoop->capacity = capacity;
+	pthread_mutex_init(&(pLoop->lock), NULL);
+	pthread_cond_init(&(pLoop->done), NULL);
+	pLoop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	pLoop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	pLoop->pSlots = (IoT_Event_Slot *) calloc(capacity, sizeof(IoT_Event_Slot));
+	pLoop->ppHeap = (IoT_Event_Slot **) calloc(capacity, sizeof(IoT_Event_Slot *));
+	if(0 > pLoop->epollFd || 0 > pLoop->wakeFd || NULL == pLoop->pSlots || NULL == pLoop->ppHeap) {
+		return false;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	if(0 != epoll_ctl(pLoop->epollFd, EPOLL_CTL_ADD, pLoop->wakeFd, &event)) {
+		return false;
+	}
+
+	pLoop->isStarted = (0 == pthread_create(&(pLoop->thread), NULL, _engine_loop, pLoop));
+	return pLoop->isStarted;
+}
+
+IoT_Event_Engine *aws_iot_event_engine_create(uint32_t nbLoops, uint32_t maxClientsPerLoop) {
+	IoT_Event_Engine *pEngine;
+	long nbCpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t i;
+
+	if(0 >= nbCpus) {
+		nbCpus = 1;
+	}
+	if(0 == nbLoops) {
+		nbLoops = (uint32_t) nbCpus;
+	}
+	if(0 == maxClientsPerLoop) {
+		return NULL;
+	}
+
+	pEngine = (IoT_Event_Engine *) calloc(1, sizeof(IoT_Event_Engine));
+	if(NULL == pEngine) {
+		return NULL;
+	}
+	pEngine->pLoops = (IoT_Event_Loop *) calloc(nbLoops, sizeof(IoT_Event_Loop));
+	if(NULL == pEngine->pLoops) {
+		free(pEngine);
+		return NULL;
+	}
+
+	for(i = 0; i < nbLoops; i++) {
+		pEngine->nbLoops++;
+		if(!_engine_init_loop(&(pEngine->pLoops[i]), (int) (i % (uint32_t) nbCpus), maxClientsPerLoop)) {
+			aws_iot_event_engine_destroy(pEngine);
+			return NULL;
+		}
+	}
+
+	return pEngine;
+}
+
+void aws_iot_event_engine_destroy(IoT_Event_Engine *pEngine) {
+	IoT_Event_Command stop;
+	IoT_Event_Loop *pLoop;
+	uint32_t i;
+
+	if(NULL == pEngine) {
+		return;
+	}
+
+	for(i = 0; i < pEngine->nbLoops; i++) {
+		pLoop = &(pEngine->pLoops[i]);
+		if(pLoop->isStarted) {
+			memset(&stop, 0, sizeof(stop));
+			stop.type = EVENT_COMMAND_STOP;
+			_engine_submit(pLoop, &stop);
+			pthread_join(pLoop->thread, NULL);
+		}
+		while(0 < pLoop->heapSize) {
+			_engine_detach(pLoop, pLoop->ppHeap[0]);
+		}
+		_engine_free_loop(pLoop);
+	}
+
+	free(pEngine->pLoops);
+	free(pEngine);
+}
+
+IoT_Error_t aws_iot_event_engine_add(IoT_Event_Engine *pEngine, AWS_IoT_Client *pClient) {
+	IoT_Event_Command add;
+	IoT_Event_Loop *pLoop = NULL;
+	uint32_t i;
+
+	if(NULL == pEngine || NULL == pClient) {
+		return NULL_VALUE_ERROR;
+	}
+	/* the engine polls the socket of the POSIX network layer */
+	if(iot_tls_read != pClient->networkStack.read) {
+		return FAILURE;
+	}
+
+	for(i = 0; i < pEngine->nbLoops; i++) {
+		pthread_mutex_lock(&(pEngine->pLoops[i].lock));
+		if(pEngine->pLoops[i].nbAssigned < pEngine->pLoops[i].capacity &&
+		   (NULL == pLoop || pEngine->pLoops[i].nbAssigned < pLoop->nbAssigned)) {
+			pLoop = &(pEngine->pLoops[i]);
+		}
+		pthread_mutex_unlock(&(pEngine->pLoops[i].lock));
+	}
+	if(NULL == pLoop) {
+		return FAILURE;
+	}
+
+	pthread_mutex_lock(&(pLoop->lock));
+	pLoop->nbAssigned++;
+	pthread_mutex_unlock(&(pLoop->lock));
+
+	memset(&add, 0, sizeof(add));
+	add.type = EVENT_COMMAND_ADD;
+	add.pClient = pClient;
+	if(SUCCESS != _engine_submit(pLoop, &add)) {
+		pthread_mutex_lock(&(pLoop->lock));
+		pLoop->nbAssigned--;
+		pthread_mutex_unlock(&(pLoop->lock));
+		return FAILURE;
+	}
+
+	return SUCCESS;
+}
+
+IoT_Error_t aws_iot_event_engine_remove(IoT_Event_Engine *pEngine, AWS_IoT_Client *pClient) {
+	IoT_Event_Command remove;
+	IoT_Event_Slot *pSlot;
+	IoT_Event_Loop *pLoop;
+
+	if(NULL == pEngine || NULL == pClient) {
+		return NULL_VALUE_ERROR;
+	}
+	pSlot = _engine_slot(pClient);
+	if(NULL == pSlot) {
+		return FAILURE;
+	}
+	pLoop = pSlot->pLoop;
+
+	memset(&remove, 0, sizeof(remove));
+	remove.type = EVENT_COMMAND_REMOVE;
+	remove.pClient = pClient;
+	if(SUCCESS != _engine_submit(pLoop, &remove)) {
+		return FAILURE;
+	}
+
+	pthread_mutex_lock(&(pLoop->lock));
+	pLoop->nbAssigned--;
+	pthread_mutex_unlock(&(pLoop->lock));
+
+	return SUCCESS;
+}
+
+IoT_Error_t aws_iot_event_engine_post(IoT_Event_Engine *pEngine, AWS_IoT_Client *pClient, IoT_Event_Engine_Task task,
+									  void *pData) {
+	IoT_Event_Command *pCommand;
+	IoT_Event_Slot *pSlot;
+
+	if(NULL == pEngine || NULL == pClient || NULL == task) {
+		return NULL_VALUE_ERROR;
+	}
+	pSlot = _engine_slot(pClient);
+	if(NULL == pSlot) {
+		return FAILURE;
+	}
+
+	pCommand = (IoT_Event_Command *) calloc(1, sizeof(IoT_Event_Command));
+	if(NULL == pCommand) {
+		return FAILURE;
+	}
+	pCommand->type = EVENT_COMMAND_POST;
+	pCommand->pClient = pClient;
+	pCommand->task = task;
+	pCommand->pData = pData;
+	pCommand->isOwned = true;
+
+	return _engine_submit(pSlot->pLoop, pCommand);
+}
+
+uint32_t aws_iot_event_engine_loop_count(const IoT_Event_Engine *pEngine) {
+	return (NULL == pEngine) ? 0 : pEngine->nbLoops;
+}
+
+uint32_t aws_iot_event_engine_loop_clients(const IoT_Event_Engine *pEngine, uint32_t loopIndex) {
+	if(NULL == pEngine || loopIndex >= pEngine->nbLoops) {
+		return 0;
+	}
+	return pEngine->pLoops[loopIndex].heapSize;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_event_engine.h
+ * @brief Event-loop engine driving many MQTT clients from a few threads (Linux)
+ *
+ * Instead of one task per client blocked in aws_iot_mqtt_yield, the engine
+ * runs one epoll loop per CPU core. Each loop owns a shard of the clients:
+ * it yields a client when its socket becomes readable, and when the next
+ * deadline of the client (keep-alive ping, ping response, reconnect back-off)
+ * expires, taken from a timer heap shared by the clients of the loop. The
+ * yields of the engine never wait for data: a read finding the socket empty
+ * ends the yield, a partially received packet is completed on a later call.
+ *
+ * Clients use the POSIX network layer (extras/platform/host/network_posix.c)
+ * and are connected, or have auto-reconnect enabled, before they are added.
+ * Once added, a client belongs to its loop thread: publish, subscribe and the
+ * other calls are made from subscription callbacks or from a task posted
+ * with aws_iot_event_engine_post. Blocking calls (a QoS 1 publish waiting for
+ * its PUBACK, a subscribe, a reconnect) stall the other clients of the loop
+ * for their duration.
+ */
+
+#ifndef AWS_IOT_SDK_EXTRAS_EVENT_ENGINE_H
+#define AWS_IOT_SDK_EXTRAS_EVENT_ENGINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+
+/**
+ * @brief Maximum number of epoll events handled per wake-up of a loop
+ */
+#ifndef AWS_IOT_EVENT_ENGINE_MAX_EVENTS
+#define AWS_IOT_EVENT_ENGINE_MAX_EVENTS 64
+#endif
+
+/**
+ * @brief Longest time a client is left alone, in ms
+ *
+ * Bounds the wait of clients without deadline, e.g. disconnected without
+ * auto-reconnect, so that a manual reconnect is noticed.
+ */
+#ifndef AWS_IOT_EVENT_ENGINE_MAX_SLEEP_MS
+#define AWS_IOT_EVENT_ENGINE_MAX_SLEEP_MS 1000
+#endif
+
+typedef struct _IoT_Event_Engine IoT_Event_Engine;
+
+/**
+ * @brief Work run on the loop thread owning a client
+ *
+ * @param pClient Client the task was posted for
+ * @param pData Data passed to aws_iot_event_engine_post
+ */
+typedef void (*IoT_Event_Engine_Task)(AWS_IoT_Client *pClient, void *pData);
+
+/**
+ * @brief Create the engine and start its loop threads
+ *
+ * Loop i is pinned to CPU i modulo the number of online CPUs.
+ *
+ * @param nbLoops Number of loops, 0 for one per online CPU
+ * @param maxClientsPerLoop Number of clients a loop can own
+ *
+ * @return IoT_Event_Engine* The engine, NULL on allocation or thread creation failure
+ */
+IoT_Event_Engine *aws_iot_event_engine_create(uint32_t nbLoops, uint32_t maxClientsPerLoop);
+
+/**
+ * @brief Stop the loops and free the engine
+ *
+ * Clients still registered are released as by aws_iot_event_engine_remove,
+ * they stay connected.
+ *
+ * @param pEngine Engine to destroy
+ */
+void aws_iot_event_engine_destroy(IoT_Event_Engine *pEngine);
+
+/**
+ * @brief Hand a client over to the loop owning the fewest clients
+ *
+ * Returns once the loop owns the client. The engine takes over the read
+ * function and pContext of the client's network, the client must not be
+ * re-initialized with iot_tls_init while it is registered.
+ *
+ * @param pEngine Engine
+ * @param pClient Client on the POSIX network layer
+ *
+ * @return IoT_Error_t SUCCESS, NULL_VALUE_ERROR, FAILURE when the client is
+ *         already registered, not on the POSIX network layer, or all loops are full
+ */
+IoT_Error_t aws_iot_event_engine_add(IoT_Event_Engine *pEngine, AWS_IoT_Client *pClient);
+
+/**
+ * @brief Take a client back from its loop
+ *
+ * Returns once the loop has released the client, which can then be used
+ * from any thread again. Can be called from a task or callback of the loop.
+ *
+ * @param pEngine Engine
+ * @param pClient Registered client
+ *
+ * @return IoT_Error_t SUCCESS, NULL_VALUE_ERROR, FAILURE when the client is not registered
+ */
+IoT_Error_t aws_iot_event_engine_remove(IoT_Event_Engine *pEngine, AWS_IoT_Client *pClient);
+
+/**
+ * @brief Run a task on the loop thread owning a client
+ *
+ * Does not wait for the task, which runs before the next yield of the
+ * client. Tasks posted for a client run in order.
+ *
+ * @param pEngine Engine
+ * @param pClient Registered client
+ * @param task Task to run
+ * @param pData Passed to the task
+ *
+ * @return IoT_Error_t SUCCESS, NULL_VALUE_ERROR, FAILURE when the client is not
+ *         registered or the task could not be allocated
+ */
+IoT_Error_t aws_iot_event_engine_post(IoT_Event_Engine *pEngine, AWS_IoT_Client *pClient, IoT_Event_Engine_Task task,
+									  void *pData);
+
+/**
+ * @brief Number of loops of the engine
+ *
+ * @param pEngine Engine
+ *
+ * @return uint32_t Number of loop threads
+ */
+uint32_t aws_iot_event_engine_loop_count(const IoT_Event_Engine *pEngine);
+
+/**
+ * @brief Number of clients owned by a loop
+ *
+ * @param pEngine Engine
+ * @param loopIndex Index of the loop, less than aws_iot_event_engine_loop_count
+ *
+ * @return uint32_t Number of registered clients on the loop
+ */
+uint32_t aws_iot_event_engine_loop_clients(const IoT_Event_Engine *pEngine, uint32_t loopIndex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_EXTRAS_EVENT_ENGINE_H */
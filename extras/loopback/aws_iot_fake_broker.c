@@ -0,0 +1,517 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_fake_broker.c
+ * @brief In-process MQTT 3.1.1 broker stand-in
+ */
+
+#include <string.h>
+
+#include "aws_iot_fake_broker.h"
+
+#define FAKE_BROKER_CONNECT 1
+#define FAKE_BROKER_CONNACK 2
+#define FAKE_BROKER_PUBLISH 3
+#define FAKE_BROKER_PUBACK 4
+#define FAKE_BROKER_SUBSCRIBE 8
+#define FAKE_BROKER_SUBACK 9
+#define FAKE_BROKER_UNSUBSCRIBE 10
+#define FAKE_BROKER_UNSUBACK 11
+#define FAKE_BROKER_PINGREQ 12
+#define FAKE_BROKER_PINGRESP 13
+#define FAKE_BROKER_DISCONNECT 14
+
+/* bytes of a packet being parsed */
+typedef struct {
+	const unsigned char *pCur;
+	const unsigned char *pEnd;
+} FakeBrokerReader_t;
+
+static bool _fake_broker_read_u16(FakeBrokerReader_t *pReader, uint16_t *pValue) {
+	if(pReader->pEnd - pReader->pCur < 2) {
+		return false;
+	}
+	*pValue = (uint16_t) ((pReader->pCur[0] << 8) | pReader->pCur[1]);
+	pReader->pCur += 2;
+	return true;
+}
+
+static bool _fake_broker_read_string(FakeBrokerReader_t *pReader, const char **ppString, uint16_t *pLen) {
+	if(!_fake_broker_read_u16(pReader, pLen) || pReader->pEnd - pReader->pCur < *pLen) {
+		return false;
+	}
+	*ppString = (const char *) pReader->pCur;
+	pReader->pCur += *pLen;
+	return true;
+}
+
+static bool _fake_broker_is_session(const IoT_Fake_Broker *pBroker, int session) {
+	return session >= 0 && session < IOT_FAKE_BROKER_MAX_SESSIONS && pBroker->sessions[session].isAttached;
+}
+
+/* MQTT 3.1.1 section 4.7, filters are assumed valid */
+static bool _fake_broker_is_matching(const char *pFilter, const char *pTopic, size_t topicLen) {
+	const char *pTopicEnd = pTopic + topicLen;
+
+	while('\0' != *pFilter) {
+		if('#' == *pFilter) {
+			return true;
+		}
+		if('+' == *pFilter) {
+			while(pTopic < pTopicEnd && '/' != *pTopic) {
+				pTopic++;
+			}
+			pFilter++;
+		} else {
+			if(pTopic == pTopicEnd || *pFilter != *pTopic) {
+				/* "a/#" also matches "a" */
+				return pTopic == pTopicEnd && '/' == pFilter[0] && '#' == pFilter[1] && '\0' == pFilter[2];
+			}
+			pFilter++;
+			pTopic++;
+		}
+	}
+	return pTopic == pTopicEnd;
+}
+
+static size_t _fake_broker_write_header(unsigned char *pBuf, unsigned char header, size_t remLen) {
+	size_t len = 0;
+
+	pBuf[len++] = header;
+	do {
+		unsigned char digit = (unsigned char) (remLen % 128);
+
+		remLen /= 128;
+		pBuf[len++] = (unsigned char) (digit | ((remLen > 0) ? 0x80 : 0));
+	} while(remLen > 0);
+	return len;
+}
+
+static bool _fake_broker_queue(IoT_Fake_Broker *pBroker, int session, const unsigned char *pHeader, size_t headerLen,
+							   const void *pBody, size_t bodyLen) {
+	IoT_Fake_Broker_Session *pSession = &pBroker->sessions[session];
+
+	if(pSession->queueHead == pSession->queueLen) {
+		pSession->queueHead = 0;
+		pSession->queueLen = 0;
+	}
+	if(IOT_FAKE_BROKER_QUEUE_LEN - pSession->queueLen < headerLen + bodyLen && 0 != pSession->queueHead) {
+		memmove(pSession->queue, &pSession->queue[pSession->queueHead], pSession->queueLen - pSession->queueHead);
+		pSession->queueLen -= pSession->queueHead;
+		pSession->queueHead = 0;
+	}
+	if(IOT_FAKE_BROKER_QUEUE_LEN - pSession->queueLen < headerLen + bodyLen) {
+		pBroker->stats.queueOverflows++;
+		return false;
+	}
+	memcpy(&pSession->queue[pSession->queueLen], pHeader, headerLen);
+	pSession->queueLen += headerLen;
+	if(0 != bodyLen) {
+		memcpy(&pSession->queue[pSession->queueLen], pBody, bodyLen);
+		pSession->queueLen += bodyLen;
+	}
+	return true;
+}
+
+static void _fake_broker_queue_ack(IoT_Fake_Broker *pBroker, int session, unsigned char header, uint16_t packetId) {
+	unsigned char packet[4];
+
+	if(0 != pBroker->acksToDrop) {
+		pBroker->acksToDrop--;
+		pBroker->stats.acksDropped++;
+		return;
+	}
+	packet[0] = header;
+	packet[1] = 2;
+	packet[2] = (unsigned char) (packetId >> 8);
+	packet[3] = (unsigned char) (packetId & 0xFF);
+	_fake_broker_queue(pBroker, session, packet, sizeof(packet), NULL, 0);
+}
+
+static bool _fake_broker_queue_publish(IoT_Fake_Broker *pBroker, int session, const char *pTopic, uint16_t topicLen,
+									   const void *pPayload, size_t payloadLen, uint8_t qos) {
+	IoT_Fake_Broker_Session *pSession = &pBroker->sessions[session];
+	unsigned char header[5 + 2 + IOT_FAKE_BROKER_MAX_FILTER_LEN + 2];
+	size_t headerLen;
+	size_t variableLen = 2 + (size_t) topicLen + ((0 < qos) ? 2 : 0);
+
+	if(topicLen >= IOT_FAKE_BROKER_MAX_FILTER_LEN) {
+		return false;
+	}
+	headerLen = _fake_broker_write_header(header, (unsigned char) ((FAKE_BROKER_PUBLISH << 4) | (qos << 1)),
+										  variableLen + payloadLen);
+	header[headerLen++] = (unsigned char) (topicLen >> 8);
+	header[headerLen++] = (unsigned char) (topicLen & 0xFF);
+	memcpy(&header[headerLen], pTopic, topicLen);
+	headerLen += topicLen;
+	if(0 < qos) {
+		if(0 == ++pSession->nextPacketId) {
+			pSession->nextPacketId = 1;
+		}
+		header[headerLen++] = (unsigned char) (pSession->nextPacketId >> 8);
+		header[headerLen++] = (unsigned char) (pSession->nextPacketId & 0xFF);
+	}
+	if(!_fake_broker_queue(pBroker, session, header, headerLen, pPayload, payloadLen)) {
+		return false;
+	}
+	pBroker->stats.publishesOut++;
+	return true;
+}
+
+static uint32_t _fake_broker_route(IoT_Fake_Broker *pBroker, const char *pTopic, uint16_t topicLen,
+								   const void *pPayload, size_t payloadLen, uint8_t qos) {
+	uint32_t delivered = 0;
+	size_t itr;
+
+	for(itr = 0; itr < pBroker->subscriptionCount; itr++) {
+		IoT_Fake_Broker_Subscription *pSubscription = &pBroker->subscriptions[itr];
+
+		if(pBroker->sessions[pSubscription->session].isConnected &&
+		   _fake_broker_is_matching(pSubscription->filter, pTopic, topicLen) &&
+		   _fake_broker_queue_publish(pBroker, pSubscription->session, pTopic, topicLen, pPayload, payloadLen,
+									  (qos < pSubscription->qos) ? qos : pSubscription->qos)) {
+			delivered++;
+		}
+	}
+	return delivered;
+}
+
+static void _fake_broker_unsubscribe(IoT_Fake_Broker *pBroker, int session, const char *pFilter, uint16_t filterLen) {
+	size_t itr = 0;
+
+	while(itr < pBroker->subscriptionCount) {
+		IoT_Fake_Broker_Subscription *pSubscription = &pBroker->subscriptions[itr];
+
+		if(session == pSubscription->session &&
+		   (NULL == pFilter || (strlen(pSubscription->filter) == filterLen &&
+								0 == memcmp(pSubscription->filter, pFilter, filterLen)))) {
+			*pSubscription = pBroker->subscriptions[--pBroker->subscriptionCount];
+		} else {
+			itr++;
+		}
+	}
+}
+
+static bool _fake_broker_handle_connect(IoT_Fake_Broker *pBroker, int session, FakeBrokerReader_t *pReader) {
+	IoT_Fake_Broker_Session *pSession = &pBroker->sessions[session];
+	unsigned char connack[4] = {FAKE_BROKER_CONNACK << 4, 2, 0, 0};
+	const char *pString;
+	uint16_t len;
+
+	/* protocol name, level, flags and keep alive, then the client id */
+	if(!_fake_broker_read_string(pReader, &pString, &len) || pReader->pEnd - pReader->pCur < 4) {
+		return false;
+	}
+	pReader->pCur += 4;
+	if(!_fake_broker_read_string(pReader, &pString, &len)) {
+		return false;
+	}
+	if(len >= sizeof(pSession->clientId)) {
+		len = sizeof(pSession->clientId) - 1;
+	}
+	memcpy(pSession->clientId, pString, len);
+	pSession->clientId[len] = '\0';
+
+	connack[3] = pBroker->connackReturnCode;
+	_fake_broker_queue(pBroker, session, connack, sizeof(connack), NULL, 0);
+	if(0 != pBroker->connackReturnCode) {
+		return false;
+	}
+	pSession->isConnected = true;
+	pBroker->stats.connects++;
+	return true;
+}
+
+static bool _fake_broker_handle_publish(IoT_Fake_Broker *pBroker, int session, unsigned char header,
+										FakeBrokerReader_t *pReader) {
+	uint8_t qos = (uint8_t) ((header >> 1) & 0x03);
+	const char *pTopic;
+	uint16_t topicLen;
+	uint16_t packetId = 0;
+
+	if(1 < qos || !_fake_broker_read_string(pReader, &pTopic, &topicLen) ||
+	   (0 < qos && !_fake_broker_read_u16(pReader, &packetId))) {
+		return false;
+	}
+	pBroker->stats.publishesIn++;
+	_fake_broker_route(pBroker, pTopic, topicLen, pReader->pCur, (size_t) (pReader->pEnd - pReader->pCur), qos);
+	if(0 < qos) {
+		_fake_broker_queue_ack(pBroker, session, FAKE_BROKER_PUBACK << 4, packetId);
+	}
+	return true;
+}
+
+static bool _fake_broker_handle_subscribe(IoT_Fake_Broker *pBroker, int session, FakeBrokerReader_t *pReader) {
+	unsigned char suback[5 + 2 + IOT_FAKE_BROKER_MAX_SUBSCRIPTIONS];
+	unsigned char codes[IOT_FAKE_BROKER_MAX_SUBSCRIPTIONS];
+	size_t codeCount = 0;
+	size_t headerLen;
+	const char *pFilter;
+	uint16_t filterLen;
+	uint16_t packetId;
+
+	if(!_fake_broker_read_u16(pReader, &packetId)) {
+		return false;
+	}
+	while(pReader->pCur < pReader->pEnd) {
+		IoT_Fake_Broker_Subscription *pSubscription;
+		uint8_t qos;
+
+		if(!_fake_broker_read_string(pReader, &pFilter, &filterLen) || pReader->pCur == pReader->pEnd ||
+		   codeCount == sizeof(codes)) {
+			return false;
+		}
+		qos = (uint8_t) (*pReader->pCur++ & 0x03);
+		if(1 < qos) {
+			qos = 1;
+		}
+
+		/* a new subscription to the same filter replaces the previous one */
+		_fake_broker_unsubscribe(pBroker, session, pFilter, filterLen);
+		if(filterLen >= IOT_FAKE_BROKER_MAX_FILTER_LEN ||
+		   pBroker->subscriptionCount == IOT_FAKE_BROKER_MAX_SUBSCRIPTIONS) {
+			codes[codeCount++] = 0x80;
+			continue;
+		}
+		pSubscription = &pBroker->subscriptions[pBroker->subscriptionCount++];
+		pSubscription->session = (uint16_t) session;
+		pSubscription->qos = qos;
+		memcpy(pSubscription->filter, pFilter, filterLen);
+		pSubscription->filter[filterLen] = '\0';
+		codes[codeCount++] = qos;
+	}
+
+	if(0 != pBroker->acksToDrop) {
+		pBroker->acksToDrop--;
+		pBroker->stats.acksDropped++;
+		return true;
+	}
+	headerLen = _fake_broker_write_header(suback, FAKE_BROKER_SUBACK << 4, 2 + codeCount);
+	suback[headerLen++] = (unsigned char) (packetId >> 8);
+	suback[headerLen++] = (unsigned char) (packetId & 0xFF);
+	_fake_broker_queue(pBroker, session, suback, headerLen, codes, codeCount);
+	return true;
+}
+
+static bool _fake_broker_handle_unsubscribe(IoT_Fake_Broker *pBroker, int session, FakeBrokerReader_t *pReader) {
+	const char *pFilter;
+	uint16_t filterLen;
+	uint16_t packetId;
+
+	if(!_fake_broker_read_u16(pReader, &packetId)) {
+		return false;
+	}
+	while(pReader->pCur < pReader->pEnd) {
+		if(!_fake_broker_read_string(pReader, &pFilter, &filterLen)) {
+			return false;
+		}
+		_fake_broker_unsubscribe(pBroker, session, pFilter, filterLen);
+	}
+	_fake_broker_queue_ack(pBroker, session, FAKE_BROKER_UNSUBACK << 4, packetId);
+	return true;
+}
+
+/* returns false when the session must be closed */
+static bool _fake_broker_handle_packet(IoT_Fake_Broker *pBroker, int session, const unsigned char *pPacket,
+									   size_t headerLen, size_t packetLen) {
+	IoT_Fake_Broker_Session *pSession = &pBroker->sessions[session];
+	FakeBrokerReader_t reader = {pPacket + headerLen, pPacket + packetLen};
+	unsigned char type = (unsigned char) (pPacket[0] >> 4);
+	unsigned char pingresp[2] = {FAKE_BROKER_PINGRESP << 4, 0};
+	uint16_t packetId;
+
+	if(!pSession->isConnected && FAKE_BROKER_CONNECT != type) {
+		return false;
+	}
+
+	switch(type) {
+		case FAKE_BROKER_CONNECT:
+			return !pSession->isConnected && _fake_broker_handle_connect(pBroker, session, &reader);
+		case FAKE_BROKER_PUBLISH:
+			return _fake_broker_handle_publish(pBroker, session, pPacket[0], &reader);
+		case FAKE_BROKER_PUBACK:
+			pBroker->stats.pubacksIn++;
+			return _fake_broker_read_u16(&reader, &packetId);
+		case FAKE_BROKER_SUBSCRIBE:
+			return _fake_broker_handle_subscribe(pBroker, session, &reader);
+		case FAKE_BROKER_UNSUBSCRIBE:
+			return _fake_broker_handle_unsubscribe(pBroker, session, &reader);
+		case FAKE_BROKER_PINGREQ:
+			_fake_broker_queue(pBroker, session, pingresp, sizeof(pingresp), NULL, 0);
+			return true;
+		case FAKE_BROKER_DISCONNECT:
+			return false;
+		default:
+			pBroker->stats.protocolErrors++;
+			return false;
+	}
+}
+
+/* length of the complete packet at the start of pBuf, 0 if incomplete, -1 if malformed */
+static long _fake_broker_packet_len(const unsigned char *pBuf, size_t len, size_t *pHeaderLen) {
+	size_t remLen = 0;
+	size_t multiplier = 1;
+	size_t itr;
+
+	for(itr = 1; itr < len && itr <= 4; itr++) {
+		remLen += (size_t) (pBuf[itr] & 0x7F) * multiplier;
+		multiplier *= 128;
+		if(0 == (pBuf[itr] & 0x80)) {
+			*pHeaderLen = itr + 1;
+			if(*pHeaderLen + remLen > IOT_FAKE_BROKER_MAX_PACKET_LEN) {
+				return -1;
+			}
+			return (*pHeaderLen + remLen <= len) ? (long) (*pHeaderLen + remLen) : 0;
+		}
+	}
+	return (itr > 4) ? -1 : 0;
+}
+
+void aws_iot_fake_broker_init(IoT_Fake_Broker *pBroker) {
+	memset(pBroker, 0, sizeof(IoT_Fake_Broker));
+}
+
+int aws_iot_fake_broker_attach(IoT_Fake_Broker *pBroker) {
+	int session;
+
+	if(pBroker->isRefusingSessions) {
+		return -1;
+	}
+	for(session = 0; session < IOT_FAKE_BROKER_MAX_SESSIONS; session++) {
+		IoT_Fake_Broker_Session *pSession = &pBroker->sessions[session];
+
+		if(!pSession->isAttached) {
+			pSession->isAttached = true;
+			pSession->isConnected = false;
+			pSession->clientId[0] = '\0';
+			pSession->nextPacketId = 0;
+			pSession->inboundLen = 0;
+			pSession->queueHead = 0;
+			pSession->queueLen = 0;
+			return session;
+		}
+	}
+	return -1;
+}
+
+void aws_iot_fake_broker_detach(IoT_Fake_Broker *pBroker, int session) {
+	if(!_fake_broker_is_session(pBroker, session)) {
+		return;
+	}
+	_fake_broker_unsubscribe(pBroker, session, NULL, 0);
+	pBroker->sessions[session].isAttached = false;
+	pBroker->sessions[session].isConnected = false;
+}
+
+IoT_Error_t aws_iot_fake_broker_receive(IoT_Fake_Broker *pBroker, int session, const unsigned char *pData, size_t len) {
+	IoT_Fake_Broker_Session *pSession;
+	size_t consumed = 0;
+	size_t headerLen = 0;
+	long packetLen;
+
+	if(!_fake_broker_is_session(pBroker, session)) {
+		return NETWORK_DISCONNECTED_ERROR;
+	}
+	pSession = &pBroker->sessions[session];
+
+	while(consumed < len) {
+		size_t chunk = len - consumed;
+
+		if(chunk > IOT_FAKE_BROKER_MAX_PACKET_LEN - pSession->inboundLen) {
+			chunk = IOT_FAKE_BROKER_MAX_PACKET_LEN - pSession->inboundLen;
+		}
+		memcpy(&pSession->inbound[pSession->inboundLen], &pData[consumed], chunk);
+		pSession->inboundLen += chunk;
+		consumed += chunk;
+
+		while(0 < (packetLen = _fake_broker_packet_len(pSession->inbound, pSession->inboundLen, &headerLen))) {
+			if(!_fake_broker_handle_packet(pBroker, session, pSession->inbound, headerLen, (size_t) packetLen)) {
+				pSession->isConnected = false;
+				_fake_broker_unsubscribe(pBroker, session, NULL, 0);
+				pSession->inboundLen = 0;
+				return NETWORK_DISCONNECTED_ERROR;
+			}
+			pSession->inboundLen -= (size_t) packetLen;
+			memmove(pSession->inbound, &pSession->inbound[packetLen], pSession->inboundLen);
+		}
+		if(0 > packetLen) {
+			pBroker->stats.protocolErrors++;
+			pSession->isConnected = false;
+			_fake_broker_unsubscribe(pBroker, session, NULL, 0);
+			pSession->inboundLen = 0;
+			return NETWORK_DISCONNECTED_ERROR;
+		}
+	}
+	return SUCCESS;
+}
+
+size_t aws_iot_fake_broker_take(IoT_Fake_Broker *pBroker, int session, unsigned char *pBuffer, size_t len) {
+	IoT_Fake_Broker_Session *pSession;
+	size_t available;
+
+	if(!_fake_broker_is_session(pBroker, session)) {
+		return 0;
+	}
+	pSession = &pBroker->sessions[session];
+	available = pSession->queueLen - pSession->queueHead;
+	if(len > available) {
+		len = available;
+	}
+	memcpy(pBuffer, &pSession->queue[pSession->queueHead], len);
+	pSession->queueHead += len;
+	return len;
+}
+
+size_t aws_iot_fake_broker_pending(const IoT_Fake_Broker *pBroker, int session) {
+	if(!_fake_broker_is_session(pBroker, session)) {
+		return 0;
+	}
+	return pBroker->sessions[session].queueLen - pBroker->sessions[session].queueHead;
+}
+
+bool aws_iot_fake_broker_is_open(const IoT_Fake_Broker *pBroker, int session) {
+	return _fake_broker_is_session(pBroker, session) && pBroker->sessions[session].isConnected;
+}
+
+uint32_t aws_iot_fake_broker_publish(IoT_Fake_Broker *pBroker, const char *pTopic, const void *pPayload,
+									 size_t payloadLen, uint8_t qos) {
+	return _fake_broker_route(pBroker, pTopic, (uint16_t) strlen(pTopic), pPayload, payloadLen,
+							  (1 < qos) ? 1 : qos);
+}
+
+void aws_iot_fake_broker_set_connack(IoT_Fake_Broker *pBroker, uint8_t returnCode) {
+	pBroker->connackReturnCode = returnCode;
+}
+
+void aws_iot_fake_broker_refuse_sessions(IoT_Fake_Broker *pBroker, bool isRefusing) {
+	pBroker->isRefusingSessions = isRefusing;
+}
+
+void aws_iot_fake_broker_drop_acks(IoT_Fake_Broker *pBroker, uint32_t count) {
+	pBroker->acksToDrop = count;
+}
+
+void aws_iot_fake_broker_close_all(IoT_Fake_Broker *pBroker) {
+	int session;
+
+	for(session = 0; session < IOT_FAKE_BROKER_MAX_SESSIONS; session++) {
+		if(pBroker->sessions[session].isAttached) {
+			pBroker->sessions[session].isConnected = false;
+			pBroker->sessions[session].queueHead = pBroker->sessions[session].queueLen;
+		}
+	}
+	pBroker->subscriptionCount = 0;
+}
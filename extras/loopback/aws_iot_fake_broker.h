@@ -0,0 +1,229 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_fake_broker.h
+ * @brief In-process MQTT 3.1.1 broker stand-in for host tests and benchmarks
+ *
+ * The broker has no transport. A transport attaches a session, feeds it the
+ * bytes written by the client with aws_iot_fake_broker_receive and hands
+ * back the bytes queued for the client with aws_iot_fake_broker_take. Every
+ * packet is answered synchronously, inside aws_iot_fake_broker_receive.
+ *
+ * Supported: CONNECT, PUBLISH QoS0/1 (routed to every matching subscription,
+ * the sender included), PUBACK, SUBSCRIBE (granted QoS capped to 1),
+ * UNSUBSCRIBE, PINGREQ and DISCONNECT. No retained messages, no persistent
+ * sessions, no QoS2.
+ *
+ * The script functions change the broker behavior for the next packets, e.g.
+ * to refuse connections or to swallow acknowledgements.
+ */
+
+#ifndef AWS_IOT_SDK_EXTRAS_FAKE_BROKER_H
+#define AWS_IOT_SDK_EXTRAS_FAKE_BROKER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "aws_iot_error.h"
+
+/**
+ * @brief Number of clients connected at the same time
+ */
+#ifndef IOT_FAKE_BROKER_MAX_SESSIONS
+#define IOT_FAKE_BROKER_MAX_SESSIONS 8
+#endif
+
+/**
+ * @brief Number of subscriptions over all sessions
+ */
+#ifndef IOT_FAKE_BROKER_MAX_SUBSCRIPTIONS
+#define IOT_FAKE_BROKER_MAX_SUBSCRIPTIONS 64
+#endif
+
+/**
+ * @brief Largest packet accepted from a client, in bytes
+ */
+#ifndef IOT_FAKE_BROKER_MAX_PACKET_LEN
+#define IOT_FAKE_BROKER_MAX_PACKET_LEN 8192
+#endif
+
+/**
+ * @brief Bytes queued for a client before packets are dropped
+ */
+#ifndef IOT_FAKE_BROKER_QUEUE_LEN
+#define IOT_FAKE_BROKER_QUEUE_LEN (64 * 1024)
+#endif
+
+/**
+ * @brief Longest topic filter, including the terminating null
+ */
+#define IOT_FAKE_BROKER_MAX_FILTER_LEN 128
+
+/**
+ * @brief Counters of a broker, cumulated over all sessions
+ */
+typedef struct {
+	uint32_t connects;			///< CONNECT packets accepted
+	uint32_t publishesIn;		///< PUBLISH packets received from clients
+	uint32_t publishesOut;		///< PUBLISH packets queued for clients
+	uint32_t pubacksIn;			///< PUBACK packets received from clients
+	uint32_t acksDropped;		///< Acknowledgements swallowed by aws_iot_fake_broker_drop_acks
+	uint32_t queueOverflows;	///< Packets dropped because a client queue was full
+	uint32_t protocolErrors;	///< Malformed or unsupported packets, the session is closed
+} IoT_Fake_Broker_Stats;
+
+/**
+ * @brief State of one connected client
+ */
+typedef struct {
+	bool isAttached;			///< Owned by a transport
+	bool isConnected;			///< CONNECT accepted, closed on DISCONNECT or error
+	char clientId[64];			///< Client identifier of the CONNECT packet
+	uint16_t nextPacketId;		///< Packet id of the next QoS1 PUBLISH sent to the client
+	size_t inboundLen;			///< Bytes of the packet being received
+	unsigned char inbound[IOT_FAKE_BROKER_MAX_PACKET_LEN];	///< Packet being received
+	size_t queueHead;			///< First byte not taken yet
+	size_t queueLen;			///< End of the queued bytes
+	unsigned char queue[IOT_FAKE_BROKER_QUEUE_LEN];		///< Bytes queued for the client
+} IoT_Fake_Broker_Session;
+
+/**
+ * @brief Subscription of a session
+ */
+typedef struct {
+	uint16_t session;			///< Index of the subscribed session
+	uint8_t qos;				///< Granted QoS
+	char filter[IOT_FAKE_BROKER_MAX_FILTER_LEN];	///< Topic filter
+} IoT_Fake_Broker_Subscription;
+
+/**
+ * @brief Broker state, large: allocate it statically or on the heap
+ */
+typedef struct {
+	IoT_Fake_Broker_Session sessions[IOT_FAKE_BROKER_MAX_SESSIONS];
+	IoT_Fake_Broker_Subscription subscriptions[IOT_FAKE_BROKER_MAX_SUBSCRIPTIONS];
+	size_t subscriptionCount;
+	uint8_t connackReturnCode;	///< Return code of the next CONNACKs, 0 accepts
+	bool isRefusingSessions;		///< aws_iot_fake_broker_attach fails
+	uint32_t acksToDrop;		///< PUBACK / SUBACK / UNSUBACK still to swallow
+	IoT_Fake_Broker_Stats stats;
+} IoT_Fake_Broker;
+
+/**
+ * @brief Reset a broker: no session, no subscription, default script
+ *
+ * @param pBroker Broker to initialize
+ */
+void aws_iot_fake_broker_init(IoT_Fake_Broker *pBroker);
+
+/**
+ * @brief Attach a new session, as when a TCP connection is accepted
+ *
+ * @param pBroker Broker
+ *
+ * @return int Session index, -1 if all sessions are in use or sessions are refused
+ */
+int aws_iot_fake_broker_attach(IoT_Fake_Broker *pBroker);
+
+/**
+ * @brief Close a session and drop its subscriptions and queued bytes
+ *
+ * @param pBroker Broker
+ * @param session Session index
+ */
+void aws_iot_fake_broker_detach(IoT_Fake_Broker *pBroker, int session);
+
+/**
+ * @brief Feed bytes written by the client of a session
+ *
+ * Complete packets are processed and answered before returning, partial ones are kept.
+ *
+ * @param pBroker Broker
+ * @param session Session index
+ * @param pData Bytes written by the client
+ * @param len Number of bytes
+ *
+ * @return IoT_Error_t SUCCESS, NETWORK_DISCONNECTED_ERROR if the session is closed
+ * (DISCONNECT, refused CONNECT or protocol error)
+ */
+IoT_Error_t aws_iot_fake_broker_receive(IoT_Fake_Broker *pBroker, int session, const unsigned char *pData, size_t len);
+
+/**
+ * @brief Take bytes queued for the client of a session
+ *
+ * @param pBroker Broker
+ * @param session Session index
+ * @param pBuffer Destination
+ * @param len Size of the destination
+ *
+ * @return size_t Number of bytes copied, 0 when nothing is queued
+ */
+size_t aws_iot_fake_broker_take(IoT_Fake_Broker *pBroker, int session, unsigned char *pBuffer, size_t len);
+
+/**
+ * @brief Number of bytes queued for the client of a session
+ */
+size_t aws_iot_fake_broker_pending(const IoT_Fake_Broker *pBroker, int session);
+
+/**
+ * @brief Whether a session is attached and has not been closed by the broker
+ */
+bool aws_iot_fake_broker_is_open(const IoT_Fake_Broker *pBroker, int session);
+
+/**
+ * @brief Publish a message from the broker side to every matching subscription
+ *
+ * @param pBroker Broker
+ * @param pTopic Topic name
+ * @param pPayload Payload
+ * @param payloadLen Payload length
+ * @param qos Maximum QoS of the delivery, 0 or 1
+ *
+ * @return uint32_t Number of sessions the message was queued for
+ */
+uint32_t aws_iot_fake_broker_publish(IoT_Fake_Broker *pBroker, const char *pTopic, const void *pPayload,
+									 size_t payloadLen, uint8_t qos);
+
+/**
+ * @brief Script: return code of the next CONNACKs, 0 accepts the connection
+ */
+void aws_iot_fake_broker_set_connack(IoT_Fake_Broker *pBroker, uint8_t returnCode);
+
+/**
+ * @brief Script: refuse new sessions, as an unreachable host would
+ */
+void aws_iot_fake_broker_refuse_sessions(IoT_Fake_Broker *pBroker, bool isRefusing);
+
+/**
+ * @brief Script: swallow the next count PUBACK, SUBACK and UNSUBACK
+ */
+void aws_iot_fake_broker_drop_acks(IoT_Fake_Broker *pBroker, uint32_t count);
+
+/**
+ * @brief Script: close every session, as a broker restart would
+ */
+void aws_iot_fake_broker_close_all(IoT_Fake_Broker *pBroker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_EXTRAS_FAKE_BROKER_H */
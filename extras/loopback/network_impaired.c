@@ -0,0 +1,362 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_impaired.c
+ * @brief Network decorator injecting latency, bandwidth caps, stalls and errors
+ */
+
+#include <string.h>
+
+#include "network_impaired.h"
+#include "timer_host.h"
+
+static IoT_Impaired_Network *_impaired(Network *pNetwork) {
+	return (IoT_Impaired_Network *) pNetwork->tlsDataParams.pContext;
+}
+
+/* times are compared modulo 2^32 */
+static bool _impaired_is_due(uint32_t now, uint32_t time) {
+	return 0 <= (int32_t) (now - time);
+}
+
+/* splitmix64 */
+static uint64_t _impaired_random(IoT_Impaired_Network *pImpaired) {
+	uint64_t z = (pImpaired->rng += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static bool _impaired_roll(IoT_Impaired_Network *pImpaired, uint16_t permille) {
+	return 0 != permille && (_impaired_random(pImpaired) % 1000) < permille;
+}
+
+static void _impaired_roll_stall(IoT_Impaired_Network *pImpaired, uint32_t now) {
+	if(pImpaired->isStalled && _impaired_is_due(now, pImpaired->stallEndMs)) {
+		pImpaired->isStalled = false;
+	}
+	if(!pImpaired->isStalled && _impaired_roll(pImpaired, pImpaired->params.stallPermille)) {
+		pImpaired->isStalled = true;
+		pImpaired->stallEndMs = now + pImpaired->params.stallMs;
+		pImpaired->stats.stalls++;
+	}
+}
+
+/* time the last of len bytes goes through a link capped at the configured bandwidth */
+static uint32_t _impaired_transmit(IoT_Impaired_Network *pImpaired, uint32_t *pFreeMs, uint32_t *pCarry, size_t len,
+								   uint32_t now) {
+	uint32_t bandwidth = pImpaired->params.bandwidthBytesPerSec;
+	uint64_t total;
+
+	if(0 == bandwidth) {
+		return now;
+	}
+	if(_impaired_is_due(now, *pFreeMs)) {
+		*pFreeMs = now;
+		*pCarry = 0;
+	}
+	total = (uint64_t) len * 1000 + *pCarry;
+	*pFreeMs += (uint32_t) (total / bandwidth);
+	*pCarry = (uint32_t) (total % bandwidth);
+	return *pFreeMs;
+}
+
+/* waits until the given time, false if the timer of the caller expires first */
+static bool _impaired_wait_until(IoT_Impaired_Network *pImpaired, uint32_t time, Timer *timer) {
+	uint32_t now = aws_iot_host_now_ms();
+	uint32_t wait;
+
+	while(!_impaired_is_due(now, time)) {
+		wait = left_ms(timer);
+		if(0 == wait) {
+			return false;
+		}
+		if(wait > time - now) {
+			wait = time - now;
+		}
+		aws_iot_host_sleep_ms(wait);
+		pImpaired->stats.delayedMs += wait;
+		now = aws_iot_host_now_ms();
+	}
+	return true;
+}
+
+static void _impaired_reset(IoT_Impaired_Network *pImpaired) {
+	pImpaired->isStalled = false;
+	pImpaired->pendingError = SUCCESS;
+	pImpaired->head = 0;
+	pImpaired->len = 0;
+	pImpaired->chunkHead = 0;
+	pImpaired->chunkCount = 0;
+}
+
+/* moves the bytes of the wrapped Network into the buffer, stamped with their arrival time */
+static void _impaired_pull(IoT_Impaired_Network *pImpaired, size_t wanted, Timer *timer) {
+	IoT_Impaired_Chunk *pChunk;
+	uint32_t arrival;
+	uint32_t now;
+	size_t rxLen = 0;
+	IoT_Error_t rc;
+	uint32_t i;
+
+	if(SUCCESS != pImpaired->pendingError || IOT_IMPAIRED_MAX_CHUNKS == pImpaired->chunkCount) {
+		return;
+	}
+	if(0 == pImpaired->chunkCount) {
+		pImpaired->head = 0;
+		pImpaired->len = 0;
+	} else if(0 != pImpaired->head && IOT_IMPAIRED_BUFFER_LEN == pImpaired->len) {
+		memmove(pImpaired->buffer, &pImpaired->buffer[pImpaired->head], pImpaired->len - pImpaired->head);
+		for(i = 0; i < pImpaired->chunkCount; i++) {
+			pImpaired->chunks[(pImpaired->chunkHead + i) % IOT_IMPAIRED_MAX_CHUNKS].end -= pImpaired->head;
+		}
+		pImpaired->len -= pImpaired->head;
+		pImpaired->head = 0;
+	}
+	if(wanted > IOT_IMPAIRED_BUFFER_LEN - pImpaired->len) {
+		wanted = IOT_IMPAIRED_BUFFER_LEN - pImpaired->len;
+	}
+	if(0 == wanted) {
+		return;
+	}
+
+	rc = pImpaired->inner.read(&(pImpaired->inner), &pImpaired->buffer[pImpaired->len], wanted, timer, &rxLen);
+	if(SUCCESS != rc && NETWORK_SSL_NOTHING_TO_READ != rc && NETWORK_SSL_READ_TIMEOUT_ERROR != rc) {
+		pImpaired->pendingError = rc;
+	}
+	if(0 == rxLen) {
+		return;
+	}
+
+	now = aws_iot_host_now_ms();
+	arrival = _impaired_transmit(pImpaired, &pImpaired->inboundFreeMs, &pImpaired->inboundCarry, rxLen, now) +
+			  pImpaired->params.latencyMs;
+	if(0 != pImpaired->params.jitterMs) {
+		arrival += (uint32_t) (_impaired_random(pImpaired) % ((uint64_t) pImpaired->params.jitterMs + 1));
+	}
+	if(!_impaired_is_due(arrival, pImpaired->lastArrivalMs)) {
+		arrival = pImpaired->lastArrivalMs;
+	}
+	pImpaired->lastArrivalMs = arrival;
+
+	pImpaired->len += rxLen;
+	pChunk = &pImpaired->chunks[(pImpaired->chunkHead + pImpaired->chunkCount) % IOT_IMPAIRED_MAX_CHUNKS];
+	pChunk->end = pImpaired->len;
+	pChunk->arrivalMs = arrival;
+	pImpaired->chunkCount++;
+}
+
+static size_t _impaired_deliver(IoT_Impaired_Network *pImpaired, unsigned char *pMsg, size_t len, uint32_t now) {
+	IoT_Impaired_Chunk *pChunk;
+	size_t delivered = 0;
+	size_t chunkLen;
+
+	if(pImpaired->isStalled) {
+		if(!_impaired_is_due(now, pImpaired->stallEndMs)) {
+			return 0;
+		}
+		pImpaired->isStalled = false;
+	}
+
+	while(delivered < len && 0 != pImpaired->chunkCount) {
+		pChunk = &pImpaired->chunks[pImpaired->chunkHead];
+		if(!_impaired_is_due(now, pChunk->arrivalMs)) {
+			break;
+		}
+		chunkLen = pChunk->end - pImpaired->head;
+		if(chunkLen > len - delivered) {
+			chunkLen = len - delivered;
+		}
+		memcpy(&pMsg[delivered], &pImpaired->buffer[pImpaired->head], chunkLen);
+		pImpaired->head += chunkLen;
+		delivered += chunkLen;
+		if(pImpaired->head == pChunk->end) {
+			pImpaired->chunkHead = (pImpaired->chunkHead + 1) % IOT_IMPAIRED_MAX_CHUNKS;
+			pImpaired->chunkCount--;
+		}
+	}
+
+	pImpaired->stats.bytesIn += delivered;
+	return delivered;
+}
+
+/* next time something can be delivered */
+static uint32_t _impaired_next_arrival(const IoT_Impaired_Network *pImpaired) {
+	uint32_t arrival = pImpaired->chunks[pImpaired->chunkHead].arrivalMs;
+
+	if(pImpaired->isStalled && !_impaired_is_due(arrival, pImpaired->stallEndMs)) {
+		arrival = pImpaired->stallEndMs;
+	}
+	return arrival;
+}
+
+/* whether the first chunk in flight can be delivered now */
+static bool _impaired_is_ready(const IoT_Impaired_Network *pImpaired, uint32_t now) {
+	return 0 != pImpaired->chunkCount && _impaired_is_due(now, pImpaired->chunks[pImpaired->chunkHead].arrivalMs) &&
+		   (!pImpaired->isStalled || _impaired_is_due(now, pImpaired->stallEndMs));
+}
+
+static IoT_Error_t _impaired_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								  size_t *read_len) {
+	IoT_Impaired_Network *pImpaired = _impaired(pNetwork);
+	bool isRolled = false;
+	IoT_Error_t rc;
+	Timer expired;
+	uint32_t now;
+
+	*read_len = 0;
+	init_timer(&expired);
+	countdown_ms(&expired, 0);
+	for(;;) {
+		/* everything available is pulled at once, to share one arrival time */
+		_impaired_pull(pImpaired, IOT_IMPAIRED_BUFFER_LEN, &expired);
+		if(0 == pImpaired->chunkCount && SUCCESS == pImpaired->pendingError) {
+			/* nothing in flight: wait on the wrapped Network like an unimpaired read */
+			_impaired_pull(pImpaired, len - *read_len, timer);
+			_impaired_pull(pImpaired, IOT_IMPAIRED_BUFFER_LEN, &expired);
+			if(0 == pImpaired->chunkCount && SUCCESS == pImpaired->pendingError) {
+				break;
+			}
+		}
+
+		/* idle polls draw nothing, the impairments follow the traffic */
+		now = aws_iot_host_now_ms();
+		if(!isRolled && _impaired_is_ready(pImpaired, now)) {
+			isRolled = true;
+			if(_impaired_roll(pImpaired, pImpaired->params.readErrorPermille)) {
+				pImpaired->stats.readErrors++;
+				return NETWORK_SSL_READ_ERROR;
+			}
+			_impaired_roll_stall(pImpaired, now);
+		}
+
+		*read_len += _impaired_deliver(pImpaired, &pMsg[*read_len], len - *read_len, now);
+		if(*read_len == len) {
+			return SUCCESS;
+		}
+		if(0 == pImpaired->chunkCount && SUCCESS != pImpaired->pendingError) {
+			rc = pImpaired->pendingError;
+			pImpaired->pendingError = SUCCESS;
+			return rc;
+		}
+		if(0 != pImpaired->chunkCount && !_impaired_wait_until(pImpaired, _impaired_next_arrival(pImpaired), timer)) {
+			break;
+		}
+	}
+
+	return (0 == *read_len) ? NETWORK_SSL_NOTHING_TO_READ : NETWORK_SSL_READ_TIMEOUT_ERROR;
+}
+
+static IoT_Error_t _impaired_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								   size_t *written_len) {
+	IoT_Impaired_Network *pImpaired = _impaired(pNetwork);
+	uint32_t ready;
+	uint32_t now;
+	IoT_Error_t rc;
+
+	*written_len = 0;
+	_impaired_roll_stall(pImpaired, aws_iot_host_now_ms());
+	if(_impaired_roll(pImpaired, pImpaired->params.writeErrorPermille)) {
+		pImpaired->stats.writeErrors++;
+		return NETWORK_SSL_WRITE_ERROR;
+	}
+	if(1 < len && _impaired_roll(pImpaired, pImpaired->params.partialWritePermille)) {
+		len = 1 + (size_t) (_impaired_random(pImpaired) % (len - 1));
+		pImpaired->stats.partialWrites++;
+	}
+
+	/* the previous writes hold the capped link, a stall holds everything */
+	now = aws_iot_host_now_ms();
+	ready = now;
+	if(0 != pImpaired->params.bandwidthBytesPerSec && !_impaired_is_due(now, pImpaired->outboundFreeMs)) {
+		ready = pImpaired->outboundFreeMs;
+	}
+	if(pImpaired->isStalled && !_impaired_is_due(ready, pImpaired->stallEndMs)) {
+		ready = pImpaired->stallEndMs;
+	}
+	if(!_impaired_wait_until(pImpaired, ready, timer)) {
+		return NETWORK_SSL_WRITE_TIMEOUT_ERROR;
+	}
+
+	rc = pImpaired->inner.write(&(pImpaired->inner), pMsg, len, timer, written_len);
+	_impaired_transmit(pImpaired, &pImpaired->outboundFreeMs, &pImpaired->outboundCarry, *written_len,
+					   aws_iot_host_now_ms());
+	pImpaired->stats.bytesOut += *written_len;
+	return rc;
+}
+
+static IoT_Error_t _impaired_connect(Network *pNetwork, TLSConnectParams *params) {
+	IoT_Impaired_Network *pImpaired = _impaired(pNetwork);
+
+	_impaired_reset(pImpaired);
+	/* the connect parameters may have been changed on the outer Network */
+	pImpaired->inner.tlsConnectParams = pNetwork->tlsConnectParams;
+	if(0 != pImpaired->params.latencyMs) {
+		aws_iot_host_sleep_ms(pImpaired->params.latencyMs);
+		pImpaired->stats.delayedMs += pImpaired->params.latencyMs;
+	}
+	return pImpaired->inner.connect(&(pImpaired->inner), params);
+}
+
+static IoT_Error_t _impaired_disconnect(Network *pNetwork) {
+	IoT_Impaired_Network *pImpaired = _impaired(pNetwork);
+
+	_impaired_reset(pImpaired);
+	return pImpaired->inner.disconnect(&(pImpaired->inner));
+}
+
+static IoT_Error_t _impaired_is_connected(Network *pNetwork) {
+	IoT_Impaired_Network *pImpaired = _impaired(pNetwork);
+
+	return pImpaired->inner.isConnected(&(pImpaired->inner));
+}
+
+static IoT_Error_t _impaired_destroy(Network *pNetwork) {
+	IoT_Impaired_Network *pImpaired = _impaired(pNetwork);
+
+	_impaired_reset(pImpaired);
+	return pImpaired->inner.destroy(&(pImpaired->inner));
+}
+
+IoT_Error_t aws_iot_impaired_network_init(Network *pNetwork, IoT_Impaired_Network *pImpaired,
+										  const IoT_Impairment_Params *pParams) {
+	if(NULL == pNetwork || NULL == pImpaired || NULL == pParams) {
+		return NULL_VALUE_ERROR;
+	}
+
+	memset(pImpaired, 0, sizeof(IoT_Impaired_Network));
+	pImpaired->inner = *pNetwork;
+	pImpaired->params = *pParams;
+	pImpaired->rng = pParams->seed;
+	pImpaired->lastArrivalMs = aws_iot_host_now_ms();
+	pImpaired->inboundFreeMs = pImpaired->lastArrivalMs;
+	pImpaired->outboundFreeMs = pImpaired->lastArrivalMs;
+
+	pNetwork->connect = _impaired_connect;
+	pNetwork->read = _impaired_read;
+	pNetwork->write = _impaired_write;
+	pNetwork->disconnect = _impaired_disconnect;
+	pNetwork->isConnected = _impaired_is_connected;
+	pNetwork->destroy = _impaired_destroy;
+	pNetwork->tlsDataParams.pContext = pImpaired;
+
+	return SUCCESS;
+}
+
+void aws_iot_impaired_network_set_params(IoT_Impaired_Network *pImpaired, const IoT_Impairment_Params *pParams) {
+	pImpaired->params = *pParams;
+}
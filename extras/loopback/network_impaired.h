@@ -0,0 +1,156 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_impaired.h
+ * @brief Network decorator degrading another Network like a bad Wi-Fi link
+ *
+ * Usage: install the Network to impair (aws_iot_mqtt_init for the POSIX
+ * layer, aws_iot_loopback_network_init for the loopback one), then
+ * aws_iot_impaired_network_init on the same Network. The decorator keeps a
+ * copy of the wrapped Network and calls it, adding on the way:
+ *
+ * - latency and jitter: bytes read from the wrapped Network reach the client
+ *   latencyMs (plus 0 to jitterMs) later, in order. It is applied once, on the
+ *   inbound direction, so it stands for the round trip;
+ * - a bandwidth cap, per direction: inbound bytes are released and outbound
+ *   bytes accepted no faster than the cap;
+ * - stalls: the link freezes for stallMs, nothing is delivered or sent;
+ * - partial writes: a write accepts only part of the buffer, as a full TCP
+ *   send buffer would;
+ * - read and write errors, with the codes of the TLS layer.
+ *
+ * Every decision comes from a PRNG seeded by the parameters. Errors, stalls
+ * and partial writes are drawn once per write and once per read that has data
+ * to deliver, never on idle polls, so the same seed and the same traffic give
+ * the same impairments. Time is the host clock (timer_host.h), the waits are
+ * bounded by the timer of the caller. Impairments only progress while the
+ * client calls the network, i.e. inside yield and the blocking calls.
+ */
+
+#ifndef AWS_IOT_SDK_EXTRAS_NETWORK_IMPAIRED_H
+#define AWS_IOT_SDK_EXTRAS_NETWORK_IMPAIRED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "network_interface.h"
+
+/**
+ * @brief Inbound bytes buffered by the decorator
+ */
+#ifndef IOT_IMPAIRED_BUFFER_LEN
+#define IOT_IMPAIRED_BUFFER_LEN 16384
+#endif
+
+/**
+ * @brief Inbound chunks in flight, each with its own arrival time
+ */
+#ifndef IOT_IMPAIRED_MAX_CHUNKS
+#define IOT_IMPAIRED_MAX_CHUNKS 64
+#endif
+
+/**
+ * @brief Impairments, probabilities are per thousand writes or reads with data
+ */
+typedef struct {
+	uint64_t seed;					///< Seed of the PRNG, same seed same impairments
+	uint32_t latencyMs;				///< Delay of the inbound bytes
+	uint32_t jitterMs;				///< Random extra delay, 0 to jitterMs, order is kept
+	uint32_t bandwidthBytesPerSec;	///< Cap of each direction, 0 for none
+	uint16_t stallPermille;			///< Chance that a read or write starts a stall of the link
+	uint32_t stallMs;				///< Duration of a stall
+	uint16_t partialWritePermille;	///< Chance that a write accepts only part of the buffer
+	uint16_t readErrorPermille;		///< Chance that a read fails with NETWORK_SSL_READ_ERROR
+	uint16_t writeErrorPermille;	///< Chance that a write fails with NETWORK_SSL_WRITE_ERROR
+} IoT_Impairment_Params;
+
+/**
+ * @brief Impairments applied so far
+ */
+typedef struct {
+	uint32_t stalls;				///< Stalls started
+	uint32_t partialWrites;			///< Writes cut short
+	uint32_t readErrors;			///< Injected read errors
+	uint32_t writeErrors;			///< Injected write errors
+	uint64_t bytesIn;				///< Bytes delivered to the client
+	uint64_t bytesOut;				///< Bytes written to the wrapped Network
+	uint64_t delayedMs;				///< Time spent waiting for latency, bandwidth and stalls
+} IoT_Impairment_Stats;
+
+/**
+ * @brief Inbound bytes of the same arrival time
+ */
+typedef struct {
+	size_t end;						///< Offset of the end of the chunk in the buffer
+	uint32_t arrivalMs;				///< Time the chunk reaches the client
+} IoT_Impaired_Chunk;
+
+/**
+ * @brief State of an impaired Network, one per client
+ */
+typedef struct {
+	Network inner;					///< The wrapped Network
+	IoT_Impairment_Params params;
+	uint64_t rng;
+	uint32_t stallEndMs;			///< Meaningful while isStalled
+	bool isStalled;
+	uint32_t inboundFreeMs;			///< The inbound link is busy until then
+	uint32_t outboundFreeMs;		///< The outbound link is busy until then
+	uint32_t inboundCarry;			///< Bytes x 1000 not accounted in inboundFreeMs yet
+	uint32_t outboundCarry;
+	uint32_t lastArrivalMs;			///< Chunks never overtake each other
+	IoT_Error_t pendingError;		///< Error of the wrapped read, returned once the buffer is drained
+	size_t head;					///< First byte not delivered
+	size_t len;						///< End of the buffered bytes
+	unsigned char buffer[IOT_IMPAIRED_BUFFER_LEN];
+	IoT_Impaired_Chunk chunks[IOT_IMPAIRED_MAX_CHUNKS];
+	uint32_t chunkHead;
+	uint32_t chunkCount;
+	IoT_Impairment_Stats stats;
+} IoT_Impaired_Network;
+
+/**
+ * @brief Wrap the Network installed in pNetwork
+ *
+ * @param pNetwork Network to impair, usually &client.networkStack, already initialized
+ * @param pImpaired State of the decorator, must outlive the client
+ * @param pParams Impairments, copied
+ *
+ * @return IoT_Error_t SUCCESS, NULL_VALUE_ERROR
+ */
+IoT_Error_t aws_iot_impaired_network_init(Network *pNetwork, IoT_Impaired_Network *pImpaired,
+										  const IoT_Impairment_Params *pParams);
+
+/**
+ * @brief Change the impairments of a running connection, e.g. to start a bad phase
+ *
+ * The PRNG is not reseeded.
+ *
+ * @param pImpaired State of the decorator
+ * @param pParams New impairments, copied
+ */
+void aws_iot_impaired_network_set_params(IoT_Impaired_Network *pImpaired, const IoT_Impairment_Params *pParams);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_EXTRAS_NETWORK_IMPAIRED_H */
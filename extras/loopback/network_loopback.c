@@ -0,0 +1,111 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_loopback.c
+ * @brief Network interface connected in memory to an IoT_Fake_Broker
+ */
+
+#include "network_loopback.h"
+
+static IoT_Fake_Broker *_loopback_broker(Network *pNetwork) {
+	return (IoT_Fake_Broker *) pNetwork->tlsDataParams.pContext;
+}
+
+static IoT_Error_t _loopback_disconnect(Network *pNetwork) {
+	if(0 <= pNetwork->tlsDataParams.fd) {
+		aws_iot_fake_broker_detach(_loopback_broker(pNetwork), pNetwork->tlsDataParams.fd);
+		pNetwork->tlsDataParams.fd = -1;
+	}
+	return SUCCESS;
+}
+
+static IoT_Error_t _loopback_connect(Network *pNetwork, TLSConnectParams *params) {
+	(void) params;
+
+	_loopback_disconnect(pNetwork);
+	pNetwork->tlsDataParams.fd = aws_iot_fake_broker_attach(_loopback_broker(pNetwork));
+	return (0 <= pNetwork->tlsDataParams.fd) ? SUCCESS : TCP_CONNECTION_ERROR;
+}
+
+static IoT_Error_t _loopback_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								   size_t *written_len) {
+	(void) timer;
+
+	if(0 > pNetwork->tlsDataParams.fd) {
+		*written_len = 0;
+		return NETWORK_SSL_WRITE_ERROR;
+	}
+	/* a session closed by the broker shows up on the next read, like a reset TCP connection */
+	aws_iot_fake_broker_receive(_loopback_broker(pNetwork), pNetwork->tlsDataParams.fd, pMsg, len);
+	*written_len = len;
+	return SUCCESS;
+}
+
+static IoT_Error_t _loopback_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								  size_t *read_len) {
+	IoT_Fake_Broker *pBroker = _loopback_broker(pNetwork);
+	int session = pNetwork->tlsDataParams.fd;
+	size_t rxLen;
+
+	*read_len = 0;
+	if(0 > session) {
+		return NETWORK_SSL_READ_ERROR;
+	}
+
+	rxLen = aws_iot_fake_broker_take(pBroker, session, pMsg, len);
+	*read_len = rxLen;
+	if(rxLen == len) {
+		return SUCCESS;
+	}
+	if(0 == rxLen && !aws_iot_fake_broker_is_open(pBroker, session)) {
+		return NETWORK_SSL_READ_ERROR;
+	}
+
+	/* nothing more can arrive before the caller writes, see network_loopback.h */
+	countdown_ms(timer, 0);
+	return (0 == rxLen) ? NETWORK_SSL_NOTHING_TO_READ : NETWORK_SSL_READ_TIMEOUT_ERROR;
+}
+
+static IoT_Error_t _loopback_is_connected(Network *pNetwork) {
+	return _loopback_broker(pNetwork)->isRefusingSessions ? NETWORK_PHYSICAL_LAYER_DISCONNECTED
+														  : NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+static IoT_Error_t _loopback_destroy(Network *pNetwork) {
+	return _loopback_disconnect(pNetwork);
+}
+
+IoT_Error_t aws_iot_loopback_network_init(Network *pNetwork, IoT_Fake_Broker *pBroker) {
+	if(NULL == pNetwork || NULL == pBroker) {
+		return NULL_VALUE_ERROR;
+	}
+
+	pNetwork->connect = _loopback_connect;
+	pNetwork->read = _loopback_read;
+	pNetwork->write = _loopback_write;
+	pNetwork->disconnect = _loopback_disconnect;
+	pNetwork->isConnected = _loopback_is_connected;
+	pNetwork->destroy = _loopback_destroy;
+
+	pNetwork->tlsDataParams.fd = -1;
+	pNetwork->tlsDataParams.pContext = pBroker;
+
+	return SUCCESS;
+}
+
+int aws_iot_loopback_network_session(const Network *pNetwork) {
+	return pNetwork->tlsDataParams.fd;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_loopback.h
+ * @brief Network interface connected in memory to an IoT_Fake_Broker
+ *
+ * Usage: aws_iot_mqtt_init, then aws_iot_loopback_network_init on the
+ * networkStack of the client (aws_iot_mqtt_init installs the default network
+ * layer), then aws_iot_mqtt_connect as usual.
+ *
+ * The broker answers inside the write call, so when nothing is queued for the
+ * client nothing can arrive before the client writes again. A read on an empty
+ * queue therefore ends the caller's wait (its timer is expired) instead of
+ * spinning until the timeout: aws_iot_mqtt_yield returns as soon as the queued
+ * packets are processed. Not thread safe, drive the broker and its clients from
+ * one thread.
+ */
+
+#ifndef AWS_IOT_SDK_EXTRAS_NETWORK_LOOPBACK_H
+#define AWS_IOT_SDK_EXTRAS_NETWORK_LOOPBACK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_fake_broker.h"
+#include "network_interface.h"
+
+/**
+ * @brief Install the loopback functions in a Network
+ *
+ * @param pNetwork Network to initialize, usually &client.networkStack
+ * @param pBroker Broker the connections are made to
+ *
+ * @return IoT_Error_t SUCCESS, NULL_VALUE_ERROR
+ */
+IoT_Error_t aws_iot_loopback_network_init(Network *pNetwork, IoT_Fake_Broker *pBroker);
+
+/**
+ * @brief Broker session of a connected loopback Network
+ *
+ * @return int Session index, -1 when not connected
+ */
+int aws_iot_loopback_network_session(const Network *pNetwork);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_EXTRAS_NETWORK_LOOPBACK_H */
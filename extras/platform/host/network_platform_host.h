@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_platform_host.h
+ * @brief Network platform definitions of the host build
+ */
+
+#ifndef IOTSDKC_NETWORK_HOST_PLATFORM_H_
+#define IOTSDKC_NETWORK_HOST_PLATFORM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef AWS_IOT_HOST_MBEDTLS
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+#endif
+
+/**
+ * @brief TLS Connection Parameters
+ *
+ * Shared by the network layers of the host build
+ */
+typedef struct _TLSDataParams {
+	int fd;			///< Socket or session of the connection, -1 when not connected
+	void *pContext;	///< State of the network layer, e.g. the broker of a loopback connection
+#ifdef AWS_IOT_HOST_MBEDTLS
+	bool isTLS;		///< The socket carries a TLS session, false for plain TCP connections
+	uint32_t flags;	///< Result of the server certificate verification
+	mbedtls_entropy_context entropy;
+	mbedtls_ctr_drbg_context ctr_drbg;
+	mbedtls_ssl_context ssl;
+	mbedtls_ssl_config conf;
+	mbedtls_x509_crt cacert;
+	mbedtls_x509_crt clicert;
+	mbedtls_pk_context pkey;
+#endif
+} TLSDataParams;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IOTSDKC_NETWORK_HOST_PLATFORM_H_ */
@@ -0,0 +1,584 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_posix.c
+ * @brief Network interface of the host build, POSIX sockets with optional mbedTLS
+ *
+ * A connection is plain TCP when pRootCALocation is NULL or empty, TLS
+ * otherwise. TLS needs the library to be built with AWS_IOT_HOST_MBEDTLS
+ * (extras/platform/host/CMakeLists.txt defines it when mbedTLS is found).
+ *
+ * Certificates and keys are either PEM text or the path of a file: anything
+ * that does not contain a "-----BEGIN" marker is loaded as a file.
+ *
+ * The socket is non-blocking, every wait is a poll() bounded by the Timer
+ * passed by the MQTT layer, so aws_iot_mqtt_yield sleeps in the kernel and
+ * returns on time.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "aws_iot_log.h"
+#include "network_interface.h"
+
+#ifdef AWS_IOT_HOST_MBEDTLS
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/version.h"
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define POSIX_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define POSIX_SEND_FLAGS 0
+#endif
+
+static void _posix_set_connect_params(Network *pNetwork, char *pRootCALocation, char *pDeviceCertLocation,
+									  char *pDevicePrivateKeyLocation, char *pDestinationURL,
+									  uint16_t destinationPort, uint32_t timeout_ms, bool ServerVerificationFlag) {
+	pNetwork->tlsConnectParams.DestinationPort = destinationPort;
+	pNetwork->tlsConnectParams.pDestinationURL = pDestinationURL;
+	pNetwork->tlsConnectParams.pDeviceCertLocation = pDeviceCertLocation;
+	pNetwork->tlsConnectParams.pDevicePrivateKeyLocation = pDevicePrivateKeyLocation;
+	pNetwork->tlsConnectParams.pRootCALocation = pRootCALocation;
+	pNetwork->tlsConnectParams.timeout_ms = timeout_ms;
+	pNetwork->tlsConnectParams.ServerVerificationFlag = ServerVerificationFlag;
+}
+
+static bool _posix_is_set(const char *pValue) {
+	return NULL != pValue && '\0' != pValue[0];
+}
+
+/**
+ * Wait until the socket is ready for events, at most timeout_ms (-1 waits forever).
+ * Returns > 0 when ready, 0 on timeout, < 0 on error
+ */
+static int _posix_wait(int fd, short events, int timeout_ms) {
+	struct pollfd pollFd;
+	int ret;
+
+	pollFd.fd = fd;
+	pollFd.events = events;
+	pollFd.revents = 0;
+	do {
+		ret = poll(&pollFd, 1, timeout_ms);
+	} while(0 > ret && EINTR == errno);
+
+	return ret;
+}
+
+static int _posix_left_ms(Timer *timer) {
+	uint32_t left = left_ms(timer);
+
+	return (left > INT_MAX) ? INT_MAX : (int) left;
+}
+
+static IoT_Error_t _posix_tcp_connect(Network *pNetwork) {
+	TLSConnectParams *pParams = &(pNetwork->tlsConnectParams);
+	struct addrinfo hints;
+	struct addrinfo *pResult = NULL;
+	struct addrinfo *pAddr;
+	char portBuffer[6];
+	int fd = -1;
+	int error;
+	int one = 1;
+	socklen_t errorLen;
+	Timer timer;
+	IoT_Error_t rc = NETWORK_ERR_NET_CONNECT_FAILED;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	snprintf(portBuffer, sizeof(portBuffer), "%u", (unsigned int) pParams->DestinationPort);
+
+	if(0 != getaddrinfo(pParams->pDestinationURL, portBuffer, &hints, &pResult)) {
+		IOT_ERROR("Unknown host %s", pParams->pDestinationURL);
+		return NETWORK_ERR_NET_UNKNOWN_HOST;
+	}
+
+	init_timer(&timer);
+	countdown_ms(&timer, pParams->timeout_ms);
+	for(pAddr = pResult; NULL != pAddr && !has_timer_expired(&timer); pAddr = pAddr->ai_next) {
+		fd = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+		if(0 > fd) {
+			rc = NETWORK_ERR_NET_SOCKET_FAILED;
+			continue;
+		}
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+		if(0 == connect(fd, pAddr->ai_addr, pAddr->ai_addrlen)) {
+			break;
+		}
+		if(EINPROGRESS == errno && 0 < _posix_wait(fd, POLLOUT, _posix_left_ms(&timer))) {
+			errorLen = sizeof(error);
+			if(0 == getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) && 0 == error) {
+				break;
+			}
+		}
+		close(fd);
+		fd = -1;
+		rc = NETWORK_ERR_NET_CONNECT_FAILED;
+	}
+	freeaddrinfo(pResult);
+
+	if(0 > fd) {
+		IOT_ERROR("Connection to %s:%s failed", pParams->pDestinationURL, portBuffer);
+		return rc;
+	}
+
+	/* MQTT packets are small and latency bound */
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	pNetwork->tlsDataParams.fd = fd;
+
+	return SUCCESS;
+}
+
+static IoT_Error_t _posix_tcp_write(int fd, unsigned char *pMsg, size_t len, Timer *timer, size_t *written_len) {
+	size_t written = 0;
+	ssize_t ret;
+
+	while(written < len) {
+		ret = send(fd, pMsg + written, len - written, POSIX_SEND_FLAGS);
+		if(0 < ret) {
+			written += (size_t) ret;
+		} else if(0 > ret && EINTR == errno) {
+			continue;
+		} else if(0 > ret && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+			if(has_timer_expired(timer)) {
+				break;
+			}
+			if(0 > _posix_wait(fd, POLLOUT, _posix_left_ms(timer))) {
+				*written_len = written;
+				return NETWORK_SSL_WRITE_ERROR;
+			}
+		} else {
+			*written_len = written;
+			return NETWORK_SSL_WRITE_ERROR;
+		}
+	}
+
+	*written_len = written;
+	return (written == len) ? SUCCESS : NETWORK_SSL_WRITE_TIMEOUT_ERROR;
+}
+
+static IoT_Error_t _posix_tcp_read(int fd, unsigned char *pMsg, size_t len, Timer *timer, size_t *read_len) {
+	size_t rxLen = 0;
+	ssize_t ret;
+
+	/* the socket is read at least once, even with an expired timer */
+	while(rxLen < len) {
+		ret = recv(fd, pMsg + rxLen, len - rxLen, 0);
+		if(0 < ret) {
+			rxLen += (size_t) ret;
+		} else if(0 > ret && EINTR == errno) {
+			continue;
+		} else if(0 > ret && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+			if(has_timer_expired(timer)) {
+				break;
+			}
+			if(0 > _posix_wait(fd, POLLIN, _posix_left_ms(timer))) {
+				*read_len = rxLen;
+				return NETWORK_SSL_READ_ERROR;
+			}
+		} else {
+			/* 0 is an orderly shutdown by the peer */
+			*read_len = rxLen;
+			return NETWORK_SSL_READ_ERROR;
+		}
+	}
+
+	*read_len = rxLen;
+	if(rxLen == len) {
+		return SUCCESS;
+	}
+	return (0 == rxLen) ? NETWORK_SSL_NOTHING_TO_READ : NETWORK_SSL_READ_TIMEOUT_ERROR;
+}
+
+#ifdef AWS_IOT_HOST_MBEDTLS
+
+static int _posix_tls_send(void *pContext, const unsigned char *pBuf, size_t len) {
+	int fd = *(int *) pContext;
+	ssize_t ret = send(fd, pBuf, len, POSIX_SEND_FLAGS);
+
+	if(0 <= ret) {
+		return (int) ret;
+	}
+	if(EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+		return MBEDTLS_ERR_SSL_WANT_WRITE;
+	}
+	return (EPIPE == errno || ECONNRESET == errno) ? MBEDTLS_ERR_NET_CONN_RESET : MBEDTLS_ERR_NET_SEND_FAILED;
+}
+
+static int _posix_tls_recv_timeout(void *pContext, unsigned char *pBuf, size_t len, uint32_t timeout_ms) {
+	int fd = *(int *) pContext;
+	ssize_t ret;
+
+	/* mbedTLS uses 0 for no timeout */
+	ret = _posix_wait(fd, POLLIN, (0 == timeout_ms) ? -1 : (timeout_ms > INT_MAX) ? INT_MAX : (int) timeout_ms);
+	if(0 == ret) {
+		return MBEDTLS_ERR_SSL_TIMEOUT;
+	}
+	if(0 > ret) {
+		return MBEDTLS_ERR_NET_RECV_FAILED;
+	}
+
+	ret = recv(fd, pBuf, len, 0);
+	if(0 <= ret) {
+		return (int) ret;
+	}
+	if(EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+		return MBEDTLS_ERR_SSL_WANT_READ;
+	}
+	return (ECONNRESET == errno) ? MBEDTLS_ERR_NET_CONN_RESET : MBEDTLS_ERR_NET_RECV_FAILED;
+}
+
+static bool _posix_is_pem(const char *pLocation) {
+	return NULL != strstr(pLocation, "-----BEGIN");
+}
+
+static int _posix_parse_crt(mbedtls_x509_crt *pCrt, const char *pLocation) {
+	if(_posix_is_pem(pLocation)) {
+		return mbedtls_x509_crt_parse(pCrt, (const unsigned char *) pLocation, strlen(pLocation) + 1);
+	}
+	return mbedtls_x509_crt_parse_file(pCrt, pLocation);
+}
+
+static int _posix_parse_key(TLSDataParams *pTlsDataParams, const char *pLocation) {
+#if MBEDTLS_VERSION_MAJOR >= 3
+	if(_posix_is_pem(pLocation)) {
+		return mbedtls_pk_parse_key(&(pTlsDataParams->pkey), (const unsigned char *) pLocation, strlen(pLocation) + 1,
+									NULL, 0, mbedtls_ctr_drbg_random, &(pTlsDataParams->ctr_drbg));
+	}
+	return mbedtls_pk_parse_keyfile(&(pTlsDataParams->pkey), pLocation, NULL, mbedtls_ctr_drbg_random,
+									&(pTlsDataParams->ctr_drbg));
+#else
+	if(_posix_is_pem(pLocation)) {
+		return mbedtls_pk_parse_key(&(pTlsDataParams->pkey), (const unsigned char *) pLocation, strlen(pLocation) + 1,
+									NULL, 0);
+	}
+	return mbedtls_pk_parse_keyfile(&(pTlsDataParams->pkey), pLocation, NULL);
+#endif
+}
+
+static IoT_Error_t _posix_tls_setup(Network *pNetwork) {
+	TLSConnectParams *pParams = &(pNetwork->tlsConnectParams);
+	TLSDataParams *pTlsDataParams = &(pNetwork->tlsDataParams);
+	static const char personalization[] = "aws_iot_posix";
+
+	mbedtls_ssl_init(&(pTlsDataParams->ssl));
+	mbedtls_ssl_config_init(&(pTlsDataParams->conf));
+	mbedtls_ctr_drbg_init(&(pTlsDataParams->ctr_drbg));
+	mbedtls_x509_crt_init(&(pTlsDataParams->cacert));
+	mbedtls_x509_crt_init(&(pTlsDataParams->clicert));
+	mbedtls_pk_init(&(pTlsDataParams->pkey));
+	mbedtls_entropy_init(&(pTlsDataParams->entropy));
+	pTlsDataParams->isTLS = true;
+	pTlsDataParams->flags = 0;
+
+	if(0 != mbedtls_ctr_drbg_seed(&(pTlsDataParams->ctr_drbg), mbedtls_entropy_func, &(pTlsDataParams->entropy),
+								  (const unsigned char *) personalization, sizeof(personalization) - 1)) {
+		return NETWORK_MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
+	}
+
+	if(0 > _posix_parse_crt(&(pTlsDataParams->cacert), pParams->pRootCALocation)) {
+		IOT_ERROR("Root CA certificate could not be parsed");
+		return NETWORK_X509_ROOT_CRT_PARSE_ERROR;
+	}
+
+	/* without client certificate the server must not ask for one, e.g. a local test broker */
+	if(_posix_is_set(pParams->pDeviceCertLocation)) {
+		if(0 != _posix_parse_crt(&(pTlsDataParams->clicert), pParams->pDeviceCertLocation)) {
+			IOT_ERROR("Device certificate could not be parsed");
+			return NETWORK_X509_DEVICE_CRT_PARSE_ERROR;
+		}
+		if(0 != _posix_parse_key(pTlsDataParams, pParams->pDevicePrivateKeyLocation)) {
+			IOT_ERROR("Device private key could not be parsed");
+			return NETWORK_PK_PRIVATE_KEY_PARSE_ERROR;
+		}
+	}
+
+	if(0 != mbedtls_ssl_config_defaults(&(pTlsDataParams->conf), MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+										MBEDTLS_SSL_PRESET_DEFAULT)) {
+		return SSL_CONNECTION_ERROR;
+	}
+	mbedtls_ssl_conf_authmode(&(pTlsDataParams->conf), pParams->ServerVerificationFlag ? MBEDTLS_SSL_VERIFY_REQUIRED
+																						: MBEDTLS_SSL_VERIFY_OPTIONAL);
+	mbedtls_ssl_conf_rng(&(pTlsDataParams->conf), mbedtls_ctr_drbg_random, &(pTlsDataParams->ctr_drbg));
+	mbedtls_ssl_conf_ca_chain(&(pTlsDataParams->conf), &(pTlsDataParams->cacert), NULL);
+	if(_posix_is_set(pParams->pDeviceCertLocation) &&
+	   0 != mbedtls_ssl_conf_own_cert(&(pTlsDataParams->conf), &(pTlsDataParams->clicert), &(pTlsDataParams->pkey))) {
+		return SSL_CONNECTION_ERROR;
+	}
+	mbedtls_ssl_conf_read_timeout(&(pTlsDataParams->conf), pParams->timeout_ms);
+
+	if(0 != mbedtls_ssl_setup(&(pTlsDataParams->ssl), &(pTlsDataParams->conf)) ||
+	   0 != mbedtls_ssl_set_hostname(&(pTlsDataParams->ssl), pParams->pDestinationURL)) {
+		return SSL_CONNECTION_ERROR;
+	}
+	mbedtls_ssl_set_bio(&(pTlsDataParams->ssl), &(pTlsDataParams->fd), _posix_tls_send, NULL,
+						_posix_tls_recv_timeout);
+
+	return SUCCESS;
+}
+
+static IoT_Error_t _posix_tls_handshake(Network *pNetwork) {
+	TLSDataParams *pTlsDataParams = &(pNetwork->tlsDataParams);
+	char info[256];
+	Timer timer;
+	int ret;
+
+	init_timer(&timer);
+	countdown_ms(&timer, pNetwork->tlsConnectParams.timeout_ms);
+	while(0 != (ret = mbedtls_ssl_handshake(&(pTlsDataParams->ssl)))) {
+		if(MBEDTLS_ERR_SSL_WANT_READ != ret && MBEDTLS_ERR_SSL_WANT_WRITE != ret && MBEDTLS_ERR_SSL_TIMEOUT != ret) {
+			IOT_ERROR("TLS handshake with %s failed, -0x%x", pNetwork->tlsConnectParams.pDestinationURL,
+					  (unsigned int) -ret);
+			return SSL_CONNECTION_ERROR;
+		}
+		if(has_timer_expired(&timer)) {
+			return NETWORK_SSL_CONNECT_TIMEOUT_ERROR;
+		}
+		if(MBEDTLS_ERR_SSL_WANT_WRITE == ret) {
+			_posix_wait(pTlsDataParams->fd, POLLOUT, _posix_left_ms(&timer));
+		}
+	}
+
+	if(pNetwork->tlsConnectParams.ServerVerificationFlag) {
+		pTlsDataParams->flags = mbedtls_ssl_get_verify_result(&(pTlsDataParams->ssl));
+		if(0 != pTlsDataParams->flags) {
+			mbedtls_x509_crt_verify_info(info, sizeof(info), "  ! ", pTlsDataParams->flags);
+			IOT_ERROR("Server certificate verification failed\n%s", info);
+			return SSL_CONNECTION_ERROR;
+		}
+	}
+
+	return SUCCESS;
+}
+
+static IoT_Error_t _posix_tls_write(TLSDataParams *pTlsDataParams, unsigned char *pMsg, size_t len, Timer *timer,
+									size_t *written_len) {
+	size_t written = 0;
+	int ret;
+
+	while(written < len) {
+		ret = mbedtls_ssl_write(&(pTlsDataParams->ssl), pMsg + written, len - written);
+		if(0 < ret) {
+			written += (size_t) ret;
+		} else if(MBEDTLS_ERR_SSL_WANT_WRITE == ret || MBEDTLS_ERR_SSL_WANT_READ == ret) {
+			if(has_timer_expired(timer)) {
+				break;
+			}
+			_posix_wait(pTlsDataParams->fd, (MBEDTLS_ERR_SSL_WANT_WRITE == ret) ? POLLOUT : POLLIN,
+						_posix_left_ms(timer));
+		} else {
+			IOT_ERROR("mbedtls_ssl_write failed, -0x%x", (unsigned int) -ret);
+			*written_len = written;
+			return NETWORK_SSL_WRITE_ERROR;
+		}
+	}
+
+	*written_len = written;
+	return (written == len) ? SUCCESS : NETWORK_SSL_WRITE_TIMEOUT_ERROR;
+}
+
+static IoT_Error_t _posix_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								   size_t *read_len) {
+	TLSDataParams *pTlsDataParams = &(pNetwork->tlsDataParams);
+	uint32_t timeout_ms = pNetwork->tlsConnectParams.timeout_ms;
+	uint32_t left;
+	size_t rxLen = 0;
+	int ret;
+
+	while(rxLen < len) {
+		/* with an expired timer nothing is waited for, neither buffered in mbedTLS nor on the socket */
+		left = left_ms(timer);
+		if(0 == left && 0 == mbedtls_ssl_get_bytes_avail(&(pTlsDataParams->ssl)) &&
+		   0 == _posix_wait(pTlsDataParams->fd, POLLIN, 0)) {
+			break;
+		}
+
+		/* never block longer than the timer allows, nor forever (0 means no timeout to mbedTLS) */
+		mbedtls_ssl_conf_read_timeout(&(pTlsDataParams->conf), (0 == left) ? 1 : (left < timeout_ms) ? left : timeout_ms);
+
+		ret = mbedtls_ssl_read(&(pTlsDataParams->ssl), pMsg + rxLen, len - rxLen);
+		if(0 < ret) {
+			rxLen += (size_t) ret;
+		} else if(0 == ret || (MBEDTLS_ERR_SSL_WANT_READ != ret && MBEDTLS_ERR_SSL_WANT_WRITE != ret &&
+							   MBEDTLS_ERR_SSL_TIMEOUT != ret)) {
+			*read_len = rxLen;
+			return NETWORK_SSL_READ_ERROR;
+		}
+
+		/* evaluated after the read so that it is done at least once */
+		if(has_timer_expired(timer)) {
+			break;
+		}
+	}
+
+	*read_len = rxLen;
+	if(rxLen == len) {
+		return SUCCESS;
+	}
+	return (0 == rxLen) ? NETWORK_SSL_NOTHING_TO_READ : NETWORK_SSL_READ_TIMEOUT_ERROR;
+}
+
+#endif /* AWS_IOT_HOST_MBEDTLS */
+
+IoT_Error_t iot_tls_init(Network *pNetwork, char *pRootCALocation, char *pDeviceCertLocation,
+						 char *pDevicePrivateKeyLocation, char *pDestinationURL,
+						 uint16_t destinationPort, uint32_t timeout_ms, bool ServerVerificationFlag) {
+	_posix_set_connect_params(pNetwork, pRootCALocation, pDeviceCertLocation, pDevicePrivateKeyLocation,
+							  pDestinationURL, destinationPort, timeout_ms, ServerVerificationFlag);
+
+	pNetwork->connect = iot_tls_connect;
+	pNetwork->read = iot_tls_read;
+	pNetwork->write = iot_tls_write;
+	pNetwork->disconnect = iot_tls_disconnect;
+	pNetwork->isConnected = iot_tls_is_connected;
+	pNetwork->destroy = iot_tls_destroy;
+
+	pNetwork->tlsDataParams.fd = -1;
+	pNetwork->tlsDataParams.pContext = NULL;
+#ifdef AWS_IOT_HOST_MBEDTLS
+	pNetwork->tlsDataParams.isTLS = false;
+#endif
+
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_is_connected(Network *pNetwork) {
+	/* the host network is not a radio link, it is considered always up */
+	(void) pNetwork;
+	return NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+IoT_Error_t iot_tls_connect(Network *pNetwork, TLSConnectParams *params) {
+	IoT_Error_t rc;
+
+	if(NULL == pNetwork) {
+		return NULL_VALUE_ERROR;
+	}
+
+	if(NULL != params) {
+		_posix_set_connect_params(pNetwork, params->pRootCALocation, params->pDeviceCertLocation,
+								  params->pDevicePrivateKeyLocation, params->pDestinationURL,
+								  params->DestinationPort, params->timeout_ms, params->ServerVerificationFlag);
+	}
+
+	/* a connection left behind by a failed session is dropped first */
+	iot_tls_destroy(pNetwork);
+
+#ifndef AWS_IOT_HOST_MBEDTLS
+	if(_posix_is_set(pNetwork->tlsConnectParams.pRootCALocation)) {
+		IOT_ERROR("TLS requested but the library is built without mbedTLS");
+		return NETWORK_SSL_INIT_ERROR;
+	}
+#endif
+
+	rc = _posix_tcp_connect(pNetwork);
+
+#ifdef AWS_IOT_HOST_MBEDTLS
+	if(SUCCESS == rc && _posix_is_set(pNetwork->tlsConnectParams.pRootCALocation)) {
+		rc = _posix_tls_setup(pNetwork);
+		if(SUCCESS == rc) {
+			rc = _posix_tls_handshake(pNetwork);
+		}
+	}
+#endif
+
+	if(SUCCESS != rc) {
+		iot_tls_destroy(pNetwork);
+	}
+
+	return rc;
+}
+
+IoT_Error_t iot_tls_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *written_len) {
+	*written_len = 0;
+	if(0 > pNetwork->tlsDataParams.fd) {
+		return NETWORK_SSL_WRITE_ERROR;
+	}
+#ifdef AWS_IOT_HOST_MBEDTLS
+	if(pNetwork->tlsDataParams.isTLS) {
+		return _posix_tls_write(&(pNetwork->tlsDataParams), pMsg, len, timer, written_len);
+	}
+#endif
+	return _posix_tcp_write(pNetwork->tlsDataParams.fd, pMsg, len, timer, written_len);
+}
+
+IoT_Error_t iot_tls_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer, size_t *read_len) {
+	*read_len = 0;
+	if(0 > pNetwork->tlsDataParams.fd) {
+		return NETWORK_SSL_READ_ERROR;
+	}
+#ifdef AWS_IOT_HOST_MBEDTLS
+	if(pNetwork->tlsDataParams.isTLS) {
+		return _posix_tls_read(pNetwork, pMsg, len, timer, read_len);
+	}
+#endif
+	return _posix_tcp_read(pNetwork->tlsDataParams.fd, pMsg, len, timer, read_len);
+}
+
+IoT_Error_t iot_tls_disconnect(Network *pNetwork) {
+#ifdef AWS_IOT_HOST_MBEDTLS
+	if(pNetwork->tlsDataParams.isTLS && 0 <= pNetwork->tlsDataParams.fd) {
+		/* best effort, the socket is closed by iot_tls_destroy anyway */
+		mbedtls_ssl_close_notify(&(pNetwork->tlsDataParams.ssl));
+	}
+#endif
+	if(0 <= pNetwork->tlsDataParams.fd) {
+		shutdown(pNetwork->tlsDataParams.fd, SHUT_RDWR);
+	}
+	return SUCCESS;
+}
+
+IoT_Error_t iot_tls_destroy(Network *pNetwork) {
+	TLSDataParams *pTlsDataParams = &(pNetwork->tlsDataParams);
+
+	if(0 <= pTlsDataParams->fd) {
+		close(pTlsDataParams->fd);
+		pTlsDataParams->fd = -1;
+	}
+
+#ifdef AWS_IOT_HOST_MBEDTLS
+	if(pTlsDataParams->isTLS) {
+		mbedtls_x509_crt_free(&(pTlsDataParams->clicert));
+		mbedtls_x509_crt_free(&(pTlsDataParams->cacert));
+		mbedtls_pk_free(&(pTlsDataParams->pkey));
+		mbedtls_ssl_free(&(pTlsDataParams->ssl));
+		mbedtls_ssl_config_free(&(pTlsDataParams->conf));
+		mbedtls_ctr_drbg_free(&(pTlsDataParams->ctr_drbg));
+		mbedtls_entropy_free(&(pTlsDataParams->entropy));
+		pTlsDataParams->isTLS = false;
+	}
+#endif
+
+	return SUCCESS;
+}
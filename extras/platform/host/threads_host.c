@@ -0,0 +1,51 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file threads_host.c
+ * @brief Mutex interface of the host build, recursive pthread mutexes
+ */
+
+#include <errno.h>
+
+#include "threads_interface.h"
+
+IoT_Error_t aws_iot_thread_mutex_init(IoT_Mutex_t *pMutex) {
+	pthread_mutexattr_t attr;
+	int rc;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	rc = pthread_mutex_init(&pMutex->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	return (0 == rc) ? SUCCESS : MUTEX_INIT_ERROR;
+}
+
+IoT_Error_t aws_iot_thread_mutex_lock(IoT_Mutex_t *pMutex) {
+	return (0 == pthread_mutex_lock(&pMutex->lock)) ? SUCCESS : MUTEX_LOCK_ERROR;
+}
+
+IoT_Error_t aws_iot_thread_mutex_trylock(IoT_Mutex_t *pMutex) {
+	return (0 == pthread_mutex_trylock(&pMutex->lock)) ? SUCCESS : MUTEX_LOCK_ERROR;
+}
+
+IoT_Error_t aws_iot_thread_mutex_unlock(IoT_Mutex_t *pMutex) {
+	return (0 == pthread_mutex_unlock(&pMutex->lock)) ? SUCCESS : MUTEX_UNLOCK_ERROR;
+}
+
+IoT_Error_t aws_iot_thread_mutex_destroy(IoT_Mutex_t *pMutex) {
+	return (0 == pthread_mutex_destroy(&pMutex->lock)) ? SUCCESS : MUTEX_DESTROY_ERROR;
+}
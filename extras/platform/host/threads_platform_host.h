@@ -0,0 +1,35 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file threads_platform_host.h
+ * @brief Mutex definition of the host build
+ */
+
+#ifndef AWS_IOTSDK_THREADS_HOST_PLATFORM_H
+#define AWS_IOTSDK_THREADS_HOST_PLATFORM_H
+
+#include <pthread.h>
+
+/**
+ * @brief Mutex Type
+ *
+ * Recursive pthread mutex, like the FreeRTOS recursive semaphore of the device build
+ */
+struct _IoT_Mutex_t {
+	pthread_mutex_t lock;
+};
+
+#endif /* AWS_IOTSDK_THREADS_HOST_PLATFORM_H */
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file timer_host.c
+ * @brief Timer interface of the host build, milliseconds of CLOCK_MONOTONIC or of a virtual clock
+ *
+ * The Timer struct of timer_platform.h is reused, one tick is one millisecond.
+ *
+ * In virtual mode the armed timers are remembered by address, with their
+ * deadline, so that aws_iot_host_clock_next_deadline can tell the harness
+ * where to jump. The address of a timer that went out of scope is never
+ * dereferenced, its entry only costs a useless jump.
+ *
+ * Virtual time does not move while the SDK busy-waits on a timer, e.g. the
+ * yield loop while a reconnect back-off runs. After
+ * AWS_IOT_HOST_CLOCK_SPIN_POLLS polls of unexpired timers without time
+ * moving, has_timer_expired jumps to the next deadline itself.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "timer_platform.h"
+#include "timer_host.h"
+
+typedef struct {
+	const Timer *pTimer;
+	uint64_t deadline;
+} HostDeadline_t;
+
+static volatile bool isVirtual = false;
+static uint64_t virtualNowMs = 0;
+static HostDeadline_t deadlines[AWS_IOT_HOST_CLOCK_MAX_TIMERS];
+static size_t deadlineCount = 0;
+static uint32_t idlePolls = 0;
+static pthread_mutex_t virtualLock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t _host_now_ms(void) {
+	struct timespec now;
+	uint32_t nowMs;
+
+	if(isVirtual) {
+		pthread_mutex_lock(&virtualLock);
+		nowMs = (uint32_t) virtualNowMs;
+		pthread_mutex_unlock(&virtualLock);
+		return nowMs;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t) ((uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000);
+}
+
+/* remembers the deadline of a timer, replacing the previous one of the same timer */
+static void _host_track(const Timer *timer, uint32_t timeout) {
+	size_t slot = deadlineCount;
+	size_t i;
+
+	pthread_mutex_lock(&virtualLock);
+	for(i = 0; i < deadlineCount; i++) {
+		if(timer == deadlines[i].pTimer) {
+			slot = i;
+			break;
+		}
+	}
+	/* table full: reuse a past deadline, or else drop the furthest one */
+	if(AWS_IOT_HOST_CLOCK_MAX_TIMERS == slot) {
+		slot = 0;
+		for(i = 0; i < deadlineCount; i++) {
+			if(deadlines[i].deadline <= virtualNowMs) {
+				slot = i;
+				break;
+			}
+			if(deadlines[i].deadline > deadlines[slot].deadline) {
+				slot = i;
+			}
+		}
+	}
+	if(0 == timeout) {
+		/* disarmed or expired on purpose: forget it */
+		if(slot < deadlineCount) {
+			deadlines[slot] = deadlines[--deadlineCount];
+		}
+	} else {
+		if(slot == deadlineCount) {
+			deadlineCount++;
+		}
+		deadlines[slot].pTimer = timer;
+		deadlines[slot].deadline = virtualNowMs + timeout;
+	}
+	pthread_mutex_unlock(&virtualLock);
+}
+
+uint32_t aws_iot_host_now_ms(void) {
+	return _host_now_ms();
+}
+
+void aws_iot_host_sleep_ms(uint32_t ms) {
+	struct timespec delay;
+
+	if(isVirtual) {
+		aws_iot_host_clock_advance(ms);
+		return;
+	}
+
+	delay.tv_sec = ms / 1000;
+	delay.tv_nsec = (long) (ms % 1000) * 1000000;
+	while(0 != nanosleep(&delay, &delay) && EINTR == errno) {
+	}
+}
+
+void aws_iot_host_clock_use_virtual(uint32_t startMs) {
+	pthread_mutex_lock(&virtualLock);
+	virtualNowMs = startMs;
+	deadlineCount = 0;
+	idlePolls = 0;
+	isVirtual = true;
+	pthread_mutex_unlock(&virtualLock);
+}
+
+void aws_iot_host_clock_use_real(void) {
+	pthread_mutex_lock(&virtualLock);
+	isVirtual = false;
+	deadlineCount = 0;
+	pthread_mutex_unlock(&virtualLock);
+}
+
+bool aws_iot_host_clock_is_virtual(void) {
+	return isVirtual;
+}
+
+void aws_iot_host_clock_advance(uint32_t ms) {
+	pthread_mutex_lock(&virtualLock);
+	virtualNowMs += ms;
+	idlePolls = 0;
+	pthread_mutex_unlock(&virtualLock);
+}
+
+bool aws_iot_host_clock_next_deadline(uint32_t *pDeadlineMs) {
+	uint64_t next = UINT64_MAX;
+	size_t i;
+
+	pthread_mutex_lock(&virtualLock);
+	for(i = 0; i < deadlineCount;) {
+		if(deadlines[i].deadline <= virtualNowMs) {
+			deadlines[i] = deadlines[--deadlineCount];
+			continue;
+		}
+		if(deadlines[i].deadline < next) {
+			next = deadlines[i].deadline;
+		}
+		i++;
+	}
+	pthread_mutex_unlock(&virtualLock);
+
+	if(UINT64_MAX == next) {
+		return false;
+	}
+	*pDeadlineMs = (uint32_t) next;
+	return true;
+}
+
+uint32_t aws_iot_host_clock_skip_to_next_deadline(void) {
+	uint32_t deadline;
+	uint32_t skipped;
+
+	if(!isVirtual || !aws_iot_host_clock_next_deadline(&deadline)) {
+		return 0;
+	}
+	skipped = deadline - _host_now_ms();
+	aws_iot_host_clock_advance(skipped);
+	return skipped;
+}
+
+bool has_timer_expired(Timer *timer) {
+	bool isSpinning;
+
+	if((_host_now_ms() - timer->start_ticks) >= timer->timeout_ticks) {
+		return true;
+	}
+	if(!isVirtual) {
+		return false;
+	}
+
+	pthread_mutex_lock(&virtualLock);
+	isSpinning = (++idlePolls >= AWS_IOT_HOST_CLOCK_SPIN_POLLS);
+	pthread_mutex_unlock(&virtualLock);
+	if(isSpinning && 0 == aws_iot_host_clock_skip_to_next_deadline()) {
+		aws_iot_host_clock_advance(1);
+	}
+	return (_host_now_ms() - timer->start_ticks) >= timer->timeout_ticks;
+}
+
+void countdown_ms(Timer *timer, uint32_t timeout) {
+	timer->start_ticks = _host_now_ms();
+	timer->timeout_ticks = timeout;
+	timer->last_polled_ticks = 0;
+	if(isVirtual) {
+		_host_track(timer, timeout);
+	}
+}
+
+uint32_t left_ms(Timer *timer) {
+	uint32_t elapsed = _host_now_ms() - timer->start_ticks;
+
+	return (elapsed < timer->timeout_ticks) ? timer->timeout_ticks - elapsed : 0;
+}
+
+void countdown_sec(Timer *timer, uint32_t timeout) {
+	countdown_ms(timer, timeout * 1000);
+}
+
+void init_timer(Timer *timer) {
+	timer->start_ticks = 0;
+	timer->timeout_ticks = 0;
+	timer->last_polled_ticks = 0;
+	if(isVirtual) {
+		_host_track(timer, 0);
+	}
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file timer_host.h
+ * @brief Clock of the host build, for the host tools built on top of the SDK
+ *
+ * The timers of timer_interface.h count on this clock. Tools that model time
+ * themselves (e.g. the impaired network) read and wait on it too, so that
+ * they stay consistent with the SDK timers.
+ *
+ * The clock is CLOCK_MONOTONIC unless a simulation switches it to virtual
+ * time with aws_iot_host_clock_use_virtual. Virtual time only moves when the
+ * harness advances it, and aws_iot_host_sleep_ms advances it instead of
+ * sleeping. A single-threaded harness over the loopback Network, where reads
+ * never wait, runs the SDK deterministically: yield, then jump to the next
+ * timer deadline with aws_iot_host_clock_skip_to_next_deadline, so hours of
+ * keep-alive, back-off and ack timeouts take milliseconds. A busy-wait of the
+ * SDK on a frozen virtual clock ends with a jump to the next deadline, see
+ * AWS_IOT_HOST_CLOCK_SPIN_POLLS. The POSIX Network
+ * waits in poll() on the real clock and is not meant for virtual time.
+ */
+
+#ifndef AWS_IOT_SDK_HOST_TIMER_H
+#define AWS_IOT_SDK_HOST_TIMER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Number of armed timers whose deadline the virtual clock remembers
+ *
+ * A client uses a handful, the rest are the stack timers of the calls in
+ * progress. When the table is full the furthest deadline is forgotten.
+ */
+#ifndef AWS_IOT_HOST_CLOCK_MAX_TIMERS
+#define AWS_IOT_HOST_CLOCK_MAX_TIMERS 256
+#endif
+
+/**
+ * @brief Polls of unexpired timers after which a frozen virtual clock jumps to the next deadline
+ */
+#ifndef AWS_IOT_HOST_CLOCK_SPIN_POLLS
+#define AWS_IOT_HOST_CLOCK_SPIN_POLLS 1000
+#endif
+
+/**
+ * @brief Current time in ms, wraps around every 49 days
+ */
+uint32_t aws_iot_host_now_ms(void);
+
+/**
+ * @brief Wait for the given time
+ *
+ * @param ms Time to wait in ms, 0 returns immediately
+ */
+void aws_iot_host_sleep_ms(uint32_t ms);
+
+/**
+ * @brief Switch to virtual time, starting at the given time
+ *
+ * Timers armed before the switch keep their real-clock ticks, switch before
+ * initializing the clients.
+ *
+ * @param startMs Initial virtual time in ms
+ */
+void aws_iot_host_clock_use_virtual(uint32_t startMs);
+
+/**
+ * @brief Go back to CLOCK_MONOTONIC
+ */
+void aws_iot_host_clock_use_real(void);
+
+/**
+ * @brief Whether the clock is virtual
+ */
+bool aws_iot_host_clock_is_virtual(void);
+
+/**
+ * @brief Move virtual time forward
+ *
+ * @param ms Time to add in ms
+ */
+void aws_iot_host_clock_advance(uint32_t ms);
+
+/**
+ * @brief Earliest deadline of the armed timers, in the future
+ *
+ * @param pDeadlineMs Set to the deadline, in clock ms
+ *
+ * @return bool false when no timer is armed
+ */
+bool aws_iot_host_clock_next_deadline(uint32_t *pDeadlineMs);
+
+/**
+ * @brief Advance virtual time to the next deadline
+ *
+ * @return uint32_t Time skipped in ms, 0 when no timer is armed or the clock is real
+ */
+uint32_t aws_iot_host_clock_skip_to_next_deadline(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_HOST_TIMER_H */
@@ -0,0 +1,367 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file iot_replay.c
+ * @brief Replays a captured MQTT session into a client, as a regression benchmark
+ *
+ * Usage: iot_replay [options] capture
+ *
+ *   -s speed     1 for the original pace, N for N times faster, 0 for no wait (1)
+ *   -n runs      replay the whole capture this many times (1)
+ *   -K seconds   keep-alive interval of the client (60)
+ *   -v           print every dispatched message
+ *   -S thing     replay through the shadow client of this thing (when built
+ *                with aws_iot_sdk)
+ *   -k key       key of the desired state to register on the delta, may be
+ *                repeated, at least one in shadow mode
+ *
+ * Each session of the capture (see network_record.h) is replayed into a
+ * fresh client: connect, the recorded subscriptions, then yield until the
+ * recorded traffic is delivered. The messages are dispatched through the
+ * read path of the SDK to a handler counting them. Reports the messages
+ * dispatched against the recorded ones, the replay time and the message
+ * rate, and a digest of the dispatched topics and payloads, the same on
+ * every run of the same capture.
+ *
+ * In shadow mode the client is the shadow client of the thing, connected
+ * with aws_iot_shadow_connect (600 s keep-alive, -K is ignored). A recorded
+ * subscription to the delta topic of the thing registers the keys on the
+ * delta instead, one to $aws/things/<thing>/shadow/+/+ makes the connect
+ * subscribe to it, so the recorded deltas go through the shadow parser to
+ * the key callbacks. Those are counted and digested too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#ifdef IOT_REPLAY_WITH_SHADOW
+#include "aws_iot_shadow_interface.h"
+#endif
+#include "network_replay.h"
+
+#define REPLAY_YIELD_MS 100
+#define REPLAY_MAX_DELTA_KEYS 16
+
+typedef struct {
+	bool isVerbose;
+	uint32_t messages;
+	uint32_t deltaValues;			///< Values passed to the delta callbacks in shadow mode
+	uint64_t payloadBytes;
+	uint64_t digest;
+} ReplayDispatch_t;
+
+#ifdef IOT_REPLAY_WITH_SHADOW
+/* referenced by ShadowInitParametersDefault, the application defines it */
+char AWS_IOT_HOST_ADDRESS[] = "replay";
+
+/* delta callbacks get no context */
+static ReplayDispatch_t *pShadowDispatch = NULL;
+#endif
+
+static uint64_t _replay_now_ns(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/* FNV-1a */
+static void _replay_digest(uint64_t *pDigest, const void *pData, size_t len) {
+	const unsigned char *pByte = (const unsigned char *) pData;
+	size_t i;
+
+	for(i = 0; i < len; i++) {
+		*pDigest = (*pDigest ^ pByte[i]) * 1099511628211ULL;
+	}
+}
+
+static void _replay_on_message(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+							   IoT_Publish_Message_Params *pParams, void *pData) {
+	ReplayDispatch_t *pDispatch = (ReplayDispatch_t *) pData;
+
+	(void) pClient;
+
+	pDispatch->messages++;
+	pDispatch->payloadBytes += pParams->payloadLen;
+	_replay_digest(&pDispatch->digest, pTopicName, topicNameLen);
+	_replay_digest(&pDispatch->digest, pParams->payload, pParams->payloadLen);
+	if(pDispatch->isVerbose) {
+		printf("%.*s (%u bytes)\n", topicNameLen, pTopicName, (unsigned int) pParams->payloadLen);
+	}
+}
+
+#ifdef IOT_REPLAY_WITH_SHADOW
+static void _replay_on_delta(const char *pJsonValueBuffer, uint32_t valueLength, jsonStruct_t *pJsonStruct) {
+	pShadowDispatch->deltaValues++;
+	_replay_digest(&pShadowDispatch->digest, pJsonStruct->pKey, strlen(pJsonStruct->pKey));
+	_replay_digest(&pShadowDispatch->digest, pJsonValueBuffer, valueLength);
+	if(pShadowDispatch->isVerbose) {
+		printf("delta %s: %.*s\n", pJsonStruct->pKey, (int) valueLength, pJsonValueBuffer);
+	}
+}
+
+static IoT_Error_t _replay_shadow_session(const IoT_Replay_Capture *pCapture, size_t session, uint32_t speed,
+										  const char *pThingName, jsonStruct_t *pKeys, size_t keyCount,
+										  ReplayDispatch_t *pDispatch, IoT_Replay_Stats *pStats) {
+	const IoT_Replay_Session *pSession = &pCapture->pSessions[session];
+	const IoT_Replay_Subscription *pSubscription;
+	ShadowInitParameters_t initParams = ShadowInitParametersDefault;
+	ShadowConnectParameters_t connectParams = ShadowConnectParametersDefault;
+	static AWS_IoT_Client client;
+	static IoT_Replay_Network replay;
+	char deltaTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	char wildcardTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+	bool isDeltaRegistered = false;
+	IoT_Error_t rc;
+	size_t i;
+	size_t k;
+
+	snprintf(deltaTopic, sizeof(deltaTopic), "$aws/things/%s/shadow/update/delta", pThingName);
+	snprintf(wildcardTopic, sizeof(wildcardTopic), "$aws/things/%s/shadow/+/+", pThingName);
+	pShadowDispatch = pDispatch;
+
+	initParams.pHost = (char *) "replay";
+	initParams.port = 8883;
+	initParams.pRootCA = (char *) "";
+	initParams.pClientCRT = (char *) "";
+	initParams.pClientKey = (char *) "";
+	initParams.enableAutoReconnect = false;
+
+	connectParams.pMyThingName = (char *) pThingName;
+	connectParams.pMqttClientId = (char *) "iot-replay";
+	connectParams.mqttClientIdLen = (uint16_t) strlen(connectParams.pMqttClientId);
+	for(i = 0; i < pSession->subscriptionCount; i++) {
+		if(0 == strcmp(pCapture->pSubscriptions[pSession->firstSubscription + i].pFilter, wildcardTopic)) {
+			connectParams.isWildcardAckSubscription = true;
+		}
+	}
+
+	rc = aws_iot_shadow_init(&client, &initParams);
+	if(SUCCESS == rc) {
+		rc = aws_iot_replay_network_init(&client.networkStack, &replay, pCapture, session, speed);
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_shadow_connect(&client, &connectParams);
+	}
+	/* with the wildcard subscription registering the keys subscribes to nothing */
+	for(k = 0; SUCCESS == rc && connectParams.isWildcardAckSubscription && k < keyCount; k++) {
+		rc = aws_iot_shadow_register_delta(&client, &pKeys[k]);
+	}
+	for(i = 0; SUCCESS == rc && i < pSession->subscriptionCount; i++) {
+		pSubscription = &pCapture->pSubscriptions[pSession->firstSubscription + i];
+		if(0 == strcmp(pSubscription->pFilter, wildcardTopic)) {
+			continue;
+		}
+		if(0 == strcmp(pSubscription->pFilter, deltaTopic) && !connectParams.isWildcardAckSubscription) {
+			for(k = 0; SUCCESS == rc && !isDeltaRegistered && k < keyCount; k++) {
+				rc = aws_iot_shadow_register_delta(&client, &pKeys[k]);
+			}
+			isDeltaRegistered = true;
+			continue;
+		}
+		rc = aws_iot_mqtt_subscribe(&client, pSubscription->pFilter, pSubscription->filterLen, pSubscription->qos,
+									_replay_on_message, pDispatch);
+	}
+	while(SUCCESS == rc && !aws_iot_replay_network_is_done(&replay)) {
+		rc = aws_iot_shadow_yield(&client, REPLAY_YIELD_MS);
+	}
+	/* the recorded end of a session that failed is expected */
+	if(SUCCESS != rc && aws_iot_replay_network_is_done(&replay) && SUCCESS != pSession->endRc) {
+		rc = SUCCESS;
+	}
+
+	if(aws_iot_mqtt_is_client_connected(&client)) {
+		aws_iot_shadow_disconnect(&client);
+	}
+	aws_iot_shadow_free(&client);
+
+	pStats->packets += replay.stats.packets;
+	pStats->publishes += replay.stats.publishes;
+	pStats->pings += replay.stats.pings;
+	pStats->bytesIn += replay.stats.bytesIn;
+	pStats->waitedMs += replay.stats.waitedMs;
+	return rc;
+}
+#endif
+
+static IoT_Error_t _replay_session(const IoT_Replay_Capture *pCapture, size_t session, uint32_t speed,
+								   uint16_t keepAliveSec, ReplayDispatch_t *pDispatch, IoT_Replay_Stats *pStats) {
+	const IoT_Replay_Session *pSession = &pCapture->pSessions[session];
+	const IoT_Replay_Subscription *pSubscription;
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	static AWS_IoT_Client client;
+	static IoT_Replay_Network replay;
+	IoT_Error_t rc;
+	size_t i;
+
+	initParams.enableAutoReconnect = false;
+	initParams.pHostURL = "replay";
+	initParams.port = 8883;
+	initParams.pRootCALocation = "";
+	initParams.pDeviceCertLocation = "";
+	initParams.pDevicePrivateKeyLocation = "";
+
+	connectParams.pClientID = "iot-replay";
+	connectParams.clientIDLen = (uint16_t) strlen(connectParams.pClientID);
+	connectParams.keepAliveIntervalInSec = keepAliveSec;
+
+	rc = aws_iot_mqtt_init(&client, &initParams);
+	if(SUCCESS == rc) {
+		rc = aws_iot_replay_network_init(&client.networkStack, &replay, pCapture, session, speed);
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_connect(&client, &connectParams);
+	}
+	for(i = 0; SUCCESS == rc && i < pSession->subscriptionCount; i++) {
+		pSubscription = &pCapture->pSubscriptions[pSession->firstSubscription + i];
+		rc = aws_iot_mqtt_subscribe(&client, pSubscription->pFilter, pSubscription->filterLen, pSubscription->qos,
+									_replay_on_message, pDispatch);
+	}
+	while(SUCCESS == rc && !aws_iot_replay_network_is_done(&replay)) {
+		rc = aws_iot_mqtt_yield(&client, REPLAY_YIELD_MS);
+	}
+	/* the recorded end of a session that failed is expected */
+	if(SUCCESS != rc && aws_iot_replay_network_is_done(&replay) && SUCCESS != pSession->endRc) {
+		rc = SUCCESS;
+	}
+
+	if(aws_iot_mqtt_is_client_connected(&client)) {
+		aws_iot_mqtt_disconnect(&client);
+	}
+	aws_iot_mqtt_free(&client);
+
+	pStats->packets += replay.stats.packets;
+	pStats->publishes += replay.stats.publishes;
+	pStats->pings += replay.stats.pings;
+	pStats->bytesIn += replay.stats.bytesIn;
+	pStats->waitedMs += replay.stats.waitedMs;
+	return rc;
+}
+
+static void _replay_usage(const char *pName) {
+	fprintf(stderr, "usage: %s [-s speed] [-n runs] [-K seconds] [-v]"
+#ifdef IOT_REPLAY_WITH_SHADOW
+			" [-S thing -k key [-k key ...]]"
+#endif
+			" capture\n", pName);
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	IoT_Replay_Capture capture;
+#ifdef IOT_REPLAY_WITH_SHADOW
+	jsonStruct_t deltaKeys[REPLAY_MAX_DELTA_KEYS];
+	size_t deltaKeyCount = 0;
+	const char *pThingName = NULL;
+#endif
+	ReplayDispatch_t dispatch;
+	IoT_Replay_Stats stats;
+	uint64_t recordedMs = 0;
+	uint32_t recordedPublishes = 0;
+	uint32_t speed = 1;
+	uint32_t runs = 1;
+	uint16_t keepAliveSec = 60;
+	uint64_t start;
+	uint64_t elapsed;
+	uint32_t run;
+	size_t failed = 0;
+	size_t i;
+	IoT_Error_t rc;
+	int option;
+
+	memset(&dispatch, 0, sizeof(dispatch));
+	while(-1 != (option = getopt(argc, argv, "s:n:K:vS:k:"))) {
+		switch(option) {
+			case 's': speed = (uint32_t) strtoul(optarg, NULL, 10); break;
+			case 'n': runs = (uint32_t) strtoul(optarg, NULL, 10); break;
+			case 'K': keepAliveSec = (uint16_t) strtoul(optarg, NULL, 10); break;
+			case 'v': dispatch.isVerbose = true; break;
+#ifdef IOT_REPLAY_WITH_SHADOW
+			case 'S': pThingName = optarg; break;
+			case 'k':
+				if(REPLAY_MAX_DELTA_KEYS == deltaKeyCount) {
+					_replay_usage(argv[0]);
+				}
+				/* an object value is handed over as it is, whatever its type */
+				memset(&deltaKeys[deltaKeyCount], 0, sizeof(deltaKeys[0]));
+				deltaKeys[deltaKeyCount].pKey = optarg;
+				deltaKeys[deltaKeyCount].type = SHADOW_JSON_OBJECT;
+				deltaKeys[deltaKeyCount].cb = _replay_on_delta;
+				deltaKeyCount++;
+				break;
+#endif
+			default: _replay_usage(argv[0]);
+		}
+	}
+	if(optind + 1 != argc || 0 == runs) {
+		_replay_usage(argv[0]);
+	}
+#ifdef IOT_REPLAY_WITH_SHADOW
+	if((NULL == pThingName) != (0 == deltaKeyCount)) {
+		_replay_usage(argv[0]);
+	}
+#endif
+
+	if(SUCCESS != aws_iot_replay_capture_load(&capture, argv[optind])) {
+		fprintf(stderr, "%s: cannot load the capture\n", argv[optind]);
+		return 1;
+	}
+	for(i = 0; i < capture.sessionCount; i++) {
+		recordedMs += capture.pSessions[i].durationMs;
+		recordedPublishes += capture.pSessions[i].publishCount;
+	}
+	printf("%s: %u sessions, %u packets, %u publishes, %u subscriptions, %.1f s recorded\n", argv[optind],
+		   (unsigned int) capture.sessionCount, (unsigned int) capture.packetCount, recordedPublishes,
+		   (unsigned int) capture.subscriptionCount, (double) recordedMs / 1e3);
+
+	for(run = 0; run < runs; run++) {
+		dispatch.messages = 0;
+		dispatch.deltaValues = 0;
+		dispatch.payloadBytes = 0;
+		dispatch.digest = 1469598103934665603ULL;
+		memset(&stats, 0, sizeof(stats));
+
+		start = _replay_now_ns();
+		for(i = 0; i < capture.sessionCount; i++) {
+#ifdef IOT_REPLAY_WITH_SHADOW
+			if(NULL != pThingName) {
+				rc = _replay_shadow_session(&capture, i, speed, pThingName, deltaKeys, deltaKeyCount, &dispatch,
+											&stats);
+			} else
+#endif
+			rc = _replay_session(&capture, i, speed, keepAliveSec, &dispatch, &stats);
+			if(SUCCESS != rc) {
+				fprintf(stderr, "session %u: replay failed, rc %d\n", (unsigned int) i, rc);
+				failed++;
+			}
+		}
+		elapsed = _replay_now_ns() - start;
+
+		printf("run %u: %u/%u publishes delivered, %u dispatched (%llu payload bytes), %u delta values, "
+			   "%u pings answered, %.1f ms, %.0f msgs/s, digest %016llx\n",
+			   run + 1, stats.publishes, recordedPublishes, dispatch.messages,
+			   (unsigned long long) dispatch.payloadBytes, dispatch.deltaValues, stats.pings, (double) elapsed / 1e6,
+			   (double) stats.publishes * 1e9 / (double) (elapsed + 1), (unsigned long long) dispatch.digest);
+	}
+
+	aws_iot_replay_capture_free(&capture);
+	return (0 == failed) ? 0 : 1;
+}
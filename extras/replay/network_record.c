@@ -0,0 +1,190 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_record.c
+ * @brief Network decorator writing the traffic of the client to a capture file
+ */
+
+#include <string.h>
+
+#include "network_record.h"
+#include "timer_host.h"
+
+static IoT_Record_Network *_record(Network *pNetwork) {
+	return (IoT_Record_Network *) pNetwork->tlsDataParams.pContext;
+}
+
+static size_t _record_put_varint(unsigned char *pBuf, uint64_t value) {
+	size_t len = 0;
+
+	do {
+		pBuf[len] = (unsigned char) (value & 0x7F);
+		value >>= 7;
+		if(0 != value) {
+			pBuf[len] |= 0x80;
+		}
+		len++;
+	} while(0 != value);
+	return len;
+}
+
+/* a failed write of the file stops the capture, never the client */
+static void _record_append(IoT_Record_Network *pRecord, uint8_t tag, uint64_t value, const unsigned char *pData,
+						   size_t len) {
+	unsigned char header[1 + 10 + 10];
+	size_t headerLen = 0;
+	uint32_t now;
+
+	if(NULL == pRecord->pFile) {
+		return;
+	}
+
+	now = aws_iot_host_now_ms();
+	header[headerLen++] = tag;
+	headerLen += _record_put_varint(&header[headerLen], now - pRecord->lastRecordMs);
+	pRecord->lastRecordMs = now;
+	if(IOT_CAPTURE_TAG_CONNECT != tag && IOT_CAPTURE_TAG_DISCONNECT != tag) {
+		headerLen += _record_put_varint(&header[headerLen], value);
+	}
+
+	if(fwrite(header, 1, headerLen, pRecord->pFile) != headerLen ||
+	   (0 != len && fwrite(pData, 1, len, pRecord->pFile) != len)) {
+		fclose(pRecord->pFile);
+		pRecord->pFile = NULL;
+		return;
+	}
+	pRecord->stats.records++;
+	pRecord->stats.fileBytes += headerLen + len;
+}
+
+static void _record_error(IoT_Record_Network *pRecord, IoT_Error_t rc) {
+	if(SUCCESS != rc && NETWORK_SSL_NOTHING_TO_READ != rc && NETWORK_SSL_READ_TIMEOUT_ERROR != rc) {
+		_record_append(pRecord, IOT_CAPTURE_TAG_ERROR, (uint64_t) -(int64_t) rc, NULL, 0);
+	}
+}
+
+static IoT_Error_t _record_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								size_t *read_len) {
+	IoT_Record_Network *pRecord = _record(pNetwork);
+	IoT_Error_t rc;
+
+	*read_len = 0;
+	rc = pRecord->inner.read(&(pRecord->inner), pMsg, len, timer, read_len);
+	if(0 != *read_len) {
+		_record_append(pRecord, IOT_CAPTURE_TAG_READ, *read_len, pMsg, *read_len);
+		pRecord->stats.bytesIn += *read_len;
+	}
+	_record_error(pRecord, rc);
+	return rc;
+}
+
+static IoT_Error_t _record_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								 size_t *written_len) {
+	IoT_Record_Network *pRecord = _record(pNetwork);
+	IoT_Error_t rc;
+
+	*written_len = 0;
+	rc = pRecord->inner.write(&(pRecord->inner), pMsg, len, timer, written_len);
+	if(0 != *written_len) {
+		_record_append(pRecord, IOT_CAPTURE_TAG_WRITE, *written_len, pMsg, *written_len);
+		pRecord->stats.bytesOut += *written_len;
+	}
+	_record_error(pRecord, rc);
+	return rc;
+}
+
+static IoT_Error_t _record_connect(Network *pNetwork, TLSConnectParams *params) {
+	IoT_Record_Network *pRecord = _record(pNetwork);
+	IoT_Error_t rc;
+
+	/* the connect parameters may have been changed on the outer Network */
+	pRecord->inner.tlsConnectParams = pNetwork->tlsConnectParams;
+	rc = pRecord->inner.connect(&(pRecord->inner), params);
+	if(SUCCESS == rc) {
+		_record_append(pRecord, IOT_CAPTURE_TAG_CONNECT, 0, NULL, 0);
+		pRecord->stats.sessions++;
+	}
+	return rc;
+}
+
+static IoT_Error_t _record_disconnect(Network *pNetwork) {
+	IoT_Record_Network *pRecord = _record(pNetwork);
+
+	_record_append(pRecord, IOT_CAPTURE_TAG_DISCONNECT, 0, NULL, 0);
+	if(NULL != pRecord->pFile) {
+		fflush(pRecord->pFile);
+	}
+	return pRecord->inner.disconnect(&(pRecord->inner));
+}
+
+static IoT_Error_t _record_is_connected(Network *pNetwork) {
+	IoT_Record_Network *pRecord = _record(pNetwork);
+
+	return pRecord->inner.isConnected(&(pRecord->inner));
+}
+
+static IoT_Error_t _record_destroy(Network *pNetwork) {
+	IoT_Record_Network *pRecord = _record(pNetwork);
+
+	return pRecord->inner.destroy(&(pRecord->inner));
+}
+
+IoT_Error_t aws_iot_record_network_init(Network *pNetwork, IoT_Record_Network *pRecord, const char *pPath) {
+	unsigned char header[IOT_CAPTURE_HEADER_LEN] = {0};
+
+	if(NULL == pNetwork || NULL == pRecord || NULL == pPath) {
+		return NULL_VALUE_ERROR;
+	}
+
+	memset(pRecord, 0, sizeof(IoT_Record_Network));
+	pRecord->pFile = fopen(pPath, "wb");
+	if(NULL == pRecord->pFile) {
+		return FAILURE;
+	}
+	memcpy(header, IOT_CAPTURE_MAGIC, 4);
+	header[4] = (unsigned char) (IOT_CAPTURE_VERSION & 0xFF);
+	header[5] = (unsigned char) (IOT_CAPTURE_VERSION >> 8);
+	if(fwrite(header, 1, sizeof(header), pRecord->pFile) != sizeof(header)) {
+		fclose(pRecord->pFile);
+		pRecord->pFile = NULL;
+		return FAILURE;
+	}
+	pRecord->stats.fileBytes = sizeof(header);
+	pRecord->lastRecordMs = aws_iot_host_now_ms();
+	pRecord->inner = *pNetwork;
+
+	pNetwork->connect = _record_connect;
+	pNetwork->read = _record_read;
+	pNetwork->write = _record_write;
+	pNetwork->disconnect = _record_disconnect;
+	pNetwork->isConnected = _record_is_connected;
+	pNetwork->destroy = _record_destroy;
+	pNetwork->tlsDataParams.pContext = pRecord;
+
+	return SUCCESS;
+}
+
+IoT_Error_t aws_iot_record_network_close(IoT_Record_Network *pRecord) {
+	if(NULL == pRecord || NULL == pRecord->pFile) {
+		return FAILURE;
+	}
+	if(0 != fclose(pRecord->pFile)) {
+		pRecord->pFile = NULL;
+		return FAILURE;
+	}
+	pRecord->pFile = NULL;
+	return SUCCESS;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_record.h
+ * @brief Network decorator capturing the traffic of a session to a file
+ *
+ * Usage: install the Network to record (aws_iot_mqtt_init for the POSIX
+ * layer, aws_iot_loopback_network_init for the loopback one), then
+ * aws_iot_record_network_init on the same Network. Every connection, every
+ * buffer read or written and every read or write error is appended to the
+ * capture file with its time, until aws_iot_record_network_close. The
+ * replayer of network_replay.h feeds a capture back into a client.
+ *
+ * Capture format, integers little-endian, varints LEB128:
+ *
+ *   header  "IOTC", u16 version, u16 reserved
+ *   record  u8 tag, varint ms since the previous record, then
+ *           IOT_CAPTURE_TAG_CONNECT     nothing, a new session starts
+ *           IOT_CAPTURE_TAG_READ/WRITE  varint length, the bytes
+ *           IOT_CAPTURE_TAG_ERROR       varint -rc of the failed read or write
+ *           IOT_CAPTURE_TAG_DISCONNECT  nothing
+ *
+ * Idle reads are not recorded, a quiet hour costs a few bytes.
+ */
+
+#ifndef AWS_IOT_SDK_EXTRAS_NETWORK_RECORD_H
+#define AWS_IOT_SDK_EXTRAS_NETWORK_RECORD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "network_interface.h"
+
+#define IOT_CAPTURE_MAGIC "IOTC"
+#define IOT_CAPTURE_VERSION 1
+#define IOT_CAPTURE_HEADER_LEN 8
+
+#define IOT_CAPTURE_TAG_CONNECT 1
+#define IOT_CAPTURE_TAG_READ 2
+#define IOT_CAPTURE_TAG_WRITE 3
+#define IOT_CAPTURE_TAG_ERROR 4
+#define IOT_CAPTURE_TAG_DISCONNECT 5
+
+/**
+ * @brief Traffic captured so far
+ */
+typedef struct {
+	uint32_t sessions;				///< Successful connections
+	uint32_t records;				///< Records written
+	uint64_t bytesIn;				///< Bytes read by the client
+	uint64_t bytesOut;				///< Bytes written by the client
+	uint64_t fileBytes;				///< Size of the capture
+} IoT_Record_Stats;
+
+/**
+ * @brief State of a recording Network, one per client
+ */
+typedef struct {
+	Network inner;					///< The wrapped Network
+	FILE *pFile;					///< NULL once closed or after a write error
+	uint32_t lastRecordMs;			///< Time of the previous record
+	IoT_Record_Stats stats;
+} IoT_Record_Network;
+
+/**
+ * @brief Wrap the Network installed in pNetwork and start a capture
+ *
+ * @param pNetwork Network to record, usually &client.networkStack, already initialized
+ * @param pRecord State of the decorator, must outlive the client
+ * @param pPath Capture file, truncated
+ *
+ * @return IoT_Error_t SUCCESS, NULL_VALUE_ERROR, FAILURE if the file cannot be created
+ */
+IoT_Error_t aws_iot_record_network_init(Network *pNetwork, IoT_Record_Network *pRecord, const char *pPath);
+
+/**
+ * @brief Flush and close the capture, the Network keeps working unrecorded
+ *
+ * @param pRecord State of the decorator
+ *
+ * @return IoT_Error_t SUCCESS, FAILURE if the capture could not be written completely
+ */
+IoT_Error_t aws_iot_record_network_close(IoT_Record_Network *pRecord);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_EXTRAS_NETWORK_RECORD_H */
@@ -0,0 +1,571 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_replay.c
+ * @brief Capture loader and Network delivering the recorded inbound packets
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "network_record.h"
+#include "network_replay.h"
+#include "timer_host.h"
+
+#define REPLAY_CONNECT 1
+#define REPLAY_PUBLISH 3
+#define REPLAY_SUBSCRIBE 8
+#define REPLAY_PINGREQ 12
+#define REPLAY_PINGRESP 13
+
+static const unsigned char replayPingResp[2] = {REPLAY_PINGRESP << 4, 0};
+
+/* state of the loader, only needed while a file is parsed */
+typedef struct {
+	IoT_Replay_Capture *pCapture;
+	IoT_Replay_Session *pSession;
+	size_t packetCapacity;
+	size_t subscriptionCapacity;
+	size_t sessionCapacity;
+	size_t bytesCapacity;
+	size_t inboundStart;			///< First byte of the inbound packet being assembled
+	unsigned char *pOutbound;		///< Outbound bytes of the packet being assembled
+	size_t outboundLen;
+	size_t outboundCapacity;
+	uint32_t gate;
+	uint64_t sessionStartMs;
+} ReplayLoader_t;
+
+static IoT_Replay_Network *_replay(Network *pNetwork) {
+	return (IoT_Replay_Network *) pNetwork->tlsDataParams.pContext;
+}
+
+/* times are compared modulo 2^32 */
+static bool _replay_is_due(uint32_t now, uint32_t time) {
+	return 0 <= (int32_t) (now - time);
+}
+
+static bool _replay_grow(void **ppArray, size_t *pCapacity, size_t needed, size_t itemSize) {
+	size_t capacity = *pCapacity;
+	void *pArray;
+
+	if(needed <= capacity) {
+		return true;
+	}
+	while(capacity < needed) {
+		capacity = (0 == capacity) ? 64 : capacity * 2;
+	}
+	pArray = realloc(*ppArray, capacity * itemSize);
+	if(NULL == pArray) {
+		return false;
+	}
+	*ppArray = pArray;
+	*pCapacity = capacity;
+	return true;
+}
+
+static bool _replay_get_varint(const unsigned char **ppCursor, const unsigned char *pEnd, uint64_t *pValue) {
+	unsigned int shift = 0;
+
+	*pValue = 0;
+	while(*ppCursor < pEnd && shift < 64) {
+		*pValue |= (uint64_t) (**ppCursor & 0x7F) << shift;
+		if(0 == (*(*ppCursor)++ & 0x80)) {
+			return true;
+		}
+		shift += 7;
+	}
+	return false;
+}
+
+/* length of the MQTT packet at pPacket, 0 while incomplete */
+static size_t _replay_packet_len(const unsigned char *pPacket, size_t available) {
+	uint32_t remaining = 0;
+	size_t i;
+
+	for(i = 1; i < available && i <= 4; i++) {
+		remaining |= (uint32_t) (pPacket[i] & 0x7F) << (7 * (i - 1));
+		if(0 == (pPacket[i] & 0x80)) {
+			return (available >= i + 1 + remaining) ? i + 1 + remaining : 0;
+		}
+	}
+	return 0;
+}
+
+/* the topic filters of a SUBSCRIBE packet */
+static bool _replay_add_subscriptions(ReplayLoader_t *pLoader, const unsigned char *pPacket, size_t len) {
+	IoT_Replay_Capture *pCapture = pLoader->pCapture;
+	IoT_Replay_Subscription *pSubscription;
+	size_t cursor = 1;
+	uint16_t filterLen;
+
+	while(cursor < len && 0 != (pPacket[cursor] & 0x80)) {
+		cursor++;
+	}
+	cursor += 1 + 2;				/* last length byte, packet id */
+	while(cursor + 2 <= len) {
+		filterLen = (uint16_t) ((pPacket[cursor] << 8) | pPacket[cursor + 1]);
+		cursor += 2;
+		if(cursor + filterLen + 1 > len) {
+			break;
+		}
+		if(!_replay_grow((void **) &pCapture->pSubscriptions, &pLoader->subscriptionCapacity,
+						 pCapture->subscriptionCount + 1, sizeof(IoT_Replay_Subscription))) {
+			return false;
+		}
+		pSubscription = &pCapture->pSubscriptions[pCapture->subscriptionCount];
+		pSubscription->pFilter = (char *) malloc((size_t) filterLen + 1);
+		if(NULL == pSubscription->pFilter) {
+			return false;
+		}
+		memcpy(pSubscription->pFilter, &pPacket[cursor], filterLen);
+		pSubscription->pFilter[filterLen] = '\0';
+		pSubscription->filterLen = filterLen;
+		pSubscription->qos = (0 == (pPacket[cursor + filterLen] & 0x03)) ? QOS0 : QOS1;
+		pCapture->subscriptionCount++;
+		pLoader->pSession->subscriptionCount++;
+		cursor += (size_t) filterLen + 1;
+	}
+	return true;
+}
+
+static bool _replay_on_write(ReplayLoader_t *pLoader, const unsigned char *pData, size_t len) {
+	size_t packetLen;
+	uint8_t type;
+
+	if(!_replay_grow((void **) &pLoader->pOutbound, &pLoader->outboundCapacity, pLoader->outboundLen + len, 1)) {
+		return false;
+	}
+	memcpy(&pLoader->pOutbound[pLoader->outboundLen], pData, len);
+	pLoader->outboundLen += len;
+
+	while(0 != (packetLen = _replay_packet_len(pLoader->pOutbound, pLoader->outboundLen))) {
+		type = (uint8_t) (pLoader->pOutbound[0] >> 4);
+		if(REPLAY_CONNECT == type || REPLAY_SUBSCRIBE == type) {
+			pLoader->gate++;
+		}
+		if(REPLAY_SUBSCRIBE == type && !_replay_add_subscriptions(pLoader, pLoader->pOutbound, packetLen)) {
+			return false;
+		}
+		memmove(pLoader->pOutbound, &pLoader->pOutbound[packetLen], pLoader->outboundLen - packetLen);
+		pLoader->outboundLen -= packetLen;
+	}
+	return true;
+}
+
+static bool _replay_on_read(ReplayLoader_t *pLoader, const unsigned char *pData, size_t len, uint64_t nowMs) {
+	IoT_Replay_Capture *pCapture = pLoader->pCapture;
+	IoT_Replay_Packet *pPacket;
+	size_t packetLen;
+
+	if(!_replay_grow((void **) &pCapture->pBytes, &pLoader->bytesCapacity, pCapture->bytesLen + len, 1)) {
+		return false;
+	}
+	memcpy(&pCapture->pBytes[pCapture->bytesLen], pData, len);
+	pCapture->bytesLen += len;
+
+	while(0 != (packetLen = _replay_packet_len(&pCapture->pBytes[pLoader->inboundStart],
+											   pCapture->bytesLen - pLoader->inboundStart))) {
+		if(!_replay_grow((void **) &pCapture->pPackets, &pLoader->packetCapacity, pCapture->packetCount + 1,
+						 sizeof(IoT_Replay_Packet))) {
+			return false;
+		}
+		pPacket = &pCapture->pPackets[pCapture->packetCount++];
+		pPacket->timeMs = (uint32_t) (nowMs - pLoader->sessionStartMs);
+		pPacket->gate = pLoader->gate;
+		pPacket->offset = pLoader->inboundStart;
+		pPacket->len = packetLen;
+		pPacket->type = (uint8_t) (pCapture->pBytes[pLoader->inboundStart] >> 4);
+		if(REPLAY_PUBLISH == pPacket->type) {
+			pLoader->pSession->publishCount++;
+		}
+		pLoader->pSession->packetCount++;
+		pLoader->inboundStart += packetLen;
+	}
+	return true;
+}
+
+static bool _replay_on_connect(ReplayLoader_t *pLoader, uint64_t nowMs) {
+	IoT_Replay_Capture *pCapture = pLoader->pCapture;
+
+	/* the partial packet of the previous session is dropped */
+	pCapture->bytesLen = pLoader->inboundStart;
+	pLoader->outboundLen = 0;
+	pLoader->gate = 0;
+	pLoader->sessionStartMs = nowMs;
+
+	if(!_replay_grow((void **) &pCapture->pSessions, &pLoader->sessionCapacity, pCapture->sessionCount + 1,
+					 sizeof(IoT_Replay_Session))) {
+		return false;
+	}
+	pLoader->pSession = &pCapture->pSessions[pCapture->sessionCount++];
+	memset(pLoader->pSession, 0, sizeof(IoT_Replay_Session));
+	pLoader->pSession->firstPacket = pCapture->packetCount;
+	pLoader->pSession->firstSubscription = pCapture->subscriptionCount;
+	pLoader->pSession->endRc = SUCCESS;
+	return true;
+}
+
+static bool _replay_parse(ReplayLoader_t *pLoader, const unsigned char *pFile, size_t fileLen) {
+	const unsigned char *pCursor = &pFile[IOT_CAPTURE_HEADER_LEN];
+	const unsigned char *pEnd = &pFile[fileLen];
+	uint64_t nowMs = 0;
+	uint64_t value;
+	uint8_t tag;
+
+	while(pCursor < pEnd) {
+		tag = *pCursor++;
+		if(!_replay_get_varint(&pCursor, pEnd, &value)) {
+			return false;
+		}
+		nowMs += value;
+
+		if(IOT_CAPTURE_TAG_CONNECT == tag) {
+			if(!_replay_on_connect(pLoader, nowMs)) {
+				return false;
+			}
+			continue;
+		}
+		if(IOT_CAPTURE_TAG_DISCONNECT != tag && !_replay_get_varint(&pCursor, pEnd, &value)) {
+			return false;
+		}
+		if((IOT_CAPTURE_TAG_READ == tag || IOT_CAPTURE_TAG_WRITE == tag) && value > (uint64_t) (pEnd - pCursor)) {
+			/* truncated capture, e.g. a device that crashed: keep what is complete */
+			return true;
+		}
+
+		/* traffic before the first connection cannot be replayed */
+		if(NULL != pLoader->pSession) {
+			pLoader->pSession->durationMs = (uint32_t) (nowMs - pLoader->sessionStartMs);
+			switch(tag) {
+				case IOT_CAPTURE_TAG_READ:
+					if(!_replay_on_read(pLoader, pCursor, (size_t) value, nowMs)) {
+						return false;
+					}
+					break;
+				case IOT_CAPTURE_TAG_WRITE:
+					if(!_replay_on_write(pLoader, pCursor, (size_t) value)) {
+						return false;
+					}
+					break;
+				case IOT_CAPTURE_TAG_ERROR:
+					if(SUCCESS == pLoader->pSession->endRc) {
+						pLoader->pSession->endRc = (IoT_Error_t) -(int64_t) value;
+					}
+					break;
+				case IOT_CAPTURE_TAG_DISCONNECT:
+					break;
+				default:
+					return false;
+			}
+		}
+		if(IOT_CAPTURE_TAG_READ == tag || IOT_CAPTURE_TAG_WRITE == tag) {
+			pCursor += value;
+		}
+	}
+	return true;
+}
+
+IoT_Error_t aws_iot_replay_capture_load(IoT_Replay_Capture *pCapture, const char *pPath) {
+	ReplayLoader_t loader;
+	unsigned char *pFile = NULL;
+	size_t fileLen = 0;
+	size_t capacity = 0;
+	size_t got;
+	bool isParsed = false;
+	FILE *pStream;
+
+	if(NULL == pCapture || NULL == pPath) {
+		return NULL_VALUE_ERROR;
+	}
+
+	memset(pCapture, 0, sizeof(IoT_Replay_Capture));
+	pStream = fopen(pPath, "rb");
+	if(NULL == pStream) {
+		return FAILURE;
+	}
+	do {
+		if(!_replay_grow((void **) &pFile, &capacity, fileLen + 65536, 1)) {
+			fileLen = 0;
+			break;
+		}
+		got = fread(&pFile[fileLen], 1, capacity - fileLen, pStream);
+		fileLen += got;
+	} while(0 != got);
+	fclose(pStream);
+
+	if(fileLen >= IOT_CAPTURE_HEADER_LEN && 0 == memcmp(pFile, IOT_CAPTURE_MAGIC, 4) &&
+	   IOT_CAPTURE_VERSION == (pFile[4] | (pFile[5] << 8))) {
+		memset(&loader, 0, sizeof(loader));
+		loader.pCapture = pCapture;
+		isParsed = _replay_parse(&loader, pFile, fileLen);
+		pCapture->bytesLen = loader.inboundStart;
+		free(loader.pOutbound);
+	}
+	free(pFile);
+
+	if(!isParsed) {
+		aws_iot_replay_capture_free(pCapture);
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+
+void aws_iot_replay_capture_free(IoT_Replay_Capture *pCapture) {
+	size_t i;
+
+	if(NULL == pCapture) {
+		return;
+	}
+	for(i = 0; i < pCapture->subscriptionCount; i++) {
+		free(pCapture->pSubscriptions[i].pFilter);
+	}
+	free(pCapture->pSubscriptions);
+	free(pCapture->pPackets);
+	free(pCapture->pSessions);
+	free(pCapture->pBytes);
+	memset(pCapture, 0, sizeof(IoT_Replay_Capture));
+}
+
+static const IoT_Replay_Packet *_replay_next_packet(IoT_Replay_Network *pReplay) {
+	const IoT_Replay_Packet *pPacket;
+
+	while(pReplay->packet < pReplay->pSession->packetCount) {
+		pPacket = &pReplay->pCapture->pPackets[pReplay->pSession->firstPacket + pReplay->packet];
+		if(0 != pReplay->packetOffset || REPLAY_PINGRESP != pPacket->type) {
+			return pPacket;
+		}
+		pReplay->packet++;
+	}
+	return NULL;
+}
+
+static uint32_t _replay_due_ms(const IoT_Replay_Network *pReplay, const IoT_Replay_Packet *pPacket) {
+	return pReplay->startMs + ((0 == pReplay->speed) ? 0 : pPacket->timeMs / pReplay->speed);
+}
+
+/* copies what can be delivered now, at packet boundaries for the PINGRESPs */
+static size_t _replay_deliver(IoT_Replay_Network *pReplay, unsigned char *pMsg, size_t len, uint32_t now) {
+	const IoT_Replay_Packet *pPacket;
+	size_t delivered = 0;
+	size_t chunkLen;
+
+	while(delivered < len) {
+		if(0 != pReplay->pingOffset || (0 == pReplay->packetOffset && 0 != pReplay->pendingPings)) {
+			chunkLen = sizeof(replayPingResp) - pReplay->pingOffset;
+			if(chunkLen > len - delivered) {
+				chunkLen = len - delivered;
+			}
+			memcpy(&pMsg[delivered], &replayPingResp[pReplay->pingOffset], chunkLen);
+			pReplay->pingOffset += chunkLen;
+			delivered += chunkLen;
+			if(sizeof(replayPingResp) == pReplay->pingOffset) {
+				pReplay->pingOffset = 0;
+				pReplay->pendingPings--;
+				pReplay->stats.pings++;
+			}
+			continue;
+		}
+
+		pPacket = _replay_next_packet(pReplay);
+		if(NULL == pPacket ||
+		   (0 == pReplay->packetOffset &&
+			(pReplay->gate < pPacket->gate || !_replay_is_due(now, _replay_due_ms(pReplay, pPacket))))) {
+			break;
+		}
+		chunkLen = pPacket->len - pReplay->packetOffset;
+		if(chunkLen > len - delivered) {
+			chunkLen = len - delivered;
+		}
+		memcpy(&pMsg[delivered], &pReplay->pCapture->pBytes[pPacket->offset + pReplay->packetOffset], chunkLen);
+		pReplay->packetOffset += chunkLen;
+		delivered += chunkLen;
+		if(pReplay->packetOffset == pPacket->len) {
+			pReplay->packetOffset = 0;
+			pReplay->packet++;
+			pReplay->stats.packets++;
+			if(REPLAY_PUBLISH == pPacket->type) {
+				pReplay->stats.publishes++;
+			}
+		}
+	}
+
+	pReplay->stats.bytesIn += delivered;
+	return delivered;
+}
+
+static IoT_Error_t _replay_read(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								size_t *read_len) {
+	IoT_Replay_Network *pReplay = _replay(pNetwork);
+	const IoT_Replay_Packet *pPacket;
+	uint32_t wait;
+	uint32_t due;
+	uint32_t now;
+
+	*read_len = 0;
+	if(NULL == pReplay->pSession) {
+		return NETWORK_SSL_READ_ERROR;
+	}
+
+	for(;;) {
+		now = aws_iot_host_now_ms();
+		*read_len += _replay_deliver(pReplay, &pMsg[*read_len], len - *read_len, now);
+		if(*read_len == len) {
+			return SUCCESS;
+		}
+
+		pPacket = _replay_next_packet(pReplay);
+		if(NULL == pPacket && 0 == pReplay->pendingPings && SUCCESS != pReplay->pSession->endRc &&
+		   !pReplay->isEndDelivered && 0 == *read_len) {
+			pReplay->isEndDelivered = true;
+			return pReplay->pSession->endRc;
+		}
+		if(NULL == pPacket || pReplay->gate < pPacket->gate) {
+			/* nothing more can arrive before the client writes, as with the loopback Network */
+			countdown_ms(timer, 0);
+			break;
+		}
+
+		due = _replay_due_ms(pReplay, pPacket);
+		wait = left_ms(timer);
+		if(0 == wait) {
+			break;
+		}
+		if(wait > due - now) {
+			wait = due - now;
+		}
+		aws_iot_host_sleep_ms(wait);
+		pReplay->stats.waitedMs += wait;
+	}
+
+	return (0 == *read_len) ? NETWORK_SSL_NOTHING_TO_READ : NETWORK_SSL_READ_TIMEOUT_ERROR;
+}
+
+/* follows the packets written by the client, for the gate and the pings */
+static IoT_Error_t _replay_write(Network *pNetwork, unsigned char *pMsg, size_t len, Timer *timer,
+								 size_t *written_len) {
+	IoT_Replay_Network *pReplay = _replay(pNetwork);
+	size_t cursor = 0;
+	size_t skipped;
+	uint8_t type;
+
+	(void) timer;
+
+	*written_len = 0;
+	if(NULL == pReplay->pSession) {
+		return NETWORK_SSL_WRITE_ERROR;
+	}
+
+	while(cursor < len) {
+		if(0 != pReplay->outRemaining) {
+			skipped = len - cursor;
+			if(skipped > pReplay->outRemaining) {
+				skipped = pReplay->outRemaining;
+			}
+			pReplay->outRemaining -= skipped;
+			cursor += skipped;
+			continue;
+		}
+
+		pReplay->outHeader[pReplay->outHeaderLen++] = pMsg[cursor++];
+		if(1 == pReplay->outHeaderLen ||
+		   (0 != (pReplay->outHeader[pReplay->outHeaderLen - 1] & 0x80) &&
+			pReplay->outHeaderLen < sizeof(pReplay->outHeader))) {
+			continue;
+		}
+
+		/* fixed header complete */
+		type = (uint8_t) (pReplay->outHeader[0] >> 4);
+		if(REPLAY_CONNECT == type || REPLAY_SUBSCRIBE == type) {
+			pReplay->gate++;
+		} else if(REPLAY_PINGREQ == type) {
+			pReplay->pendingPings++;
+		}
+		pReplay->outRemaining = _replay_packet_len(pReplay->outHeader, SIZE_MAX);
+		pReplay->outRemaining = (0 == pReplay->outRemaining) ? 0 : pReplay->outRemaining - pReplay->outHeaderLen;
+		pReplay->outHeaderLen = 0;
+	}
+
+	*written_len = len;
+	return SUCCESS;
+}
+
+static IoT_Error_t _replay_connect(Network *pNetwork, TLSConnectParams *params) {
+	IoT_Replay_Network *pReplay = _replay(pNetwork);
+
+	(void) params;
+
+	if(pReplay->nextSession >= pReplay->pCapture->sessionCount) {
+		pReplay->pSession = NULL;
+		return NETWORK_ERR_NET_CONNECT_FAILED;
+	}
+	pReplay->pSession = &pReplay->pCapture->pSessions[pReplay->nextSession++];
+	pReplay->packet = 0;
+	pReplay->packetOffset = 0;
+	pReplay->startMs = aws_iot_host_now_ms();
+	pReplay->gate = 0;
+	pReplay->pendingPings = 0;
+	pReplay->pingOffset = 0;
+	pReplay->isEndDelivered = false;
+	pReplay->outHeaderLen = 0;
+	pReplay->outRemaining = 0;
+	return SUCCESS;
+}
+
+static IoT_Error_t _replay_disconnect(Network *pNetwork) {
+	(void) pNetwork;
+	return SUCCESS;
+}
+
+static IoT_Error_t _replay_is_connected(Network *pNetwork) {
+	(void) pNetwork;
+	return NETWORK_PHYSICAL_LAYER_CONNECTED;
+}
+
+static IoT_Error_t _replay_destroy(Network *pNetwork) {
+	(void) pNetwork;
+	return SUCCESS;
+}
+
+IoT_Error_t aws_iot_replay_network_init(Network *pNetwork, IoT_Replay_Network *pReplay,
+										const IoT_Replay_Capture *pCapture, size_t session, uint32_t speed) {
+	if(NULL == pNetwork || NULL == pReplay || NULL == pCapture) {
+		return NULL_VALUE_ERROR;
+	}
+
+	memset(pReplay, 0, sizeof(IoT_Replay_Network));
+	pReplay->pCapture = pCapture;
+	pReplay->speed = speed;
+	pReplay->nextSession = session;
+
+	pNetwork->connect = _replay_connect;
+	pNetwork->read = _replay_read;
+	pNetwork->write = _replay_write;
+	pNetwork->disconnect = _replay_disconnect;
+	pNetwork->isConnected = _replay_is_connected;
+	pNetwork->destroy = _replay_destroy;
+	pNetwork->tlsDataParams.pContext = pReplay;
+
+	return SUCCESS;
+}
+
+bool aws_iot_replay_network_is_done(const IoT_Replay_Network *pReplay) {
+	const IoT_Replay_Session *pSession = pReplay->pSession;
+
+	return NULL == pSession ||
+		   (pReplay->packet >= pSession->packetCount && (SUCCESS == pSession->endRc || pReplay->isEndDelivered));
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file network_replay.h
+ * @brief Network feeding a captured session back into a client
+ *
+ * Usage: aws_iot_replay_capture_load a capture of network_record.h, then
+ * for each session to replay aws_iot_mqtt_init a client,
+ * aws_iot_replay_network_init its Network and connect. The client must
+ * subscribe to the filters of IoT_Replay_Session in that order, as the
+ * recorded application did; aws_iot_mqtt_yield then dispatches the recorded
+ * publishes until aws_iot_replay_network_is_done.
+ *
+ * The inbound bytes of the capture are cut into MQTT packets. A packet is
+ * released at its recorded time, divided by the speed factor, and not before
+ * the client has written as many CONNECT and SUBSCRIBE packets as the
+ * recorded one had, so a fast replay cannot overtake the handshake. The
+ * client's own PINGREQs are answered and the recorded PINGRESPs dropped,
+ * since the keep-alive of the replay does not follow the one of the capture.
+ * Everything else the client writes is discarded. A session that ended with
+ * a read or write error ends with the same error.
+ */
+
+#ifndef AWS_IOT_SDK_EXTRAS_NETWORK_REPLAY_H
+#define AWS_IOT_SDK_EXTRAS_NETWORK_REPLAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "aws_iot_mqtt_client.h"
+#include "network_interface.h"
+
+/**
+ * @brief One inbound MQTT packet of a capture
+ */
+typedef struct {
+	uint32_t timeMs;				///< Time after the connection it was read
+	uint32_t gate;					///< CONNECT and SUBSCRIBE packets written before it
+	size_t offset;					///< First byte in IoT_Replay_Capture::pBytes
+	size_t len;						///< Length of the whole packet
+	uint8_t type;					///< MQTT control packet type
+} IoT_Replay_Packet;
+
+/**
+ * @brief One topic filter subscribed during a capture
+ */
+typedef struct {
+	char *pFilter;					///< Null-terminated, owned by the capture
+	uint16_t filterLen;
+	QoS qos;
+} IoT_Replay_Subscription;
+
+/**
+ * @brief One connection of a capture
+ */
+typedef struct {
+	size_t firstPacket;				///< Index in IoT_Replay_Capture::pPackets
+	size_t packetCount;
+	size_t firstSubscription;		///< Index in IoT_Replay_Capture::pSubscriptions
+	size_t subscriptionCount;
+	uint32_t publishCount;			///< Inbound PUBLISH packets
+	uint32_t durationMs;			///< Connection to last record
+	IoT_Error_t endRc;				///< Error that ended the session, SUCCESS if none
+} IoT_Replay_Session;
+
+/**
+ * @brief A capture loaded in memory
+ */
+typedef struct {
+	unsigned char *pBytes;			///< Inbound bytes of all the complete packets
+	size_t bytesLen;
+	IoT_Replay_Packet *pPackets;
+	size_t packetCount;
+	IoT_Replay_Subscription *pSubscriptions;
+	size_t subscriptionCount;
+	IoT_Replay_Session *pSessions;
+	size_t sessionCount;
+} IoT_Replay_Capture;
+
+/**
+ * @brief Packets delivered so far
+ */
+typedef struct {
+	uint32_t packets;				///< Recorded packets delivered
+	uint32_t publishes;				///< Recorded PUBLISH packets delivered
+	uint32_t pings;					///< PINGREQs of the client answered
+	uint64_t bytesIn;				///< Bytes delivered to the client
+	uint64_t waitedMs;				///< Time spent waiting for recorded times
+} IoT_Replay_Stats;
+
+/**
+ * @brief State of a replay Network, one per client
+ */
+typedef struct {
+	const IoT_Replay_Capture *pCapture;
+	uint32_t speed;					///< 1 for the original pace, N for N times faster, 0 for no wait
+	size_t nextSession;				///< Replayed by the next connect
+	const IoT_Replay_Session *pSession;	///< NULL before the first connect
+	size_t packet;					///< Next packet of the session
+	size_t packetOffset;			///< Bytes of that packet already delivered
+	uint32_t startMs;				///< Time of the connection
+	uint32_t gate;					///< CONNECT and SUBSCRIBE packets written by the client
+	uint32_t pendingPings;			///< PINGREQs not answered yet
+	size_t pingOffset;				///< Bytes of the PINGRESP being delivered
+	bool isEndDelivered;			///< The error ending the session was returned
+	unsigned char outHeader[5];		///< Fixed header of the packet being written
+	size_t outHeaderLen;
+	size_t outRemaining;			///< Bytes of that packet still to come
+	IoT_Replay_Stats stats;
+} IoT_Replay_Network;
+
+/**
+ * @brief Load and index a capture
+ *
+ * @param pCapture Capture to fill, release it with aws_iot_replay_capture_free
+ * @param pPath File written by network_record.h
+ *
+ * @return IoT_Error_t SUCCESS, NULL_VALUE_ERROR, FAILURE if the file cannot be read or is not a capture
+ */
+IoT_Error_t aws_iot_replay_capture_load(IoT_Replay_Capture *pCapture, const char *pPath);
+
+/**
+ * @brief Release a loaded capture
+ *
+ * @param pCapture Capture loaded by aws_iot_replay_capture_load
+ */
+void aws_iot_replay_capture_free(IoT_Replay_Capture *pCapture);
+
+/**
+ * @brief Install the replay in pNetwork
+ *
+ * Call it after aws_iot_mqtt_init, which installs the platform Network. The
+ * first connect replays the given session, the following ones the next
+ * sessions, and fail once the capture is exhausted.
+ *
+ * @param pNetwork Network to replace, usually &client.networkStack
+ * @param pReplay State of the replay, must outlive the client
+ * @param pCapture Capture to replay, must outlive the client
+ * @param session Index of the first session to replay
+ * @param speed 1 for the original pace, N for N times faster, 0 for as fast as possible
+ *
+ * @return IoT_Error_t SUCCESS, NULL_VALUE_ERROR
+ */
+IoT_Error_t aws_iot_replay_network_init(Network *pNetwork, IoT_Replay_Network *pReplay,
+										const IoT_Replay_Capture *pCapture, size_t session, uint32_t speed);
+
+/**
+ * @brief Whether the current session has been entirely delivered
+ *
+ * @param pReplay State of the replay
+ */
+bool aws_iot_replay_network_is_done(const IoT_Replay_Network *pReplay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_EXTRAS_NETWORK_REPLAY_H */
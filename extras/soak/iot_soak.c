@@ -0,0 +1,413 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file iot_soak.c
+ * @brief Soak harness: connect/subscribe/publish/disconnect cycles, fails on resource drift
+ *
+ * Usage: iot_soak [options]
+ *
+ *   -m mode      client: one client reconnected every cycle (default)
+ *                fresh: a client initialized and freed every cycle, like the
+ *                       examples that allocate a new object on every retry
+ *                wrapper: a new AWSGreenGrassIoT per cycle, connected to the
+ *                       stand-in broker on 127.0.0.1:8883 (when built with the
+ *                       C++ wrapper). A cycle takes about 1.4 s, the wait of
+ *                       the wrapper's connect and task loop, so long runs
+ *                       are only practical in the client and fresh modes
+ *   -n cycles    cycles to run (1000000, 100 in wrapper mode)
+ *   -r cycles    sample period (1/50 of the run)
+ *   -w percent   cycles run before the baseline sample (10)
+ *
+ * A cycle connects, subscribes to a topic of its own, publishes to it with
+ * QoS 0 and QoS 1, yields until both messages are back, unsubscribes and
+ * disconnects. The client and wrapper modes talk to the in-process fake
+ * broker through the loopback Network.
+ *
+ * Every sample prints the live heap allocations and bytes, the heap
+ * high-water mark, the threads and the open file descriptors of the process.
+ * Heap calls are counted by wrapping malloc, calloc, realloc and free at link
+ * time, so only the allocations of the SDK and of the harness are seen. The
+ * run fails (exit 1) if a cycle fails, or if any of those grew between the
+ * baseline and the last sample: a cycle that leaks one block or one thread
+ * shows up as a steady slope.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <malloc.h>
+
+#include "aws_iot_mqtt_client_interface.h"
+#include "network_loopback.h"
+
+#include "iot_soak.h"
+
+#define SOAK_DEFAULT_CYCLES 1000000
+#define SOAK_DEFAULT_WRAPPER_CYCLES 100
+#define SOAK_SAMPLES 50
+#define SOAK_YIELD_LIMIT 100
+
+typedef struct {
+	uint64_t cycle;
+	double elapsedS;
+	int64_t liveAllocations;
+	int64_t liveBytes;
+	int64_t peakBytes;
+	int threads;
+	int fds;
+} SoakSample_t;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static int64_t liveAllocations = 0;
+static int64_t liveBytes = 0;
+static int64_t peakBytes = 0;
+
+static IoT_Fake_Broker broker;
+static AWS_IoT_Client client;
+static volatile uint32_t received;
+
+static void _soak_account(void *ptr, int64_t count) {
+	int64_t bytes;
+	int64_t peak;
+
+	if(NULL == ptr) {
+		return;
+	}
+	bytes = count * (int64_t) malloc_usable_size(ptr);
+	__atomic_add_fetch(&liveAllocations, count, __ATOMIC_RELAXED);
+	bytes = __atomic_add_fetch(&liveBytes, bytes, __ATOMIC_RELAXED);
+	peak = __atomic_load_n(&peakBytes, __ATOMIC_RELAXED);
+	while(bytes > peak &&
+		  !__atomic_compare_exchange_n(&peakBytes, &peak, bytes, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+void *__wrap_malloc(size_t size) {
+	void *ptr = __real_malloc(size);
+
+	_soak_account(ptr, 1);
+	return ptr;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+	void *ptr = __real_calloc(nmemb, size);
+
+	_soak_account(ptr, 1);
+	return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+	void *newPtr;
+
+	_soak_account(ptr, -1);
+	newPtr = __real_realloc(ptr, size);
+	/* on failure the old block is still there */
+	_soak_account((NULL == newPtr && 0 != size) ? ptr : newPtr, 1);
+	return newPtr;
+}
+
+void __wrap_free(void *ptr) {
+	_soak_account(ptr, -1);
+	__real_free(ptr);
+}
+
+static double _soak_now_s(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+static int _soak_threads(void) {
+	char line[128];
+	int threads = -1;
+	FILE *pFile = fopen("/proc/self/status", "r");
+
+	if(NULL == pFile) {
+		return -1;
+	}
+	while(NULL != fgets(line, sizeof(line), pFile)) {
+		if(1 == sscanf(line, "Threads: %d", &threads)) {
+			break;
+		}
+	}
+	fclose(pFile);
+	return threads;
+}
+
+/* the descriptor of the directory itself is not counted */
+static int _soak_fds(void) {
+	struct dirent *pEntry;
+	int fds = -1;
+	DIR *pDir = opendir("/proc/self/fd");
+
+	if(NULL == pDir) {
+		return -1;
+	}
+	while(NULL != (pEntry = readdir(pDir))) {
+		if('.' != pEntry->d_name[0]) {
+			fds++;
+		}
+	}
+	closedir(pDir);
+	return fds;
+}
+
+static void _soak_sample(SoakSample_t *pSample, uint64_t cycle, double start) {
+	pSample->cycle = cycle;
+	pSample->elapsedS = _soak_now_s() - start;
+	pSample->liveAllocations = __atomic_load_n(&liveAllocations, __ATOMIC_RELAXED);
+	pSample->liveBytes = __atomic_load_n(&liveBytes, __ATOMIC_RELAXED);
+	pSample->peakBytes = __atomic_load_n(&peakBytes, __ATOMIC_RELAXED);
+	pSample->threads = _soak_threads();
+	pSample->fds = _soak_fds();
+}
+
+static void _soak_print(const SoakSample_t *pSample, const SoakSample_t *pPrevious, const char *pNote) {
+	double rate = 0.0;
+
+	if(NULL != pPrevious && pSample->elapsedS > pPrevious->elapsedS) {
+		rate = (double) (pSample->cycle - pPrevious->cycle) / (pSample->elapsedS - pPrevious->elapsedS);
+	}
+	printf("%12llu %10.1f %10.1f %12lld %12lld %12lld %8d %6d %s\n", (unsigned long long) pSample->cycle,
+		   pSample->elapsedS, rate, (long long) pSample->liveAllocations, (long long) pSample->liveBytes,
+		   (long long) pSample->peakBytes, pSample->threads, pSample->fds, pNote);
+	fflush(stdout);
+}
+
+static bool _soak_check(const char *pName, int64_t baseline, int64_t last) {
+	if(last <= baseline) {
+		return true;
+	}
+	printf("drift: %s grew from %lld to %lld\n", pName, (long long) baseline, (long long) last);
+	return false;
+}
+
+static void _soak_on_message(AWS_IoT_Client *pClient, char *pTopicName, uint16_t topicNameLen,
+							 IoT_Publish_Message_Params *pParams, void *pData) {
+	(void) pClient;
+	(void) pTopicName;
+	(void) topicNameLen;
+	(void) pParams;
+	(void) pData;
+	received++;
+}
+
+static IoT_Error_t _soak_init_client(void) {
+	IoT_Client_Init_Params initParams = iotClientInitParamsDefault;
+	IoT_Error_t rc;
+
+	initParams.enableAutoReconnect = false;
+	initParams.pHostURL = "loopback";
+	initParams.port = 8883;
+	initParams.pRootCALocation = "";
+	initParams.pDeviceCertLocation = "";
+	initParams.pDevicePrivateKeyLocation = "";
+	initParams.mqttCommandTimeout_ms = 2000;
+
+	rc = aws_iot_mqtt_init(&client, &initParams);
+	if(SUCCESS == rc) {
+		rc = aws_iot_loopback_network_init(&client.networkStack, &broker);
+	}
+	return rc;
+}
+
+/* one connect, subscribe, publish, unsubscribe, disconnect cycle of the C client */
+static bool _soak_client_cycle(uint64_t cycle, bool isFresh) {
+	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
+	IoT_Publish_Message_Params params;
+	static char topic[32];
+	char payload[32];
+	uint16_t topicLen;
+	unsigned int i;
+	IoT_Error_t rc = SUCCESS;
+
+	if(isFresh) {
+		rc = _soak_init_client();
+	}
+
+	connectParams.pClientID = "iot-soak";
+	connectParams.clientIDLen = (uint16_t) strlen(connectParams.pClientID);
+	connectParams.keepAliveIntervalInSec = 60;
+	snprintf(topic, sizeof(topic), "soak/%llu", (unsigned long long) (cycle % 1000));
+	topicLen = (uint16_t) strlen(topic);
+
+	memset(&params, 0, sizeof(params));
+	params.payload = payload;
+	params.payloadLen = (size_t) snprintf(payload, sizeof(payload), "%llu", (unsigned long long) cycle);
+	received = 0;
+
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_connect(&client, &connectParams);
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_subscribe(&client, topic, topicLen, QOS1, _soak_on_message, NULL);
+	}
+	if(SUCCESS == rc) {
+		params.qos = QOS0;
+		rc = aws_iot_mqtt_publish(&client, topic, topicLen, &params);
+	}
+	if(SUCCESS == rc) {
+		params.qos = QOS1;
+		rc = aws_iot_mqtt_publish(&client, topic, topicLen, &params);
+	}
+	for(i = 0; SUCCESS == rc && received < 2 && i < SOAK_YIELD_LIMIT; i++) {
+		rc = aws_iot_mqtt_yield(&client, 1);
+	}
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_unsubscribe(&client, topic, topicLen);
+	}
+	if(aws_iot_mqtt_is_client_connected(&client)) {
+		IoT_Error_t disconnectRc = aws_iot_mqtt_disconnect(&client);
+
+		if(SUCCESS == rc) {
+			rc = disconnectRc;
+		}
+	}
+	if(isFresh) {
+		aws_iot_mqtt_free(&client);
+	}
+
+	return SUCCESS == rc && 2 == received;
+}
+
+static void _soak_usage(const char *pName) {
+	fprintf(stderr, "usage: %s [-m client|fresh"
+#ifdef IOT_SOAK_WITH_WRAPPER
+			"|wrapper"
+#endif
+			"] [-n cycles] [-r cycles] [-w percent]\n", pName);
+#ifdef IOT_SOAK_WITH_WRAPPER
+	fprintf(stderr, "a wrapper cycle takes about 1.4 s, run millions of cycles in client or fresh mode\n");
+#endif
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	const char *pMode = "client";
+	uint64_t cycles = 0;
+	uint64_t period = 0;
+	uint64_t warmup;
+	uint64_t failed = 0;
+	uint64_t cycle;
+	unsigned int warmupPercent = 10;
+	SoakSample_t baseline;
+	SoakSample_t previous;
+	SoakSample_t sample;
+	bool isFresh = false;
+	bool isWrapper = false;
+	bool isClean = true;
+	bool isOk;
+	double start;
+	int option;
+
+	while(-1 != (option = getopt(argc, argv, "m:n:r:w:"))) {
+		switch(option) {
+			case 'm': pMode = optarg; break;
+			case 'n': cycles = strtoull(optarg, NULL, 10); break;
+			case 'r': period = strtoull(optarg, NULL, 10); break;
+			case 'w': warmupPercent = (unsigned int) strtoul(optarg, NULL, 10); break;
+			default: _soak_usage(argv[0]);
+		}
+	}
+	if(0 == strcmp(pMode, "fresh")) {
+		isFresh = true;
+#ifdef IOT_SOAK_WITH_WRAPPER
+	} else if(0 == strcmp(pMode, "wrapper")) {
+		isWrapper = true;
+#endif
+	} else if(0 != strcmp(pMode, "client")) {
+		_soak_usage(argv[0]);
+	}
+	if(0 == cycles) {
+		cycles = isWrapper ? SOAK_DEFAULT_WRAPPER_CYCLES : SOAK_DEFAULT_CYCLES;
+	}
+	if(0 == period) {
+		period = (cycles >= SOAK_SAMPLES) ? cycles / SOAK_SAMPLES : 1;
+	}
+	if(warmupPercent >= 100) {
+		_soak_usage(argv[0]);
+	}
+	warmup = cycles * warmupPercent / 100;
+
+	aws_iot_fake_broker_init(&broker);
+	if(isWrapper) {
+#ifdef IOT_SOAK_WITH_WRAPPER
+		if(!iot_soak_wrapper_start()) {
+			fprintf(stderr, "cannot start the stand-in broker on 127.0.0.1:%d\n", IOT_SOAK_WRAPPER_PORT);
+			return 1;
+		}
+#endif
+	} else if(!isFresh && SUCCESS != _soak_init_client()) {
+		fprintf(stderr, "client initialization failed\n");
+		return 1;
+	}
+
+	printf("mode %s, %llu cycles, baseline after %llu\n", pMode, (unsigned long long) cycles,
+		   (unsigned long long) warmup);
+	printf("%12s %10s %10s %12s %12s %12s %8s %6s\n", "cycles", "elapsed s", "cycles/s", "live allocs",
+		   "live bytes", "peak bytes", "threads", "fds");
+
+	start = _soak_now_s();
+	_soak_sample(&previous, 0, start);
+	_soak_print(&previous, NULL, "start");
+	baseline = previous;
+	for(cycle = 1; cycle <= cycles; cycle++) {
+#ifdef IOT_SOAK_WITH_WRAPPER
+		isOk = isWrapper ? iot_soak_wrapper_cycle(cycle) : _soak_client_cycle(cycle, isFresh);
+#else
+		isOk = _soak_client_cycle(cycle, isFresh);
+#endif
+		if(!isOk && 0 == failed++) {
+			printf("cycle %llu failed\n", (unsigned long long) cycle);
+		}
+		if(cycle == warmup || 0 == cycle % period || cycle == cycles) {
+			_soak_sample(&sample, cycle, start);
+			_soak_print(&sample, &previous, (cycle == warmup) ? "baseline" : "");
+			if(cycle == warmup) {
+				baseline = sample;
+			}
+			previous = sample;
+		}
+	}
+
+	if(isWrapper) {
+#ifdef IOT_SOAK_WITH_WRAPPER
+		iot_soak_wrapper_stop();
+#endif
+	} else if(!isFresh) {
+		aws_iot_mqtt_free(&client);
+	}
+
+	if(0 != failed) {
+		printf("%llu cycles failed\n", (unsigned long long) failed);
+		isClean = false;
+	}
+	isClean &= _soak_check("live allocations", baseline.liveAllocations, previous.liveAllocations);
+	isClean &= _soak_check("live heap bytes", baseline.liveBytes, previous.liveBytes);
+	isClean &= _soak_check("heap high-water mark", baseline.peakBytes, previous.peakBytes);
+	isClean &= _soak_check("threads", baseline.threads, previous.threads);
+	isClean &= _soak_check("file descriptors", baseline.fds, previous.fds);
+	printf("%s\n", isClean ? "no drift" : "FAILED");
+	return isClean ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file iot_soak.h
+ * @brief AWSGreenGrassIoT cycles of the soak harness, built with the C++ wrapper
+ */
+
+#ifndef AWS_IOT_SDK_EXTRAS_SOAK_H
+#define AWS_IOT_SDK_EXTRAS_SOAK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Port of the stand-in broker, the one AWSGreenGrassIoT connects to
+ */
+#define IOT_SOAK_WRAPPER_PORT 8883
+
+/**
+ * @brief Start the stand-in broker on 127.0.0.1:IOT_SOAK_WRAPPER_PORT
+ *
+ * @return bool false if the port could not be bound
+ */
+bool iot_soak_wrapper_start(void);
+
+/**
+ * @brief Create an AWSGreenGrassIoT, connect, subscribe, publish, wait for the message and delete it
+ *
+ * Returns once the stand-in broker closed its end of the connection too, so
+ * the file descriptors counted after a cycle are the ones left by the client.
+ *
+ * @param cycle Number of the cycle, part of the topic and the payload
+ *
+ * @return bool false if a step failed or the message did not come back
+ */
+bool iot_soak_wrapper_cycle(uint64_t cycle);
+
+/**
+ * @brief Stop the stand-in broker
+ */
+void iot_soak_wrapper_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_EXTRAS_SOAK_H */
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file soak_wrapper.cpp
+ * @brief AWSGreenGrassIoT cycles of the soak harness, against the stand-in broker
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <new>
+
+#include "AWSGreenGrassIoT.h"
+#include "iot_fleet_standin.h"
+#include "iot_soak.h"
+
+#define SOAK_WRAPPER_WAIT_MS 5000
+
+static volatile int received = 0;
+
+/* objects go through malloc, where the harness counts the heap */
+void * operator new(size_t size) {
+    void * ptr = malloc(size ? size : 1);
+    if (ptr == NULL)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void * ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void * ptr, size_t size) noexcept {
+    (void) size;
+    free(ptr);
+}
+
+static void _soakOnMessage(int topicNameLen, char *topicName, int payloadLen, char *payLoad) {
+    (void) topicNameLen;
+    (void) topicName;
+    (void) payloadLen;
+    (void) payLoad;
+    received++;
+}
+
+bool iot_soak_wrapper_start(void) {
+    return iot_fleet_standin_start(IOT_SOAK_WRAPPER_PORT, 0);
+}
+
+/*
+    the pattern of the examples: a new object per connection, deleted afterwards.
+    The taskRunner dispatches the message, the harness only waits for it
+*/
+bool iot_soak_wrapper_cycle(uint64_t cycle) {
+    static char topic[32];
+    char payload[32];
+    bool ok;
+
+    snprintf(topic, sizeof(topic), "soak/%llu", (unsigned long long) (cycle % 1000));
+    snprintf(payload, sizeof(payload), "%llu", (unsigned long long) cycle);
+    received = 0;
+
+    AWSGreenGrassIoT * greengrass = new AWSGreenGrassIoT("127.0.0.1", "iot-soak", "", "", "");
+    ok = greengrass->connectToIoTCore() && greengrass->subscribe(topic, _soakOnMessage) &&
+         greengrass->publish(topic, payload);
+    for (int waited = 0; ok && received == 0 && waited < SOAK_WRAPPER_WAIT_MS; waited += 10)
+        usleep(10 * 1000);
+    ok = ok && received == 1;
+    delete greengrass;
+
+    /* the stand-in closes its end of the connection on its own thread, its descriptor
+       must be gone before the harness counts the open ones */
+    for (int waited = 0; iot_fleet_standin_connections() != 0 && waited < SOAK_WRAPPER_WAIT_MS; waited += 1)
+        usleep(1000);
+
+    return ok;
+}
+
+void iot_soak_wrapper_stop(void) {
+    iot_fleet_standin_stop();
+}
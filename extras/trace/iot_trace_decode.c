@@ -0,0 +1,275 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file iot_trace_decode.c
+ * @brief Host decoder of the aws_iot_trace_dump binary format
+ *
+ * Usage: iot_trace_decode [-t] dump.bin > out
+ *
+ * Without option the output is a Chrome trace (load it in chrome://tracing or
+ * https://ui.perfetto.dev). With -t it is a text timeline, one line per event,
+ * indented by call depth.
+ *
+ * Build: cc -I../../src -o iot_trace_decode iot_trace_decode.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "aws_iot_trace.h"
+
+#define MAX_FUNCTIONS 1024
+#define MAX_TASKS 256
+
+typedef struct {
+	uint8_t task;
+	uint8_t type;
+	const char *pFunction;
+	uint16_t line;
+	int32_t rc;
+	uint64_t timestampUs;
+	size_t order;
+} DecodedEvent_t;
+
+static char *functionNames[MAX_FUNCTIONS];
+static char *taskNames[MAX_TASKS];
+static uint32_t lastTimestamp[MAX_TASKS];
+static uint64_t timestampBase[MAX_TASKS];
+static DecodedEvent_t *events = NULL;
+static size_t nbEvents = 0;
+static size_t eventsCapacity = 0;
+
+static uint16_t get_u16(const uint8_t *pBuf) {
+	return (uint16_t) (pBuf[0] | (pBuf[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *pBuf) {
+	return (uint32_t) pBuf[0] | ((uint32_t) pBuf[1] << 8) | ((uint32_t) pBuf[2] << 16) | ((uint32_t) pBuf[3] << 24);
+}
+
+static bool read_exact(FILE *pFile, uint8_t *pBuf, size_t len) {
+	return fread(pBuf, 1, len, pFile) == len;
+}
+
+static char *read_name(FILE *pFile, uint8_t nameLen) {
+	char *pName = (char *) malloc((size_t) nameLen + 1);
+
+	if(NULL == pName || !read_exact(pFile, (uint8_t *) pName, nameLen)) {
+		free(pName);
+		return NULL;
+	}
+	pName[nameLen] = '\0';
+	return pName;
+}
+
+static const char *function_name(uint16_t id) {
+	return (id < MAX_FUNCTIONS && NULL != functionNames[id]) ? functionNames[id] : "?";
+}
+
+static bool add_event(const uint8_t *pRecord) {
+	DecodedEvent_t *pEvent;
+	uint8_t task = pRecord[1];
+	uint32_t timestamp = get_u32(&pRecord[12]);
+
+	if(nbEvents == eventsCapacity) {
+		eventsCapacity = (0 == eventsCapacity) ? 1024 : eventsCapacity * 2;
+		events = (DecodedEvent_t *) realloc(events, eventsCapacity * sizeof(DecodedEvent_t));
+		if(NULL == events) {
+			return false;
+		}
+	}
+
+	/* the device clock is 32 bit microseconds, unwrap it per task */
+	if(timestamp < lastTimestamp[task]) {
+		timestampBase[task] += (uint64_t) 1 << 32;
+	}
+	lastTimestamp[task] = timestamp;
+
+	pEvent = &events[nbEvents];
+	pEvent->task = task;
+	pEvent->type = pRecord[2];
+	pEvent->pFunction = function_name(get_u16(&pRecord[4]));
+	pEvent->line = get_u16(&pRecord[6]);
+	pEvent->rc = (int32_t) get_u32(&pRecord[8]);
+	pEvent->timestampUs = timestampBase[task] + timestamp;
+	pEvent->order = nbEvents;
+	nbEvents++;
+	return true;
+}
+
+static int compare_events(const void *pA, const void *pB) {
+	const DecodedEvent_t *pEventA = (const DecodedEvent_t *) pA;
+	const DecodedEvent_t *pEventB = (const DecodedEvent_t *) pB;
+
+	if(pEventA->timestampUs != pEventB->timestampUs) {
+		return (pEventA->timestampUs < pEventB->timestampUs) ? -1 : 1;
+	}
+	return (pEventA->order < pEventB->order) ? -1 : 1;
+}
+
+static bool decode(FILE *pFile, uint32_t *pDropped) {
+	uint8_t record[IOT_TRACE_EVENT_RECORD_LEN];
+	uint16_t id;
+
+	if(!read_exact(pFile, record, 12) || 0 != memcmp(record, IOT_TRACE_MAGIC, 4)) {
+		fprintf(stderr, "not a trace dump\n");
+		return false;
+	}
+	if(IOT_TRACE_VERSION != get_u16(&record[4])) {
+		fprintf(stderr, "unsupported trace version %u\n", get_u16(&record[4]));
+		return false;
+	}
+	*pDropped = get_u32(&record[8]);
+
+	while(read_exact(pFile, record, 1)) {
+		switch(record[0]) {
+			case IOT_TRACE_TAG_TASK:
+				if(!read_exact(pFile, &record[1], 2)) {
+					return false;
+				}
+				free(taskNames[record[1]]);
+				taskNames[record[1]] = read_name(pFile, record[2]);
+				break;
+			case IOT_TRACE_TAG_FUNCTION:
+				if(!read_exact(pFile, &record[1], 3)) {
+					return false;
+				}
+				id = get_u16(&record[1]);
+				if(id >= MAX_FUNCTIONS) {
+					return false;
+				}
+				/* a name can be re-announced with the same id when the device table is full,
+				 * decoded events keep pointing to the previous one */
+				functionNames[id] = read_name(pFile, record[3]);
+				break;
+			case IOT_TRACE_TAG_EVENT:
+				if(!read_exact(pFile, &record[1], IOT_TRACE_EVENT_RECORD_LEN - 1) || !add_event(record)) {
+					return false;
+				}
+				break;
+			case IOT_TRACE_TAG_END:
+				return true;
+			default:
+				fprintf(stderr, "corrupted dump, unknown tag 0x%02x\n", record[0]);
+				return false;
+		}
+	}
+
+	fprintf(stderr, "truncated dump\n");
+	return nbEvents > 0;
+}
+
+static void print_chrome_trace(void) {
+	size_t i;
+	int task;
+	bool first = true;
+
+	printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	for(task = 0; task < MAX_TASKS; task++) {
+		if(NULL != taskNames[task]) {
+			printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				   first ? "" : ",\n", task, taskNames[task]);
+			first = false;
+		}
+	}
+	for(i = 0; i < nbEvents; i++) {
+		if(IOT_TRACE_ENTRY == events[i].type) {
+			printf("%s{\"name\":\"%s\",\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%llu}", first ? "" : ",\n",
+				   events[i].pFunction, events[i].task, (unsigned long long) events[i].timestampUs);
+		} else {
+			printf("%s{\"name\":\"%s\",\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"args\":{\"line\":%u",
+				   first ? "" : ",\n", events[i].pFunction, events[i].task,
+				   (unsigned long long) events[i].timestampUs, events[i].line);
+			if(IOT_TRACE_EXIT_RC == events[i].type) {
+				printf(",\"rc\":%d", events[i].rc);
+			}
+			printf("}}");
+		}
+		first = false;
+	}
+	printf("\n]}\n");
+}
+
+static void print_timeline(void) {
+	static int depth[MAX_TASKS];
+	uint64_t origin = (nbEvents > 0) ? events[0].timestampUs : 0;
+	size_t i;
+
+	for(i = 0; i < nbEvents; i++) {
+		DecodedEvent_t *pEvent = &events[i];
+
+		if(IOT_TRACE_ENTRY != pEvent->type && depth[pEvent->task] > 0) {
+			depth[pEvent->task]--;
+		}
+		printf("%12.3f ms  %-16s %*s%s %s", (double) (pEvent->timestampUs - origin) / 1000.0,
+			   (NULL != taskNames[pEvent->task]) ? taskNames[pEvent->task] : "?", 2 * depth[pEvent->task], "",
+			   (IOT_TRACE_ENTRY == pEvent->type) ? ">" : "<", pEvent->pFunction);
+		if(IOT_TRACE_EXIT_RC == pEvent->type) {
+			printf(" rc=%d", pEvent->rc);
+		}
+		printf(" L#%u\n", pEvent->line);
+		if(IOT_TRACE_ENTRY == pEvent->type) {
+			depth[pEvent->task]++;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	bool isTimeline = false;
+	const char *pPath = NULL;
+	uint32_t dropped = 0;
+	FILE *pFile;
+	int i;
+
+	for(i = 1; i < argc; i++) {
+		if(0 == strcmp(argv[i], "-t")) {
+			isTimeline = true;
+		} else {
+			pPath = argv[i];
+		}
+	}
+	if(NULL == pPath) {
+		fprintf(stderr, "usage: %s [-t] dump.bin\n", argv[0]);
+		return 2;
+	}
+
+	pFile = fopen(pPath, "rb");
+	if(NULL == pFile) {
+		perror(pPath);
+		return 1;
+	}
+	if(!decode(pFile, &dropped)) {
+		fclose(pFile);
+		return 1;
+	}
+	fclose(pFile);
+
+	/* rings are dumped task after task, interleave them */
+	qsort(events, nbEvents, sizeof(DecodedEvent_t), compare_events);
+
+	if(isTimeline) {
+		print_timeline();
+	} else {
+		print_chrome_trace();
+	}
+	if(0 != dropped) {
+		fprintf(stderr, "%u events dropped on the device (no free task slot)\n", dropped);
+	}
+	return 0;
+}
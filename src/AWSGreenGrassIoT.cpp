@@ -23,10 +23,32 @@ Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
 #include "aws_iot_version.h"
 #include "aws_iot_mqtt_client_interface.h"
 
+#ifdef AWS_IOT_PLATFORM_HOST
+/* Linux build (extras/CMakeLists.txt): a pthread runs the task, the SDK network layer
+   (extras/platform/host/network_posix.c) carries discovery and the health probes */
+#include <stdio.h>
+#include <time.h>
+#include "aws_ggd_types.h"
+#include "network_interface.h"
+
+#define pvPortMalloc malloc
+#define vPortFree free
+#define GG_PRINTF printf
+
+static uint32_t millis(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) ((uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_nsec / 1000000);
+}
+#else
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 #include <HTTPClient.h>
+
+#define GG_PRINTF Serial.printf
+#endif
 #include "aws_greengrass_discovery.h"
 
 #include "AWSGreenGrassIoT.h"
@@ -39,7 +61,7 @@ static void disconnectCallbackHandler(AWS_IoT_Client *pClient, void *data) {
 	IoT_Error_t rc = FAILURE;
     AWSGreenGrassIoT * pGreengrass = (AWSGreenGrassIoT  *) data;
 
-    Serial.println("Disconnect callback handler");
+    GG_PRINTF("Disconnect callback handler\n");
 
 	if(NULL == pClient) {
         /* if the IoT Client is null, it is not possible to reconnect automatically
@@ -77,6 +99,13 @@ static void iot_subscribe_callback_handler(AWS_IoT_Client *pClient, char *topicN
         subApplCallBackHandler(topicNameLen, topicName, params->payloadLen,(char *)params->payload);
 }
 
+#ifdef AWS_IOT_PLATFORM_HOST
+static void * _hostTaskEntry(void * param) {
+    AWSGreenGrassIoT::taskRunner(param);
+    return NULL;
+}
+#endif
+
 AWSGreenGrassIoT::AWSGreenGrassIoT(const char * AwsIoTCoreurl, // AWS IoT core URL
                     const char * thingName,     // AWS thing name
                     const char * iotCoreCA,     // AWS IoT core certificate (defined in certificate.c)
@@ -91,80 +120,285 @@ AWSGreenGrassIoT::AWSGreenGrassIoT(const char * AwsIoTCoreurl, // AWS IoT core U
 
     _connected = false;
     _isGGDiscovered = false;
+    _clientInitialized = false;
+#ifdef AWS_IOT_PLATFORM_HOST
+    _taskStarted = false;
+    _taskStop = false;
+#else
+    _task = NULL;
+#endif
+    _ggCA = NULL;
+    _nbEndpoints = 0;
+    _nbGGEndpoints = 0;
+    _currentEndpoint = -1;
+    _failoverAfterMs = AWS_GG_FAILOVER_AFTER_MS;
+    _failbackProbeMs = AWS_GG_FAILBACK_PROBE_MS;
+    _failbackProbes = AWS_GG_FAILBACK_PROBES;
+    _downSince = 0;
+    _lastProbe = 0;
+    _probeCandidate = -1;
+    _probeSuccesses = 0;
+    _metricsTopic = NULL;
+    _metricsDocument = NULL;
+    _metricsPeriodMs = 0;
+    _lastMetricsPublish = 0;
     _iotCoreCA = (char *) iotCoreCA;
     _thingCA = (char *) thingCA;
     _thingKey = (char *) thingKey;
 }
 
 /*
-    the connect member function can be used either to connect to Greengrass or
-    directly to AWS IoT core (depending on the host address and the root Certificate)
+    the connect member function builds the endpoint list (greengrass cores discovered
+    for the thing first, AWS IoT Core last) and connects to the first reachable one.
+    Once connected, the taskRunner keeps watching the link: it fails over to the next
+    endpoint when the current one stays down longer than _failoverAfterMs, and fails back
+    to a preferred endpoint after _failbackProbes consecutive successful health probes.
 */
 
-int AWSGreenGrassIoT::_connect( char * host,  char * rootCA) {
+int AWSGreenGrassIoT::_connect(bool useGreengrass, bool useIoTCore) {
 
 	IoT_Error_t rc = FAILURE;
     _connected = false;
-    const size_t stack_size = 36*1024;
 
 	IoT_Client_Init_Params mqttInitParams = iotClientInitParamsDefault;
 	IoT_Client_Connect_Params connectParams = iotClientConnectParamsDefault;
 
+    _clearEndpoints();
+
+    if (useGreengrass && discoverGG())
+        _nbGGEndpoints = _nbEndpoints;
+
+    if (useIoTCore && _nbEndpoints < AWS_GG_MAX_ENDPOINTS) {
+        _endpoints[_nbEndpoints].host = (char *) pvPortMalloc(strlen(_iotCoreUrl)+1);
+        strcpy(_endpoints[_nbEndpoints].host, _iotCoreUrl);
+        _endpoints[_nbEndpoints].rootCA = _iotCoreCA;
+        _endpoints[_nbEndpoints].port = _port;
+        _endpoints[_nbEndpoints].isGreengrass = false;
+        _nbEndpoints++;
+    }
+
+    if (_nbEndpoints == 0)
+        return rc;
+
 	IOT_INFO("\nAWS IoT SDK Version %d.%d.%d-%s\n", VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH, VERSION_TAG);
 
-	IOT_DEBUG("rootCA %s", rootCA);
 	IOT_DEBUG("clientCRT %s", _thingCA);
 	IOT_DEBUG("clientKey %s", _thingKey);
-	mqttInitParams.enableAutoReconnect = true;
-	mqttInitParams.pHostURL = host;
-	mqttInitParams.port = _port;
-	mqttInitParams.pRootCALocation = rootCA;
-	mqttInitParams.pDeviceCertLocation = _thingCA;
-	mqttInitParams.pDevicePrivateKeyLocation = _thingKey;
-	mqttInitParams.mqttCommandTimeout_ms = 20000;
-	mqttInitParams.tlsHandshakeTimeout_ms = 5000;
-
-    if (strcmp(host, _iotCoreUrl) == 0)
-	    mqttInitParams.isSSLHostnameVerify = true;
-    else
- 	    mqttInitParams.isSSLHostnameVerify = false;  // in case of Greengrass, the host certificate doesn't have to be verified
 
-	mqttInitParams.disconnectHandler = disconnectCallbackHandler;
-	mqttInitParams.disconnectHandlerData = this;
+    /* the client is initialized once: subscriptions live in its message handlers and must
+       survive every endpoint switch */
+    if (!_clientInitialized) {
+        mqttInitParams.enableAutoReconnect = true;
+        mqttInitParams.pHostURL = _endpoints[0].host;
+        mqttInitParams.port = _endpoints[0].port;
+        mqttInitParams.pRootCALocation = _endpoints[0].rootCA;
+        mqttInitParams.pDeviceCertLocation = _thingCA;
+        mqttInitParams.pDevicePrivateKeyLocation = _thingKey;
+        mqttInitParams.mqttCommandTimeout_ms = 20000;
+        mqttInitParams.tlsHandshakeTimeout_ms = 5000;
+        mqttInitParams.isSSLHostnameVerify = !_endpoints[0].isGreengrass;  // in case of Greengrass, the host certificate doesn't have to be verified
+        mqttInitParams.disconnectHandler = disconnectCallbackHandler;
+        mqttInitParams.disconnectHandlerData = this;
+
+        rc = aws_iot_mqtt_init(&_client, &mqttInitParams);
+        if(SUCCESS != rc) {
+            IOT_ERROR("aws_iot_mqtt_init returned error : %d ", rc);
+            return rc;
+        }
 
-	rc = aws_iot_mqtt_init(&_client, &mqttInitParams);
-	if(SUCCESS != rc) {
-		IOT_ERROR("aws_iot_mqtt_init returned error : %d ", rc);
-		return rc;
-	}
+        connectParams.keepAliveIntervalInSec = AWS_GG_KEEPALIVE_SEC;
+        connectParams.isCleanSession = true;
+        connectParams.MQTTVersion = MQTT_3_1_1;
+        connectParams.clientIDLen = (uint16_t) strlen(_thingName);
+        if (connectParams.clientIDLen != 0) {
+            connectParams.pClientID = _thingName;
+        } else {
+            connectParams.pClientID = NULL;
+        }
 
-	connectParams.keepAliveIntervalInSec = 600;
-	connectParams.isCleanSession = true;
-	connectParams.MQTTVersion = MQTT_3_1_1;
-    if (connectParams.clientIDLen = (uint16_t) strlen(_thingName))
-	connectParams.pClientID = _thingName;
-	else
-        {
-        connectParams.clientIDLen = 0;
-        connectParams.pClientID = NULL;
+        connectParams.isWillMsgPresent = false;
+
+        rc = aws_iot_mqtt_set_connect_params(&_client, &connectParams);
+        if(SUCCESS != rc) {
+            IOT_ERROR("aws_iot_mqtt_set_connect_params returned error : %d ", rc);
+            return rc;
         }
-    
-	connectParams.isWillMsgPresent = false;
+        _clientInitialized = true;
+    }
 
-	IOT_INFO("Connecting...");
-	rc = aws_iot_mqtt_connect(&_client, &connectParams);
-	if(SUCCESS != rc) {
-		IOT_ERROR("Error(%d) connecting to %s:%d", rc, mqttInitParams.pHostURL, mqttInitParams.port);
-	}
-    else
-        _connected = true;
+    rc = FAILURE;
+    for (int i = 0; i < _nbEndpoints; i++) {
+        if (_connectEndpoint(i)) {
+            rc = SUCCESS;
+            _connected = true;
+            break;
+        }
+    }
 
-     if(rc == SUCCESS)
-        xTaskCreate(&taskRunner, "AWSGreenGrassIoTTask", stack_size, NULL, 6, NULL);
+#ifdef AWS_IOT_PLATFORM_HOST
+    if(rc == SUCCESS && !_taskStarted) {
+        _taskStop = false;
+        _taskStarted = (pthread_create(&_task, NULL, &_hostTaskEntry, this) == 0);
+    }
+#else
+    if(rc == SUCCESS && _task == NULL) {
+        const size_t stack_size = 36*1024;
+#ifdef ENABLE_IOT_LOG_ASYNC
+        // SDK logs are formatted by a low priority task, not in the MQTT receive path
+        aws_iot_log_sink_start(1);
+#endif
+        xTaskCreate(&taskRunner, "AWSGreenGrassIoTTask", stack_size, this, 6, &_task);
+    }
+#endif
 
 	return rc;
 }
 
+/*
+    retarget the network stack to the endpoint and (re)connect. The subscriptions
+    registered so far are replayed on the new session by aws_iot_mqtt_attempt_reconnect
+*/
+bool AWSGreenGrassIoT::_connectEndpoint(int index) {
+
+	IoT_Error_t rc = FAILURE;
+    AWSEndpoint_t * pEndpoint = &_endpoints[index];
+
+    if (aws_iot_mqtt_is_client_connected(&_client))
+        aws_iot_mqtt_disconnect(&_client);
+
+    rc = iot_tls_init(&_client.networkStack, pEndpoint->rootCA, _thingCA, _thingKey,
+                      pEndpoint->host, pEndpoint->port, 5000, !pEndpoint->isGreengrass);
+    if (SUCCESS != rc)
+        return false;
+
+    for (int i = 0; i < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; i++)
+        _client.clientData.messageHandlers[i].resubscribed = 0;
+
+	IOT_INFO("Connecting to %s:%d...", pEndpoint->host, pEndpoint->port);
+    rc = aws_iot_mqtt_attempt_reconnect(&_client);
+    if (NETWORK_RECONNECTED != rc) {
+		IOT_ERROR("Error(%d) connecting to %s:%d", rc, pEndpoint->host, pEndpoint->port);
+        return false;
+    }
+
+    _currentEndpoint = index;
+    _downSince = 0;
+    _probeSuccesses = 0;
+    _probeCandidate = -1;
+    _lastProbe = millis();
+    return true;
+}
+
+/*
+    called by the taskRunner after every yield: failover with hysteresis while the current
+    endpoint is down, fail back once a preferred endpoint has been healthy for a while
+*/
+void AWSGreenGrassIoT::_superviseEndpoints(void) {
+
+    uint32_t now = millis();
+
+    if (!_connected || _currentEndpoint < 0)
+        return;
+
+    if (aws_iot_mqtt_is_client_connected(&_client)) {
+        _downSince = 0;
+
+        if (_currentEndpoint == 0 || now - _lastProbe < _failbackProbeMs)
+            return;
+
+        _lastProbe = now;
+        int candidate = -1;
+        for (int i = 0; i < _currentEndpoint; i++) {
+            if (_probeEndpoint(i)) {
+                candidate = i;
+                break;
+            }
+        }
+
+        if (candidate < 0) {
+            _probeSuccesses = 0;
+        } else if (candidate != _probeCandidate) {
+            _probeCandidate = candidate;
+            _probeSuccesses = 1;
+        } else {
+            _probeSuccesses++;
+        }
+
+        if (candidate >= 0 && _probeSuccesses >= _failbackProbes) {
+            int previous = _currentEndpoint;
+            IOT_INFO("Failing back to %s", _endpoints[candidate].host);
+            if (!_connectEndpoint(candidate))
+                _connectEndpoint(previous);
+        }
+        return;
+    }
+
+    if (_downSince == 0) {
+        _downSince = now;
+        return;
+    }
+
+    if (now - _downSince < _failoverAfterMs)
+        return;
+
+    /* try every other endpoint once, in preference order starting after the current one */
+    for (int i = 1; i <= _nbEndpoints; i++) {
+        int next = (_currentEndpoint + i) % _nbEndpoints;
+        IOT_WARN("Failing over to %s", _endpoints[next].host);
+        if (_connectEndpoint(next))
+            return;
+    }
+    _downSince = now;
+}
+
+/*
+    a plain TCP connect is enough to tell whether the endpoint is listening again,
+    without paying for a second TLS session
+*/
+bool AWSGreenGrassIoT::_probeEndpoint(int index) {
+
+#ifdef AWS_IOT_PLATFORM_HOST
+    /* no root CA selects a plain TCP connection */
+    Network probe;
+    iot_tls_init(&probe, NULL, NULL, NULL, _endpoints[index].host, _endpoints[index].port,
+                 AWS_GG_PROBE_TIMEOUT_MS, false);
+    bool ret = (probe.connect(&probe, NULL) == SUCCESS);
+    probe.disconnect(&probe);
+    probe.destroy(&probe);
+#else
+    WiFiClient probe;
+    bool ret = probe.connect(_endpoints[index].host, _endpoints[index].port, AWS_GG_PROBE_TIMEOUT_MS);
+    probe.stop();
+#endif
+    return ret;
+}
+
+void AWSGreenGrassIoT::_clearEndpoints(void) {
+
+    for (int i = 0; i < _nbEndpoints; i++)
+        vPortFree(_endpoints[i].host);
+    _nbEndpoints = 0;
+    _nbGGEndpoints = 0;
+    _currentEndpoint = -1;
+}
+
+void AWSGreenGrassIoT::setFailoverPolicy(uint32_t failoverAfterMs, uint32_t failbackProbeMs, uint8_t failbackProbes) {
+
+    _failoverAfterMs = failoverAfterMs;
+    _failbackProbeMs = failbackProbeMs;
+    _failbackProbes = failbackProbes ? failbackProbes : 1;
+}
+
+bool AWSGreenGrassIoT::isConnectedToGG(void) {
+
+    return _currentEndpoint >= 0 && _endpoints[_currentEndpoint].isGreengrass && aws_iot_mqtt_is_client_connected(&_client);
+}
+
+const char * AWSGreenGrassIoT::currentHost(void) {
+
+    return _currentEndpoint >= 0 ? _endpoints[_currentEndpoint].host : NULL;
+}
+
 
 bool AWSGreenGrassIoT::publish(char *pubtopic, char *pubPayLoad) {
 
@@ -218,13 +452,13 @@ bool AWSGreenGrassIoT::subscribe(char *subTopic, pSubCallBackHandler_t pSubCallB
     subApplCallBackHandler = pSubCallBackHandler;
 
     if (_connected) {
-        ESP_LOGI(TAG, "Subscribing...");
+        IOT_INFO("Subscribing...");
         rc = aws_iot_mqtt_subscribe(&_client, subTopic, strlen(subTopic), QOS0, iot_subscribe_callback_handler, NULL);
         if(SUCCESS != rc) {
-            ESP_LOGE(TAG, "Error subscribing : %d ", rc);
+            IOT_ERROR("Error subscribing : %d ", rc);
             return false;
         }
-        ESP_LOGI(TAG, "Subscribing... Successful");
+        IOT_INFO("Subscribing... Successful");
         ret = true;
     }
     return ret;
@@ -232,6 +466,33 @@ bool AWSGreenGrassIoT::subscribe(char *subTopic, pSubCallBackHandler_t pSubCallB
 
 AWSGreenGrassIoT::~AWSGreenGrassIoT(void)
 {
+#ifdef AWS_IOT_PLATFORM_HOST
+    if (_taskStarted) {
+        _taskStop = true;
+        pthread_join(_task, NULL);
+    }
+#else
+    if (_task != NULL) {
+#ifdef ENABLE_IOT_TRACE
+        aws_iot_trace_release(_task);
+#endif
+        vTaskDelete(_task);
+    }
+#endif
+    /* the client is shared by all the instances: close the session, or the next instance
+       initializes it over a live connection and its socket is lost */
+    if (_clientInitialized) {
+        if (aws_iot_mqtt_is_client_connected(&_client))
+            aws_iot_mqtt_disconnect(&_client);
+        aws_iot_mqtt_free(&_client);
+    }
+    _clearEndpoints();
+    if (_ggCA != NULL)
+        vPortFree(_ggCA);
+    if (_metricsTopic != NULL)
+        vPortFree(_metricsTopic);
+    if (_metricsDocument != NULL)
+        vPortFree(_metricsDocument);
     vPortFree(_iotCoreUrl);
     vPortFree(_thingName);
 }
@@ -239,23 +500,136 @@ AWSGreenGrassIoT::~AWSGreenGrassIoT(void)
 
 bool AWSGreenGrassIoT::discoverGG(void) {
 
+    _isGGDiscovered = false;
+
+    char * payload = _fetchDiscoveryDocument();
+    if (payload == NULL)
+        return false;
+
+    GGD_HostAddressData_t hostAddressData[AWS_GG_MAX_ENDPOINTS];
+    uint32_t nbHosts = 0;
+    GG_PRINTF("Response from greengrass discovery\n");
+
+    // extract every Greengrass host address and the greengrass root certificate.
+    // they point inside payload, so keep our own copies
+    if (GGD_GetGGCEndpoints(payload, hostAddressData, AWS_GG_MAX_ENDPOINTS - 1, &nbHosts)) {
+        if (_ggCA != NULL)
+            vPortFree(_ggCA);
+        _ggCA = (char *) pvPortMalloc(strlen(hostAddressData[0].pcCertificate)+1);
+        strcpy(_ggCA, hostAddressData[0].pcCertificate);
+
+        for (uint32_t i = 0; i < nbHosts; i++) {
+            _endpoints[_nbEndpoints].host = (char *) pvPortMalloc(strlen(hostAddressData[i].pcHostAddress)+1);
+            strcpy(_endpoints[_nbEndpoints].host, hostAddressData[i].pcHostAddress);
+            _endpoints[_nbEndpoints].rootCA = _ggCA;
+            _endpoints[_nbEndpoints].port = hostAddressData[i].usPort;
+            _endpoints[_nbEndpoints].isGreengrass = true;
+            _nbEndpoints++;
+        }
+        _isGGDiscovered = true;
+    }
+
+    vPortFree(payload);
+    return _isGGDiscovered;
+}
+
+/*
+    Generate  green grass discovery url:
+        https://XXXXXXXXXXXXX-ats.iot.region.amazonaws.com:port/greengrass/discover/thing/thing-name
+    and return the response body (pvPortMalloc'ed), NULL on error
+*/
+#ifdef AWS_IOT_PLATFORM_HOST
+
+/*
+    the request is sent over the SDK network layer. HTTP/1.0 keeps the response
+    unchunked and lets the server close the connection after the body
+*/
+char * AWSGreenGrassIoT::_fetchDiscoveryDocument(void) {
+
+    Network network;
+    Timer timer;
+    IoT_Error_t rc;
+    char request[512];
+    char * response = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    size_t transferred = 0;
+
+    iot_tls_init(&network, _iotCoreCA, _thingCA, _thingKey, _iotCoreUrl, AWS_GG_DISCOVERY_PORT,
+                 AWS_GG_DISCOVERY_TIMEOUT_MS, true);
+    if (network.connect(&network, NULL) != SUCCESS) {
+        GG_PRINTF("[HTTPS] Unable to connect\n");
+        return NULL;
+    }
+
+    int requestLength = snprintf(request, sizeof(request), "GET /greengrass/discover/thing/%s HTTP/1.0\r\nHost: %s\r\n\r\n",
+                                 _thingName, _iotCoreUrl);
+    init_timer(&timer);
+    countdown_ms(&timer, AWS_GG_DISCOVERY_TIMEOUT_MS);
+    rc = FAILURE;
+    if (requestLength > 0 && (size_t) requestLength < sizeof(request))
+        rc = network.write(&network, (unsigned char *) request, (size_t) requestLength, &timer, &transferred);
+
+    // read until the server closes the connection, a full buffer asks for more room
+    while (rc == SUCCESS) {
+        if (capacity - length < 2) {
+            if (capacity >= AWS_GG_DISCOVERY_MAX_LEN) {
+                rc = FAILURE;
+                break;
+            }
+            capacity = capacity ? capacity * 2 : 4096;
+            char * grown = (char *) realloc(response, capacity);
+            if (grown == NULL) {
+                rc = FAILURE;
+                break;
+            }
+            response = grown;
+        }
+        rc = network.read(&network, (unsigned char *) response + length, capacity - length - 1, &timer, &transferred);
+        length += transferred;
+    }
+    network.disconnect(&network);
+    network.destroy(&network);
+
+    // the connection closed by the server is the only good outcome
+    char * body = NULL;
+    if (rc == NETWORK_SSL_READ_ERROR && response != NULL) {
+        response[length] = '\0';
+        body = strstr(response, "\r\n\r\n");
+        if (strncmp(response, "HTTP/1.", 7) != 0 || strncmp(response + 8, " 200", 4) != 0 || body == NULL) {
+            GG_PRINTF("[HTTPS] GET... failed: %.*s\n", (int) strcspn(response, "\r\n"), response);
+            body = NULL;
+        }
+    } else {
+        GG_PRINTF("[HTTPS] GET... failed, error: %d\n", rc);
+    }
+
+    if (body == NULL) {
+        free(response);
+        return NULL;
+    }
+    body += 4;
+    memmove(response, body, strlen(body) + 1);
+    return response;
+}
+
+#else
+
+char * AWSGreenGrassIoT::_fetchDiscoveryDocument(void) {
+
     String greenGrassDiscoveryUrl;
     HTTPClient https;
     WiFiClientSecure * _wfclient;
+    char * document = NULL;
 
     _wfclient = new WiFiClientSecure;
     _wfclient->setCACert(_iotCoreCA);
     _wfclient->setCertificate(_thingCA);
     _wfclient->setPrivateKey(_thingKey);
 
-/*
-      Generate  green grass discovery url:
-             https://XXXXXXXXXXXXX-ats.iot.region.amazonaws.com:port/greengrass/discover/thing/thing-name
-*/
+    greenGrassDiscoveryUrl = String("https://") + String(_iotCoreUrl) + String(":") + String(AWS_GG_DISCOVERY_PORT) +
+                             String("/greengrass/discover/thing/") + String(_thingName);
 
-    greenGrassDiscoveryUrl = String("https://") + String(_iotCoreUrl) + String(":8443/greengrass/discover/thing/") + String(_thingName);
-
-    _isGGDiscovered = false;
     if (https.begin(*_wfclient, greenGrassDiscoveryUrl))
     {
 
@@ -266,55 +640,46 @@ bool AWSGreenGrassIoT::discoverGG(void) {
         if (httpCode > 0)
         {
             // HTTP header has been send and Server response header has been handled
-            ESP_LOGI(TAG,"[HTTPS] GET... successful\n");
+            IOT_INFO("[HTTPS] GET... successful\n");
 
             // file found at server
             if (httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_MOVED_PERMANENTLY)
             {
                 String payload = https.getString();
-                Serial.printf("Response from greengrass discovery\n");
-
-                // extract the Greengrass host address and greengrass root certificate
-                _isGGDiscovered = GGD_GetGGCIPandCertificate(payload.c_str(), &_HostAddressData);
+                document = (char *) pvPortMalloc(payload.length()+1);
+                if (document != NULL)
+                    strcpy(document, payload.c_str());
             }
         }
         else
         {
-            Serial.printf("[HTTPS] GET... failed, error: %s\n", https.errorToString(httpCode).c_str());
+            GG_PRINTF("[HTTPS] GET... failed, error: %s\n", https.errorToString(httpCode).c_str());
         }
 
         https.end();
     }
     else
     {
-        Serial.printf("[HTTPS] Unable to connect\n");
+        GG_PRINTF("[HTTPS] Unable to connect\n");
     }
 
     delete _wfclient;
-    return _isGGDiscovered;
+    return document;
 }
 
+#endif
+
 bool AWSGreenGrassIoT::connectToGG(void) {
 
     if (!_connected)
     {
-        if (!_isGGDiscovered)
-            {
-                if (discoverGG())
-                {
-                    if (_connect( (char *) _HostAddressData.pcHostAddress, (char *) _HostAddressData.pcCertificate ) == 0)
-                        _connected = true;
-                    else {
-                        Serial.println("Failed to connect to Greengrass");
-                    }
-
-                }
-                else
-                {
-                    Serial.println("Greengrass Discovery failed");
-                }
-
-            }
+        if (_connect(true, false) != 0)
+        {
+            if (_isGGDiscovered)
+                GG_PRINTF("Failed to connect to Greengrass\n");
+            else
+                GG_PRINTF("Greengrass Discovery failed\n");
+        }
     }
     return _connected;
 }
@@ -323,27 +688,95 @@ bool AWSGreenGrassIoT::connectToIoTCore(void) {
 
     if (!_connected)
     {
-        if (_connect(_iotCoreUrl, _iotCoreCA) == 0)
-            _connected = true;
-        else
+        if (_connect(false, true) != 0)
         {
-            Serial.println("Failed to connect to AWS IoT Core");
+            GG_PRINTF("Failed to connect to AWS IoT Core\n");
         }
     }
 
     return _connected;
 }
 
+bool AWSGreenGrassIoT::connect(void) {
+
+    if (!_connected)
+    {
+        if (_connect(true, true) != 0)
+        {
+            GG_PRINTF("Failed to connect to Greengrass and AWS IoT Core\n");
+        }
+    }
+
+    return _connected;
+}
+
+/*
+    Client metrics (packet counters, error tables, latency histograms) are published as a
+    compact JSON document every periodMs from the taskRunner.
+    The first document is sent one period after the call.
+*/
+void AWSGreenGrassIoT::setMetricsPublish(const char * topic, uint32_t periodMs) {
+    if (_metricsTopic != NULL) {
+        vPortFree(_metricsTopic);
+        _metricsTopic = NULL;
+    }
+    if (_metricsDocument != NULL) {
+        vPortFree(_metricsDocument);
+        _metricsDocument = NULL;
+    }
+    _metricsPeriodMs = 0;
+
+    if (topic == NULL || periodMs == 0)
+        return;
+
+    _metricsTopic = (char *) pvPortMalloc(strlen(topic)+1);
+    strcpy(_metricsTopic, topic);
+    // the document does not fit on the taskRunner stack
+    _metricsDocument = (char *) pvPortMalloc(AWS_IOT_MQTT_TX_BUF_LEN);
+    _lastMetricsPublish = millis();
+    _metricsPeriodMs = periodMs;
+}
+
+void AWSGreenGrassIoT::_publishMetrics(void) {
+#ifndef DISABLE_IOT_CLIENT_METRICS
+    if (_metricsPeriodMs == 0 || !aws_iot_mqtt_is_client_connected(&_client))
+        return;
+
+    if ((uint32_t)(millis() - _lastMetricsPublish) < _metricsPeriodMs)
+        return;
+    _lastMetricsPublish = millis();
+
+    IoT_Error_t rc = aws_iot_mqtt_publish_metrics(&_client, _metricsTopic, strlen(_metricsTopic),
+                                                  _metricsDocument, AWS_IOT_MQTT_TX_BUF_LEN);
+    if (rc != SUCCESS) {
+        GG_PRINTF("Metrics publish failed: %d\n", rc);
+    }
+#endif
+}
+
 void AWSGreenGrassIoT::taskRunner( void * param) {
+    AWSGreenGrassIoT * pGreengrass = (AWSGreenGrassIoT *) param;
     IoT_Error_t rc = SUCCESS;
+#ifdef AWS_IOT_PLATFORM_HOST
+    while(!pGreengrass->_taskStop)
+#else
     while(1)
+#endif
     {
         //allocate some time to read messages from IoT broker
         rc = aws_iot_mqtt_yield( &_client, 400);
+        pGreengrass->_superviseEndpoints();
+        pGreengrass->_publishMetrics();
         if(NETWORK_ATTEMPTING_RECONNECT == rc) {
             continue;
         }
 
+#ifdef AWS_IOT_PLATFORM_HOST
+        // in slices, so that deleting the object does not wait for the whole second
+        for (int i = 0; i < 10 && !pGreengrass->_taskStop; i++)
+            usleep(100 * 1000);
+#else
         vTaskDelay(1000 / portTICK_RATE_MS);
+#endif
     }
 }
@@ -16,11 +16,69 @@ Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
 #ifndef _AWSGREENGRASS_H_
 #define _AWSGREENGRASS_H_
 
+#ifdef AWS_IOT_PLATFORM_HOST
+/* BaseType_t of the discovery API, FreeRTOS provides it on the device */
+#include "aws_ggd_types.h"
+#include <pthread.h>
+#endif
+
 #include "aws_greengrass_discovery.h"
 #include "aws_iot_mqtt_client.h"
 
 typedef void (*pSubCallBackHandler_t)(int topicNameLen, char *topicName, int payloadLen, char *payLoad);
 
+/* maximum number of endpoints in the failover list (greengrass core addresses + AWS IoT Core) */
+#ifndef AWS_GG_MAX_ENDPOINTS
+#define AWS_GG_MAX_ENDPOINTS            4
+#endif
+
+/* how long the current endpoint may stay unreachable before switching to the next one */
+#ifndef AWS_GG_FAILOVER_AFTER_MS
+#define AWS_GG_FAILOVER_AFTER_MS        10000
+#endif
+
+/* interval between health probes of a preferred endpoint while running on a fallback one */
+#ifndef AWS_GG_FAILBACK_PROBE_MS
+#define AWS_GG_FAILBACK_PROBE_MS        30000
+#endif
+
+/* number of consecutive successful probes before failing back to a preferred endpoint */
+#ifndef AWS_GG_FAILBACK_PROBES
+#define AWS_GG_FAILBACK_PROBES          3
+#endif
+
+/* keep-alive negotiated with the broker. It is only the ceiling: the client pings an idle
+   link more often when it observes silent drops (see AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC) */
+#ifndef AWS_GG_KEEPALIVE_SEC
+#define AWS_GG_KEEPALIVE_SEC            600
+#endif
+
+/* timeout of a single health probe (plain TCP connect to the endpoint) */
+#ifndef AWS_GG_PROBE_TIMEOUT_MS
+#define AWS_GG_PROBE_TIMEOUT_MS         1000
+#endif
+
+/* port and timeout of the greengrass discovery request */
+#ifndef AWS_GG_DISCOVERY_PORT
+#define AWS_GG_DISCOVERY_PORT           8443
+#endif
+
+#ifndef AWS_GG_DISCOVERY_TIMEOUT_MS
+#define AWS_GG_DISCOVERY_TIMEOUT_MS     5000
+#endif
+
+/* largest discovery response accepted by the host build */
+#ifndef AWS_GG_DISCOVERY_MAX_LEN
+#define AWS_GG_DISCOVERY_MAX_LEN        (64 * 1024)
+#endif
+
+typedef struct {
+  char * host;          // host address (owned copy)
+  char * rootCA;        // root certificate used to authenticate the endpoint
+  uint16_t port;
+  bool isGreengrass;    // greengrass cores are not verified against their hostname
+} AWSEndpoint_t;
+
 class AWSGreenGrassIoT  {
 
 public:
@@ -34,6 +92,13 @@ public:
 
   bool connectToGG(void);
   bool connectToIoTCore(void);
+  bool connect(void);   // greengrass cores first, AWS IoT Core as fallback
+
+  void setFailoverPolicy(uint32_t failoverAfterMs, uint32_t failbackProbeMs, uint8_t failbackProbes);
+  bool isConnectedToGG(void);
+  const char * currentHost(void);
+
+  void setMetricsPublish(const char * topic, uint32_t periodMs);   // periodMs 0 stops publishing
 
   bool publish(char *pubtopic, char *pubPayLoad);
   bool publishBinary( char * pubtopic, char * payload, int payloadLength);
@@ -46,16 +111,48 @@ public:
   void disconnect() { _connected = false; _isGGDiscovered=false;}
 
 protected:
-  int _connect( char * host,  char * rootCA);
+  int _connect(bool useGreengrass, bool useIoTCore);
+  bool _connectEndpoint(int index);
+  void _superviseEndpoints(void);
+  bool _probeEndpoint(int index);
+  void _publishMetrics(void);
+  void _clearEndpoints(void);
   bool discoverGG(void);
+  char * _fetchDiscoveryDocument(void);
 
 private:
 
   char * _iotCoreUrl;
   char * _thingName;
-  GGD_HostAddressData_t _HostAddressData;
+  char * _ggCA;
   bool _isGGDiscovered;
   bool _connected;
+  bool _clientInitialized;
+#ifdef AWS_IOT_PLATFORM_HOST
+  pthread_t _task;
+  bool _taskStarted;
+  volatile bool _taskStop;
+#else
+  TaskHandle_t _task;
+#endif
+
+  AWSEndpoint_t _endpoints[AWS_GG_MAX_ENDPOINTS];
+  int _nbEndpoints;
+  int _nbGGEndpoints;
+  int _currentEndpoint;
+
+  uint32_t _failoverAfterMs;
+  uint32_t _failbackProbeMs;
+  uint8_t _failbackProbes;
+  uint32_t _downSince;
+  uint32_t _lastProbe;
+  int _probeCandidate;
+  uint8_t _probeSuccesses;
+
+  char * _metricsTopic;
+  char * _metricsDocument;
+  uint32_t _metricsPeriodMs;
+  uint32_t _lastMetricsPublish;
 
   char * _iotCoreCA;
   char * _thingCA;
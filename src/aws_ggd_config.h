@@ -41,6 +41,8 @@
 /**
  * @brief Size of the array used by jsmn to store the tokens.
  */
+#ifndef ggdconfigJSON_MAX_TOKENS
 #define ggdconfigJSON_MAX_TOKENS            ( 128 )
+#endif
 
 #endif /* _AWS_GGD_CONFIG_H_ */
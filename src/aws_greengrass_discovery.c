@@ -299,6 +299,87 @@ BaseType_t GGD_GetIPandCertificateFromJSON( const char * pcJSONFile, /*lint !e97
 }
 /*-----------------------------------------------------------*/
 
+BaseType_t GGD_GetGGCEndpoints( const char * pcBuffer, /*lint !e971 can use char without signed/unsigned. */
+                                GGD_HostAddressData_t * pxHostAddressData,
+                                const uint32_t ulMaxEndpoints,
+                                uint32_t * pulNbEndpoints )
+{
+    BaseType_t xStatus;
+    jsmn_parser xParser;
+    jsmntok_t pxTok[ ggdconfigJSON_MAX_TOKENS ];
+    int32_t lNbTokens;
+    uint32_t ulTokenIndex = 0;
+    uint8_t ucCurrentInterface = 0, ucTargetInterface = 1;
+    GGD_HostAddressData_t xCandidate;
+
+    configASSERT( pcBuffer != NULL );
+    configASSERT( pxHostAddressData != NULL );
+    configASSERT( pulNbEndpoints != NULL );
+
+    *pulNbEndpoints = 0;
+
+    jsmn_init( &xParser );
+    lNbTokens = ( int32_t ) jsmn_parse( &xParser,
+                                        pcBuffer,
+                                        strlen( pcBuffer ),
+                                        pxTok,
+                                        ( unsigned int ) ggdconfigJSON_MAX_TOKENS );
+
+    if( ( lNbTokens < 0 ) || ( ulMaxEndpoints == 0 ) )
+    {
+        ggdconfigPRINT( "JSON parsing: Failed to parse JSON\r\n" );
+
+        xStatus = pdFAIL;
+    }
+    else
+    {
+        xStatus = prvGGDGetCertificate( (char *) pcBuffer,
+                                        NULL,
+                                        pdTRUE,
+                                        pxTok,
+                                        ( uint32_t ) lNbTokens,
+                                        &xCandidate );
+
+        if( xStatus == pdFAIL )
+        {
+            ggdconfigPRINT( "JSON parsing: Couldn't find certificate\r\n" );
+        }
+    }
+
+    if( xStatus == pdPASS )
+    {
+        /* Walk every interface of every core, keeping the usable ones in order. */
+        while( ( *pulNbEndpoints < ulMaxEndpoints ) &&
+               ( prvGGDGetIPOnInterface( (char *) pcBuffer,
+                                         ucTargetInterface,
+                                         pxTok,
+                                         ( uint32_t ) lNbTokens,
+                                         &xCandidate,
+                                         &ulTokenIndex,
+                                         &ucCurrentInterface ) == pdPASS ) )
+        {
+            if( prvIsIPvalid( xCandidate.pcHostAddress ) == pdTRUE )
+            {
+                ggdconfigPRINT( "Discovered Greengrass IP address %s, port: %d\n", xCandidate.pcHostAddress, xCandidate.usPort );
+                pxHostAddressData[ *pulNbEndpoints ] = xCandidate;
+                ( *pulNbEndpoints )++;
+            }
+
+            ucTargetInterface++;
+        }
+
+        if( *pulNbEndpoints == 0 )
+        {
+            ggdconfigPRINT( "GGD - Can't find greengrass Core\r\n" );
+
+            xStatus = pdFAIL;
+        }
+    }
+
+    return xStatus;
+}
+/*-----------------------------------------------------------*/
+
 /* Return true if the string " pcString" is found inside the token pxTok in JSON file pcJson. */
 static BaseType_t prvGGDJsoneq( const char * pcJson,    /*lint !e971 can use char without signed/unsigned. */
                                 const jsmntok_t * const pxTok,
@@ -132,6 +132,33 @@ BaseType_t GGD_GetIPandCertificateFromJSON( const char * pcJSONFile,
                                             const HostParameters_t * pxHostParameters,
                                             GGD_HostAddressData_t * pxHostAddressData,
                                             const BaseType_t xAutoSelectFlag );
+/*
+ * @brief  Get every usable core address and the group certificate
+ *
+ * Same as GGD_GetGGCIPandCertificate with the auto selection, but instead of
+ * stopping at the first valid address it collects every HostAddress/PortNumber
+ * pair of every core, in the order they appear in the JSON file. Loop back and
+ * IPv6 addresses are skipped.
+ *
+ * @note: All the returned entries share the same pcCertificate, and
+ * pcHostAddress points inside the JSON file which is modified inline.
+ * The caller has to copy what it needs before releasing the buffer.
+ *
+ * @param [in] pcBuffer: JSON file returned by the discovery service.
+ *
+ * @param [out] pxHostAddressData : array of host address data
+ *
+ * @param [in] ulMaxEndpoints: Number of entries of pxHostAddressData.
+ *
+ * @param [out] pulNbEndpoints: Number of entries filled in.
+ *
+ * @return pdPASS if the certificate and at least one address were found.
+ * Otherwise pdFAIL is returned.
+ */
+BaseType_t GGD_GetGGCEndpoints( const char * pcBuffer,
+                                GGD_HostAddressData_t * pxHostAddressData,
+                                const uint32_t ulMaxEndpoints,
+                                uint32_t * pulNbEndpoints );
 #endif /* _AWS_GREENGRASS_DISCOVERY_H_ */
 
 #ifdef __cplusplus
@@ -42,23 +42,62 @@ extern char AWS_IOT_HOST_ADDRESS[];
 #define _ENABLE_THREAD_SUPPORT_
 
 // MQTT PubSub
+#ifndef AWS_IOT_MQTT_TX_BUF_LEN
 #define AWS_IOT_MQTT_TX_BUF_LEN 512 ///< Any time a message is sent out through the MQTT layer. The message is copied into this buffer anytime a publish is done. This will also be used in the case of Thing Shadow
+#endif
+#ifndef AWS_IOT_MQTT_RX_BUF_LEN
 #define AWS_IOT_MQTT_RX_BUF_LEN 512 ///< Any message that comes into the device should be less than this buffer size. If a received message is bigger than this buffer size the message will be dropped.
+#endif
+#ifndef AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS
 #define AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS 5 ///< Maximum number of topic filters the MQTT client can handle at any given time. This should be increased appropriately when using Thing Shadow
+#endif
 
 // Auto Reconnect specific config
-#define AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL 1000 ///< Minimum time before the First reconnect attempt is made as part of the exponential back-off algorithm
-#define AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL 128000 ///< Maximum time interval after which exponential back-off will stop attempting to reconnect.
+#define AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL 1000 ///< Lower bound of the jittered back-off delay between reconnect attempts. The first attempt after a transient error waits a random delay below it
+#define AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL 128000 ///< Upper bound of the jittered back-off delay. Reconnect attempts continue indefinitely at most this far apart
+
+// Keep-alive
+#define AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC 30 ///< Shortest idle time before the link is checked with a PINGREQ. The adaptive interval halves on every silent drop down to this value, the ceiling is the keep-alive interval negotiated on connect
+#define AWS_IOT_MQTT_KEEPALIVE_GROW_AFTER 3 ///< Number of successful idle pings after which the adaptive interval grows by AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC, up to one step below the last interval that dropped
+#define AWS_IOT_MQTT_KEEPALIVE_RETRY_AFTER 20 ///< Number of successful idle pings held below an interval that dropped after which the adaptive interval may grow one step closer to it again
 
 // Thing Shadow specific configs
 #define SHADOW_MAX_SIZE_OF_RX_BUFFER (AWS_IOT_MQTT_RX_BUF_LEN + 1) ///< Maximum size of the SHADOW buffer to store the received Shadow message
 #define MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES 80  ///< Maximum size of the Unique Client Id. For More info on the Client Id refer \ref response "Acknowledgments"
 #define MAX_SIZE_CLIENT_ID_WITH_SEQUENCE (MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES + 10) ///< This is size of the extra sequence number that will be appended to the Unique client Id
 #define MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE (MAX_SIZE_CLIENT_ID_WITH_SEQUENCE + 20) ///< This is size of the the total clientToken key and value pair in the JSON
-#define MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME 10 ///< At Any given time we will wait for this many responses. This will correlate to the rate at which the shadow actions are requested
+#ifndef MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME
+#define MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME 10 ///< At Any given time we will wait for this many responses. This will correlate to the rate at which the shadow actions are requested. Up to 65535, a response is matched to its request and expired in constant or logarithmic time whatever the size
+#endif
 #define MAX_THINGNAME_HANDLED_AT_ANY_GIVEN_TIME 10 ///< We could perform shadow action on any thing Name and this is maximum Thing Names we can act on at any given time
 #define MAX_SHADOW_TOPIC_LENGTH_WITHOUT_THINGNAME 60 ///< All shadow actions have to be published or subscribed to a topic which is of the formablogt $aws/things/{thingName}/shadow/update/accepted. This refers to the size of the topic without the Thing Name
+#ifndef MAX_JSON_TOKEN_EXPECTED
 #define MAX_JSON_TOKEN_EXPECTED 120 ///< These are the max tokens that is expected to be in the Shadow JSON document. Include the metadata that gets published
+#endif
+#ifndef SHADOW_DELTA_KEY_HASH_SIZE
+#define SHADOW_DELTA_KEY_HASH_SIZE 256 ///< Buckets of the hash index of keys registered with aws_iot_shadow_register_delta. Must be a power of two, keep it at least twice the number of registered keys
+#endif
+#ifndef SHADOW_DELTA_MAX_PATH_DEPTH
+#define SHADOW_DELTA_MAX_PATH_DEPTH 8 ///< Deepest object of a delta whose keys are matched. Deeper values are delivered whole to the key that contains them
+#endif
+#ifndef SHADOW_CACHE_MAX_VALUES
+#define SHADOW_CACHE_MAX_VALUES 16 ///< Reported values tracked by a ShadowCache_t
+#endif
+#ifndef SHADOW_CACHE_STORAGE_SIZE
+#define SHADOW_CACHE_STORAGE_SIZE 256 ///< Bytes of a ShadowCache_t holding copies of the values, two per value: the last accepted one and the one in flight
+#endif
+#ifndef SHADOW_COALESCE_MAX_BATCHES
+#define SHADOW_COALESCE_MAX_BATCHES 2 ///< Coalesced updates collecting or waiting for their response at any given time. Updates that find none free are published on their own
+#endif
+#ifndef SHADOW_COALESCE_MAX_CALLERS
+#define SHADOW_COALESCE_MAX_CALLERS 8 ///< Updates merged into one coalesced update, the next one opens another
+#endif
+#ifndef SHADOW_COALESCE_DOCUMENT_SIZE
+#define SHADOW_COALESCE_DOCUMENT_SIZE AWS_IOT_MQTT_TX_BUF_LEN ///< Size of a coalesced update document, clientToken included
+#endif
+#ifndef SHADOW_COALESCE_MAX_TOKENS
+#define SHADOW_COALESCE_MAX_TOKENS 64 ///< Tokens of an update document and of a coalesced document. Larger updates are published on their own
+#endif
 #define MAX_SIZE_OF_THING_NAME 20 ///< The Thing Name should not be bigger than this value. Modify this if the Thing Name needs to be bigger
 #define MAX_SHADOW_TOPIC_LENGTH_BYTES (MAX_SHADOW_TOPIC_LENGTH_WITHOUT_THINGNAME + MAX_SIZE_OF_THING_NAME) ///< This size includes the length of topic with Thing Name
 
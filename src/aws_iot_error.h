@@ -38,6 +38,10 @@ extern "C" {
  * Values greater than 0 are specific non-error return codes
  */
 typedef enum {
+	/** Shadow cache: no reported value changed since the last accepted update, nothing was published */
+			SHADOW_NOTHING_TO_UPDATE = 8,
+	/** Returned when a message larger than the read buffer was delivered in fragments */
+			MQTT_RX_MESSAGE_FRAGMENTED = 7,
 	/** Returned when the Network physical layer is connected */
 			NETWORK_PHYSICAL_LAYER_CONNECTED = 6,
 	/** Returned when the Network is manually disconnected */
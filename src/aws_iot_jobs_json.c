@@ -17,72 +17,22 @@
 extern "C" {
 #endif
 
-#define __STDC_FORMAT_MACROS
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stddef.h>
-#include <stdio.h>
-#include <stdarg.h>
 
 #include "jsmn.h"
 #include "aws_iot_jobs_json.h"
+#include "aws_iot_json_writer.h"
 
-struct _SerializeState {
-	int totalSize;
-	char *nextPtr;
-	size_t remaingSize;
-};
-
-static void _printToBuffer(struct _SerializeState *state, const char *fmt, ...) {
-	if (state->totalSize == -1) return;
-
-	va_list vl;
-	va_start(vl, fmt);
-	int len = vsnprintf(state->nextPtr, state->remaingSize, fmt, vl);
-	if (len < 0) {
-		state->totalSize = -1;
-	} else {
-		state->totalSize += len;
-		if (state->nextPtr != NULL) {
-			if (state->remaingSize > (size_t) len) {
-				state->remaingSize -= (size_t) len;
-				state->nextPtr += len;
-			} else {
-				state->remaingSize = 0;
-				state->nextPtr = NULL;
-			}
-		}
-	}
-	va_end(vl);
-}
-
-static void _printKey(struct _SerializeState *state, bool first, const char *key) {
-	if (first) {
-		_printToBuffer(state, "{\"%s\":", key);
-	} else {
-		_printToBuffer(state, ",\"%s\":", key);
-	}
-}
-
-static void _printStringValue(struct _SerializeState *state, const char *value) {
-	if (value == NULL) {
-		_printToBuffer(state, "null");
-	} else {
-		_printToBuffer(state, "\"%s\"", value);
-	}
+static void _printKey(JsonWriter_t *writer, bool first, const char *key) {
+	jsonWriteChar(writer, first ? '{' : ',');
+	jsonWriteKey(writer, key);
 }
 
-static void _printLongValue(struct _SerializeState *state, int64_t value) {
-	_printToBuffer(state, "%lld", value);
-}
-
-static void _printBooleanValue(struct _SerializeState *state, bool value) {
-	if(value) {
-		_printToBuffer(state, "true");
-	} else {
-		_printToBuffer(state, "false");
-	}
+static int _terminate(JsonWriter_t *writer) {
+	return (int) jsonWriterTerminate(writer);
 }
 
 int aws_iot_jobs_json_serialize_update_job_execution_request(
@@ -91,51 +41,52 @@ int aws_iot_jobs_json_serialize_update_job_execution_request(
 {
 	const char *statusStr = aws_iot_jobs_map_status_to_string(request->status);
 	if (statusStr == NULL) return -1;
-	if (requestBuffer == NULL) bufferSize = 0;
 
-	struct _SerializeState state = { 0, requestBuffer, bufferSize };
-	_printKey(&state, true, "status");
-	_printStringValue(&state, statusStr);
+	JsonWriter_t writer;
+	jsonWriterInit(&writer, requestBuffer, bufferSize);
+	_printKey(&writer, true, "status");
+	jsonWriteString(&writer, statusStr);
 	if (request->statusDetails != NULL) {
-		_printKey(&state, false, "statusDetails");
-		_printToBuffer(&state, "%s", request->statusDetails);
+		_printKey(&writer, false, "statusDetails");
+		jsonWriteText(&writer, request->statusDetails);
 	}
 	if (request->executionNumber != 0) {
-		_printKey(&state, false, "executionNumber");
-		_printLongValue(&state, request->executionNumber);
+		_printKey(&writer, false, "executionNumber");
+		jsonWriteInt(&writer, request->executionNumber);
 	}
 	if (request->expectedVersion != 0) {
-		_printKey(&state, false, "expectedVersion");
-		_printLongValue(&state, request->expectedVersion);
+		_printKey(&writer, false, "expectedVersion");
+		jsonWriteInt(&writer, request->expectedVersion);
 	}
 	if (request->includeJobExecutionState) {
-		_printKey(&state, false, "includeJobExecutionState");
-		_printBooleanValue(&state, request->includeJobExecutionState);
+		_printKey(&writer, false, "includeJobExecutionState");
+		jsonWriteBool(&writer, request->includeJobExecutionState);
 	}
 	if (request->includeJobDocument) {
-		_printKey(&state, false, "includeJobDocument");
-		_printBooleanValue(&state, request->includeJobDocument);
+		_printKey(&writer, false, "includeJobDocument");
+		jsonWriteBool(&writer, request->includeJobDocument);
 	}
 	if (request->clientToken != NULL) {
-		_printKey(&state, false, "clientToken");
-		_printStringValue(&state, request->clientToken);
+		_printKey(&writer, false, "clientToken");
+		jsonWriteString(&writer, request->clientToken);
 	}
 
-	_printToBuffer(&state, "}");
+	jsonWriteChar(&writer, '}');
 
-	return state.totalSize;
+	return _terminate(&writer);
 }
 
 int aws_iot_jobs_json_serialize_client_token_only_request(
 		char *requestBuffer, size_t bufferSize,
 		const char *clientToken)
 {
-	struct _SerializeState state = { 0, requestBuffer, bufferSize };
-	_printKey(&state, true, "clientToken");
-	_printStringValue(&state, clientToken);
-	_printToBuffer(&state, "}");
+	JsonWriter_t writer;
+	jsonWriterInit(&writer, requestBuffer, bufferSize);
+	_printKey(&writer, true, "clientToken");
+	jsonWriteString(&writer, clientToken);
+	jsonWriteChar(&writer, '}');
 
-	return state.totalSize;
+	return _terminate(&writer);
 }
 
 int aws_iot_jobs_json_serialize_describe_job_execution_request(
@@ -144,52 +95,51 @@ int aws_iot_jobs_json_serialize_describe_job_execution_request(
 {
 	bool first = true;
 
-	if (requestBuffer == NULL) return 0;
-
-	struct _SerializeState state = { 0, requestBuffer, bufferSize };
+	JsonWriter_t writer;
+	jsonWriterInit(&writer, requestBuffer, bufferSize);
 	if (request->clientToken != NULL) {
-		_printKey(&state, first, "clientToken");
-		_printStringValue(&state, request->clientToken);
+		_printKey(&writer, first, "clientToken");
+		jsonWriteString(&writer, request->clientToken);
 		first = false;
 	}
 	if (request->executionNumber != 0) {
-		_printKey(&state, first, "executionNumber");
-		_printLongValue(&state, request->executionNumber);
+		_printKey(&writer, first, "executionNumber");
+		jsonWriteInt(&writer, request->executionNumber);
 		first = false;
 	}
 	if (request->includeJobDocument) {
-		_printKey(&state, first, "includeJobDocument");
-		_printBooleanValue(&state, request->includeJobDocument);
+		_printKey(&writer, first, "includeJobDocument");
+		jsonWriteBool(&writer, request->includeJobDocument);
+		first = false;
+	}
+	if (first) {
+		jsonWriteChar(&writer, '{');
 	}
 
-	_printToBuffer(&state, "}");
+	jsonWriteChar(&writer, '}');
 
-	return state.totalSize;
+	return _terminate(&writer);
 }
 
 int aws_iot_jobs_json_serialize_start_next_job_execution_request(
 		char *requestBuffer, size_t bufferSize,
 		const AwsIotStartNextPendingJobExecutionRequest *request)
 {
-	if (requestBuffer == NULL) bufferSize = 0;
-	struct _SerializeState state = { 0, requestBuffer, bufferSize };
+	JsonWriter_t writer;
+	jsonWriterInit(&writer, requestBuffer, bufferSize);
 	if (request->statusDetails != NULL) {
-		_printKey(&state, true, "statusDetails");
-		_printToBuffer(&state, "%s", request->statusDetails);
+		_printKey(&writer, true, "statusDetails");
+		jsonWriteText(&writer, request->statusDetails);
 	}
 	if (request->clientToken != NULL) {
-		if(request->statusDetails != NULL) {
-			_printKey(&state, false, "clientToken");
-		} else {
-			_printKey(&state, true, "clientToken");
-		}
-		_printStringValue(&state, request->clientToken);
+		_printKey(&writer, request->statusDetails == NULL, "clientToken");
+		jsonWriteString(&writer, request->clientToken);
 	}
 	if (request->clientToken == NULL && request->statusDetails == NULL) {
-		_printToBuffer(&state, "{");
+		jsonWriteChar(&writer, '{');
 	}
-	_printToBuffer(&state, "}");
-	return state.totalSize;
+	jsonWriteChar(&writer, '}');
+	return _terminate(&writer);
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,842 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_json_number.c
+ * @brief Conversions between JSON numbers and C numbers
+ *
+ * Parsing takes Clinger's fast path when the digits and the power of ten are
+ * both exact doubles. Otherwise a close approximation is corrected one unit
+ * in the last place at a time, comparing the decimal number with the midpoint
+ * between neighbouring values as big integers.
+ *
+ * Formatting is the free-format algorithm of Steele & White, as refined by
+ * Burger & Dybvig: digits are generated until the number left is within half
+ * a unit in the last place, so they are the shortest that round-trip. Like
+ * Ryu, it needs no printf and no locale, but it trades Ryu's large tables of
+ * powers for small big integers, which suits the flash of the targets.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_json_number.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+/* the largest product compared is a 55 bit midpoint times 10^383, about 1330 bits */
+#define BIG_NUMBER_WORDS 44
+
+/* significant digits compared exactly, later ones only tell that the number is above the kept ones */
+#define EXACT_DIGITS 40
+
+/* digits of a uint64_t that never overflow */
+#define MANTISSA_DIGITS 19
+
+/* decimal magnitudes beyond which every double is infinite or zero */
+#define MAX_DECIMAL_MAGNITUDE 310
+#define MIN_DECIMAL_MAGNITUDE (-343)
+
+/* magnitudes written without an exponent, as JavaScript writes them */
+#define MAX_FIXED_POINT 21
+#define MIN_FIXED_POINT (-6)
+
+typedef struct {
+	uint32_t words[BIG_NUMBER_WORDS];	/* least significant first */
+	uint16_t length;					/* words in use, the highest one is not 0 */
+} BigNumber_t;
+
+/* IEEE 754 binary format */
+typedef struct {
+	uint8_t mantissaBits;	/* hidden bit included */
+	int16_t minExponent;	/* exponent of the lowest mantissa bit of a subnormal */
+	int16_t maxExponent;	/* exponent of the lowest mantissa bit of the largest finite value */
+} FloatFormat_t;
+
+static const FloatFormat_t doubleFormat = {53, -1074, 971};
+static const FloatFormat_t floatFormat = {24, -149, 104};
+
+/* mantissa * 2^exponent, an exponent above the format's maximum is an infinity */
+typedef struct {
+	uint64_t mantissa;
+	int32_t exponent;
+} BinaryNumber_t;
+
+/* significant digits * 10^exponent, the digits without leading or trailing zeros */
+typedef struct {
+	const char *pInteger;		/* integer part digits */
+	const char *pFraction;		/* fraction digits */
+	uint32_t integerLength;
+	uint32_t fractionLength;
+	uint32_t firstDigit;		/* index of the first significant digit, integer then fraction digits */
+	uint32_t digitCount;		/* significant digits, 0 for zero */
+	int32_t exponent;
+	uint64_t mantissa;			/* the first MANTISSA_DIGITS significant digits */
+	bool isNegative;
+} DecimalNumber_t;
+
+static const double exactPowersOfTen[] = {1e0,	1e1,  1e2,	1e3,  1e4,	1e5,  1e6,	1e7,  1e8,	1e9,  1e10, 1e11,
+										  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const uint32_t powersOfFive[] = {1,		  5,		 25,		125,	   625,		  3125,		15625,
+										78125,	  390625,	 1953125,	9765625,   48828125,  244140625, 1220703125};
+
+#define MAX_EXACT_POWER_OF_TEN 22
+#define MAX_POWER_OF_FIVE 13
+#define DOUBLE_EXACT_INTEGER ((uint64_t) 1 << 53)
+#define FIXED_DIGITS_LIMIT ((uint64_t) 1 << 50)
+
+static void bigFromUint64(BigNumber_t *pNumber, uint64_t value) {
+	pNumber->words[0] = (uint32_t) value;
+	pNumber->words[1] = (uint32_t) (value >> 32);
+	pNumber->length = (0 != pNumber->words[1]) ? 2 : ((0 != pNumber->words[0]) ? 1 : 0);
+}
+
+/* number = number * factor + addend, factor is not 0 */
+static void bigMultiplyAdd(BigNumber_t *pNumber, uint32_t factor, uint32_t addend) {
+	uint64_t carry = addend;
+	uint16_t i;
+
+	for(i = 0; i < pNumber->length; i++) {
+		carry += (uint64_t) pNumber->words[i] * factor;
+		pNumber->words[i] = (uint32_t) carry;
+		carry >>= 32;
+	}
+	if(0 != carry && pNumber->length < BIG_NUMBER_WORDS) {
+		pNumber->words[pNumber->length++] = (uint32_t) carry;
+	}
+}
+
+static void bigShiftLeft(BigNumber_t *pNumber, uint32_t bits) {
+	uint16_t wordShift = (uint16_t) (bits / 32);
+	uint32_t bitShift = bits % 32;
+	int32_t i;
+
+	if(0 == pNumber->length) {
+		return;
+	}
+
+	if(0 == bitShift) {
+		for(i = pNumber->length - 1; i >= 0; i--) {
+			pNumber->words[i + wordShift] = pNumber->words[i];
+		}
+	} else {
+		pNumber->words[pNumber->length + wordShift] = 0;
+		for(i = pNumber->length - 1; i >= 0; i--) {
+			pNumber->words[i + wordShift + 1] |= pNumber->words[i] >> (32 - bitShift);
+			pNumber->words[i + wordShift] = pNumber->words[i] << bitShift;
+		}
+		pNumber->length++;
+	}
+	memset(pNumber->words, 0, wordShift * sizeof(pNumber->words[0]));
+	pNumber->length = (uint16_t) (pNumber->length + wordShift);
+	if(0 == pNumber->words[pNumber->length - 1]) {
+		pNumber->length--;
+	}
+}
+
+/* 10^n is 5^n * 2^n, the powers of five fit in a word 13 at a time */
+static void bigMultiplyPow10(BigNumber_t *pNumber, uint32_t exponent) {
+	uint32_t remaining = exponent;
+
+	for(; remaining >= MAX_POWER_OF_FIVE; remaining -= MAX_POWER_OF_FIVE) {
+		bigMultiplyAdd(pNumber, powersOfFive[MAX_POWER_OF_FIVE], 0);
+	}
+	if(0 != remaining) {
+		bigMultiplyAdd(pNumber, powersOfFive[remaining], 0);
+	}
+	bigShiftLeft(pNumber, exponent);
+}
+
+static int bigCompare(const BigNumber_t *pA, const BigNumber_t *pB) {
+	int32_t i;
+
+	if(pA->length != pB->length) {
+		return (pA->length > pB->length) ? 1 : -1;
+	}
+	for(i = pA->length - 1; i >= 0; i--) {
+		if(pA->words[i] != pB->words[i]) {
+			return (pA->words[i] > pB->words[i]) ? 1 : -1;
+		}
+	}
+	return 0;
+}
+
+/* pSum may be one of the operands */
+static void bigAdd(BigNumber_t *pSum, const BigNumber_t *pA, const BigNumber_t *pB) {
+	const BigNumber_t *pLong = (pA->length >= pB->length) ? pA : pB;
+	const BigNumber_t *pShort = (pLong == pA) ? pB : pA;
+	uint64_t carry = 0;
+	uint16_t i;
+
+	for(i = 0; i < pLong->length; i++) {
+		carry += pLong->words[i];
+		if(i < pShort->length) {
+			carry += pShort->words[i];
+		}
+		pSum->words[i] = (uint32_t) carry;
+		carry >>= 32;
+	}
+	pSum->length = pLong->length;
+	if(0 != carry && pSum->length < BIG_NUMBER_WORDS) {
+		pSum->words[pSum->length++] = (uint32_t) carry;
+	}
+}
+
+/* number = number - subtrahend, the subtrahend is not larger */
+static void bigSubtract(BigNumber_t *pNumber, const BigNumber_t *pSubtrahend) {
+	uint32_t borrow = 0;
+	uint64_t subtracted;
+	uint32_t word;
+	uint16_t i;
+
+	for(i = 0; i < pNumber->length; i++) {
+		subtracted = (uint64_t) ((i < pSubtrahend->length) ? pSubtrahend->words[i] : 0) + borrow;
+		word = pNumber->words[i];
+		pNumber->words[i] = word - (uint32_t) subtracted;
+		borrow = ((uint64_t) word < subtracted) ? 1 : 0;
+	}
+	while(pNumber->length > 0 && 0 == pNumber->words[pNumber->length - 1]) {
+		pNumber->length--;
+	}
+}
+
+static bool isDigit(char c) {
+	return '0' <= c && c <= '9';
+}
+
+static uint32_t scanDigits(const char **ppText, const char *pEnd) {
+	const char *pStart = *ppText;
+
+	while(*ppText < pEnd && isDigit(**ppText)) {
+		(*ppText)++;
+	}
+	return (uint32_t) (*ppText - pStart);
+}
+
+static char digitAt(const DecimalNumber_t *pNumber, uint32_t index) {
+	if(index < pNumber->integerLength) {
+		return pNumber->pInteger[index];
+	}
+	return pNumber->pFraction[index - pNumber->integerLength];
+}
+
+/* -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? and nothing else */
+static bool scanNumber(const char *pText, size_t length, DecimalNumber_t *pNumber) {
+	const char *pEnd = pText + length;
+	int32_t exponent = 0;
+	bool isExponentNegative = false;
+	uint32_t first;
+	uint32_t last;
+	uint32_t i;
+
+	pNumber->isNegative = (pText < pEnd && '-' == *pText);
+	if(pNumber->isNegative) {
+		pText++;
+	}
+
+	pNumber->pInteger = pText;
+	pNumber->integerLength = scanDigits(&pText, pEnd);
+	if(0 == pNumber->integerLength || ('0' == pNumber->pInteger[0] && pNumber->integerLength > 1)) {
+		return false;
+	}
+
+	pNumber->pFraction = pText;
+	pNumber->fractionLength = 0;
+	if(pText < pEnd && '.' == *pText) {
+		pText++;
+		pNumber->pFraction = pText;
+		pNumber->fractionLength = scanDigits(&pText, pEnd);
+		if(0 == pNumber->fractionLength) {
+			return false;
+		}
+	}
+
+	if(pText < pEnd && ('e' == *pText || 'E' == *pText)) {
+		pText++;
+		if(pText < pEnd && ('+' == *pText || '-' == *pText)) {
+			isExponentNegative = ('-' == *pText);
+			pText++;
+		}
+		if(pText == pEnd || !isDigit(*pText)) {
+			return false;
+		}
+		for(; pText < pEnd && isDigit(*pText); pText++) {
+			/* far beyond any double already, stop before the exponent overflows */
+			if(exponent < 100000) {
+				exponent = exponent * 10 + (*pText - '0');
+			}
+		}
+	}
+
+	if(pText != pEnd) {
+		return false;
+	}
+
+	last = pNumber->integerLength + pNumber->fractionLength;
+	for(first = 0; first < last && '0' == digitAt(pNumber, first); first++) {
+	}
+	while(last > first && '0' == digitAt(pNumber, last - 1)) {
+		last--;
+	}
+	pNumber->firstDigit = first;
+	pNumber->digitCount = last - first;
+	pNumber->exponent = (isExponentNegative ? -exponent : exponent) + (int32_t) pNumber->integerLength - (int32_t) last;
+
+	pNumber->mantissa = 0;
+	for(i = first; i < last && i < first + MANTISSA_DIGITS; i++) {
+		pNumber->mantissa = pNumber->mantissa * 10 + (uint64_t) (digitAt(pNumber, i) - '0');
+	}
+	return true;
+}
+
+IoT_Error_t jsonNumberParseInteger(const char *pText, size_t length, int64_t minimum, int64_t maximum,
+								   int64_t *pValue) {
+	DecimalNumber_t number;
+	uint64_t magnitude;
+	int64_t value;
+	int32_t i;
+
+	if(!scanNumber(pText, length, &number)) {
+		return JSON_PARSE_ERROR;
+	}
+
+	magnitude = 0;
+	if(0 != number.digitCount) {
+		/* a fraction is left, or more digits than 19 that cannot fit an int64_t */
+		if(number.exponent < 0 || number.digitCount + (uint32_t) number.exponent > MANTISSA_DIGITS) {
+			return JSON_PARSE_ERROR;
+		}
+		magnitude = number.mantissa;
+		for(i = 0; i < number.exponent; i++) {
+			magnitude *= 10;
+		}
+	}
+
+	if(number.isNegative) {
+		if(magnitude > (uint64_t) INT64_MAX + 1) {
+			return JSON_PARSE_ERROR;
+		}
+		value = (0 == magnitude) ? 0 : -(int64_t) (magnitude - 1) - 1;
+	} else {
+		if(magnitude > (uint64_t) INT64_MAX) {
+			return JSON_PARSE_ERROR;
+		}
+		value = (int64_t) magnitude;
+	}
+
+	if(value < minimum || value > maximum) {
+		return JSON_PARSE_ERROR;
+	}
+	*pValue = value;
+	return SUCCESS;
+}
+
+static uint64_t doubleBits(double value) {
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static uint32_t floatBits(float value) {
+	uint32_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/* bits of a positive value, without the sign */
+static void toBinary(uint64_t bits, const FloatFormat_t *pFormat, BinaryNumber_t *pNumber) {
+	uint64_t hiddenBit = (uint64_t) 1 << (pFormat->mantissaBits - 1);
+	uint32_t biasedExponent = (uint32_t) (bits >> (pFormat->mantissaBits - 1));
+
+	pNumber->mantissa = bits & (hiddenBit - 1);
+	if(0 == biasedExponent) {
+		pNumber->exponent = pFormat->minExponent;
+	} else {
+		pNumber->mantissa |= hiddenBit;
+		pNumber->exponent = (int32_t) biasedExponent + pFormat->minExponent - 1;
+	}
+}
+
+static uint64_t fromBinary(const BinaryNumber_t *pNumber, const FloatFormat_t *pFormat) {
+	uint64_t hiddenBit = (uint64_t) 1 << (pFormat->mantissaBits - 1);
+	uint64_t biasedExponent = 0;
+
+	if(pNumber->mantissa >= hiddenBit) {
+		biasedExponent = (uint64_t) (pNumber->exponent - pFormat->minExponent + 1);
+	}
+	return (biasedExponent << (pFormat->mantissaBits - 1)) | (pNumber->mantissa & (hiddenBit - 1));
+}
+
+static void nextUp(BinaryNumber_t *pNumber, const FloatFormat_t *pFormat) {
+	pNumber->mantissa++;
+	if(pNumber->mantissa == (uint64_t) 1 << pFormat->mantissaBits) {
+		pNumber->mantissa >>= 1;
+		pNumber->exponent++;
+	}
+}
+
+static void nextDown(BinaryNumber_t *pNumber, const FloatFormat_t *pFormat) {
+	if(pNumber->mantissa == (uint64_t) 1 << (pFormat->mantissaBits - 1) && pNumber->exponent > pFormat->minExponent) {
+		pNumber->mantissa = ((uint64_t) 1 << pFormat->mantissaBits) - 1;
+		pNumber->exponent--;
+	} else {
+		pNumber->mantissa--;
+	}
+}
+
+/* exact when the digits and the power of ten are exact doubles, the product or quotient is then rounded once */
+static bool parseExactDouble(const DecimalNumber_t *pNumber, double *pValue) {
+	uint64_t mantissa = pNumber->mantissa;
+	int32_t exponent = pNumber->exponent;
+
+	if(pNumber->digitCount > MANTISSA_DIGITS || mantissa > DOUBLE_EXACT_INTEGER) {
+		return false;
+	}
+	/* 12e25 is 12000e22 */
+	while(exponent > MAX_EXACT_POWER_OF_TEN && mantissa <= DOUBLE_EXACT_INTEGER / 10) {
+		mantissa *= 10;
+		exponent--;
+	}
+	if(exponent > MAX_EXACT_POWER_OF_TEN || exponent < -MAX_EXACT_POWER_OF_TEN) {
+		return false;
+	}
+
+	if(exponent >= 0) {
+		*pValue = (double) mantissa * exactPowersOfTen[exponent];
+	} else {
+		*pValue = (double) mantissa / exactPowersOfTen[-exponent];
+	}
+	return true;
+}
+
+/* within a few units in the last place, the powers of ten above 1e22 are rounded */
+static double approximateDouble(const DecimalNumber_t *pNumber) {
+	double value = (double) pNumber->mantissa;
+	int32_t exponent = pNumber->exponent;
+	bool isTiny;
+
+	if(pNumber->digitCount > MANTISSA_DIGITS) {
+		exponent += (int32_t) (pNumber->digitCount - MANTISSA_DIGITS);
+	}
+	/* subnormal intermediate results would lose most of the digits, they are scaled once at the end */
+	isTiny = exponent < -300;
+	if(isTiny) {
+		exponent += 300;
+	}
+	for(; exponent > MAX_EXACT_POWER_OF_TEN; exponent -= MAX_EXACT_POWER_OF_TEN) {
+		value *= exactPowersOfTen[MAX_EXACT_POWER_OF_TEN];
+	}
+	for(; exponent < -MAX_EXACT_POWER_OF_TEN; exponent += MAX_EXACT_POWER_OF_TEN) {
+		value /= exactPowersOfTen[MAX_EXACT_POWER_OF_TEN];
+	}
+	value = (exponent >= 0) ? value * exactPowersOfTen[exponent] : value / exactPowersOfTen[-exponent];
+	return isTiny ? value * 1e-300 : value;
+}
+
+/* compares digits * 10^exponent with the midpoint of two neighbours, as integers */
+static int compareToMidpoint(const BigNumber_t *pDigits, int32_t exponent, bool isTruncated,
+							 const BinaryNumber_t *pLower, const BinaryNumber_t *pUpper) {
+	BigNumber_t decimal = *pDigits;
+	BigNumber_t midpoint;
+	int32_t binaryExponent = (pLower->exponent < pUpper->exponent) ? pLower->exponent : pUpper->exponent;
+	int comparison;
+
+	/* the neighbours are at most one binary exponent apart, midpoint = sum * 2^(binaryExponent - 1) */
+	bigFromUint64(&midpoint, (pLower->mantissa << (pLower->exponent - binaryExponent))
+								 + (pUpper->mantissa << (pUpper->exponent - binaryExponent)));
+	binaryExponent--;
+
+	if(exponent >= 0) {
+		bigMultiplyPow10(&decimal, (uint32_t) exponent);
+	} else {
+		bigMultiplyPow10(&midpoint, (uint32_t) -exponent);
+	}
+	if(binaryExponent >= 0) {
+		bigShiftLeft(&midpoint, (uint32_t) binaryExponent);
+	} else {
+		bigShiftLeft(&decimal, (uint32_t) -binaryExponent);
+	}
+
+	comparison = bigCompare(&decimal, &midpoint);
+	return (0 == comparison && isTruncated) ? 1 : comparison;
+}
+
+/* the nearest value of the format, ties to even, starting from an approximation */
+static void parseSlow(const DecimalNumber_t *pNumber, const FloatFormat_t *pFormat, BinaryNumber_t *pValue) {
+	BigNumber_t digits;
+	BinaryNumber_t neighbour;
+	uint32_t count = (pNumber->digitCount < EXACT_DIGITS) ? pNumber->digitCount : EXACT_DIGITS;
+	int32_t exponent = pNumber->exponent + (int32_t) (pNumber->digitCount - count);
+	bool isTruncated = count < pNumber->digitCount;
+	uint32_t i;
+	int comparison;
+
+	bigFromUint64(&digits, 0);
+	for(i = pNumber->firstDigit; i < pNumber->firstDigit + count; i++) {
+		bigMultiplyAdd(&digits, 10, (uint32_t) (digitAt(pNumber, i) - '0'));
+	}
+
+	while(pValue->exponent <= pFormat->maxExponent) {
+		neighbour = *pValue;
+		nextUp(&neighbour, pFormat);
+		comparison = compareToMidpoint(&digits, exponent, isTruncated, pValue, &neighbour);
+		if(comparison > 0 || (0 == comparison && 0 != (pValue->mantissa & 1))) {
+			*pValue = neighbour;
+			continue;
+		}
+		if(0 == pValue->mantissa) {
+			break;
+		}
+		neighbour = *pValue;
+		nextDown(&neighbour, pFormat);
+		comparison = compareToMidpoint(&digits, exponent, isTruncated, &neighbour, pValue);
+		if(comparison < 0 || (0 == comparison && 0 != (pValue->mantissa & 1))) {
+			*pValue = neighbour;
+			continue;
+		}
+		break;
+	}
+}
+
+/* starts from the bits of an approximation of the magnitude, returns the bits of the nearest value */
+static uint64_t parseBinary(const DecimalNumber_t *pNumber, const FloatFormat_t *pFormat, uint64_t approximation) {
+	BinaryNumber_t value;
+	int32_t magnitude = pNumber->exponent + (int32_t) pNumber->digitCount;
+
+	if(magnitude > MAX_DECIMAL_MAGNITUDE) {
+		value.mantissa = (uint64_t) 1 << (pFormat->mantissaBits - 1);
+		value.exponent = pFormat->maxExponent + 1;
+		return fromBinary(&value, pFormat);
+	}
+	if(magnitude < MIN_DECIMAL_MAGNITUDE) {
+		return 0;
+	}
+
+	toBinary(approximation, pFormat, &value);
+	if(value.exponent > pFormat->maxExponent) {
+		value.mantissa = ((uint64_t) 1 << pFormat->mantissaBits) - 1;
+		value.exponent = pFormat->maxExponent;
+	} else if(0 == value.mantissa) {
+		value.mantissa = 1;
+	}
+	parseSlow(pNumber, pFormat, &value);
+	return fromBinary(&value, pFormat);
+}
+
+IoT_Error_t jsonNumberParseDouble(const char *pText, size_t length, double *pValue) {
+	DecimalNumber_t number;
+	uint64_t bits;
+	double value = 0.0;
+
+	if(!scanNumber(pText, length, &number)) {
+		return JSON_PARSE_ERROR;
+	}
+
+	if(0 != number.digitCount && !parseExactDouble(&number, &value)) {
+		bits = parseBinary(&number, &doubleFormat, doubleBits(approximateDouble(&number)));
+		memcpy(&value, &bits, sizeof(value));
+	}
+	*pValue = number.isNegative ? -value : value;
+	return SUCCESS;
+}
+
+/* a double exactly halfway between two floats, it may have been rounded there */
+static bool isFloatMidpoint(double value) {
+	return 0x10000000 == (doubleBits(value) & 0x1FFFFFFF);
+}
+
+IoT_Error_t jsonNumberParseFloat(const char *pText, size_t length, float *pValue) {
+	DecimalNumber_t number;
+	uint32_t bits;
+	double wide;
+	float value = 0.0f;
+
+	if(!scanNumber(pText, length, &number)) {
+		return JSON_PARSE_ERROR;
+	}
+
+	if(0 != number.digitCount) {
+		/* the exact double is between 1e-22 and 1e38, rounding it again is right unless it is a float midpoint */
+		if(parseExactDouble(&number, &wide) && !isFloatMidpoint(wide)) {
+			value = (float) wide;
+		} else {
+			bits = (uint32_t) parseBinary(&number, &floatFormat, floatBits((float) approximateDouble(&number)));
+			memcpy(&value, &bits, sizeof(value));
+		}
+	}
+	*pValue = number.isNegative ? -value : value;
+	return SUCCESS;
+}
+
+static uint32_t bitLength(uint64_t value) {
+	uint32_t length = 0;
+
+	for(; 0 != value; value >>= 1) {
+		length++;
+	}
+	return length;
+}
+
+/* floor(e * log10(2)), 78913 / 2^18 is close enough for the exponents of a double */
+static int32_t floorLog10Pow2(int32_t exponent) {
+	if(exponent >= 0) {
+		return (int32_t) (((uint32_t) exponent * 78913) >> 18);
+	}
+	return -(int32_t) ((((uint32_t) -exponent * 78913) >> 18) + 1);
+}
+
+/*
+ * Shortest digits of a positive value, which is 0.digits * 10^point. The value
+ * is r / s, the neighbours are half-way at r - m and r + m (or r + 2m when the
+ * value is a power of two and the gap below is half the gap above), all
+ * scaled by the same power of ten as the digits are produced.
+ */
+static uint32_t shortestDigits(const BinaryNumber_t *pValue, const FloatFormat_t *pFormat, char *pDigits,
+							   int32_t *pPoint) {
+	BigNumber_t r;
+	BigNumber_t s;
+	BigNumber_t margin;
+	BigNumber_t high;
+	bool isEven = (0 == (pValue->mantissa & 1));
+	bool isUnequalGap = pValue->mantissa == (uint64_t) 1 << (pFormat->mantissaBits - 1)
+						&& pValue->exponent > pFormat->minExponent;
+	bool isLow;
+	bool isHigh;
+	int32_t point;
+	uint32_t count = 0;
+	uint32_t digit;
+	int comparison;
+
+	bigFromUint64(&r, pValue->mantissa);
+	bigShiftLeft(&r, isUnequalGap ? 2 : 1);
+	bigFromUint64(&s, isUnequalGap ? 4 : 2);
+	bigFromUint64(&margin, 1);
+	if(pValue->exponent >= 0) {
+		bigShiftLeft(&r, (uint32_t) pValue->exponent);
+		bigShiftLeft(&margin, (uint32_t) pValue->exponent);
+	} else {
+		bigShiftLeft(&s, (uint32_t) -pValue->exponent);
+	}
+
+	/* an estimate never above the decimal point, raised until the upper neighbour is below 1 */
+	point = floorLog10Pow2(pValue->exponent + (int32_t) bitLength(pValue->mantissa) - 1);
+	if(point >= 0) {
+		bigMultiplyPow10(&s, (uint32_t) point);
+	} else {
+		bigMultiplyPow10(&r, (uint32_t) -point);
+		bigMultiplyPow10(&margin, (uint32_t) -point);
+	}
+	for(;;) {
+		bigAdd(&high, &r, &margin);
+		if(isUnequalGap) {
+			bigAdd(&high, &high, &margin);
+		}
+		comparison = bigCompare(&high, &s);
+		if(comparison < 0 || (0 == comparison && !isEven)) {
+			break;
+		}
+		bigMultiplyAdd(&s, 10, 0);
+		point++;
+	}
+
+	do {
+		bigMultiplyAdd(&r, 10, 0);
+		bigMultiplyAdd(&margin, 10, 0);
+		for(digit = 0; bigCompare(&r, &s) >= 0; digit++) {
+			bigSubtract(&r, &s);
+		}
+
+		comparison = bigCompare(&r, &margin);
+		isLow = comparison < 0 || (0 == comparison && isEven);
+		bigAdd(&high, &r, &margin);
+		if(isUnequalGap) {
+			bigAdd(&high, &high, &margin);
+		}
+		comparison = bigCompare(&high, &s);
+		isHigh = comparison > 0 || (0 == comparison && isEven);
+
+		/* both neighbours are in reach on the last digit, the nearer one wins */
+		if(isLow && isHigh) {
+			bigShiftLeft(&r, 1);
+			if(bigCompare(&r, &s) >= 0) {
+				digit++;
+			}
+		} else if(isHigh) {
+			digit++;
+		}
+		pDigits[count++] = (char) ('0' + digit);
+	} while(!isLow && !isHigh);
+
+	*pPoint = point;
+	return count;
+}
+
+static size_t writeUnsigned(char *pText, uint64_t value) {
+	char digits[20];
+	size_t count = 0;
+	size_t length = 0;
+
+	do {
+		digits[count++] = (char) ('0' + (value % 10));
+		value /= 10;
+	} while(0 != value);
+	while(count > 0) {
+		pText[length++] = digits[--count];
+	}
+	return length;
+}
+
+static size_t writeZeros(char *pText, int32_t count) {
+	int32_t i;
+
+	for(i = 0; i < count; i++) {
+		pText[i] = '0';
+	}
+	return (size_t) ((count > 0) ? count : 0);
+}
+
+/* 0.digits * 10^point, written like JavaScript writes numbers */
+static size_t writeDigits(char *pText, const char *pDigits, uint32_t count, int32_t point) {
+	size_t length = 0;
+
+	if((int32_t) count <= point && point <= MAX_FIXED_POINT) {
+		memcpy(pText, pDigits, count);
+		length = count;
+		length += writeZeros(pText + length, point - (int32_t) count);
+	} else if(0 < point && point <= MAX_FIXED_POINT) {
+		memcpy(pText, pDigits, (size_t) point);
+		length = (size_t) point;
+		pText[length++] = '.';
+		memcpy(pText + length, pDigits + point, count - (uint32_t) point);
+		length += count - (uint32_t) point;
+	} else if(MIN_FIXED_POINT < point && point <= 0) {
+		pText[length++] = '0';
+		pText[length++] = '.';
+		length += writeZeros(pText + length, -point);
+		memcpy(pText + length, pDigits, count);
+		length += count;
+	} else {
+		pText[length++] = pDigits[0];
+		if(count > 1) {
+			pText[length++] = '.';
+			memcpy(pText + length, pDigits + 1, count - 1);
+			length += count - 1;
+		}
+		pText[length++] = 'e';
+		if(point - 1 < 0) {
+			pText[length++] = '-';
+		}
+		length += writeUnsigned(pText + length, (uint64_t) ((point - 1 < 0) ? 1 - point : point - 1));
+	}
+	return length;
+}
+
+/*
+ * Most values have few decimals: the first count of decimals whose rounded
+ * integer divides back to the value exactly gives its shortest digits. The
+ * integer and the power of ten are exact, so the division rounds like a
+ * reader does. Kept below 2^50, the scaled value is too close to the exact
+ * product to miss the integer. A float is read through the same double
+ * unless that double is halfway between two floats.
+ */
+static bool fixedDigits(double magnitude, const FloatFormat_t *pFormat, uint64_t *pInteger, int32_t *pDecimals) {
+	double scaled;
+	double quotient;
+	uint64_t integer;
+	int32_t decimals;
+
+	/* from there on a value may have shorter digits with trailing zeros */
+	if(magnitude >= (double) ((uint64_t) 1 << (pFormat->mantissaBits - 1))) {
+		return false;
+	}
+	for(decimals = 0; decimals <= MAX_EXACT_POWER_OF_TEN; decimals++) {
+		scaled = magnitude * exactPowersOfTen[decimals];
+		if(scaled >= (double) FIXED_DIGITS_LIMIT) {
+			return false;
+		}
+		integer = (uint64_t) (scaled + 0.5);
+		quotient = (double) integer / exactPowersOfTen[decimals];
+		if(&floatFormat == pFormat ? (!isFloatMidpoint(quotient) && (float) quotient == (float) magnitude)
+								   : quotient == magnitude) {
+			*pInteger = integer;
+			*pDecimals = decimals;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* bits and magnitude of a value without its sign */
+static size_t formatBinary(char *pText, bool isNegative, uint64_t bits, double magnitude,
+						   const FloatFormat_t *pFormat) {
+	BinaryNumber_t value;
+	char digits[20];
+	uint64_t integer;
+	int32_t decimals;
+	uint32_t count;
+	int32_t point;
+	size_t length = 0;
+
+	/* JSON has no infinity or NaN */
+	toBinary(bits, pFormat, &value);
+	if(value.exponent > pFormat->maxExponent) {
+		memcpy(pText, "null", 5);
+		return 4;
+	}
+
+	if(isNegative) {
+		pText[length++] = '-';
+	}
+	if(0 == value.mantissa) {
+		pText[length++] = '0';
+	} else {
+		if(fixedDigits(magnitude, pFormat, &integer, &decimals)) {
+			count = (uint32_t) writeUnsigned(digits, integer);
+			point = (int32_t) count - decimals;
+			while('0' == digits[count - 1]) {
+				count--;
+			}
+		} else {
+			count = shortestDigits(&value, pFormat, digits, &point);
+		}
+		length += writeDigits(pText + length, digits, count, point);
+	}
+	pText[length] = '\0';
+	return length;
+}
+
+size_t jsonNumberFormatDouble(char *pText, double value) {
+	uint64_t bits = doubleBits(value);
+	bool isNegative = (0 != (bits >> 63));
+
+	return formatBinary(pText, isNegative, bits & ~((uint64_t) 1 << 63), isNegative ? -value : value, &doubleFormat);
+}
+
+size_t jsonNumberFormatFloat(char *pText, float value) {
+	uint32_t bits = floatBits(value);
+	bool isNegative = (0 != (bits >> 31));
+
+	return formatBinary(pText, isNegative, bits & ~((uint32_t) 1 << 31), isNegative ? -(double) value : value,
+						&floatFormat);
+}
+
+#ifdef __cplusplus
+}
+#endif
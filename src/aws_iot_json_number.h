@@ -0,0 +1,121 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_json_number.h
+ * @brief Conversions between JSON numbers and C numbers
+ *
+ * sscanf and printf are slow on the newlib targets, pull floating point
+ * formatting code into the image and depend on the locale. These functions
+ * read exactly the characters of a JSON number, nothing before or after it,
+ * and need no terminating null.
+ *
+ * Integers are range checked instead of wrapping around. Floating point
+ * values are correctly rounded: most numbers take an exact fast path, the
+ * others are settled by comparing big integers. Past 40 significant digits,
+ * far more than any serializer writes, the remaining digits only count as
+ * not zero, which could misround a number that close to a midpoint.
+ *
+ * Formatting prints the shortest digits that read back as the same value,
+ * so 0.1 is written as 0.1 and a float is printed with the digits a float
+ * needs.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_JSON_NUMBER_H_
+#define AWS_IOT_SDK_SRC_JSON_NUMBER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "aws_iot_error.h"
+
+/**
+ * @brief Size of a buffer holding any formatted number, terminating null included
+ */
+#define JSON_NUMBER_TEXT_SIZE 32
+
+/**
+ * @brief Parse a JSON number that must be an integer within the given range
+ *
+ * A fraction or exponent is accepted when the value is still an integer,
+ * e.g. 2.0 or 1e3.
+ *
+ * @param pText First character of the number
+ * @param length Length of the number
+ * @param minimum Smallest accepted value
+ * @param maximum Largest accepted value
+ * @param pValue Receives the value
+ *
+ * @return SUCCESS, or JSON_PARSE_ERROR if the text is not a JSON integer or it is out of range
+ */
+IoT_Error_t jsonNumberParseInteger(const char *pText, size_t length, int64_t minimum, int64_t maximum,
+								   int64_t *pValue);
+
+/**
+ * @brief Parse a JSON number into the nearest double
+ *
+ * @param pText First character of the number
+ * @param length Length of the number
+ * @param pValue Receives the value, an infinity if it is too large for a double
+ *
+ * @return SUCCESS, or JSON_PARSE_ERROR if the text is not a JSON number
+ */
+IoT_Error_t jsonNumberParseDouble(const char *pText, size_t length, double *pValue);
+
+/**
+ * @brief Parse a JSON number into the nearest float
+ *
+ * The number is rounded once, straight to a float, not through a double.
+ *
+ * @param pText First character of the number
+ * @param length Length of the number
+ * @param pValue Receives the value, an infinity if it is too large for a float
+ *
+ * @return SUCCESS, or JSON_PARSE_ERROR if the text is not a JSON number
+ */
+IoT_Error_t jsonNumberParseFloat(const char *pText, size_t length, float *pValue);
+
+/**
+ * @brief Format a double with the fewest digits that parse back to it
+ *
+ * Magnitudes from 1e-6 to 1e21 are written without an exponent, like
+ * JavaScript does. JSON has no infinity or NaN, they are written as null.
+ *
+ * @param pText Receives the number, at least JSON_NUMBER_TEXT_SIZE bytes
+ * @param value Value to format
+ *
+ * @return size_t Length of the text, the terminating null excluded
+ */
+size_t jsonNumberFormatDouble(char *pText, double value);
+
+/**
+ * @brief Format a float with the fewest digits that parse back to it as a float
+ *
+ * @param pText Receives the number, at least JSON_NUMBER_TEXT_SIZE bytes
+ * @param value Value to format
+ *
+ * @return size_t Length of the text, the terminating null excluded
+ */
+size_t jsonNumberFormatFloat(char *pText, float value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AWS_IOT_SDK_SRC_JSON_NUMBER_H_
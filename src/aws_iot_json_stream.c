@@ -0,0 +1,290 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_json_stream.c
+ * @brief Incremental JSON tokenizer
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_json_stream.h"
+
+#include <string.h>
+
+enum {
+	STREAM_VALUE,			/* a value is expected */
+	STREAM_ARRAY_FIRST,		/* a value or the end of an empty array */
+	STREAM_KEY_FIRST,		/* a key or the end of an empty object */
+	STREAM_KEY,				/* a key, after a comma */
+	STREAM_KEY_STRING,
+	STREAM_KEY_ESCAPE,
+	STREAM_COLON,
+	STREAM_STRING,
+	STREAM_STRING_ESCAPE,
+	STREAM_PRIMITIVE,
+	STREAM_AFTER_VALUE,		/* a comma or the end of the container */
+	STREAM_DONE,
+	STREAM_ERROR
+};
+
+static bool isBlank(char c) {
+	return ' ' == c || '\t' == c || '\r' == c || '\n' == c;
+}
+
+/* every byte of a captured value is copied, nested values are found inside it */
+static void captureChar(JsonStream_t *pStream, char c) {
+	if(0 == pStream->openCaptures) {
+		return;
+	}
+	if(pStream->captureLen < pStream->captureSize) {
+		pStream->pCapture[pStream->captureLen++] = c;
+	} else {
+		pStream->isCaptureFull = true;
+	}
+}
+
+/* the value at the current depth is complete, end is its end offset in the capture buffer */
+static void endValue(JsonStream_t *pStream, jsmntype_t type, size_t end) {
+	uint16_t depth = pStream->depth;
+
+	pStream->state = (0 == depth) ? STREAM_DONE : STREAM_AFTER_VALUE;
+	if(pStream->captureStarts[depth] < 0) {
+		return;
+	}
+
+	memset(&pStream->valueToken, 0, sizeof(pStream->valueToken));
+	pStream->valueToken.type = type;
+	pStream->valueToken.start = (int) pStream->captureStarts[depth];
+	pStream->valueToken.end = (int) end;
+	pStream->isValueTruncated = pStream->isCaptureFull;
+	pStream->captureStarts[depth] = -1;
+	pStream->openCaptures--;
+	if(0 == pStream->openCaptures) {
+		/* each captured value is null-terminated, for handlers that read it as a C string */
+		if(pStream->captureLen < pStream->captureSize) {
+			pStream->pCapture[pStream->captureLen++] = '\0';
+		} else {
+			pStream->isCaptureFull = true;
+			pStream->isValueTruncated = true;
+		}
+	}
+	pStream->handler(pStream, JSON_STREAM_VALUE, pStream->pContext);
+}
+
+static IoT_Error_t beginValue(JsonStream_t *pStream, char c) {
+	uint16_t depth = pStream->depth;
+	bool isCaptured = pStream->isCaptureRequested;
+
+	pStream->isCaptureRequested = false;
+	if(isCaptured) {
+		pStream->openCaptures++;
+		pStream->captureStarts[depth] = (int32_t) pStream->captureLen;
+	}
+	captureChar(pStream, c);
+
+	if('{' == c || '[' == c) {
+		if(depth >= JSON_STREAM_MAX_DEPTH) {
+			return JSON_PARSE_ERROR;
+		}
+		pStream->frames[depth].isArray = ('[' == c);
+		pStream->frames[depth].keyLen = 0;
+		pStream->depth++;
+		pStream->state = ('[' == c) ? STREAM_ARRAY_FIRST : STREAM_KEY_FIRST;
+	} else if('"' == c) {
+		/* like jsmn, a string token excludes the quotes */
+		if(isCaptured) {
+			pStream->captureStarts[depth] = (int32_t) pStream->captureLen;
+		}
+		pStream->state = STREAM_STRING;
+	} else if('-' == c || ('0' <= c && c <= '9') || 't' == c || 'f' == c || 'n' == c) {
+		pStream->state = STREAM_PRIMITIVE;
+	} else {
+		return JSON_PARSE_ERROR;
+	}
+	return SUCCESS;
+}
+
+static IoT_Error_t endContainer(JsonStream_t *pStream, char c) {
+	if(0 == pStream->depth || pStream->frames[pStream->depth - 1].isArray != (']' == c)) {
+		return JSON_PARSE_ERROR;
+	}
+	captureChar(pStream, c);
+	pStream->depth--;
+	endValue(pStream, (']' == c) ? JSMN_ARRAY : JSMN_OBJECT, pStream->captureLen);
+	return SUCCESS;
+}
+
+static void beginKey(JsonStream_t *pStream, char c) {
+	captureChar(pStream, c);
+	pStream->frames[pStream->depth - 1].keyLen = 0;
+	pStream->state = STREAM_KEY_STRING;
+}
+
+static void appendKey(JsonStream_t *pStream, char c) {
+	JsonStreamFrame_t *pFrame = &pStream->frames[pStream->depth - 1];
+
+	captureChar(pStream, c);
+	if(pFrame->keyLen < JSON_STREAM_MAX_KEY_LEN) {
+		pFrame->key[pFrame->keyLen] = c;
+	}
+	if(pFrame->keyLen < UINT16_MAX) {
+		pFrame->keyLen++;
+	}
+}
+
+void jsonStreamInit(JsonStream_t *pStream, char *pCapture, size_t captureSize, JsonStreamHandler_t handler,
+					void *pContext) {
+	uint16_t i;
+
+	pStream->depth = 0;
+	pStream->state = STREAM_VALUE;
+	pStream->isCaptureRequested = false;
+	pStream->isCaptureFull = false;
+	pStream->openCaptures = 0;
+	for(i = 0; i <= JSON_STREAM_MAX_DEPTH; i++) {
+		pStream->captureStarts[i] = -1;
+	}
+	pStream->pCapture = pCapture;
+	pStream->captureSize = captureSize;
+	pStream->captureLen = 0;
+	pStream->isValueTruncated = false;
+	pStream->handler = handler;
+	pStream->pContext = pContext;
+}
+
+IoT_Error_t jsonStreamFeed(JsonStream_t *pStream, const char *pData, size_t length) {
+	IoT_Error_t rc = SUCCESS;
+	size_t i = 0;
+	char c;
+
+	if(STREAM_ERROR == pStream->state) {
+		return JSON_PARSE_ERROR;
+	}
+
+	while(i < length && SUCCESS == rc) {
+		c = pData[i];
+		switch(pStream->state) {
+			case STREAM_VALUE:
+				if(isBlank(c)) {
+					captureChar(pStream, c);
+				} else {
+					rc = beginValue(pStream, c);
+				}
+				break;
+			case STREAM_ARRAY_FIRST:
+				if(isBlank(c)) {
+					captureChar(pStream, c);
+				} else if(']' == c) {
+					rc = endContainer(pStream, c);
+				} else {
+					rc = beginValue(pStream, c);
+				}
+				break;
+			case STREAM_KEY_FIRST:
+			case STREAM_KEY:
+				if(isBlank(c)) {
+					captureChar(pStream, c);
+				} else if('"' == c) {
+					beginKey(pStream, c);
+				} else if('}' == c && STREAM_KEY_FIRST == pStream->state) {
+					rc = endContainer(pStream, c);
+				} else {
+					rc = JSON_PARSE_ERROR;
+				}
+				break;
+			case STREAM_KEY_STRING:
+				if('"' == c) {
+					captureChar(pStream, c);
+					pStream->state = STREAM_COLON;
+					pStream->isCaptureRequested = pStream->handler(pStream, JSON_STREAM_KEY, pStream->pContext);
+				} else {
+					appendKey(pStream, c);
+					if('\\' == c) {
+						pStream->state = STREAM_KEY_ESCAPE;
+					}
+				}
+				break;
+			case STREAM_KEY_ESCAPE:
+				appendKey(pStream, c);
+				pStream->state = STREAM_KEY_STRING;
+				break;
+			case STREAM_COLON:
+				captureChar(pStream, c);
+				if(':' == c) {
+					pStream->state = STREAM_VALUE;
+				} else if(!isBlank(c)) {
+					rc = JSON_PARSE_ERROR;
+				}
+				break;
+			case STREAM_STRING:
+				if('"' == c) {
+					endValue(pStream, JSMN_STRING, pStream->captureLen);
+				} else if('\\' == c) {
+					pStream->state = STREAM_STRING_ESCAPE;
+				}
+				captureChar(pStream, c);
+				break;
+			case STREAM_STRING_ESCAPE:
+				captureChar(pStream, c);
+				pStream->state = STREAM_STRING;
+				break;
+			case STREAM_PRIMITIVE:
+				if(isBlank(c) || ',' == c || '}' == c || ']' == c) {
+					/* the delimiter is read again after the value */
+					endValue(pStream, JSMN_PRIMITIVE, pStream->captureLen);
+					continue;
+				}
+				captureChar(pStream, c);
+				break;
+			case STREAM_AFTER_VALUE:
+				if(isBlank(c)) {
+					captureChar(pStream, c);
+				} else if(',' == c) {
+					captureChar(pStream, c);
+					pStream->state = pStream->frames[pStream->depth - 1].isArray ? STREAM_VALUE : STREAM_KEY;
+				} else if('}' == c || ']' == c) {
+					rc = endContainer(pStream, c);
+				} else {
+					rc = JSON_PARSE_ERROR;
+				}
+				break;
+			case STREAM_DONE:
+				if(!isBlank(c)) {
+					rc = JSON_PARSE_ERROR;
+				}
+				break;
+			default:
+				rc = JSON_PARSE_ERROR;
+				break;
+		}
+		i++;
+	}
+
+	if(SUCCESS != rc) {
+		pStream->state = STREAM_ERROR;
+	}
+	return rc;
+}
+
+bool jsonStreamIsComplete(const JsonStream_t *pStream) {
+	return STREAM_DONE == pStream->state;
+}
+
+#ifdef __cplusplus
+}
+#endif
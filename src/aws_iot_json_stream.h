@@ -0,0 +1,143 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_json_stream.h
+ * @brief Incremental JSON tokenizer
+ *
+ * Consumes a document in fragments of any size, for documents that do not fit
+ * in a buffer or have more tokens than a jsmn token array can hold. The state
+ * is bounded: a stack of JSON_STREAM_MAX_DEPTH containers with the current key
+ * of each, and a capture buffer given by the caller. Every object key is
+ * reported to a handler, which can ask for the value of that key. Captured
+ * values are copied to the capture buffer and reported with a jsmn token
+ * giving their type and position there, as jsmn_parse would for the whole
+ * document, so the json_utils parse functions apply to them.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_JSON_STREAM_H_
+#define AWS_IOT_SDK_SRC_JSON_STREAM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "aws_iot_error.h"
+#include "jsmn.h"
+
+/**
+ * @brief Deepest nesting of objects and arrays, deeper documents are rejected
+ */
+#ifndef JSON_STREAM_MAX_DEPTH
+#define JSON_STREAM_MAX_DEPTH 10
+#endif
+
+/**
+ * @brief Longest key kept for the handler, longer keys are reported truncated
+ */
+#ifndef JSON_STREAM_MAX_KEY_LEN
+#define JSON_STREAM_MAX_KEY_LEN 32
+#endif
+
+/**
+ * @brief Events reported to the handler
+ */
+typedef enum {
+	JSON_STREAM_KEY,	///< A key was read, it is the key of frames[depth - 1]. Return true to capture its value
+	JSON_STREAM_VALUE	///< A captured value is complete, the value of the key of frames[depth - 1], see valueToken
+} JsonStreamEvent_t;
+
+typedef struct JsonStream JsonStream_t;
+
+/**
+ * @brief Handler of the tokenizer events
+ *
+ * @return bool For JSON_STREAM_KEY, true to capture the value of the key. Ignored otherwise
+ */
+typedef bool (*JsonStreamHandler_t)(JsonStream_t *pStream, JsonStreamEvent_t event, void *pContext);
+
+/**
+ * @brief Open object or array
+ */
+typedef struct {
+	char key[JSON_STREAM_MAX_KEY_LEN];	///< Current key of an object, not terminated
+	uint16_t keyLen;					///< Length of the key, larger than JSON_STREAM_MAX_KEY_LEN when truncated
+	bool isArray;						///< The container is an array, it has no key
+} JsonStreamFrame_t;
+
+/**
+ * @brief Tokenizer state, all of it, no allocation is made
+ */
+struct JsonStream {
+	JsonStreamFrame_t frames[JSON_STREAM_MAX_DEPTH];	///< Open containers, the root first
+	uint16_t depth;										///< Number of open containers
+	uint8_t state;										///< Position in the grammar
+	bool isCaptureRequested;							///< The handler asked for the value of the last key
+	bool isCaptureFull;									///< The capture buffer overflowed, values completed since are truncated
+	uint16_t openCaptures;								///< Captured values being read
+	int32_t captureStarts[JSON_STREAM_MAX_DEPTH + 1];	///< Capture offset of the value read at each depth, -1 if not captured
+	char *pCapture;										///< Buffer of the captured values
+	size_t captureSize;									///< Size of pCapture
+	size_t captureLen;									///< Bytes used in pCapture
+	jsmntok_t valueToken;								///< JSON_STREAM_VALUE: type, start and end of the value in pCapture
+	bool isValueTruncated;								///< JSON_STREAM_VALUE: the value did not fit, valueToken is not usable
+	JsonStreamHandler_t handler;						///< Handler of the events
+	void *pContext;										///< Passed to the handler
+};
+
+/**
+ * @brief Start a new document
+ *
+ * @param pStream Tokenizer state
+ * @param pCapture Buffer receiving the captured values, kept until the next init
+ * @param captureSize Size of pCapture
+ * @param handler Handler of the events
+ * @param pContext Passed to the handler
+ */
+void jsonStreamInit(JsonStream_t *pStream, char *pCapture, size_t captureSize, JsonStreamHandler_t handler,
+					void *pContext);
+
+/**
+ * @brief Tokenize the next fragment of the document
+ *
+ * The handler is called from this function. Fragments can split the document
+ * anywhere, including inside a key or a value.
+ *
+ * @param pStream Tokenizer state
+ * @param pData Fragment
+ * @param length Length of the fragment
+ *
+ * @return SUCCESS, or JSON_PARSE_ERROR if the document is malformed or too deep, the next calls fail too
+ */
+IoT_Error_t jsonStreamFeed(JsonStream_t *pStream, const char *pData, size_t length);
+
+/**
+ * @brief Whether the top-level value has been read completely
+ *
+ * @param pStream Tokenizer state
+ *
+ * @return bool true once the document is complete, anything else but blanks after it is an error
+ */
+bool jsonStreamIsComplete(const JsonStream_t *pStream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AWS_IOT_SDK_SRC_JSON_STREAM_H_
@@ -28,10 +28,10 @@ extern "C" {
 
 #include "aws_iot_json_utils.h"
 
-#include <stdio.h>
 #include <stdint.h>
 #include <string.h>
 
+#include "aws_iot_json_number.h"
 #include "aws_iot_log.h"
 
 int8_t jsoneq(const char *json, jsmntok_t *tok, const char *s) {
@@ -45,87 +45,86 @@ int8_t jsoneq(const char *json, jsmntok_t *tok, const char *s) {
 	return -1;
 }
 
-IoT_Error_t parseUnsignedInteger32Value(uint32_t *i, const char *jsonString, jsmntok_t *token) {
+/* the number is read within the token, out of range values are rejected instead of wrapping around */
+static IoT_Error_t parseIntegerToken(int64_t *pValue, int64_t minimum, int64_t maximum, const char *jsonString,
+									 jsmntok_t *token) {
 	if(token->type != JSMN_PRIMITIVE) {
-		IOT_WARN("Token was not an integer");
 		return JSON_PARSE_ERROR;
 	}
 
-	if(('-' == (char) (jsonString[token->start])) || (1 != sscanf(jsonString + token->start, "%u", i))) {
+	return jsonNumberParseInteger(jsonString + token->start, (size_t) (token->end - token->start), minimum, maximum,
+								  pValue);
+}
+
+IoT_Error_t parseUnsignedInteger32Value(uint32_t *i, const char *jsonString, jsmntok_t *token) {
+	int64_t value;
+
+	if(SUCCESS != parseIntegerToken(&value, 0, UINT32_MAX, jsonString, token)) {
 		IOT_WARN("Token was not an unsigned integer.");
 		return JSON_PARSE_ERROR;
 	}
 
+	*i = (uint32_t) value;
 	return SUCCESS;
 }
 
 IoT_Error_t parseUnsignedInteger16Value(uint16_t *i, const char *jsonString, jsmntok_t *token) {
-	if(token->type != JSMN_PRIMITIVE) {
-		IOT_WARN("Token was not an integer");
-		return JSON_PARSE_ERROR;
-	}
+	int64_t value;
 
-	if(('-' == (char) (jsonString[token->start])) || (1 != sscanf(jsonString + token->start, "%hu", i))) {
+	if(SUCCESS != parseIntegerToken(&value, 0, UINT16_MAX, jsonString, token)) {
 		IOT_WARN("Token was not an unsigned integer.");
 		return JSON_PARSE_ERROR;
 	}
 
+	*i = (uint16_t) value;
 	return SUCCESS;
 }
 
 IoT_Error_t parseUnsignedInteger8Value(uint8_t *i, const char *jsonString, jsmntok_t *token) {
-	if(token->type != JSMN_PRIMITIVE) {
-		IOT_WARN("Token was not an integer");
-		return JSON_PARSE_ERROR;
-	}
+	int64_t value;
 
-	if(('-' == (char) (jsonString[token->start])) || (1 != sscanf(jsonString + token->start, "%hhu", i))) {
+	if(SUCCESS != parseIntegerToken(&value, 0, UINT8_MAX, jsonString, token)) {
 		IOT_WARN("Token was not an unsigned integer.");
 		return JSON_PARSE_ERROR;
 	}
 
+	*i = (uint8_t) value;
 	return SUCCESS;
 }
 
 IoT_Error_t parseInteger32Value(int32_t *i, const char *jsonString, jsmntok_t *token) {
-	if(token->type != JSMN_PRIMITIVE) {
-		IOT_WARN("Token was not an integer");
-		return JSON_PARSE_ERROR;
-	}
+	int64_t value;
 
-	if(1 != sscanf(jsonString + token->start, "%i", i)) {
+	if(SUCCESS != parseIntegerToken(&value, INT32_MIN, INT32_MAX, jsonString, token)) {
 		IOT_WARN("Token was not an integer.");
 		return JSON_PARSE_ERROR;
 	}
 
+	*i = (int32_t) value;
 	return SUCCESS;
 }
 
 IoT_Error_t parseInteger16Value(int16_t *i, const char *jsonString, jsmntok_t *token) {
-	if(token->type != JSMN_PRIMITIVE) {
-		IOT_WARN("Token was not an integer");
-		return JSON_PARSE_ERROR;
-	}
+	int64_t value;
 
-	if(1 != sscanf(jsonString + token->start, "%hi", i)) {
+	if(SUCCESS != parseIntegerToken(&value, INT16_MIN, INT16_MAX, jsonString, token)) {
 		IOT_WARN("Token was not an integer.");
 		return JSON_PARSE_ERROR;
 	}
 
+	*i = (int16_t) value;
 	return SUCCESS;
 }
 
 IoT_Error_t parseInteger8Value(int8_t *i, const char *jsonString, jsmntok_t *token) {
-	if(token->type != JSMN_PRIMITIVE) {
-		IOT_WARN("Token was not an integer");
-		return JSON_PARSE_ERROR;
-	}
+	int64_t value;
 
-	if(1 != sscanf(jsonString + token->start, "%hhi", i)) {
+	if(SUCCESS != parseIntegerToken(&value, INT8_MIN, INT8_MAX, jsonString, token)) {
 		IOT_WARN("Token was not an integer.");
 		return JSON_PARSE_ERROR;
 	}
 
+	*i = (int8_t) value;
 	return SUCCESS;
 }
 
@@ -135,7 +134,7 @@ IoT_Error_t parseFloatValue(float *f, const char *jsonString, jsmntok_t *token)
 		return JSON_PARSE_ERROR;
 	}
 
-	if(1 != sscanf(jsonString + token->start, "%f", f)) {
+	if(SUCCESS != jsonNumberParseFloat(jsonString + token->start, (size_t) (token->end - token->start), f)) {
 		IOT_WARN("Token was not a float.");
 		return JSON_PARSE_ERROR;
 	}
@@ -149,7 +148,7 @@ IoT_Error_t parseDoubleValue(double *d, const char *jsonString, jsmntok_t *token
 		return JSON_PARSE_ERROR;
 	}
 
-	if(1 != sscanf(jsonString + token->start, "%lf", d)) {
+	if(SUCCESS != jsonNumberParseDouble(jsonString + token->start, (size_t) (token->end - token->start), d)) {
 		IOT_WARN("Token was not a double.");
 		return JSON_PARSE_ERROR;
 	}
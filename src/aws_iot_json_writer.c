@@ -0,0 +1,186 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_json_writer.c
+ * @brief JSON writer shared by the shadow and jobs serializers
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_json_writer.h"
+
+#include <string.h>
+
+#include "aws_iot_json_number.h"
+
+void jsonWriterInit(JsonWriter_t *pWriter, char *pBuffer, size_t size) {
+	pWriter->pBuffer = pBuffer;
+	pWriter->size = (NULL != pBuffer) ? size : 0;
+	pWriter->length = 0;
+}
+
+void jsonWriterSeek(JsonWriter_t *pWriter, size_t position) {
+	pWriter->length = position;
+}
+
+size_t jsonWriterTerminate(JsonWriter_t *pWriter) {
+	if(NULL != pWriter->pBuffer && pWriter->size > 0) {
+		pWriter->pBuffer[(pWriter->length < pWriter->size) ? pWriter->length : pWriter->size - 1] = '\0';
+	}
+	return pWriter->length;
+}
+
+bool isJsonWriterTruncated(const JsonWriter_t *pWriter) {
+	return pWriter->length >= pWriter->size;
+}
+
+/* bytes past the capacity are counted, not written, one byte is kept for the terminating null */
+void jsonWriteRaw(JsonWriter_t *pWriter, const char *pData, size_t length) {
+	size_t room;
+
+	if(pWriter->length + 1 < pWriter->size) {
+		room = pWriter->size - 1 - pWriter->length;
+		memcpy(pWriter->pBuffer + pWriter->length, pData, (length < room) ? length : room);
+	}
+	pWriter->length += length;
+}
+
+void jsonWriteChar(JsonWriter_t *pWriter, char c) {
+	if(pWriter->length + 1 < pWriter->size) {
+		pWriter->pBuffer[pWriter->length] = c;
+	}
+	pWriter->length++;
+}
+
+void jsonWriteText(JsonWriter_t *pWriter, const char *pText) {
+	jsonWriteRaw(pWriter, pText, strlen(pText));
+}
+
+/* runs of plain characters are copied at once, quotes, backslashes and control characters are escaped */
+static void writeEscaped(JsonWriter_t *pWriter, const char *pString) {
+	static const char hexDigits[] = "0123456789abcdef";
+	const char *pRun = pString;
+	char escape[6] = {'\\', 'u', '0', '0', '0', '0'};
+	unsigned char c;
+
+	for(; '\0' != *pString; pString++) {
+		c = (unsigned char) *pString;
+		if(c >= 0x20 && '"' != c && '\\' != c) {
+			continue;
+		}
+		jsonWriteRaw(pWriter, pRun, (size_t) (pString - pRun));
+		pRun = pString + 1;
+
+		switch(c) {
+			case '"':
+			case '\\':
+				escape[1] = (char) c;
+				break;
+			case '\n':
+				escape[1] = 'n';
+				break;
+			case '\r':
+				escape[1] = 'r';
+				break;
+			case '\t':
+				escape[1] = 't';
+				break;
+			case '\b':
+				escape[1] = 'b';
+				break;
+			case '\f':
+				escape[1] = 'f';
+				break;
+			default:
+				escape[1] = 'u';
+				escape[4] = hexDigits[c >> 4];
+				escape[5] = hexDigits[c & 0x0F];
+				break;
+		}
+		jsonWriteRaw(pWriter, escape, ('u' == escape[1]) ? 6 : 2);
+	}
+	jsonWriteRaw(pWriter, pRun, (size_t) (pString - pRun));
+}
+
+void jsonWriteString(JsonWriter_t *pWriter, const char *pString) {
+	if(NULL == pString) {
+		jsonWriteRaw(pWriter, "null", 4);
+		return;
+	}
+	jsonWriteChar(pWriter, '"');
+	writeEscaped(pWriter, pString);
+	jsonWriteChar(pWriter, '"');
+}
+
+void jsonWriteKey(JsonWriter_t *pWriter, const char *pKey) {
+	jsonWriteChar(pWriter, '"');
+	writeEscaped(pWriter, pKey);
+	jsonWriteRaw(pWriter, "\":", 2);
+}
+
+void jsonWriteUint(JsonWriter_t *pWriter, uint64_t value) {
+	char digits[20];
+	size_t i = sizeof(digits);
+	uint32_t value32;
+
+	/* 64 bit divisions are slow on 32 bit targets, most values do not need them */
+	while(value > UINT32_MAX) {
+		digits[--i] = (char) ('0' + (value % 10));
+		value /= 10;
+	}
+	value32 = (uint32_t) value;
+	do {
+		digits[--i] = (char) ('0' + (value32 % 10));
+		value32 /= 10;
+	} while(0 != value32);
+
+	jsonWriteRaw(pWriter, &digits[i], sizeof(digits) - i);
+}
+
+void jsonWriteInt(JsonWriter_t *pWriter, int64_t value) {
+	if(value < 0) {
+		jsonWriteChar(pWriter, '-');
+		jsonWriteUint(pWriter, (uint64_t) 0 - (uint64_t) value);
+	} else {
+		jsonWriteUint(pWriter, (uint64_t) value);
+	}
+}
+
+void jsonWriteBool(JsonWriter_t *pWriter, bool value) {
+	if(value) {
+		jsonWriteRaw(pWriter, "true", 4);
+	} else {
+		jsonWriteRaw(pWriter, "false", 5);
+	}
+}
+
+void jsonWriteDouble(JsonWriter_t *pWriter, double value) {
+	char text[JSON_NUMBER_TEXT_SIZE];
+
+	jsonWriteRaw(pWriter, text, jsonNumberFormatDouble(text, value));
+}
+
+void jsonWriteFloat(JsonWriter_t *pWriter, float value) {
+	char text[JSON_NUMBER_TEXT_SIZE];
+
+	jsonWriteRaw(pWriter, text, jsonNumberFormatFloat(text, value));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_json_writer.h
+ * @brief JSON writer shared by the shadow and jobs serializers
+ *
+ * The writer keeps a cursor and the capacity of the destination, so appending
+ * costs the size of what is appended: no strlen of the document and no printf
+ * per token. Like snprintf, the output is truncated to the destination and
+ * the length counts every byte, written or not, so a writer without a buffer
+ * measures a document (dry run) and a truncated one tells the size needed.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_JSON_WRITER_H_
+#define AWS_IOT_SDK_SRC_JSON_WRITER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Writer state
+ */
+typedef struct {
+	char *pBuffer;		///< Destination, NULL for a dry run
+	size_t size;		///< Size of pBuffer, terminating null included
+	size_t length;		///< Length of the document so far, truncated bytes included
+} JsonWriter_t;
+
+/**
+ * @brief Start writing at the beginning of a buffer
+ *
+ * @param pWriter Writer
+ * @param pBuffer Destination, NULL to only compute the length
+ * @param size Size of pBuffer, ignored when NULL
+ */
+void jsonWriterInit(JsonWriter_t *pWriter, char *pBuffer, size_t size);
+
+/**
+ * @brief Move the cursor, e.g. to the end of a document already in the buffer
+ *
+ * @param pWriter Writer
+ * @param position New length of the document, the next bytes are written there
+ */
+void jsonWriterSeek(JsonWriter_t *pWriter, size_t position);
+
+/**
+ * @brief Null-terminate the document, truncated if needed
+ *
+ * @param pWriter Writer
+ *
+ * @return size_t Length of the complete document, as snprintf returns it
+ */
+size_t jsonWriterTerminate(JsonWriter_t *pWriter);
+
+/**
+ * @brief Whether the document did not fit, terminating null included
+ *
+ * @param pWriter Writer
+ *
+ * @return bool true if bytes were dropped, always true for a dry run of a non-empty document
+ */
+bool isJsonWriterTruncated(const JsonWriter_t *pWriter);
+
+/**
+ * @brief Append bytes as they are
+ */
+void jsonWriteRaw(JsonWriter_t *pWriter, const char *pData, size_t length);
+
+/**
+ * @brief Append one byte as it is
+ */
+void jsonWriteChar(JsonWriter_t *pWriter, char c);
+
+/**
+ * @brief Append a null-terminated string as it is, e.g. a JSON value built by the caller
+ */
+void jsonWriteText(JsonWriter_t *pWriter, const char *pText);
+
+/**
+ * @brief Append a quoted and escaped string, null for a NULL string
+ */
+void jsonWriteString(JsonWriter_t *pWriter, const char *pString);
+
+/**
+ * @brief Append a quoted and escaped key followed by a colon
+ */
+void jsonWriteKey(JsonWriter_t *pWriter, const char *pKey);
+
+/**
+ * @brief Append a signed integer
+ */
+void jsonWriteInt(JsonWriter_t *pWriter, int64_t value);
+
+/**
+ * @brief Append an unsigned integer
+ */
+void jsonWriteUint(JsonWriter_t *pWriter, uint64_t value);
+
+/**
+ * @brief Append true or false
+ */
+void jsonWriteBool(JsonWriter_t *pWriter, bool value);
+
+/**
+ * @brief Append a double with the shortest digits that read back as the same value, null if not finite
+ */
+void jsonWriteDouble(JsonWriter_t *pWriter, double value);
+
+/**
+ * @brief Append a float with the shortest digits that read back as the same float, null if not finite
+ */
+void jsonWriteFloat(JsonWriter_t *pWriter, float value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AWS_IOT_SDK_SRC_JSON_WRITER_H_
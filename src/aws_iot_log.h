@@ -35,12 +35,55 @@ extern "C" {
 #include <stdio.h>
 #include <stdlib.h>
 
+/**
+ * @brief Log levels, for IOT_LOG_LEVEL
+ *
+ * Defining IOT_LOG_LEVEL selects every level up to and including it and strips the
+ * others at compile time, whatever the individual ENABLE_IOT_* flags say.
+ */
+#define IOT_LOG_LEVEL_NONE	0
+#define IOT_LOG_LEVEL_ERROR	1
+#define IOT_LOG_LEVEL_WARN	2
+#define IOT_LOG_LEVEL_INFO	3
+#define IOT_LOG_LEVEL_DEBUG	4
+
+#ifdef IOT_LOG_LEVEL
+#undef ENABLE_IOT_ERROR
+#undef ENABLE_IOT_WARN
+#undef ENABLE_IOT_INFO
+#undef ENABLE_IOT_DEBUG
+#if IOT_LOG_LEVEL >= IOT_LOG_LEVEL_ERROR
+#define ENABLE_IOT_ERROR
+#endif
+#if IOT_LOG_LEVEL >= IOT_LOG_LEVEL_WARN
+#define ENABLE_IOT_WARN
+#endif
+#if IOT_LOG_LEVEL >= IOT_LOG_LEVEL_INFO
+#define ENABLE_IOT_INFO
+#endif
+#if IOT_LOG_LEVEL >= IOT_LOG_LEVEL_DEBUG
+#define ENABLE_IOT_DEBUG
+#endif
+#endif
+
+/**
+ * @brief Deferred formatting backend
+ *
+ * With ENABLE_IOT_LOG_ASYNC the enabled levels record their arguments in the
+ * ring buffer of aws_iot_log_sink.h instead of calling printf, see aws_iot_log_sink_start.
+ */
+#ifdef ENABLE_IOT_LOG_ASYNC
+#include "aws_iot_log_sink.h"
+#endif
+
 /**
  * @brief Debug level logging macro.
  *
  * Macro to expose function, line number as well as desired log message.
  */
-#ifdef ENABLE_IOT_DEBUG
+#if defined(ENABLE_IOT_DEBUG) && defined(ENABLE_IOT_LOG_ASYNC)
+#define IOT_DEBUG(...) aws_iot_log_sink_record(IOT_LOG_LEVEL_DEBUG, __func__, __LINE__, __VA_ARGS__)
+#elif defined(ENABLE_IOT_DEBUG)
 #define IOT_DEBUG(...)    \
 	{\
 	printf("DEBUG:   %s L#%d ", __func__, __LINE__);  \
@@ -53,21 +96,22 @@ extern "C" {
 
 /**
  * @brief Debug level trace logging macro.
- *
- * Macro to print message function entry and exit
+ * Macro to record function entry and exit in the binary trace buffers, see aws_iot_trace.h
  */
 #ifdef ENABLE_IOT_TRACE
+#include "aws_iot_trace.h"
+
 #define FUNC_ENTRY    \
 	{\
-	printf("FUNC_ENTRY:   %s L#%d \n", __func__, __LINE__);  \
+	aws_iot_trace_record(IOT_TRACE_ENTRY, __func__, __LINE__, 0);  \
 	}
 #define FUNC_EXIT    \
 	{\
-	printf("FUNC_EXIT:   %s L#%d \n", __func__, __LINE__);  \
+	aws_iot_trace_record(IOT_TRACE_EXIT, __func__, __LINE__, 0);  \
 	}
 #define FUNC_EXIT_RC(x)    \
 	{\
-	printf("FUNC_EXIT:   %s L#%d Return Code : %d \n", __func__, __LINE__, x);  \
+	aws_iot_trace_record(IOT_TRACE_EXIT_RC, __func__, __LINE__, (int32_t) (x));  \
 	return x; \
 	}
 #else
@@ -82,7 +126,9 @@ extern "C" {
  *
  * Macro to expose desired log message.  Info messages do not include automatic function names and line numbers.
  */
-#ifdef ENABLE_IOT_INFO
+#if defined(ENABLE_IOT_INFO) && defined(ENABLE_IOT_LOG_ASYNC)
+#define IOT_INFO(...) aws_iot_log_sink_record(IOT_LOG_LEVEL_INFO, __func__, __LINE__, __VA_ARGS__)
+#elif defined(ENABLE_IOT_INFO)
 #define IOT_INFO(...)    \
 	{\
 	printf(__VA_ARGS__); \
@@ -97,7 +143,9 @@ extern "C" {
  *
  * Macro to expose function, line number as well as desired log message.
  */
-#ifdef ENABLE_IOT_WARN
+#if defined(ENABLE_IOT_WARN) && defined(ENABLE_IOT_LOG_ASYNC)
+#define IOT_WARN(...) aws_iot_log_sink_record(IOT_LOG_LEVEL_WARN, __func__, __LINE__, __VA_ARGS__)
+#elif defined(ENABLE_IOT_WARN)
 #define IOT_WARN(...)   \
 	{ \
 	printf("WARN:  %s L#%d ", __func__, __LINE__);  \
@@ -113,7 +161,9 @@ extern "C" {
  *
  * Macro to expose function, line number as well as desired log message.
  */
-#ifdef ENABLE_IOT_ERROR
+#if defined(ENABLE_IOT_ERROR) && defined(ENABLE_IOT_LOG_ASYNC)
+#define IOT_ERROR(...) aws_iot_log_sink_record(IOT_LOG_LEVEL_ERROR, __func__, __LINE__, __VA_ARGS__)
+#elif defined(ENABLE_IOT_ERROR)
 #define IOT_ERROR(...)  \
 	{ \
 	printf("ERROR: %s L#%d ", __func__, __LINE__); \
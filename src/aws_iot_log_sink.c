@@ -0,0 +1,539 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_log_sink.c
+ * @brief Deferred-format log sink
+ *
+ * A record is the format string pointer followed by the arguments encoded as
+ * tagged values: 'i'/'u'/'p' 64 bit integers, 'f' doubles and 's' length
+ * prefixed string copies. The encoder walks the format only to know the
+ * argument types, the formatting task walks it again to print them.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef ENABLE_IOT_LOG_ASYNC
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "aws_iot_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+
+typedef struct {
+	const char *pFormat;
+	const char *pFunction;
+	uint16_t line;
+	uint8_t level;
+	uint8_t isTruncated;
+} LogRecordHeader_t;
+
+typedef struct {
+	const char *pStart;	/* flags, width and precision, after the '%' */
+	size_t flagsLen;	/* length of the flags */
+	const char *pWidth;
+	size_t widthLen;	/* 0 when there is no width, 1 for '*' */
+	const char *pPrecision;
+	size_t precisionLen;	/* digits after the '.', 1 for '*' */
+	bool hasPrecision;
+	char length;		/* 'H' hh, 'h', 'l', 'L' ll or long double, 'z', 'j', 't', 0 none */
+	char conversion;
+} LogSpec_t;
+
+static RingbufHandle_t logRingbuf = NULL;
+static uint32_t logDropped = 0;
+
+static const char *_aws_iot_log_sink_parse_spec(const char *p, LogSpec_t *pSpec) {
+	memset(pSpec, 0, sizeof(LogSpec_t));
+
+	pSpec->pStart = p;
+	while('-' == *p || '+' == *p || ' ' == *p || '#' == *p || '0' == *p) {
+		p++;
+	}
+	pSpec->flagsLen = (size_t) (p - pSpec->pStart);
+
+	pSpec->pWidth = p;
+	if('*' == *p) {
+		p++;
+	} else {
+		while(*p >= '0' && *p <= '9') {
+			p++;
+		}
+	}
+	pSpec->widthLen = (size_t) (p - pSpec->pWidth);
+
+	if('.' == *p) {
+		p++;
+		pSpec->hasPrecision = true;
+		pSpec->pPrecision = p;
+		if('*' == *p) {
+			p++;
+		} else {
+			while(*p >= '0' && *p <= '9') {
+				p++;
+			}
+		}
+		pSpec->precisionLen = (size_t) (p - pSpec->pPrecision);
+	}
+
+	if('h' == *p) {
+		p++;
+		pSpec->length = 'h';
+		if('h' == *p) {
+			p++;
+			pSpec->length = 'H';
+		}
+	} else if('l' == *p) {
+		p++;
+		pSpec->length = 'l';
+		if('l' == *p) {
+			p++;
+			pSpec->length = 'L';
+		}
+	} else if('L' == *p || 'z' == *p || 'j' == *p || 't' == *p) {
+		pSpec->length = *p++;
+	}
+
+	pSpec->conversion = *p;
+	return ('\0' == *p) ? p : p + 1;
+}
+
+static bool _aws_iot_log_sink_put(uint8_t *pRecord, size_t *pLen, char tag, const void *pValue, size_t valueLen) {
+	if(*pLen + 1 + valueLen > IOT_LOG_MAX_RECORD_LEN) {
+		return false;
+	}
+	pRecord[(*pLen)++] = (uint8_t) tag;
+	memcpy(&pRecord[*pLen], pValue, valueLen);
+	*pLen += valueLen;
+	return true;
+}
+
+static bool _aws_iot_log_sink_put_string(uint8_t *pRecord, size_t *pLen, const char *pString, int precision) {
+	size_t stringLen = 0;
+	size_t room;
+
+	if(NULL == pString) {
+		pString = "(null)";
+	}
+	while(stringLen < IOT_LOG_MAX_STRING_LEN && (precision < 0 || stringLen < (size_t) precision)
+		  && '\0' != pString[stringLen]) {
+		stringLen++;
+	}
+
+	/* shorten the copy rather than dropping the argument */
+	if(*pLen + 2 > IOT_LOG_MAX_RECORD_LEN) {
+		return false;
+	}
+	room = IOT_LOG_MAX_RECORD_LEN - *pLen - 2;
+	if(stringLen > room) {
+		stringLen = room;
+	}
+
+	pRecord[(*pLen)++] = 's';
+	pRecord[(*pLen)++] = (uint8_t) stringLen;
+	memcpy(&pRecord[*pLen], pString, stringLen);
+	*pLen += stringLen;
+	return true;
+}
+
+static size_t _aws_iot_log_sink_encode(uint8_t *pRecord, const char *pFormat, va_list args, bool *pIsTruncated) {
+	size_t len = sizeof(LogRecordHeader_t);
+	const char *p = pFormat;
+	LogSpec_t spec;
+	int precision;
+	int64_t intValue;
+	uint64_t uintValue;
+	double doubleValue;
+	bool ok = true;
+
+	while(ok && '\0' != *p) {
+		if('%' != *p++) {
+			continue;
+		}
+		if('%' == *p) {
+			p++;
+			continue;
+		}
+		p = _aws_iot_log_sink_parse_spec(p, &spec);
+
+		precision = -1;
+		if(1 == spec.widthLen && '*' == spec.pWidth[0]) {
+			intValue = va_arg(args, int);
+			ok = _aws_iot_log_sink_put(pRecord, &len, 'i', &intValue, sizeof(intValue));
+		}
+		if(ok && spec.hasPrecision && 1 == spec.precisionLen && '*' == spec.pPrecision[0]) {
+			precision = va_arg(args, int);
+			intValue = precision;
+			ok = _aws_iot_log_sink_put(pRecord, &len, 'i', &intValue, sizeof(intValue));
+		} else if(spec.hasPrecision) {
+			precision = 0;
+			for(size_t i = 0; i < spec.precisionLen; i++) {
+				precision = precision * 10 + (spec.pPrecision[i] - '0');
+			}
+		}
+		if(!ok) {
+			break;
+		}
+
+		switch(spec.conversion) {
+			case 'd':
+			case 'i':
+			case 'c':
+				switch(spec.length) {
+					case 'l': intValue = va_arg(args, long); break;
+					case 'L': intValue = va_arg(args, long long); break;
+					case 'z': intValue = (int64_t) va_arg(args, size_t); break;
+					case 'j': intValue = va_arg(args, intmax_t); break;
+					case 't': intValue = va_arg(args, ptrdiff_t); break;
+					default: intValue = va_arg(args, int); break;
+				}
+				ok = _aws_iot_log_sink_put(pRecord, &len, 'i', &intValue, sizeof(intValue));
+				break;
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'o':
+				switch(spec.length) {
+					case 'l': uintValue = va_arg(args, unsigned long); break;
+					case 'L': uintValue = va_arg(args, unsigned long long); break;
+					case 'z': uintValue = va_arg(args, size_t); break;
+					case 'j': uintValue = va_arg(args, uintmax_t); break;
+					case 't': uintValue = (uint64_t) va_arg(args, ptrdiff_t); break;
+					default: uintValue = va_arg(args, unsigned int); break;
+				}
+				ok = _aws_iot_log_sink_put(pRecord, &len, 'u', &uintValue, sizeof(uintValue));
+				break;
+			case 'f':
+			case 'F':
+			case 'e':
+			case 'E':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+				doubleValue = ('L' == spec.length) ? (double) va_arg(args, long double) : va_arg(args, double);
+				ok = _aws_iot_log_sink_put(pRecord, &len, 'f', &doubleValue, sizeof(doubleValue));
+				break;
+			case 's':
+				ok = _aws_iot_log_sink_put_string(pRecord, &len, va_arg(args, const char *), precision);
+				break;
+			case 'p':
+				uintValue = (uint64_t) (uintptr_t) va_arg(args, void *);
+				ok = _aws_iot_log_sink_put(pRecord, &len, 'p', &uintValue, sizeof(uintValue));
+				break;
+			default:
+				/* %n or unknown conversion, the rest of the arguments cannot be located */
+				ok = false;
+				break;
+		}
+	}
+
+	*pIsTruncated = !ok;
+	return len;
+}
+
+static bool _aws_iot_log_sink_get(const uint8_t *pRecord, size_t recordLen, size_t *pOffset, char tag, void *pValue) {
+	if(*pOffset + 9 > recordLen || tag != (char) pRecord[*pOffset]) {
+		return false;
+	}
+	memcpy(pValue, &pRecord[*pOffset + 1], 8);
+	*pOffset += 9;
+	return true;
+}
+
+static void _aws_iot_log_sink_append(char *pLine, size_t *pLineLen, const char *pFormat, ...) {
+	va_list args;
+	int written;
+
+	if(*pLineLen >= IOT_LOG_MAX_LINE_LEN - 1) {
+		return;
+	}
+	va_start(args, pFormat);
+	written = vsnprintf(&pLine[*pLineLen], IOT_LOG_MAX_LINE_LEN - *pLineLen, pFormat, args);
+	va_end(args);
+	if(written > 0) {
+		*pLineLen += (size_t) written;
+		if(*pLineLen > IOT_LOG_MAX_LINE_LEN - 1) {
+			*pLineLen = IOT_LOG_MAX_LINE_LEN - 1;
+		}
+	}
+}
+
+static void _aws_iot_log_sink_format(const uint8_t *pRecord, size_t recordLen) {
+	LogRecordHeader_t header;
+	char line[IOT_LOG_MAX_LINE_LEN];
+	char spec[32];
+	size_t lineLen = 0;
+	size_t offset = sizeof(LogRecordHeader_t);
+	size_t specLen;
+	const char *p;
+	const char *pSpecEnd;
+	LogSpec_t parsed;
+	int64_t width, precision, intValue;
+	uint64_t uintValue;
+	double doubleValue;
+	uint8_t stringLen;
+	bool ok = true;
+
+	memcpy(&header, pRecord, sizeof(LogRecordHeader_t));
+	line[0] = '\0';
+
+	switch(header.level) {
+		case IOT_LOG_LEVEL_DEBUG:
+			_aws_iot_log_sink_append(line, &lineLen, "DEBUG:   %s L#%d ", header.pFunction, header.line);
+			break;
+		case IOT_LOG_LEVEL_WARN:
+			_aws_iot_log_sink_append(line, &lineLen, "WARN:  %s L#%d ", header.pFunction, header.line);
+			break;
+		case IOT_LOG_LEVEL_ERROR:
+			_aws_iot_log_sink_append(line, &lineLen, "ERROR: %s L#%d ", header.pFunction, header.line);
+			break;
+		default:
+			break;
+	}
+
+	p = header.pFormat;
+	while(ok && '\0' != *p) {
+		if('%' != *p) {
+			pSpecEnd = strchr(p, '%');
+			specLen = (NULL == pSpecEnd) ? strlen(p) : (size_t) (pSpecEnd - p);
+			_aws_iot_log_sink_append(line, &lineLen, "%.*s", (int) specLen, p);
+			p += specLen;
+			continue;
+		}
+		p++;
+		if('%' == *p) {
+			_aws_iot_log_sink_append(line, &lineLen, "%%");
+			p++;
+			continue;
+		}
+		p = _aws_iot_log_sink_parse_spec(p, &parsed);
+
+		width = -1;
+		precision = -1;
+		if(1 == parsed.widthLen && '*' == parsed.pWidth[0]) {
+			ok = _aws_iot_log_sink_get(pRecord, recordLen, &offset, 'i', &width);
+		}
+		if(ok && parsed.hasPrecision && 1 == parsed.precisionLen && '*' == parsed.pPrecision[0]) {
+			ok = _aws_iot_log_sink_get(pRecord, recordLen, &offset, 'i', &precision);
+		}
+		if(!ok) {
+			break;
+		}
+
+		/* rebuild the conversion with the stored width/precision and a 64 bit length modifier */
+		specLen = (size_t) snprintf(spec, sizeof(spec), "%%%.*s", (int) parsed.flagsLen, parsed.pStart);
+		if(width >= 0) {
+			specLen += (size_t) snprintf(&spec[specLen], sizeof(spec) - specLen, "%d", (int) width);
+		} else {
+			specLen += (size_t) snprintf(&spec[specLen], sizeof(spec) - specLen, "%.*s", (int) parsed.widthLen,
+										 parsed.pWidth);
+		}
+		if(precision >= 0) {
+			specLen += (size_t) snprintf(&spec[specLen], sizeof(spec) - specLen, ".%d", (int) precision);
+		} else if(parsed.hasPrecision) {
+			specLen += (size_t) snprintf(&spec[specLen], sizeof(spec) - specLen, ".%.*s",
+										 (int) parsed.precisionLen, parsed.pPrecision);
+		}
+		if(specLen >= sizeof(spec) - 4) {
+			ok = false;
+			break;
+		}
+
+		switch(parsed.conversion) {
+			case 'c':
+				ok = _aws_iot_log_sink_get(pRecord, recordLen, &offset, 'i', &intValue);
+				spec[specLen++] = 'c';
+				spec[specLen] = '\0';
+				if(ok) {
+					_aws_iot_log_sink_append(line, &lineLen, spec, (int) intValue);
+				}
+				break;
+			case 'd':
+			case 'i':
+				ok = _aws_iot_log_sink_get(pRecord, recordLen, &offset, 'i', &intValue);
+				spec[specLen++] = 'l';
+				spec[specLen++] = 'l';
+				spec[specLen++] = parsed.conversion;
+				spec[specLen] = '\0';
+				if(ok) {
+					_aws_iot_log_sink_append(line, &lineLen, spec, (long long) intValue);
+				}
+				break;
+			case 'u':
+			case 'x':
+			case 'X':
+			case 'o':
+				ok = _aws_iot_log_sink_get(pRecord, recordLen, &offset, 'u', &uintValue);
+				/* narrow types print truncated like the original conversion would */
+				if('H' == parsed.length) {
+					uintValue = (uint8_t) uintValue;
+				} else if('h' == parsed.length) {
+					uintValue = (uint16_t) uintValue;
+				}
+				spec[specLen++] = 'l';
+				spec[specLen++] = 'l';
+				spec[specLen++] = parsed.conversion;
+				spec[specLen] = '\0';
+				if(ok) {
+					_aws_iot_log_sink_append(line, &lineLen, spec, (unsigned long long) uintValue);
+				}
+				break;
+			case 'f':
+			case 'F':
+			case 'e':
+			case 'E':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+				ok = _aws_iot_log_sink_get(pRecord, recordLen, &offset, 'f', &doubleValue);
+				spec[specLen++] = parsed.conversion;
+				spec[specLen] = '\0';
+				if(ok) {
+					_aws_iot_log_sink_append(line, &lineLen, spec, doubleValue);
+				}
+				break;
+			case 's':
+				if(offset + 2 > recordLen || 's' != (char) pRecord[offset]) {
+					ok = false;
+					break;
+				}
+				stringLen = pRecord[offset + 1];
+				offset += 2;
+				if(offset + stringLen > recordLen) {
+					ok = false;
+					break;
+				}
+				/* the copy is already cut to the precision, print exactly its bytes */
+				if(width >= 0) {
+					snprintf(spec, sizeof(spec), "%%%.*s%d.*s", (int) parsed.flagsLen, parsed.pStart, (int) width);
+				} else {
+					snprintf(spec, sizeof(spec), "%%%.*s%.*s.*s", (int) parsed.flagsLen, parsed.pStart,
+							 (int) parsed.widthLen, parsed.pWidth);
+				}
+				_aws_iot_log_sink_append(line, &lineLen, spec, (int) stringLen, (const char *) &pRecord[offset]);
+				offset += stringLen;
+				break;
+			case 'p':
+				ok = _aws_iot_log_sink_get(pRecord, recordLen, &offset, 'p', &uintValue);
+				if(ok) {
+					_aws_iot_log_sink_append(line, &lineLen, "%p", (void *) (uintptr_t) uintValue);
+				}
+				break;
+			default:
+				ok = false;
+				break;
+		}
+	}
+
+	if(!ok || header.isTruncated) {
+		_aws_iot_log_sink_append(line, &lineLen, "[...]");
+	}
+	printf("%s\n", line);
+}
+
+void aws_iot_log_sink_record(uint8_t level, const char *pFunction, uint16_t line, const char *pFormat, ...) {
+	union {
+		LogRecordHeader_t header;
+		uint8_t bytes[IOT_LOG_MAX_RECORD_LEN];
+	} record;
+	bool isTruncated;
+	size_t len;
+	va_list args;
+
+	va_start(args, pFormat);
+	len = _aws_iot_log_sink_encode(record.bytes, pFormat, args, &isTruncated);
+	va_end(args);
+
+	record.header.pFormat = pFormat;
+	record.header.pFunction = pFunction;
+	record.header.line = line;
+	record.header.level = level;
+	record.header.isTruncated = isTruncated ? 1 : 0;
+
+	if(NULL == logRingbuf) {
+		/* sink not started yet, keep the log rather than losing it */
+		_aws_iot_log_sink_format(record.bytes, len);
+		return;
+	}
+
+	if(pdTRUE != xRingbufferSend(logRingbuf, record.bytes, len, 0)) {
+		logDropped++;
+	}
+}
+
+static void _aws_iot_log_sink_task(void *pParam) {
+	uint32_t reportedDropped = 0;
+	size_t len;
+	uint8_t *pRecord;
+
+	(void) pParam;
+
+	for(;;) {
+		pRecord = (uint8_t *) xRingbufferReceive(logRingbuf, &len, portMAX_DELAY);
+		if(NULL == pRecord) {
+			continue;
+		}
+		_aws_iot_log_sink_format(pRecord, len);
+		vRingbufferReturnItem(logRingbuf, pRecord);
+
+		if(reportedDropped != logDropped) {
+			printf("LOG: %u records dropped\n", (unsigned int) (logDropped - reportedDropped));
+			reportedDropped = logDropped;
+		}
+	}
+}
+
+int aws_iot_log_sink_start(uint32_t priority) {
+	RingbufHandle_t ringbuf;
+
+	if(NULL != logRingbuf) {
+		return 0;
+	}
+
+	ringbuf = xRingbufferCreate(IOT_LOG_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+	if(NULL == ringbuf) {
+		return -1;
+	}
+	logRingbuf = ringbuf;
+
+	if(pdPASS != xTaskCreate(_aws_iot_log_sink_task, "iot_log", IOT_LOG_TASK_STACK_SIZE, NULL,
+							 (UBaseType_t) priority, NULL)) {
+		logRingbuf = NULL;
+		vRingbufferDelete(ringbuf);
+		return -1;
+	}
+
+	return 0;
+}
+
+uint32_t aws_iot_log_sink_dropped(void) {
+	return logDropped;
+}
+
+#endif /* ENABLE_IOT_LOG_ASYNC */
+
+#ifdef __cplusplus
+}
+#endif
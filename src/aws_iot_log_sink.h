@@ -0,0 +1,113 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_log_sink.h
+ * @brief Deferred-format log sink used by the IOT_* macros
+ *
+ * With ENABLE_IOT_LOG_ASYNC the IOT_DEBUG / IOT_INFO / IOT_WARN / IOT_ERROR
+ * macros do not format anything in the caller. They store the format string
+ * pointer and the raw arguments (strings are copied, truncated to
+ * IOT_LOG_MAX_STRING_LEN) in a ring buffer. A low priority task started with
+ * aws_iot_log_sink_start formats and prints the records later, so a slow
+ * console no longer blocks the MQTT receive path.
+ *
+ * Format strings must be literals, which all SDK log calls are.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_LOG_SINK_H
+#define AWS_IOT_SDK_SRC_IOT_LOG_SINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Size of the ring buffer holding pending records, in bytes
+ */
+#ifndef IOT_LOG_BUFFER_SIZE
+#define IOT_LOG_BUFFER_SIZE 4096
+#endif
+
+/**
+ * @brief Maximum size of one record (header and arguments), in bytes
+ */
+#ifndef IOT_LOG_MAX_RECORD_LEN
+#define IOT_LOG_MAX_RECORD_LEN 192
+#endif
+
+/**
+ * @brief String arguments are truncated to this length
+ */
+#ifndef IOT_LOG_MAX_STRING_LEN
+#define IOT_LOG_MAX_STRING_LEN 64
+#endif
+
+/**
+ * @brief Maximum length of a formatted line
+ */
+#ifndef IOT_LOG_MAX_LINE_LEN
+#define IOT_LOG_MAX_LINE_LEN 256
+#endif
+
+/**
+ * @brief Stack size of the formatting task, in bytes
+ */
+#ifndef IOT_LOG_TASK_STACK_SIZE
+#define IOT_LOG_TASK_STACK_SIZE 3072
+#endif
+
+/**
+ * @brief Store a log record
+ *
+ * Called by the IOT_* macros, not meant to be called directly. Never blocks:
+ * when the ring buffer is full the record is dropped and counted. Before
+ * aws_iot_log_sink_start the record is printed synchronously.
+ *
+ * @param level Log level of the record, IOT_LOG_LEVEL_*
+ * @param pFunction Calling function (__func__)
+ * @param line Source line
+ * @param pFormat printf format, must have static storage
+ */
+void aws_iot_log_sink_record(uint8_t level, const char *pFunction, uint16_t line, const char *pFormat, ...)
+#ifdef __GNUC__
+	__attribute__((format(printf, 4, 5)))
+#endif
+;
+
+/**
+ * @brief Create the ring buffer and the formatting task
+ *
+ * @param priority FreeRTOS priority of the formatting task, keep it low
+ *
+ * @return int 0 on success, -1 if the buffer or the task could not be created
+ */
+int aws_iot_log_sink_start(uint32_t priority);
+
+/**
+ * @brief Number of records dropped because the ring buffer was full
+ *
+ * @return uint32_t Dropped records since start
+ */
+uint32_t aws_iot_log_sink_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_LOG_SINK_H */
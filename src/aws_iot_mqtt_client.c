@@ -228,6 +228,13 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, IoT_Client_Init_Params *p
 	pClient->clientData.writeBufSize = AWS_IOT_MQTT_TX_BUF_LEN;
 	pClient->clientData.readBufSize = AWS_IOT_MQTT_RX_BUF_LEN;
 	pClient->clientData.counterNetworkDisconnected = 0;
+	pClient->clientData.pingIntervalSec = 0;
+	pClient->clientData.pingDroppedIntervalSec = 0;
+	pClient->clientData.pingSuccessStreak = 0;
+	pClient->clientData.currentReconnectWaitInterval = AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL;
+	pClient->clientData.reconnectState = RECONNECT_STATE_IDLE;
+	pClient->clientData.reconnectAttempts = 0;
+	pClient->clientData.reconnectJitterSeed = 0;
 	pClient->clientData.disconnectHandler = pInitParams->disconnectHandler;
 	pClient->clientData.disconnectHandlerData = pInitParams->disconnectHandlerData;
 	pClient->clientData.nextPacketId = 1;
@@ -257,6 +264,7 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, IoT_Client_Init_Params *p
 	}
 #endif
 	pClient->clientStatus.isPingOutstanding = 0;
+	pClient->clientStatus.isIdlePing = false;
 	pClient->clientStatus.isAutoReconnectEnabled = pInitParams->enableAutoReconnect;
 
 	rc = iot_tls_init(&(pClient->networkStack), pInitParams->pRootCALocation, pInitParams->pDeviceCertLocation,
@@ -274,8 +282,13 @@ IoT_Error_t aws_iot_mqtt_init(AWS_IoT_Client *pClient, IoT_Client_Init_Params *p
 	}
 
 	init_timer(&(pClient->pingTimer));
+	init_timer(&(pClient->sendDeadlineTimer));
 	init_timer(&(pClient->reconnectDelayTimer));
 
+#ifndef DISABLE_IOT_CLIENT_METRICS
+	(void)aws_iot_mqtt_reset_metrics(pClient);
+#endif
+
 	pClient->clientStatus.clientState = CLIENT_STATE_INITIALIZED;
 
 	FUNC_EXIT_RC(SUCCESS);
@@ -358,6 +371,27 @@ uint32_t aws_iot_mqtt_get_network_disconnected_count(AWS_IoT_Client *pClient) {
 	return pClient->clientData.counterNetworkDisconnected;
 }
 
+IoT_Error_t aws_iot_mqtt_get_reconnect_status(AWS_IoT_Client *pClient, IoT_Reconnect_Status *pStatus) {
+	FUNC_ENTRY;
+	if(NULL == pClient || NULL == pStatus) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pStatus->state = pClient->clientData.reconnectState;
+	pStatus->attempts = pClient->clientData.reconnectAttempts;
+	pStatus->currentWaitMs = pClient->clientData.currentReconnectWaitInterval;
+	pStatus->nextAttemptInMs = 0;
+	if(RECONNECT_STATE_BACKOFF == pStatus->state && !has_timer_expired(&(pClient->reconnectDelayTimer))) {
+		pStatus->nextAttemptInMs = left_ms(&(pClient->reconnectDelayTimer));
+	}
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+uint16_t aws_iot_mqtt_get_ping_interval(AWS_IoT_Client *pClient) {
+	return pClient->clientData.pingIntervalSec;
+}
+
 void aws_iot_mqtt_reset_network_disconnected_count(AWS_IoT_Client *pClient) {
 	pClient->clientData.counterNetworkDisconnected = 0;
 }
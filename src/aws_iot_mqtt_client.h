@@ -52,6 +52,7 @@ extern "C" {
 /* AWS Specific header files */
 #include "aws_iot_error.h"
 #include "aws_iot_config.h"
+#include "aws_iot_mqtt_client_metrics.h"
 
 /* Platform specific implementation header files */
 #include "network_interface.h"
@@ -90,6 +91,8 @@ typedef struct {
 	uint16_t id;		///< Message sequence identifier.  Handled automatically by the MQTT client.
 	void *payload;		///< Pointer to MQTT message payload (bytes).
 	size_t payloadLen;	///< Length of MQTT payload.
+	size_t payloadOffset;	///< Incoming only: offset of payload in the message, non zero for the next fragments of a message delivered in fragments, see aws_iot_mqtt_set_fragmented_delivery()
+	size_t totalPayloadLen;	///< Incoming only: length of the whole message payload, larger than payloadLen when it is delivered in fragments
 } IoT_Publish_Message_Params;
 
 /**
@@ -210,6 +213,32 @@ typedef enum _ClientState {
 	CLIENT_STATE_PENDING_RECONNECT = 13
 } ClientState;
 
+/**
+ * @brief Reconnect State Type
+ *
+ * Defining a type for the state of the auto-reconnect state machine driven by yield
+ *
+ */
+typedef enum _ReconnectState {
+	RECONNECT_STATE_IDLE = 0,		///< Connected, or auto-reconnect not engaged
+	RECONNECT_STATE_FAST_RETRY = 1,		///< Connection just lost, the first attempt waits a random delay below the minimum back-off
+	RECONNECT_STATE_BACKOFF = 2,		///< Waiting for the jittered back-off delay to expire
+	RECONNECT_STATE_ATTEMPTING = 3		///< Reconnect or resubscribe in progress
+} ReconnectState;
+
+/**
+ * @brief Reconnect Status
+ *
+ * Snapshot of the auto-reconnect state machine, see aws_iot_mqtt_get_reconnect_status
+ *
+ */
+typedef struct {
+	ReconnectState state;			///< Current state of the reconnect state machine
+	uint32_t attempts;			///< Failed attempts since the connection was lost
+	uint32_t currentWaitMs;			///< Back-off delay applied before the next attempt. In milliseconds
+	uint32_t nextAttemptInMs;		///< Time left before the next attempt, 0 if it is due. In milliseconds
+} IoT_Reconnect_Status;
+
 /**
  * @brief Application Callback Handler Type
  *
@@ -234,6 +263,7 @@ typedef struct _MessageHandlers {
 	QoS qos;
 	pApplicationHandler_t pApplicationHandler;
 	void *pApplicationHandlerData;
+	bool isFragmented;	///< Messages larger than the read buffer are delivered in fragments instead of being dropped
 } MessageHandlers;   /* Message handlers are indexed by subscription topic */
 
 /**
@@ -246,6 +276,7 @@ typedef struct _MessageHandlers {
 typedef struct _ClientStatus {
 	ClientState clientState;
 	bool isPingOutstanding;
+	bool isIdlePing;
 	bool isAutoReconnectEnabled;
 } ClientStatus;
 
@@ -262,8 +293,14 @@ typedef struct _ClientData {
 	uint32_t packetTimeoutMs;
 	uint32_t commandTimeoutMs;
 	uint16_t keepAliveInterval;
+	uint16_t pingIntervalSec;
+	uint16_t pingDroppedIntervalSec;
+	uint8_t pingSuccessStreak;
 	uint32_t currentReconnectWaitInterval;
 	uint32_t counterNetworkDisconnected;
+	ReconnectState reconnectState;
+	uint32_t reconnectAttempts;
+	uint32_t reconnectJitterSeed;
 
 	/* The below values are initialized with the
 	 * lengths of the TX/RX buffers and never modified
@@ -287,6 +324,12 @@ typedef struct _ClientData {
 	iot_disconnect_handler disconnectHandler;
 
 	void *disconnectHandlerData;
+
+#ifndef DISABLE_IOT_CLIENT_METRICS
+	IoT_Client_Metrics metrics;
+	Timer metricsYieldTimer;
+	bool isMetricsYieldTimerRunning;
+#endif
 } ClientData;
 
 /**
@@ -297,6 +340,7 @@ typedef struct _ClientData {
  */
 struct _Client {
 	Timer pingTimer;
+	Timer sendDeadlineTimer;
 	Timer reconnectDelayTimer;
 
 	ClientStatus clientStatus;
@@ -403,6 +447,102 @@ IoT_Error_t aws_iot_mqtt_autoreconnect_set_status(AWS_IoT_Client *pClient, bool
  */
 uint32_t aws_iot_mqtt_get_network_disconnected_count(AWS_IoT_Client *pClient);
 
+/**
+ * @brief Get the state of the auto-reconnect state machine
+ *
+ * Called to know whether the client is reconnecting, how many attempts failed so far
+ * and when the next attempt will be made
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pStatus Reference to the structure to fill
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_get_reconnect_status(AWS_IoT_Client *pClient, IoT_Reconnect_Status *pStatus);
+
+/**
+ * @brief Get the current adaptive keep-alive interval
+ *
+ * Called to get the idle time after which the client checks the link with a PINGREQ.
+ * It moves between AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC and the keep-alive interval
+ * negotiated on connect, depending on the silent drops observed, and stays below
+ * the last interval that dropped until that one is tried again
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return uint16_t the interval in seconds
+ */
+uint16_t aws_iot_mqtt_get_ping_interval(AWS_IoT_Client *pClient);
+
+#ifndef DISABLE_IOT_CLIENT_METRICS
+/**
+ * @brief Get a snapshot of the client metrics
+ *
+ * Called to copy the packet and byte counters, the error tables, the queue depth gauge
+ * and the latency histograms of the client
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pSnapshot Reference to the structure to fill
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_get_metrics(AWS_IoT_Client *pClient, IoT_Client_Metrics *pSnapshot);
+
+/**
+ * @brief Reset the client metrics
+ *
+ * Called to set all counters, gauges and histograms of the client back to zero
+ *
+ * @param pClient Reference to the IoT Client
+ *
+ * @return IoT_Error_t Type defining successful/failed API call
+ */
+IoT_Error_t aws_iot_mqtt_reset_metrics(AWS_IoT_Client *pClient);
+
+/**
+ * @brief Update the queue depth gauge
+ *
+ * Called by the layers queueing requests on top of the client (shadow, jobs)
+ * when the number of requests waiting for a response changes
+ *
+ * @param pClient Reference to the IoT Client
+ * @param depth Number of requests waiting for a response
+ */
+void aws_iot_mqtt_metrics_set_queue_depth(AWS_IoT_Client *pClient, uint32_t depth);
+
+/**
+ * @brief Serialize metrics to compact JSON
+ *
+ * Packet types and error codes with no occurrence are left out, as are the trailing
+ * empty histogram buckets. Pass a NULL buffer to get the required size
+ *
+ * @param pMetrics Metrics to serialize
+ * @param pBuffer Output buffer, can be NULL
+ * @param bufferSize Size of pBuffer
+ *
+ * @return int Length of the document without the terminating null character, -1 on error
+ */
+int aws_iot_mqtt_metrics_serialize(const IoT_Client_Metrics *pMetrics, char *pBuffer, size_t bufferSize);
+
+/**
+ * @brief Publish the client metrics
+ *
+ * Called to publish the serialized metrics of the client with QoS0 on the given topic.
+ * The document is built in a buffer of the caller, so that it does not take the
+ * stack of the task publishing it
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic to publish to
+ * @param topicNameLen Length of the topic name
+ * @param pBuffer Buffer the document is serialized in
+ * @param bufferSize Size of pBuffer
+ *
+ * @return IoT_Error_t Type defining successful/failed API call, MQTT_TX_BUFFER_TOO_SHORT_ERROR if the document does not fit
+ */
+IoT_Error_t aws_iot_mqtt_publish_metrics(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+										 char *pBuffer, size_t bufferSize);
+#endif
+
 /**
  * @brief Reset Network Disconnect conter
  *
@@ -264,6 +264,87 @@ IoT_Error_t aws_iot_mqtt_internal_init_header(MQTTHeader *pHeader, MessageTypes
 	FUNC_EXIT_RC(SUCCESS);
 }
 
+/**
+ * @brief Arm the keep-alive timers after a successful connect
+ *
+ * The adaptive interval learnt on a previous session is kept, bounded by the
+ * keep-alive interval negotiated for this one
+ */
+void aws_iot_mqtt_internal_keep_alive_start(AWS_IoT_Client *pClient) {
+	uint16_t ceiling = pClient->clientData.keepAliveInterval;
+
+	if(0 == pClient->clientData.pingIntervalSec || ceiling < pClient->clientData.pingIntervalSec) {
+		pClient->clientData.pingIntervalSec = ceiling;
+	}
+
+	pClient->clientStatus.isPingOutstanding = false;
+	countdown_sec(&pClient->pingTimer, pClient->clientData.pingIntervalSec);
+	countdown_sec(&pClient->sendDeadlineTimer, ceiling);
+}
+
+/**
+ * @brief The link survived a full idle interval, after enough of them try a longer one
+ *
+ * Growth stops one step below the last interval that dropped. After a long run of
+ * successes there that bound moves up one step, so a NAT timeout that was raised or
+ * a drop that was not caused by idling is eventually forgotten
+ */
+static void _aws_iot_mqtt_internal_grow_ping_interval(AWS_IoT_Client *pClient) {
+	uint16_t ceiling = pClient->clientData.keepAliveInterval;
+	uint16_t dropped = pClient->clientData.pingDroppedIntervalSec;
+
+	if(0 != dropped) {
+		dropped = dropped > AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC ? dropped - AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC : dropped;
+		if(dropped < ceiling) {
+			ceiling = dropped;
+		}
+	}
+
+	pClient->clientData.pingSuccessStreak++;
+	if(ceiling <= pClient->clientData.pingIntervalSec) {
+		if(0 != pClient->clientData.pingDroppedIntervalSec &&
+		   AWS_IOT_MQTT_KEEPALIVE_RETRY_AFTER <= pClient->clientData.pingSuccessStreak) {
+			pClient->clientData.pingSuccessStreak = 0;
+			pClient->clientData.pingDroppedIntervalSec += AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC;
+			if(pClient->clientData.keepAliveInterval < pClient->clientData.pingDroppedIntervalSec) {
+				pClient->clientData.pingDroppedIntervalSec = 0;
+			}
+		}
+		return;
+	}
+	if(AWS_IOT_MQTT_KEEPALIVE_GROW_AFTER <= pClient->clientData.pingSuccessStreak) {
+		pClient->clientData.pingSuccessStreak = 0;
+		pClient->clientData.pingIntervalSec += AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC;
+		if(ceiling < pClient->clientData.pingIntervalSec) {
+			pClient->clientData.pingIntervalSec = ceiling;
+		}
+		countdown_sec(&pClient->pingTimer, pClient->clientData.pingIntervalSec);
+	}
+}
+
+/**
+ * @brief Any successful traffic proves the link is alive
+ *
+ * Inbound packets also answer an outstanding ping. Only outbound packets push the
+ * send deadline, the broker expects a packet from us within the negotiated interval
+ */
+void aws_iot_mqtt_internal_keep_alive_on_traffic(AWS_IoT_Client *pClient, bool isOutbound) {
+	if(0 == pClient->clientData.keepAliveInterval) {
+		return;
+	}
+
+	if(isOutbound) {
+		countdown_sec(&pClient->sendDeadlineTimer, pClient->clientData.keepAliveInterval);
+		if(pClient->clientStatus.isPingOutstanding) {
+			/* bytes accepted by the stack do not answer the ping */
+			return;
+		}
+	}
+
+	pClient->clientStatus.isPingOutstanding = false;
+	countdown_sec(&pClient->pingTimer, pClient->clientData.pingIntervalSec);
+}
+
 IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t length, Timer *pTimer) {
 
 	size_t sentLen, sent;
@@ -311,7 +392,8 @@ IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t le
 
 	if(sent == length) {
 		/* record the fact that we have successfully sent the packet */
-		//countdown_sec(&c->pingTimer, c->clientData.keepAliveInterval);
+		aws_iot_mqtt_internal_keep_alive_on_traffic(pClient, true);
+		IOT_METRICS_PACKET(pClient, true, pClient->clientData.writeBuf[0], length);
 		FUNC_EXIT_RC(SUCCESS);
 	}
 
@@ -378,6 +460,109 @@ static IoT_Error_t _aws_iot_mqtt_internal_decode_packet_remaining_len(AWS_IoT_Cl
 	FUNC_EXIT_RC(rc);
 }
 
+static bool _aws_iot_mqtt_internal_is_topic_matched(char *pTopicFilter, char *pTopicName, uint16_t topicNameLen);
+
+static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClient, char *pTopicName,
+														  uint16_t topicNameLen,
+														  IoT_Publish_Message_Params *pMessageParams, bool isFragment);
+
+/**
+ * A PUBLISH that does not fit in the read buffer. When a subscription matching
+ * its topic accepts fragments, the variable header is kept at the start of the
+ * buffer and the payload is read in chunks of the space left after it, each
+ * chunk delivered as it arrives. Returns MQTT_RX_BUFFER_TOO_SHORT_ERROR when
+ * nobody wants the message, the caller then drops the rest of it.
+ */
+static IoT_Error_t _aws_iot_mqtt_internal_read_fragmented_publish(AWS_IoT_Client *pClient, Timer *pTimer,
+																   size_t offset, size_t rem_len) {
+	IoT_Publish_Message_Params msg;
+	MQTTHeader header = {0};
+	IoT_Error_t rc;
+	size_t read_len, headerLen, chunkLen, chunkMax;
+	uint32_t itr, ackLen;
+	uint16_t topicNameLen;
+	char *pTopicName;
+	bool isWanted = false;
+
+	header.byte = pClient->clientData.readBuf[0];
+	msg.qos = (QoS) MQTT_HEADER_FIELD_QOS(header.byte);
+	msg.isDup = MQTT_HEADER_FIELD_DUP(header.byte);
+	msg.isRetained = MQTT_HEADER_FIELD_RETAIN(header.byte);
+	msg.id = 0;
+
+	rc = _aws_iot_mqtt_internal_readWrapper(pClient, offset, 2, pTimer, &read_len);
+	if(SUCCESS != rc || 2 != read_len) {
+		return FAILURE;
+	}
+	topicNameLen = (uint16_t) ((pClient->clientData.readBuf[offset] << 8) | pClient->clientData.readBuf[offset + 1]);
+	headerLen = 2 + (size_t) topicNameLen + ((QOS0 != msg.qos) ? 2 : 0);
+	if(headerLen > rem_len || offset + headerLen >= pClient->clientData.readBufSize) {
+		return MQTT_RX_BUFFER_TOO_SHORT_ERROR;
+	}
+
+	rc = _aws_iot_mqtt_internal_readWrapper(pClient, offset + 2, headerLen - 2, pTimer, &read_len);
+	if(SUCCESS != rc || headerLen - 2 != read_len) {
+		return FAILURE;
+	}
+	pTopicName = (char *) &pClient->clientData.readBuf[offset + 2];
+	if(QOS0 != msg.qos) {
+		msg.id = (uint16_t) ((pClient->clientData.readBuf[offset + headerLen - 2] << 8)
+							 | pClient->clientData.readBuf[offset + headerLen - 1]);
+	}
+
+	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS && !isWanted; ++itr) {
+		isWanted = pClient->clientData.messageHandlers[itr].isFragmented
+				   && NULL != pClient->clientData.messageHandlers[itr].topicName
+				   && _aws_iot_mqtt_internal_is_topic_matched((char *) pClient->clientData.messageHandlers[itr].topicName,
+															  pTopicName, topicNameLen);
+	}
+	if(!isWanted) {
+		return MQTT_RX_BUFFER_TOO_SHORT_ERROR;
+	}
+
+	msg.payload = &pClient->clientData.readBuf[offset + headerLen];
+	msg.payloadOffset = 0;
+	msg.totalPayloadLen = rem_len - headerLen;
+	chunkMax = pClient->clientData.readBufSize - offset - headerLen;
+
+	do {
+		chunkLen = msg.totalPayloadLen - msg.payloadOffset;
+		if(chunkLen > chunkMax) {
+			chunkLen = chunkMax;
+		}
+		pClient->clientData.readBufIndex = offset + headerLen;
+		rc = _aws_iot_mqtt_internal_readWrapper(pClient, offset + headerLen, chunkLen, pTimer, &read_len);
+		if(SUCCESS != rc || chunkLen != read_len) {
+			aws_iot_mqtt_internal_flushBuffers(pClient);
+			return FAILURE;
+		}
+		msg.payloadLen = chunkLen;
+		if(msg.payloadOffset + chunkLen == msg.totalPayloadLen) {
+			/* the whole packet is read, handlers may use the client again from the last fragment */
+			aws_iot_mqtt_internal_flushBuffers(pClient);
+			IOT_METRICS_PACKET(pClient, false, header.byte, offset + rem_len);
+		}
+		rc = _aws_iot_mqtt_internal_deliver_message(pClient, pTopicName, topicNameLen, &msg, true);
+		if(SUCCESS != rc) {
+			return rc;
+		}
+		msg.payloadOffset += chunkLen;
+	} while(msg.payloadOffset < msg.totalPayloadLen);
+
+	if(QOS0 != msg.qos) {
+		rc = aws_iot_mqtt_internal_serialize_ack(pClient->clientData.writeBuf, pClient->clientData.writeBufSize,
+												 PUBACK, 0, msg.id, &ackLen);
+		if(SUCCESS == rc) {
+			rc = aws_iot_mqtt_internal_send_packet(pClient, ackLen, pTimer);
+		}
+		if(SUCCESS != rc) {
+			return rc;
+		}
+	}
+
+	return MQTT_RX_MESSAGE_FRAGMENTED;
+}
+
 static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, Timer *pTimer, uint8_t *pPacketType) {
 	size_t rem_len, total_bytes_read, bytes_to_be_read, read_len;
 	IoT_Error_t rc;
@@ -406,10 +591,26 @@ static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, T
 		return rc;
 	} 
      
-	/* if the buffer is too short then the message will be dropped silently */
+	/* if the buffer is too short then the message will be dropped silently,
+	 * unless it is a PUBLISH that a subscription takes in fragments */
 	if((rem_len + offset) >= pClient->clientData.readBufSize) {
-		bytes_to_be_read = pClient->clientData.readBufSize;
-		do {
+		header.byte = pClient->clientData.readBuf[0];
+		if(PUBLISH == MQTT_HEADER_FIELD_TYPE(header.byte)) {
+			*pPacketType = PUBLISH;
+			rc = _aws_iot_mqtt_internal_read_fragmented_publish(pClient, &packetTimer, offset, rem_len);
+			if(MQTT_RX_BUFFER_TOO_SHORT_ERROR != rc) {
+				return rc;
+			}
+		}
+
+		/* part of the variable header may have been read already */
+		total_bytes_read = pClient->clientData.readBufIndex - offset;
+		bytes_to_be_read = rem_len - total_bytes_read;
+		if(bytes_to_be_read > pClient->clientData.readBufSize) {
+			bytes_to_be_read = pClient->clientData.readBufSize;
+		}
+		rc = SUCCESS;
+		while(total_bytes_read < rem_len && SUCCESS == rc) {
 			rc = pClient->networkStack.read(&(pClient->networkStack), pClient->clientData.readBuf, bytes_to_be_read,
 											pTimer, &read_len);
 			if(SUCCESS == rc) {
@@ -420,7 +621,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, T
 					bytes_to_be_read = rem_len - total_bytes_read;
 				}
 			}
-		} while(total_bytes_read < rem_len && SUCCESS == rc);
+		}
 
         /* Check buffer was correctly emptied, otherwise, return error message. */
         if ( total_bytes_read == rem_len )
@@ -446,6 +647,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_read_packet(AWS_IoT_Client *pClient, T
     aws_iot_mqtt_internal_flushBuffers( pClient );
 	header.byte = pClient->clientData.readBuf[0];
 	*pPacketType = MQTT_HEADER_FIELD_TYPE(header.byte);
+	IOT_METRICS_PACKET(pClient, false, header.byte, offset + rem_len);
 
 	FUNC_EXIT_RC(rc);
 }
@@ -491,7 +693,7 @@ static bool _aws_iot_mqtt_internal_is_topic_matched(char *pTopicFilter, char *pT
 
 static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClient, char *pTopicName,
 														  uint16_t topicNameLen,
-														  IoT_Publish_Message_Params *pMessageParams) {
+														  IoT_Publish_Message_Params *pMessageParams, bool isFragment) {
 	uint32_t itr;
 	IoT_Error_t rc;
 	ClientState clientState;
@@ -510,7 +712,8 @@ static IoT_Error_t _aws_iot_mqtt_internal_deliver_message(AWS_IoT_Client *pClien
 
 	/* Find the right message handler - indexed by topic */
 	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++itr) {
-		if(NULL != pClient->clientData.messageHandlers[itr].topicName) {
+		if(NULL != pClient->clientData.messageHandlers[itr].topicName
+		   && (!isFragment || pClient->clientData.messageHandlers[itr].isFragmented)) {
 			if(((topicNameLen == pClient->clientData.messageHandlers[itr].topicNameLen)
 				&&
 				(strncmp(pTopicName, (char *) pClient->clientData.messageHandlers[itr].topicName, topicNameLen) == 0))
@@ -552,7 +755,9 @@ static IoT_Error_t _aws_iot_mqtt_internal_handle_publish(AWS_IoT_Client *pClient
 		FUNC_EXIT_RC(rc);
 	}
 
-	rc = _aws_iot_mqtt_internal_deliver_message(pClient, topicName, topicNameLen, &msg);
+	msg.payloadOffset = 0;
+	msg.totalPayloadLen = msg.payloadLen;
+	rc = _aws_iot_mqtt_internal_deliver_message(pClient, topicName, topicNameLen, &msg, false);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
 	}
@@ -609,10 +814,16 @@ IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTi
 	if(MQTT_NOTHING_TO_READ == rc) {
 		/* Nothing to read, not a cycle failure */
 		return SUCCESS;
+	} else if(MQTT_RX_MESSAGE_FRAGMENTED == rc) {
+		/* already delivered and acknowledged while it was read */
+		aws_iot_mqtt_internal_keep_alive_on_traffic(pClient, false);
+		return SUCCESS;
 	} else if(SUCCESS != rc) {
 		return rc;
 	}
 
+	aws_iot_mqtt_internal_keep_alive_on_traffic(pClient, false);
+
 	switch(*pPacketType) {
 		case CONNACK:
 		case PUBACK:
@@ -629,8 +840,10 @@ IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTi
 			/* QoS2 not supported at this time */
 			break;
 		case PINGRESP: {
-			pClient->clientStatus.isPingOutstanding = 0;
-			countdown_sec(&pClient->pingTimer, pClient->clientData.keepAliveInterval);
+			if(pClient->clientStatus.isIdlePing) {
+				pClient->clientStatus.isIdlePing = false;
+				_aws_iot_mqtt_internal_grow_ping_interval(pClient);
+			}
 			break;
 		}
 		default: {
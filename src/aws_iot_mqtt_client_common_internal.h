@@ -104,6 +104,8 @@ unsigned char aws_iot_mqtt_internal_read_char(unsigned char **pptr);
 void aws_iot_mqtt_internal_write_char(unsigned char **pptr, unsigned char c);
 void aws_iot_mqtt_internal_write_utf8_string(unsigned char **pptr, const char *string, uint16_t stringLen);
 
+void aws_iot_mqtt_internal_keep_alive_start(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_keep_alive_on_traffic(AWS_IoT_Client *pClient, bool isOutbound);
 IoT_Error_t aws_iot_mqtt_internal_flushBuffers( AWS_IoT_Client *pClient );
 IoT_Error_t aws_iot_mqtt_internal_send_packet(AWS_IoT_Client *pClient, size_t length, Timer *pTimer);
 IoT_Error_t aws_iot_mqtt_internal_cycle_read(AWS_IoT_Client *pClient, Timer *pTimer, uint8_t *pPacketType);
@@ -119,6 +121,37 @@ IoT_Error_t aws_iot_mqtt_internal_deserialize_publish(uint8_t *dup, QoS *qos,
 IoT_Error_t aws_iot_mqtt_set_client_state(AWS_IoT_Client *pClient, ClientState expectedCurrentState,
 										  ClientState newState);
 
+#ifndef DISABLE_IOT_CLIENT_METRICS
+
+void aws_iot_mqtt_internal_stopwatch_start(Timer *pTimer);
+uint32_t aws_iot_mqtt_internal_stopwatch_ms(Timer *pTimer);
+void aws_iot_mqtt_internal_metrics_packet(AWS_IoT_Client *pClient, bool isOutbound, unsigned char header, size_t len);
+void aws_iot_mqtt_internal_metrics_error(IoT_Metrics_Errors *pErrors, IoT_Error_t rc);
+void aws_iot_mqtt_internal_metrics_latency(IoT_Metrics_Histogram *pHistogram, uint32_t ms);
+void aws_iot_mqtt_internal_metrics_yield_enter(AWS_IoT_Client *pClient);
+void aws_iot_mqtt_internal_metrics_yield_exit(AWS_IoT_Client *pClient);
+
+#define IOT_METRICS_PACKET(pClient, isOutbound, header, len) aws_iot_mqtt_internal_metrics_packet(pClient, isOutbound, header, len)
+#define IOT_METRICS_ERROR(pClient, table, rc) aws_iot_mqtt_internal_metrics_error(&(pClient)->clientData.metrics.table, rc)
+#define IOT_METRICS_COUNT(pClient, counter) ((pClient)->clientData.metrics.counter++)
+#define IOT_METRICS_STOPWATCH_START(pTimer) aws_iot_mqtt_internal_stopwatch_start(pTimer)
+#define IOT_METRICS_LATENCY(pClient, histogram, pTimer) \
+	aws_iot_mqtt_internal_metrics_latency(&(pClient)->clientData.metrics.histogram, aws_iot_mqtt_internal_stopwatch_ms(pTimer))
+#define IOT_METRICS_YIELD_ENTER(pClient) aws_iot_mqtt_internal_metrics_yield_enter(pClient)
+#define IOT_METRICS_YIELD_EXIT(pClient) aws_iot_mqtt_internal_metrics_yield_exit(pClient)
+
+#else
+
+#define IOT_METRICS_PACKET(pClient, isOutbound, header, len)
+#define IOT_METRICS_ERROR(pClient, table, rc)
+#define IOT_METRICS_COUNT(pClient, counter)
+#define IOT_METRICS_STOPWATCH_START(pTimer)
+#define IOT_METRICS_LATENCY(pClient, histogram, pTimer)
+#define IOT_METRICS_YIELD_ENTER(pClient)
+#define IOT_METRICS_YIELD_EXIT(pClient)
+
+#endif
+
 #ifdef _ENABLE_THREAD_SUPPORT_
 
 IoT_Error_t aws_iot_mqtt_client_lock_mutex(AWS_IoT_Client *pClient, IoT_Mutex_t *pMutex);
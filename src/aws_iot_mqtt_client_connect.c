@@ -398,11 +398,13 @@ static IoT_Error_t _aws_iot_mqtt_internal_connect(AWS_IoT_Client *pClient, IoT_C
 		}
 	}
 
+	IOT_METRICS_STOPWATCH_START(&connect_timer);
 	rc = pClient->networkStack.connect(&(pClient->networkStack), NULL);
 	if(SUCCESS != rc) {
 		/* TLS Connect failed, return error */
 		FUNC_EXIT_RC(rc);
 	}
+	IOT_METRICS_LATENCY(pClient, handshakeTime, &connect_timer);
 
 	init_timer(&connect_timer);
 	countdown_ms(&connect_timer, pClient->clientData.commandTimeoutMs);
@@ -437,8 +439,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_connect(AWS_IoT_Client *pClient, IoT_C
 		FUNC_EXIT_RC(connack_rc);
 	}
 
-	pClient->clientStatus.isPingOutstanding = false;
-	countdown_sec(&pClient->pingTimer, pClient->clientData.keepAliveInterval);
+	aws_iot_mqtt_internal_keep_alive_start(pClient);
 
 	FUNC_EXIT_RC(SUCCESS);
 }
@@ -485,6 +486,10 @@ IoT_Error_t aws_iot_mqtt_connect(AWS_IoT_Client *pClient, IoT_Client_Connect_Par
 		aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTING, CLIENT_STATE_DISCONNECTED_ERROR);
 	} else {
 		aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTING, CLIENT_STATE_CONNECTED_IDLE);
+		/* whoever connected, the reconnect state machine starts over from the next disconnect */
+		pClient->clientData.reconnectState = RECONNECT_STATE_IDLE;
+		pClient->clientData.reconnectAttempts = 0;
+		pClient->clientData.currentReconnectWaitInterval = AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL;
 	}
 
 	FUNC_EXIT_RC(rc);
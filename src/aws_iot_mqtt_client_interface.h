@@ -132,6 +132,27 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
 								   QoS qos, pApplicationHandler_t pApplicationHandler, void *pApplicationHandlerData);
 
+/**
+ * @brief Deliver messages larger than the read buffer in fragments
+ *
+ * By default an incoming message that does not fit in AWS_IOT_MQTT_RX_BUF_LEN
+ * is read and dropped. Once enabled on a subscription, its handler is called
+ * once per fragment instead: payload and payloadLen hold the fragment,
+ * payloadOffset its position in the message and totalPayloadLen the size of
+ * the whole payload. Fragments of a message are delivered in order, the
+ * topic name and the other parameters are the same for all of them. Messages
+ * that fit are still delivered whole, with payloadOffset 0.
+ *
+ * @param pClient Reference to the IoT Client
+ * @param pTopicName Topic filter of an existing subscription
+ * @param topicNameLen Length of the topic filter
+ * @param isEnabled true to deliver large messages in fragments, false to drop them
+ *
+ * @return SUCCESS, or FAILURE if there is no such subscription
+ */
+IoT_Error_t aws_iot_mqtt_set_fragmented_delivery(AWS_IoT_Client *pClient, const char *pTopicName,
+												 uint16_t topicNameLen, bool isEnabled);
+
 /**
  * @brief Subscribe to an MQTT topic.
  *
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_mqtt_client_metrics.c
+ * @brief Per client counters, gauges and latency histograms
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "aws_iot_json_writer.h"
+#include "aws_iot_mqtt_client_common_internal.h"
+
+#ifndef DISABLE_IOT_CLIENT_METRICS
+
+/* Durations are measured with a long countdown timer, see aws_iot_mqtt_internal_stopwatch_start */
+#define IOT_METRICS_STOPWATCH_SPAN_MS 3600000
+
+static const uint32_t histogramBoundsMs[IOT_METRICS_HISTOGRAM_BUCKETS - 1] = {
+	1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000
+};
+
+void aws_iot_mqtt_internal_stopwatch_start(Timer *pTimer) {
+	init_timer(pTimer);
+	countdown_ms(pTimer, IOT_METRICS_STOPWATCH_SPAN_MS);
+}
+
+uint32_t aws_iot_mqtt_internal_stopwatch_ms(Timer *pTimer) {
+	return IOT_METRICS_STOPWATCH_SPAN_MS - left_ms(pTimer);
+}
+
+void aws_iot_mqtt_internal_metrics_packet(AWS_IoT_Client *pClient, bool isOutbound, unsigned char header, size_t len) {
+	uint8_t type = (uint8_t) (header >> 4);
+
+	if(isOutbound) {
+		pClient->clientData.metrics.packetsOut[type]++;
+		pClient->clientData.metrics.bytesOut[type] += (uint32_t) len;
+	} else {
+		pClient->clientData.metrics.packetsIn[type]++;
+		pClient->clientData.metrics.bytesIn[type] += (uint32_t) len;
+	}
+}
+
+void aws_iot_mqtt_internal_metrics_error(IoT_Metrics_Errors *pErrors, IoT_Error_t rc) {
+	uint8_t i;
+
+	for(i = 0; i < IOT_METRICS_MAX_ERROR_CODES; i++) {
+		if(0 == pErrors->rc[i]) {
+			pErrors->rc[i] = (int16_t) rc;
+		}
+		if((int16_t) rc == pErrors->rc[i]) {
+			pErrors->count[i]++;
+			return;
+		}
+	}
+	pErrors->otherErrors++;
+}
+
+void aws_iot_mqtt_internal_metrics_latency(IoT_Metrics_Histogram *pHistogram, uint32_t ms) {
+	uint8_t i;
+
+	for(i = 0; i < IOT_METRICS_HISTOGRAM_BUCKETS - 1; i++) {
+		if(ms <= histogramBoundsMs[i]) {
+			break;
+		}
+	}
+	pHistogram->buckets[i]++;
+	pHistogram->count++;
+	pHistogram->sumMs += ms;
+	if(ms > pHistogram->maxMs) {
+		pHistogram->maxMs = ms;
+	}
+}
+
+void aws_iot_mqtt_internal_metrics_yield_enter(AWS_IoT_Client *pClient) {
+	if(pClient->clientData.isMetricsYieldTimerRunning) {
+		aws_iot_mqtt_internal_metrics_latency(&pClient->clientData.metrics.yieldLag,
+											  aws_iot_mqtt_internal_stopwatch_ms(&pClient->clientData.metricsYieldTimer));
+	}
+}
+
+void aws_iot_mqtt_internal_metrics_yield_exit(AWS_IoT_Client *pClient) {
+	aws_iot_mqtt_internal_stopwatch_start(&pClient->clientData.metricsYieldTimer);
+	pClient->clientData.isMetricsYieldTimerRunning = true;
+}
+
+IoT_Error_t aws_iot_mqtt_get_metrics(AWS_IoT_Client *pClient, IoT_Client_Metrics *pSnapshot) {
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pSnapshot) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	/* Counters are updated without locking, a snapshot taken while traffic flows may be
+	 * off by the packets in flight */
+	memcpy(pSnapshot, &pClient->clientData.metrics, sizeof(IoT_Client_Metrics));
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_mqtt_reset_metrics(AWS_IoT_Client *pClient) {
+	FUNC_ENTRY;
+
+	if(NULL == pClient) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	memset(&pClient->clientData.metrics, 0, sizeof(IoT_Client_Metrics));
+	pClient->clientData.isMetricsYieldTimerRunning = false;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+void aws_iot_mqtt_metrics_set_queue_depth(AWS_IoT_Client *pClient, uint32_t depth) {
+	if(NULL == pClient) {
+		return;
+	}
+
+	pClient->clientData.metrics.queueDepth = depth;
+	if(depth > pClient->clientData.metrics.queueDepthMax) {
+		pClient->clientData.metrics.queueDepthMax = depth;
+	}
+}
+
+static void _writeNumberKey(JsonWriter_t *pWriter, int64_t key) {
+	jsonWriteChar(pWriter, '"');
+	jsonWriteInt(pWriter, key);
+	jsonWriteRaw(pWriter, "\":", 2);
+}
+
+static void _writePackets(JsonWriter_t *pWriter, const char *key, const uint32_t *pPackets, const uint32_t *pBytes) {
+	bool first = true;
+	uint8_t i;
+
+	jsonWriteKey(pWriter, key);
+	jsonWriteChar(pWriter, '{');
+	for(i = 0; i < IOT_METRICS_PACKET_TYPES; i++) {
+		if(0 != pPackets[i]) {
+			if(!first) {
+				jsonWriteChar(pWriter, ',');
+			}
+			_writeNumberKey(pWriter, i);
+			jsonWriteChar(pWriter, '[');
+			jsonWriteUint(pWriter, pPackets[i]);
+			jsonWriteChar(pWriter, ',');
+			jsonWriteUint(pWriter, pBytes[i]);
+			jsonWriteChar(pWriter, ']');
+			first = false;
+		}
+	}
+	jsonWriteChar(pWriter, '}');
+}
+
+static void _writeErrors(JsonWriter_t *pWriter, const char *key, const IoT_Metrics_Errors *pErrors) {
+	uint8_t i;
+
+	jsonWriteChar(pWriter, ',');
+	jsonWriteKey(pWriter, key);
+	jsonWriteChar(pWriter, '{');
+	for(i = 0; i < IOT_METRICS_MAX_ERROR_CODES && 0 != pErrors->rc[i]; i++) {
+		if(0 != i) {
+			jsonWriteChar(pWriter, ',');
+		}
+		_writeNumberKey(pWriter, pErrors->rc[i]);
+		jsonWriteUint(pWriter, pErrors->count[i]);
+	}
+	if(0 != pErrors->otherErrors) {
+		if(0 != i) {
+			jsonWriteChar(pWriter, ',');
+		}
+		jsonWriteKey(pWriter, "other");
+		jsonWriteUint(pWriter, pErrors->otherErrors);
+	}
+	jsonWriteChar(pWriter, '}');
+}
+
+static void _writePair(JsonWriter_t *pWriter, const char *key, uint32_t first, uint32_t second) {
+	jsonWriteChar(pWriter, ',');
+	jsonWriteKey(pWriter, key);
+	jsonWriteChar(pWriter, '[');
+	jsonWriteUint(pWriter, first);
+	jsonWriteChar(pWriter, ',');
+	jsonWriteUint(pWriter, second);
+	jsonWriteChar(pWriter, ']');
+}
+
+static void _writeHistogram(JsonWriter_t *pWriter, const char *key, const IoT_Metrics_Histogram *pHistogram) {
+	int8_t last = IOT_METRICS_HISTOGRAM_BUCKETS - 1;
+	int8_t i;
+
+	/* trailing empty buckets are implicit */
+	while(last >= 0 && 0 == pHistogram->buckets[last]) {
+		last--;
+	}
+
+	jsonWriteChar(pWriter, ',');
+	jsonWriteKey(pWriter, key);
+	jsonWriteRaw(pWriter, "{\"n\":", 5);
+	jsonWriteUint(pWriter, pHistogram->count);
+	jsonWriteRaw(pWriter, ",\"sum\":", 7);
+	jsonWriteUint(pWriter, pHistogram->sumMs);
+	jsonWriteRaw(pWriter, ",\"max\":", 7);
+	jsonWriteUint(pWriter, pHistogram->maxMs);
+	jsonWriteRaw(pWriter, ",\"b\":[", 6);
+	for(i = 0; i <= last; i++) {
+		if(0 != i) {
+			jsonWriteChar(pWriter, ',');
+		}
+		jsonWriteUint(pWriter, pHistogram->buckets[i]);
+	}
+	jsonWriteRaw(pWriter, "]}", 2);
+}
+
+int aws_iot_mqtt_metrics_serialize(const IoT_Client_Metrics *pMetrics, char *pBuffer, size_t bufferSize) {
+	JsonWriter_t writer;
+
+	if(NULL == pMetrics) {
+		return -1;
+	}
+
+	jsonWriterInit(&writer, pBuffer, bufferSize);
+	jsonWriteChar(&writer, '{');
+	_writePackets(&writer, "out", pMetrics->packetsOut, pMetrics->bytesOut);
+	jsonWriteChar(&writer, ',');
+	_writePackets(&writer, "in", pMetrics->packetsIn, pMetrics->bytesIn);
+	_writeErrors(&writer, "pubErr", &pMetrics->publishErrors);
+	_writeErrors(&writer, "subErr", &pMetrics->subscribeErrors);
+	_writePair(&writer, "reconnect", pMetrics->reconnectAttempts, pMetrics->reconnectSuccesses);
+	_writePair(&writer, "queue", pMetrics->queueDepth, pMetrics->queueDepthMax);
+	_writeHistogram(&writer, "ackMs", &pMetrics->qos1AckLatency);
+	_writeHistogram(&writer, "handshakeMs", &pMetrics->handshakeTime);
+	_writeHistogram(&writer, "yieldLagMs", &pMetrics->yieldLag);
+	jsonWriteChar(&writer, '}');
+
+	return (int) jsonWriterTerminate(&writer);
+}
+
+IoT_Error_t aws_iot_mqtt_publish_metrics(AWS_IoT_Client *pClient, const char *pTopicName, uint16_t topicNameLen,
+										 char *pBuffer, size_t bufferSize) {
+	IoT_Client_Metrics snapshot;
+	IoT_Publish_Message_Params params;
+	int len;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pBuffer) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	rc = aws_iot_mqtt_get_metrics(pClient, &snapshot);
+	if(SUCCESS != rc) {
+		FUNC_EXIT_RC(rc);
+	}
+
+	len = aws_iot_mqtt_metrics_serialize(&snapshot, pBuffer, bufferSize);
+	if(len < 0) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+	if((size_t) len >= bufferSize) {
+		FUNC_EXIT_RC(MQTT_TX_BUFFER_TOO_SHORT_ERROR);
+	}
+
+	params.qos = QOS0;
+	params.isRetained = 0;
+	params.id = 0;
+	params.payload = (void *) pBuffer;
+	params.payloadLen = (size_t) len;
+
+	rc = aws_iot_mqtt_publish(pClient, pTopicName, topicNameLen, &params);
+	FUNC_EXIT_RC(rc);
+}
+
+#endif /* DISABLE_IOT_CLIENT_METRICS */
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_mqtt_client_metrics.h
+ * @brief Per client counters, gauges and latency histograms
+ *
+ * Every AWS_IoT_Client keeps a metrics block updated by the MQTT layer.
+ * The application reads it with aws_iot_mqtt_get_metrics and can publish
+ * a compact JSON rendering of it with aws_iot_mqtt_publish_metrics.
+ * Define DISABLE_IOT_CLIENT_METRICS to compile the metrics out.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_MQTT_CLIENT_METRICS_H
+#define AWS_IOT_SDK_SRC_IOT_MQTT_CLIENT_METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "aws_iot_error.h"
+
+/**
+ * @brief Number of MQTT control packet types, indexed by the type field of the fixed header
+ */
+#define IOT_METRICS_PACKET_TYPES 16
+
+/**
+ * @brief Number of buckets of a latency histogram
+ *
+ * Bucket upper bounds are 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 and 10000 ms.
+ * The last bucket counts everything above.
+ */
+#define IOT_METRICS_HISTOGRAM_BUCKETS 14
+
+/**
+ * @brief Number of distinct error codes tracked per operation
+ *
+ * Failures with other codes are added to the otherErrors counter
+ */
+#define IOT_METRICS_MAX_ERROR_CODES 6
+
+/**
+ * @brief Fixed-bucket latency histogram
+ */
+typedef struct {
+	uint32_t buckets[IOT_METRICS_HISTOGRAM_BUCKETS];	///< Number of samples per bucket
+	uint32_t count;						///< Number of samples
+	uint32_t sumMs;						///< Sum of all samples. In milliseconds
+	uint32_t maxMs;						///< Largest sample. In milliseconds
+} IoT_Metrics_Histogram;
+
+/**
+ * @brief Failure counters of an operation, by error code
+ */
+typedef struct {
+	int16_t rc[IOT_METRICS_MAX_ERROR_CODES];		///< Error code of each slot, 0 if unused
+	uint32_t count[IOT_METRICS_MAX_ERROR_CODES];		///< Number of failures with that code
+	uint32_t otherErrors;					///< Failures that did not fit in the table
+} IoT_Metrics_Errors;
+
+/**
+ * @brief Metrics block of an MQTT client
+ */
+typedef struct {
+	uint32_t packetsOut[IOT_METRICS_PACKET_TYPES];		///< Packets sent, per packet type
+	uint32_t packetsIn[IOT_METRICS_PACKET_TYPES];		///< Packets received, per packet type
+	uint32_t bytesOut[IOT_METRICS_PACKET_TYPES];		///< Bytes sent, per packet type
+	uint32_t bytesIn[IOT_METRICS_PACKET_TYPES];		///< Bytes received, per packet type
+	IoT_Metrics_Errors publishErrors;			///< aws_iot_mqtt_publish failures
+	IoT_Metrics_Errors subscribeErrors;			///< aws_iot_mqtt_subscribe failures
+	uint32_t reconnectAttempts;				///< Auto-reconnect attempts
+	uint32_t reconnectSuccesses;				///< Successful auto-reconnects
+	uint32_t queueDepth;					///< Requests waiting for a response (gauge)
+	uint32_t queueDepthMax;					///< High water mark of queueDepth
+	IoT_Metrics_Histogram qos1AckLatency;			///< PUBLISH to PUBACK time of QoS1 messages
+	IoT_Metrics_Histogram handshakeTime;			///< Network (TCP + TLS) connect time
+	IoT_Metrics_Histogram yieldLag;				///< Time between two consecutive yield calls
+} IoT_Client_Metrics;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_MQTT_CLIENT_METRICS_H */
@@ -197,6 +197,9 @@ IoT_Error_t aws_iot_mqtt_internal_serialize_ack(unsigned char *pTxBuf, size_t tx
 static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const char *pTopicName,
 												  uint16_t topicNameLen, IoT_Publish_Message_Params *pParams) {
 	Timer timer;
+#ifndef DISABLE_IOT_CLIENT_METRICS
+	Timer ackTimer;
+#endif
 	uint32_t len = 0;
 	uint16_t packet_id;
 	unsigned char dup, type;
@@ -220,6 +223,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const
 	}
 
 	/* send the publish packet */
+	IOT_METRICS_STOPWATCH_START(&ackTimer);
 	rc = aws_iot_mqtt_internal_send_packet(pClient, len, &timer);
 	if(SUCCESS != rc) {
 		FUNC_EXIT_RC(rc);
@@ -237,6 +241,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_publish(AWS_IoT_Client *pClient, const
 		if(SUCCESS != rc) {
 			FUNC_EXIT_RC(rc);
 		}
+		IOT_METRICS_LATENCY(pClient, qos1AckLatency, &ackTimer);
 	}
 
 	FUNC_EXIT_RC(SUCCESS);
@@ -271,11 +276,13 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 	}
 
 	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		IOT_METRICS_ERROR(pClient, publishErrors, NETWORK_DISCONNECTED_ERROR);
 		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
 	}
 
 	clientState = aws_iot_mqtt_get_client_state(pClient);
 	if(CLIENT_STATE_CONNECTED_IDLE != clientState && CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN != clientState) {
+		IOT_METRICS_ERROR(pClient, publishErrors, MQTT_CLIENT_NOT_IDLE_ERROR);
 		FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
 	}
 
@@ -290,6 +297,9 @@ IoT_Error_t aws_iot_mqtt_publish(AWS_IoT_Client *pClient, const char *pTopicName
 	if(SUCCESS == pubRc && SUCCESS != rc) {
 		pubRc = rc;
 	}
+	if(SUCCESS != pubRc) {
+		IOT_METRICS_ERROR(pClient, publishErrors, pubRc);
+	}
 
 	FUNC_EXIT_RC(pubRc);
 }
@@ -269,6 +269,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_subscribe(AWS_IoT_Client *pClient, con
 	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].pApplicationHandlerData =
 			pApplicationHandlerData;
 	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].qos = qos;
+	pClient->clientData.messageHandlers[indexOfFreeMessageHandler].isFragmented = false;
 
 	FUNC_EXIT_RC(SUCCESS);
 }
@@ -305,11 +306,13 @@ IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicNa
 	}
 
 	if(!aws_iot_mqtt_is_client_connected(pClient)) {
+		IOT_METRICS_ERROR(pClient, subscribeErrors, NETWORK_DISCONNECTED_ERROR);
 		FUNC_EXIT_RC(NETWORK_DISCONNECTED_ERROR);
 	}
 
 	clientState = aws_iot_mqtt_get_client_state(pClient);
 	if(CLIENT_STATE_CONNECTED_IDLE != clientState && CLIENT_STATE_CONNECTED_WAIT_FOR_CB_RETURN != clientState) {
+		IOT_METRICS_ERROR(pClient, subscribeErrors, MQTT_CLIENT_NOT_IDLE_ERROR);
 		FUNC_EXIT_RC(MQTT_CLIENT_NOT_IDLE_ERROR);
 	}
 
@@ -325,10 +328,36 @@ IoT_Error_t aws_iot_mqtt_subscribe(AWS_IoT_Client *pClient, const char *pTopicNa
 	if(SUCCESS == subRc && SUCCESS != rc) {
 		subRc = rc;
 	}
+	if(SUCCESS != subRc) {
+		IOT_METRICS_ERROR(pClient, subscribeErrors, subRc);
+	}
 
 	FUNC_EXIT_RC(subRc);
 }
 
+IoT_Error_t aws_iot_mqtt_set_fragmented_delivery(AWS_IoT_Client *pClient, const char *pTopicName,
+												 uint16_t topicNameLen, bool isEnabled) {
+	uint32_t itr;
+	IoT_Error_t rc = FAILURE;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pTopicName) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; ++itr) {
+		if(NULL != pClient->clientData.messageHandlers[itr].topicName
+		   && topicNameLen == pClient->clientData.messageHandlers[itr].topicNameLen
+		   && 0 == strncmp(pTopicName, pClient->clientData.messageHandlers[itr].topicName, topicNameLen)) {
+			pClient->clientData.messageHandlers[itr].isFragmented = isEnabled;
+			rc = SUCCESS;
+		}
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
 /**
  * @brief Subscribe to an MQTT topic.
  *
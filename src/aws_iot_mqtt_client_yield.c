@@ -71,25 +71,123 @@ static IoT_Error_t _aws_iot_mqtt_handle_disconnect(AWS_IoT_Client *pClient) {
 }
 
 
+/**
+ * @brief Next value of the per-client pseudo random sequence used for the back-off jitter
+ *
+ * The sequence is seeded from the client ID so that devices sharing the same firmware and
+ * losing the connection at the same time do not retry in lockstep
+ */
+static uint32_t _aws_iot_mqtt_next_jitter_random(AWS_IoT_Client *pClient) {
+	uint32_t x = pClient->clientData.reconnectJitterSeed;
+	uint16_t i;
+
+	if(0 == x) {
+		/* FNV-1a of the client ID */
+		x = 2166136261u;
+		for(i = 0; i < pClient->clientData.options.clientIDLen; i++) {
+			x = (x ^ (uint8_t) pClient->clientData.options.pClientID[i]) * 16777619u;
+		}
+		x ^= pClient->clientData.counterNetworkDisconnected;
+		if(0 == x) {
+			x = 1;
+		}
+	}
+
+	/* xorshift32 */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	pClient->clientData.reconnectJitterSeed = x;
+
+	return x;
+}
+
+/**
+ * @brief Decorrelated jitter back-off
+ *
+ * next = min(MAX, random_between(MIN, previous * 3))
+ */
+static uint32_t _aws_iot_mqtt_next_reconnect_wait_interval(AWS_IoT_Client *pClient) {
+	uint32_t upper = pClient->clientData.currentReconnectWaitInterval;
+	uint32_t next;
+
+	if(upper > AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL / 3) {
+		upper = AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL;
+	} else {
+		upper *= 3;
+	}
+	if(upper <= AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL) {
+		return AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL;
+	}
+
+	next = AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL +
+		   _aws_iot_mqtt_next_jitter_random(pClient) % (upper - AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL + 1);
+	if(AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL < next) {
+		next = AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL;
+	}
+
+	return next;
+}
+
+/**
+ * @brief Enter the reconnect state machine after the connection was lost
+ *
+ * Transient errors (the physical layer is still up) get a first attempt after a
+ * random delay in [0, MIN), which spreads the clients a broker drop disconnects
+ * all at once, otherwise the state machine goes straight to back-off
+ */
+static void _aws_iot_mqtt_start_reconnect(AWS_IoT_Client *pClient) {
+	IoT_Error_t rc = NETWORK_PHYSICAL_LAYER_DISCONNECTED;
+
+	pClient->clientData.reconnectAttempts = 0;
+	pClient->clientData.currentReconnectWaitInterval = AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL;
+
+	if(NULL != pClient->networkStack.isConnected) {
+		rc = pClient->networkStack.isConnected(&(pClient->networkStack));
+	}
+
+	if(NETWORK_PHYSICAL_LAYER_CONNECTED == rc) {
+		pClient->clientData.reconnectState = RECONNECT_STATE_FAST_RETRY;
+		countdown_ms(&(pClient->reconnectDelayTimer),
+					 _aws_iot_mqtt_next_jitter_random(pClient) % AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL);
+	} else {
+		pClient->clientData.reconnectState = RECONNECT_STATE_BACKOFF;
+		pClient->clientData.currentReconnectWaitInterval = _aws_iot_mqtt_next_reconnect_wait_interval(pClient);
+		countdown_ms(&(pClient->reconnectDelayTimer), pClient->clientData.currentReconnectWaitInterval);
+	}
+}
+
 static IoT_Error_t _aws_iot_mqtt_handle_reconnect(AWS_IoT_Client *pClient) {
 	IoT_Error_t rc;
 
 	FUNC_ENTRY;
 
+	if(RECONNECT_STATE_IDLE == pClient->clientData.reconnectState) {
+		/* Reconnect pending without a disconnect seen by yield, e.g. a failed manual attempt */
+		_aws_iot_mqtt_start_reconnect(pClient);
+	}
+
 	if(!has_timer_expired(&(pClient->reconnectDelayTimer))) {
 		/* Timer has not expired. Not time to attempt reconnect yet.
 		 * Return attempting reconnect */
 		FUNC_EXIT_RC(NETWORK_ATTEMPTING_RECONNECT);
 	}
 
+	pClient->clientData.reconnectState = RECONNECT_STATE_ATTEMPTING;
+
 	rc = NETWORK_PHYSICAL_LAYER_DISCONNECTED;
 	if(NULL != pClient->networkStack.isConnected) {
 		rc = pClient->networkStack.isConnected(&(pClient->networkStack));
 	}
 
 	if(NETWORK_PHYSICAL_LAYER_CONNECTED == rc) {
+		IOT_METRICS_COUNT(pClient, reconnectAttempts);
 		rc = aws_iot_mqtt_attempt_reconnect(pClient);
 		if(NETWORK_RECONNECTED == rc) {
+			IOT_METRICS_COUNT(pClient, reconnectSuccesses);
+			pClient->clientData.reconnectState = RECONNECT_STATE_IDLE;
+			pClient->clientData.reconnectAttempts = 0;
+			pClient->clientData.currentReconnectWaitInterval = AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL;
 			rc = aws_iot_mqtt_set_client_state(pClient, CLIENT_STATE_CONNECTED_IDLE,
 											   CLIENT_STATE_CONNECTED_YIELD_IN_PROGRESS);
 			if(SUCCESS != rc) {
@@ -99,13 +197,13 @@ static IoT_Error_t _aws_iot_mqtt_handle_reconnect(AWS_IoT_Client *pClient) {
 		}
 	}
 
-	pClient->clientData.currentReconnectWaitInterval *= 2;
-
-	if(AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL < pClient->clientData.currentReconnectWaitInterval) {
-		FUNC_EXIT_RC(NETWORK_RECONNECT_TIMED_OUT_ERROR);
-	}
+	/* Keep trying forever, the interval is capped by AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL */
+	pClient->clientData.reconnectAttempts++;
+	pClient->clientData.reconnectState = RECONNECT_STATE_BACKOFF;
+	pClient->clientData.currentReconnectWaitInterval = _aws_iot_mqtt_next_reconnect_wait_interval(pClient);
 	countdown_ms(&(pClient->reconnectDelayTimer), pClient->clientData.currentReconnectWaitInterval);
-	FUNC_EXIT_RC(rc);
+
+	FUNC_EXIT_RC(NETWORK_ATTEMPTING_RECONNECT);
 }
 
 static IoT_Error_t _aws_iot_mqtt_keep_alive(AWS_IoT_Client *pClient) {
@@ -123,16 +221,38 @@ static IoT_Error_t _aws_iot_mqtt_keep_alive(AWS_IoT_Client *pClient) {
 		FUNC_EXIT_RC(SUCCESS);
 	}
 
-	if(!has_timer_expired(&pClient->pingTimer)) {
-		FUNC_EXIT_RC(SUCCESS);
-	}
-
 	if(pClient->clientStatus.isPingOutstanding) {
+		if(!has_timer_expired(&pClient->pingTimer)) {
+			FUNC_EXIT_RC(SUCCESS);
+		}
+
+		/* Nothing came back after an idle interval: the link was dropped silently,
+		 * most likely by a NAT or firewall idle timeout. Probe twice as often from now on
+		 * and do not grow back to that interval soon */
+		if(pClient->clientStatus.isIdlePing) {
+			pClient->clientData.pingSuccessStreak = 0;
+			pClient->clientData.pingDroppedIntervalSec = pClient->clientData.pingIntervalSec;
+			pClient->clientData.pingIntervalSec /= 2;
+			if(pClient->clientData.pingIntervalSec < AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC) {
+				pClient->clientData.pingIntervalSec = AWS_IOT_MQTT_KEEPALIVE_FLOOR_SEC;
+			}
+			if(pClient->clientData.keepAliveInterval < pClient->clientData.pingIntervalSec) {
+				pClient->clientData.pingIntervalSec = pClient->clientData.keepAliveInterval;
+			}
+		}
 		rc = _aws_iot_mqtt_handle_disconnect(pClient);
 		FUNC_EXIT_RC(rc);
 	}
 
-	/* there is no ping outstanding - send one */
+	/* Ping when the link has been idle for the adaptive interval, or when nothing was sent
+	 * for the negotiated interval (inbound traffic alone does not keep the broker happy) */
+	if(!has_timer_expired(&pClient->pingTimer) && !has_timer_expired(&pClient->sendDeadlineTimer)) {
+		FUNC_EXIT_RC(SUCCESS);
+	}
+
+	/* there is no ping outstanding - send one. Only a ping of an idle link tells how long the
+	 * link survives idle, one sent for the send deadline follows inbound traffic */
+	pClient->clientStatus.isIdlePing = has_timer_expired(&pClient->pingTimer);
 	init_timer(&timer);
 
 	countdown_ms(&timer, pClient->clientData.commandTimeoutMs);
@@ -152,8 +272,8 @@ static IoT_Error_t _aws_iot_mqtt_keep_alive(AWS_IoT_Client *pClient) {
 	}
 
 	pClient->clientStatus.isPingOutstanding = true;
-	/* start a timer to wait for PINGRESP from server */
-	countdown_sec(&pClient->pingTimer, pClient->clientData.keepAliveInterval);
+	/* start a timer to wait for PINGRESP (or any other packet) from server */
+	countdown_ms(&pClient->pingTimer, pClient->clientData.commandTimeoutMs);
 
 	FUNC_EXIT_RC(SUCCESS);
 }
@@ -200,10 +320,6 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 		 subsequent invocations only attempt remaining subscribes.  */
 		if((CLIENT_STATE_PENDING_RECONNECT == clientState) ||
 			(CLIENT_STATE_CONNECTED_RESUBSCRIBE_IN_PROGRESS == clientState)) {
-			if(AWS_IOT_MQTT_MAX_RECONNECT_WAIT_INTERVAL < pClient->clientData.currentReconnectWaitInterval) {
-				yieldRc = NETWORK_RECONNECT_TIMED_OUT_ERROR;
-				break;
-			}
 			yieldRc = _aws_iot_mqtt_handle_reconnect(pClient);
 			/* Network reconnect attempted, check if yield timer expired before
 			 * doing anything else */
@@ -229,8 +345,7 @@ static IoT_Error_t _aws_iot_mqtt_internal_yield(AWS_IoT_Client *pClient, uint32_
 					FUNC_EXIT_RC(yieldRc);
 				}
 
-				pClient->clientData.currentReconnectWaitInterval = AWS_IOT_MQTT_MIN_RECONNECT_WAIT_INTERVAL;
-				countdown_ms(&(pClient->reconnectDelayTimer), pClient->clientData.currentReconnectWaitInterval);
+				_aws_iot_mqtt_start_reconnect(pClient);
 
 				for(itr = 0; itr < AWS_IOT_MQTT_NUM_SUBSCRIBE_HANDLERS; itr++) {
 					pClient->clientData.messageHandlers[itr].resubscribed = 0;
@@ -278,6 +393,8 @@ IoT_Error_t aws_iot_mqtt_yield(AWS_IoT_Client *pClient, uint32_t timeout_ms) {
 		FUNC_EXIT_RC(NULL_VALUE_ERROR);
 	}
 
+	IOT_METRICS_YIELD_ENTER(pClient);
+
 	clientState = aws_iot_mqtt_get_client_state(pClient);
 	/* Check if network was manually disconnected */
 	if(CLIENT_STATE_DISCONNECTED_MANUALLY == clientState) {
@@ -316,6 +433,8 @@ IoT_Error_t aws_iot_mqtt_yield(AWS_IoT_Client *pClient, uint32_t timeout_ms) {
 		}
 	}
 
+	IOT_METRICS_YIELD_EXIT(pClient);
+
 	FUNC_EXIT_RC(yieldRc);
 }
 
@@ -28,6 +28,7 @@ extern "C" {
 #include "aws_iot_error.h"
 #include "aws_iot_log.h"
 #include "aws_iot_shadow_actions.h"
+#include "aws_iot_shadow_coalesce.h"
 #include "aws_iot_shadow_json.h"
 #include "aws_iot_shadow_key.h"
 #include "aws_iot_shadow_records.h"
@@ -36,7 +37,7 @@ const ShadowInitParameters_t ShadowInitParametersDefault = {(char *) AWS_IOT_MQT
 															NULL, false, NULL};
 
 const ShadowConnectParameters_t ShadowConnectParametersDefault = {(char *) AWS_IOT_MY_THING_NAME,
-								  (char *) AWS_IOT_MQTT_CLIENT_ID, 0, NULL};
+								  (char *) AWS_IOT_MQTT_CLIENT_ID, 0, NULL, false};
 
 static char deleteAcceptedTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
 
@@ -56,6 +57,19 @@ void aws_iot_shadow_disable_discard_old_delta_msgs(void) {
 	shadowDiscardOldDeltaFlag = false;
 }
 
+void aws_iot_shadow_enable_update_coalescing(uint32_t window_ms) {
+	if(0 == window_ms) {
+		aws_iot_shadow_disable_update_coalescing();
+		return;
+	}
+	shadowCoalescingWindow_ms = window_ms;
+}
+
+void aws_iot_shadow_disable_update_coalescing(void) {
+	shadowCoalescingWindow_ms = 0;
+	flushShadowUpdateBatches(true);
+}
+
 IoT_Error_t aws_iot_shadow_free(AWS_IoT_Client *pClient)
 {
     IoT_Error_t rc;
@@ -99,6 +113,7 @@ IoT_Error_t aws_iot_shadow_init(AWS_IoT_Client *pClient, ShadowInitParameters_t
 	resetClientTokenSequenceNum();
 	aws_iot_shadow_reset_last_received_version();
 	initDeltaTokens();
+	initShadowUpdateBatches();
 
 	FUNC_EXIT_RC(SUCCESS);
 }
@@ -134,7 +149,9 @@ IoT_Error_t aws_iot_shadow_connect(AWS_IoT_Client *pClient, ShadowConnectParamet
 
 	initializeRecords(pClient);
 
-	if(NULL != pParams->deleteActionHandler) {
+	if(pParams->isWildcardAckSubscription) {
+		rc = subscribeToAllShadowTopics(pParams->deleteActionHandler);
+	} else if(NULL != pParams->deleteActionHandler) {
 		snprintf(deleteAcceptedTopic, MAX_SHADOW_TOPIC_LENGTH_BYTES,
 				 "$aws/things/%s/shadow/delete/accepted", myThingName);
 		deleteAcceptedTopicLen = (uint16_t) strlen(deleteAcceptedTopic);
@@ -162,6 +179,7 @@ IoT_Error_t aws_iot_shadow_yield(AWS_IoT_Client *pClient, uint32_t timeout) {
 		return NULL_VALUE_ERROR;
 	}
 
+	flushShadowUpdateBatches(false);
 	HandleExpiredResponseCallbacks();
 	return aws_iot_mqtt_yield(pClient, timeout);
 }
@@ -183,8 +201,13 @@ IoT_Error_t aws_iot_shadow_update(AWS_IoT_Client *pClient, const char *pThingNam
 		FUNC_EXIT_RC(MQTT_CONNECTION_ERROR);
 	}
 
-	rc = aws_iot_shadow_internal_action(pThingName, SHADOW_UPDATE, pJsonString, strlen(pJsonString), callback, pContextData,
-										timeout_seconds, isPersistentSubscribe);
+	if(0 != shadowCoalescingWindow_ms) {
+		rc = coalesceShadowUpdate(pThingName, pJsonString, callback, pContextData, timeout_seconds,
+								  isPersistentSubscribe);
+	} else {
+		rc = aws_iot_shadow_internal_action(pThingName, SHADOW_UPDATE, pJsonString, strlen(pJsonString), callback,
+											pContextData, timeout_seconds, isPersistentSubscribe);
+	}
 
 	FUNC_EXIT_RC(rc);
 }
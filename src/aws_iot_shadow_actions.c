@@ -35,7 +35,7 @@ IoT_Error_t aws_iot_shadow_internal_action(const char *pThingName, ShadowActions
 	IoT_Error_t ret_val = SUCCESS;
 	bool isClientTokenPresent = false;
 	bool isAckWaitListFree = false;
-	uint8_t indexAckWaitList;
+	uint16_t indexAckWaitList;
 	char extractedClientToken[MAX_SIZE_CLIENT_ID_WITH_SEQUENCE];
 
 	FUNC_ENTRY;
@@ -47,12 +47,14 @@ IoT_Error_t aws_iot_shadow_internal_action(const char *pThingName, ShadowActions
 	isClientTokenPresent = extractClientToken(pJsonDocumentToBeSent, jsonSize, extractedClientToken, MAX_SIZE_CLIENT_ID_WITH_SEQUENCE );
 
 	if(isClientTokenPresent && (NULL != callback)) {
-		if(getNextFreeIndexOfAckWaitList(&indexAckWaitList)) {
+		if(getNextFreeIndexOfAckWaitList(extractedClientToken, &indexAckWaitList)) {
 			isAckWaitListFree = true;
 		}
 
 		if(isAckWaitListFree) {
-			if(!isSubscriptionPresent(pThingName, action)) {
+			if(isCoveredByWildcardSubscription(pThingName)) {
+				/* the acks already arrive, no subscription to make or to settle */
+			} else if(!isSubscriptionPresent(pThingName, action)) {
 				ret_val = subscribeToShadowActionAcks(pThingName, action, isSticky);
 			} else {
 				incrementSubscriptionCnt(pThingName, action, isSticky);
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_shadow_cache.c
+ * @brief Reported state cache sending only the values that changed
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_shadow_cache.h"
+
+#include <string.h>
+
+#include "aws_iot_json_writer.h"
+#include "aws_iot_log.h"
+#include "aws_iot_shadow_json.h"
+#include "aws_iot_shadow_key.h"
+#include "aws_iot_shadow_records.h"
+
+/* error code of an update rejected because its version is not the one of the shadow */
+#define SHADOW_VERSION_CONFLICT_CODE 409
+
+static bool isTextValue(const jsonStruct_t *pStruct) {
+	return SHADOW_JSON_STRING == pStruct->type || SHADOW_JSON_OBJECT == pStruct->type;
+}
+
+static size_t getValueSize(const jsonStruct_t *pStruct) {
+	switch(pStruct->type) {
+		case SHADOW_JSON_INT32:
+		case SHADOW_JSON_UINT32:
+			return sizeof(int32_t);
+		case SHADOW_JSON_INT16:
+		case SHADOW_JSON_UINT16:
+			return sizeof(int16_t);
+		case SHADOW_JSON_INT8:
+		case SHADOW_JSON_UINT8:
+			return sizeof(int8_t);
+		case SHADOW_JSON_FLOAT:
+			return sizeof(float);
+		case SHADOW_JSON_DOUBLE:
+			return sizeof(double);
+		case SHADOW_JSON_BOOL:
+			return sizeof(bool);
+		case SHADOW_JSON_STRING:
+		case SHADOW_JSON_OBJECT:
+			return pStruct->dataLength;
+		default:
+			return 0;
+	}
+}
+
+static uint8_t *getAcceptedCopy(ShadowCache_t *pCache, const ShadowCacheValue_t *pValue) {
+	return &pCache->storage[pValue->storageOffset];
+}
+
+static uint8_t *getInFlightCopy(ShadowCache_t *pCache, const ShadowCacheValue_t *pValue) {
+	return &pCache->storage[pValue->storageOffset + pValue->size];
+}
+
+/* floating point values are compared bit for bit: a NaN that stays NaN is not a change */
+static bool isValueChanged(ShadowCache_t *pCache, const ShadowCacheValue_t *pValue) {
+	if(!pValue->isAccepted) {
+		return true;
+	}
+	if(isTextValue(pValue->pStruct)) {
+		return strncmp((const char *) pValue->pStruct->pData, (const char *) getAcceptedCopy(pCache, pValue),
+					   pValue->size) != 0;
+	}
+	return memcmp(pValue->pStruct->pData, getAcceptedCopy(pCache, pValue), pValue->size) != 0;
+}
+
+static void copyValue(uint8_t *pCopy, const ShadowCacheValue_t *pValue) {
+	if(isTextValue(pValue->pStruct)) {
+		/* padded with nulls, so the copy compares as the string it holds */
+		strncpy((char *) pCopy, (const char *) pValue->pStruct->pData, pValue->size);
+	} else {
+		memcpy(pCopy, pValue->pStruct->pData, pValue->size);
+	}
+}
+
+static void dropInFlightValues(ShadowCache_t *pCache) {
+	uint16_t i;
+
+	for(i = 0; i < pCache->valueCount; i++) {
+		pCache->values[i].isInFlight = false;
+	}
+}
+
+static void acceptInFlightValues(ShadowCache_t *pCache) {
+	ShadowCacheValue_t *pValue;
+	uint16_t i;
+
+	for(i = 0; i < pCache->valueCount; i++) {
+		pValue = &pCache->values[i];
+		if(pValue->isInFlight) {
+			memcpy(getAcceptedCopy(pCache, pValue), getInFlightCopy(pCache, pValue), pValue->size);
+			pValue->isAccepted = true;
+			pValue->isInFlight = false;
+		}
+	}
+}
+
+/* the ack handler does not pass on its token index, the response is parsed again */
+static void onUpdateResponse(const char *pThingName, ShadowActions_t action, Shadow_Ack_Status_t status,
+							 const char *pReceivedJsonDocument, void *pContextData) {
+	ShadowCache_t *pCache = (ShadowCache_t *) pContextData;
+	ShadowJsonIndex_t jsonIndex;
+	int32_t tokenCount = 0;
+	uint32_t errorCode = 0;
+	bool isParsed;
+
+	isParsed = NULL != pReceivedJsonDocument && '\0' != pReceivedJsonDocument[0]
+			   && isJsonValidAndParse(pReceivedJsonDocument, strlen(pReceivedJsonDocument), &jsonIndex, &tokenCount);
+
+	if(SHADOW_ACK_ACCEPTED == status || SHADOW_ACK_ACCEPTED_STREAMED == status) {
+		acceptInFlightValues(pCache);
+		/* a document too large to be kept has no version, the next update goes without one */
+		if(!isParsed || !extractVersionNumber(pReceivedJsonDocument, &jsonIndex, tokenCount, &pCache->version)) {
+			pCache->version = 0;
+		}
+	} else {
+		dropInFlightValues(pCache);
+		if(SHADOW_ACK_REJECTED == status && isParsed && extractErrorCode(pReceivedJsonDocument, tokenCount, &errorCode)
+		   && SHADOW_VERSION_CONFLICT_CODE == errorCode) {
+			IOT_WARN("Shadow version conflict, the next update reports every value\n");
+			aws_iot_shadow_cache_invalidate(pCache);
+		}
+	}
+	pCache->isUpdateInFlight = false;
+
+	if(NULL != pCache->callback) {
+		pCache->callback(pThingName, action, status, pReceivedJsonDocument, pCache->pCallbackContext);
+	}
+}
+
+IoT_Error_t aws_iot_shadow_cache_init(ShadowCache_t *pCache, bool isVersionChecked) {
+	FUNC_ENTRY;
+
+	if(NULL == pCache) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	pCache->valueCount = 0;
+	pCache->storageUsed = 0;
+	pCache->version = 0;
+	pCache->isVersionChecked = isVersionChecked;
+	pCache->isUpdateInFlight = false;
+	pCache->callback = NULL;
+	pCache->pCallbackContext = NULL;
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+IoT_Error_t aws_iot_shadow_cache_add(ShadowCache_t *pCache, jsonStruct_t *pStruct) {
+	ShadowCacheValue_t *pValue;
+	size_t size;
+
+	FUNC_ENTRY;
+
+	if(NULL == pCache || NULL == pStruct || NULL == pStruct->pKey || NULL == pStruct->pData) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	size = getValueSize(pStruct);
+	if(0 == size) {
+		FUNC_EXIT_RC(FAILURE);
+	}
+	if(pCache->valueCount >= SHADOW_CACHE_MAX_VALUES
+	   || size > (size_t) (SHADOW_CACHE_STORAGE_SIZE - pCache->storageUsed) / 2) {
+		FUNC_EXIT_RC(LIMIT_EXCEEDED_ERROR);
+	}
+
+	pValue = &pCache->values[pCache->valueCount++];
+	pValue->pStruct = pStruct;
+	pValue->storageOffset = pCache->storageUsed;
+	pValue->size = (uint16_t) size;
+	pValue->isAccepted = false;
+	pValue->isInFlight = false;
+	pCache->storageUsed += (uint16_t) (2 * size);
+
+	FUNC_EXIT_RC(SUCCESS);
+}
+
+void aws_iot_shadow_cache_invalidate(ShadowCache_t *pCache) {
+	uint16_t i;
+
+	for(i = 0; i < pCache->valueCount; i++) {
+		pCache->values[i].isAccepted = false;
+	}
+	pCache->version = 0;
+}
+
+static uint32_t getExpectedVersion(const ShadowCache_t *pCache, const char *pThingName) {
+	uint32_t receivedVersion;
+
+	if(!pCache->isVersionChecked || 0 == pCache->version) {
+		return 0;
+	}
+	/* only the deltas of the own thing are tracked, the version of another shadow comes from its updates */
+	if(NULL == pThingName || 0 != strcmp(pThingName, myThingName)) {
+		return pCache->version;
+	}
+	/* deltas and get responses received since the last update moved the shadow on */
+	receivedVersion = aws_iot_shadow_get_last_received_version();
+	return receivedVersion > pCache->version ? receivedVersion : pCache->version;
+}
+
+IoT_Error_t aws_iot_shadow_cache_update(AWS_IoT_Client *pClient, ShadowCache_t *pCache, const char *pThingName,
+										char *pJsonDocument, size_t maxSizeOfJsonDocument,
+										fpActionCallback_t callback, void *pContextData, uint8_t timeout_seconds,
+										bool isPersistentSubscribe) {
+	JsonWriter_t writer;
+	ShadowCacheValue_t *pValue;
+	uint32_t version;
+	uint16_t i;
+	bool isAnyChanged = false;
+	IoT_Error_t rc;
+
+	FUNC_ENTRY;
+
+	if(NULL == pClient || NULL == pCache || NULL == pJsonDocument) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+	if(pCache->isUpdateInFlight) {
+		FUNC_EXIT_RC(SHADOW_WAIT_FOR_PUBLISH);
+	}
+
+	jsonWriterInit(&writer, pJsonDocument, maxSizeOfJsonDocument);
+	jsonWriteRaw(&writer, "{\"state\":{\"reported\":{", 22);
+	for(i = 0; i < pCache->valueCount; i++) {
+		pValue = &pCache->values[i];
+		pValue->isInFlight = isValueChanged(pCache, pValue);
+		if(!pValue->isInFlight) {
+			continue;
+		}
+		if(isAnyChanged) {
+			jsonWriteChar(&writer, ',');
+		}
+		isAnyChanged = true;
+		jsonWriteKey(&writer, pValue->pStruct->pKey);
+		writeJsonData(&writer, pValue->pStruct->type, pValue->pStruct->pData);
+		copyValue(getInFlightCopy(pCache, pValue), pValue);
+	}
+	if(!isAnyChanged) {
+		FUNC_EXIT_RC(SHADOW_NOTHING_TO_UPDATE);
+	}
+	jsonWriteRaw(&writer, "}}", 2);
+
+	version = getExpectedVersion(pCache, pThingName);
+	if(0 != version) {
+		jsonWriteChar(&writer, ',');
+		jsonWriteKey(&writer, SHADOW_VERSION_STRING);
+		jsonWriteUint(&writer, version);
+	}
+	jsonWriteChar(&writer, ',');
+	jsonWriteKey(&writer, SHADOW_CLIENT_TOKEN_STRING);
+	jsonWriteChar(&writer, '"');
+	writeClientToken(&writer);
+	jsonWriteRaw(&writer, "\"}", 2);
+	jsonWriterTerminate(&writer);
+
+	if(isJsonWriterTruncated(&writer)) {
+		dropInFlightValues(pCache);
+		FUNC_EXIT_RC(SHADOW_JSON_BUFFER_TRUNCATED);
+	}
+
+	pCache->callback = callback;
+	pCache->pCallbackContext = pContextData;
+	pCache->isUpdateInFlight = true;
+	rc = aws_iot_shadow_update(pClient, pThingName, pJsonDocument, onUpdateResponse, pCache, timeout_seconds,
+							   isPersistentSubscribe);
+	if(SUCCESS != rc) {
+		pCache->isUpdateInFlight = false;
+		dropInFlightValues(pCache);
+	}
+
+	FUNC_EXIT_RC(rc);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_shadow_cache.h
+ * @brief Reported state cache sending only the values that changed
+ *
+ * The cache keeps a copy of every reported value the shadow service accepted.
+ * An update built from it reports only the values that differ from their
+ * copy, and nothing is published when none does. The copies are replaced
+ * when the update is accepted, so a rejected or lost update is sent again by
+ * the next one.
+ *
+ * Updates can carry the version of the shadow the cache last saw, the
+ * service then rejects them with a version conflict if the shadow changed in
+ * between. After a conflict the next update reports every value, without a
+ * version, and its acceptance sets the version again.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_SHADOW_CACHE_H_
+#define AWS_IOT_SDK_SRC_IOT_SHADOW_CACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "aws_iot_config.h"
+#include "aws_iot_error.h"
+#include "aws_iot_shadow_interface.h"
+
+/**
+ * @brief A reported value tracked by the cache
+ */
+typedef struct {
+	jsonStruct_t *pStruct;		///< Key and current value, read on every update
+	uint16_t storageOffset;		///< Accepted copy in the cache storage, the copy in flight follows it
+	uint16_t size;				///< Bytes of each copy
+	bool isAccepted;			///< The accepted copy holds the value the service has
+	bool isInFlight;			///< The copy in flight is in the update waiting for its response
+} ShadowCacheValue_t;
+
+/**
+ * @brief Reported state of one shadow
+ *
+ * Only one update of a cache is in flight at a time. The cache must stay
+ * valid until the response or the timeout of its last update.
+ */
+typedef struct {
+	ShadowCacheValue_t values[SHADOW_CACHE_MAX_VALUES];
+	uint8_t storage[SHADOW_CACHE_STORAGE_SIZE];	///< Copies of the values
+	uint16_t valueCount;
+	uint16_t storageUsed;
+	uint32_t version;							///< Version of the shadow after the last accepted update, 0 if unknown
+	bool isVersionChecked;						///< Updates carry the expected version
+	bool isUpdateInFlight;
+	fpActionCallback_t callback;				///< Callback of the update in flight
+	void *pCallbackContext;
+} ShadowCache_t;
+
+/**
+ * @brief Initialize an empty cache
+ *
+ * @param pCache Cache to initialize
+ * @param isVersionChecked true to send the expected version with every update
+ *
+ * @return An IoT Error Type defining successful/failed operation
+ */
+IoT_Error_t aws_iot_shadow_cache_init(ShadowCache_t *pCache, bool isVersionChecked);
+
+/**
+ * @brief Track a reported value
+ *
+ * The value is reported by the next update, then only when it changes.
+ * SHADOW_JSON_STRING and SHADOW_JSON_OBJECT values are compared over
+ * dataLength bytes, the size of their buffer.
+ *
+ * @param pCache Cache
+ * @param pStruct Key and value, it must stay valid as long as the cache is used
+ *
+ * @return SUCCESS, LIMIT_EXCEEDED_ERROR when SHADOW_CACHE_MAX_VALUES or SHADOW_CACHE_STORAGE_SIZE is reached
+ */
+IoT_Error_t aws_iot_shadow_cache_add(ShadowCache_t *pCache, jsonStruct_t *pStruct);
+
+/**
+ * @brief Forget the accepted values and the version
+ *
+ * The next update reports every value without a version, e.g. after the
+ * shadow was deleted.
+ *
+ * @param pCache Cache
+ */
+void aws_iot_shadow_cache_invalidate(ShadowCache_t *pCache);
+
+/**
+ * @brief Report the values that changed since the last accepted update
+ *
+ * Builds {"state":{"reported":{...}},"version":N,"clientToken":"..."} in
+ * pJsonDocument and publishes it with aws_iot_shadow_update. The version is
+ * the one of the last accepted update, or for the thing the shadow client was
+ * initialized with the higher one of a delta or get response received since.
+ * It is left out of the first update after init or
+ * after a conflict. The cache is updated from the response before the
+ * callback is called.
+ *
+ * @param pClient MQTT Client used as the protocol layer
+ * @param pCache Cache
+ * @param pThingName Thing Name of the shadow
+ * @param pJsonDocument Buffer the document is built in
+ * @param maxSizeOfJsonDocument Size of pJsonDocument
+ * @param callback Called with the response, as for aws_iot_shadow_update, can be NULL
+ * @param pContextData Passed to the callback
+ * @param timeout_seconds Time to wait for the response
+ * @param isPersistentSubscribe As for aws_iot_shadow_update
+ *
+ * @return SUCCESS when the update was published, SHADOW_NOTHING_TO_UPDATE when no value changed,
+ *         SHADOW_WAIT_FOR_PUBLISH while the previous update of the cache waits for its response,
+ *         or the error of the document or of aws_iot_shadow_update
+ */
+IoT_Error_t aws_iot_shadow_cache_update(AWS_IoT_Client *pClient, ShadowCache_t *pCache, const char *pThingName,
+										char *pJsonDocument, size_t maxSizeOfJsonDocument,
+										fpActionCallback_t callback, void *pContextData, uint8_t timeout_seconds,
+										bool isPersistentSubscribe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AWS_IOT_SDK_SRC_IOT_SHADOW_CACHE_H_
@@ -0,0 +1,380 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_shadow_coalesce.c
+ * @brief Merging of shadow updates published within a window
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "aws_iot_shadow_coalesce.h"
+
+#include <string.h>
+
+#include "timer_interface.h"
+#include "aws_iot_json_utils.h"
+#include "aws_iot_json_writer.h"
+#include "aws_iot_log.h"
+#include "aws_iot_shadow_actions.h"
+#include "aws_iot_shadow_json.h"
+#include "aws_iot_shadow_key.h"
+#include "aws_iot_config.h"
+
+typedef struct {
+	fpActionCallback_t callback;
+	void *pContextData;
+} CoalescedCaller_t;
+
+typedef enum {
+	BATCH_FREE, BATCH_COLLECTING, BATCH_IN_FLIGHT
+} ShadowUpdateBatchState_t;
+
+typedef struct {
+	char thingName[MAX_SIZE_OF_THING_NAME];
+	char document[SHADOW_COALESCE_DOCUMENT_SIZE];	///< Merged document, without clientToken until it is published
+	CoalescedCaller_t callers[SHADOW_COALESCE_MAX_CALLERS];
+	uint8_t callerCount;
+	uint8_t timeout_seconds;						///< Longest timeout of the merged updates
+	bool isPersistentSubscribe;
+	ShadowUpdateBatchState_t state;
+	Timer window;
+} ShadowUpdateBatch_t;
+
+/* a source document of a merge and its tokens */
+typedef struct {
+	const char *pJson;
+	jsmntok_t *pTokens;
+	int32_t tokenCount;
+} MergeSource_t;
+
+uint32_t shadowCoalescingWindow_ms = 0;
+
+static ShadowUpdateBatch_t updateBatches[SHADOW_COALESCE_MAX_BATCHES];
+static char mergedDocument[SHADOW_COALESCE_DOCUMENT_SIZE];
+/* own tokens: a merge can run from a delta callback, while the shadow tokens are still read */
+static jsmntok_t batchTokens[SHADOW_COALESCE_MAX_TOKENS];
+static jsmntok_t updateTokens[SHADOW_COALESCE_MAX_TOKENS];
+
+void initShadowUpdateBatches(void) {
+	uint8_t i;
+
+	for(i = 0; i < SHADOW_COALESCE_MAX_BATCHES; i++) {
+		updateBatches[i].state = BATCH_FREE;
+	}
+}
+
+static bool parseMergeSource(MergeSource_t *pSource, const char *pJson, jsmntok_t *pTokens) {
+	jsmn_parser parser;
+
+	jsmn_init(&parser);
+	pSource->pJson = pJson;
+	pSource->pTokens = pTokens;
+	pSource->tokenCount = jsmn_parse(&parser, pJson, strlen(pJson), pTokens, SHADOW_COALESCE_MAX_TOKENS);
+	return pSource->tokenCount > 0 && JSMN_OBJECT == pTokens[0].type;
+}
+
+/* index of the first token after the value starting at valueIndex */
+static int32_t skipMergeValue(const MergeSource_t *pSource, int32_t valueIndex) {
+	int32_t i = valueIndex + 1;
+
+	while(i < pSource->tokenCount && pSource->pTokens[i].start < pSource->pTokens[valueIndex].end) {
+		i++;
+	}
+	return i;
+}
+
+/* copies a token as it is in its document, quotes included for a string */
+static void writeMergeToken(JsonWriter_t *pWriter, const MergeSource_t *pSource, int32_t index) {
+	const jsmntok_t *pToken = &pSource->pTokens[index];
+	int start = pToken->start;
+	int end = pToken->end;
+
+	if(JSMN_STRING == pToken->type) {
+		start--;
+		end++;
+	}
+	jsonWriteRaw(pWriter, pSource->pJson + start, (size_t) (end - start));
+}
+
+static bool isSameKey(const MergeSource_t *pSource, int32_t keyIndex, const MergeSource_t *pKeySource,
+					  int32_t otherKeyIndex) {
+	const jsmntok_t *pKey = &pSource->pTokens[keyIndex];
+	const jsmntok_t *pOtherKey = &pKeySource->pTokens[otherKeyIndex];
+
+	return (pKey->end - pKey->start) == (pOtherKey->end - pOtherKey->start)
+		   && 0 == strncmp(pSource->pJson + pKey->start, pKeySource->pJson + pOtherKey->start,
+						   (size_t) (pKey->end - pKey->start));
+}
+
+/* value token of the key of pKeySource in the object at objectIndex, -1 when it has none */
+static int32_t findMergeKey(const MergeSource_t *pSource, int32_t objectIndex, const MergeSource_t *pKeySource,
+							int32_t keyIndex) {
+	int32_t end = skipMergeValue(pSource, objectIndex);
+	int32_t key;
+
+	for(key = objectIndex + 1; key + 1 < end; key = skipMergeValue(pSource, key + 1)) {
+		if(isSameKey(pSource, key, pKeySource, keyIndex)) {
+			return key + 1;
+		}
+	}
+	return -1;
+}
+
+/* the clientToken of each update is dropped, the batch gets its own */
+static bool isDroppedKey(const MergeSource_t *pSource, int32_t keyIndex, bool isTopLevel) {
+	return isTopLevel && 0 == jsoneq(pSource->pJson, &pSource->pTokens[keyIndex], SHADOW_CLIENT_TOKEN_STRING);
+}
+
+static void writeMergedValue(JsonWriter_t *pWriter, const MergeSource_t *pBatch, int32_t batchIndex,
+							 const MergeSource_t *pUpdate, int32_t updateIndex, bool isTopLevel);
+
+/* keys of the batch object in their order, each replaced or merged with the update one, then the new keys */
+static void writeMergedObject(JsonWriter_t *pWriter, const MergeSource_t *pBatch, int32_t batchIndex,
+							  const MergeSource_t *pUpdate, int32_t updateIndex, bool isTopLevel) {
+	int32_t batchEnd = skipMergeValue(pBatch, batchIndex);
+	int32_t updateEnd = skipMergeValue(pUpdate, updateIndex);
+	int32_t key, value;
+	bool isFirst = true;
+
+	jsonWriteChar(pWriter, '{');
+	for(key = batchIndex + 1; key + 1 < batchEnd; key = skipMergeValue(pBatch, key + 1)) {
+		if(isDroppedKey(pBatch, key, isTopLevel)) {
+			continue;
+		}
+		if(!isFirst) {
+			jsonWriteChar(pWriter, ',');
+		}
+		isFirst = false;
+		writeMergeToken(pWriter, pBatch, key);
+		jsonWriteChar(pWriter, ':');
+		value = findMergeKey(pUpdate, updateIndex, pBatch, key);
+		if(value < 0) {
+			writeMergeToken(pWriter, pBatch, key + 1);
+		} else {
+			writeMergedValue(pWriter, pBatch, key + 1, pUpdate, value, false);
+		}
+	}
+	for(key = updateIndex + 1; key + 1 < updateEnd; key = skipMergeValue(pUpdate, key + 1)) {
+		if(isDroppedKey(pUpdate, key, isTopLevel) || findMergeKey(pBatch, batchIndex, pUpdate, key) >= 0) {
+			continue;
+		}
+		if(!isFirst) {
+			jsonWriteChar(pWriter, ',');
+		}
+		isFirst = false;
+		writeMergeToken(pWriter, pUpdate, key);
+		jsonWriteChar(pWriter, ':');
+		writeMergeToken(pWriter, pUpdate, key + 1);
+	}
+	jsonWriteChar(pWriter, '}');
+}
+
+static void writeMergedValue(JsonWriter_t *pWriter, const MergeSource_t *pBatch, int32_t batchIndex,
+							 const MergeSource_t *pUpdate, int32_t updateIndex, bool isTopLevel) {
+	if(JSMN_OBJECT == pBatch->pTokens[batchIndex].type && JSMN_OBJECT == pUpdate->pTokens[updateIndex].type) {
+		writeMergedObject(pWriter, pBatch, batchIndex, pUpdate, updateIndex, isTopLevel);
+	} else {
+		writeMergeToken(pWriter, pUpdate, updateIndex);
+	}
+}
+
+/* room is left for the clientToken added when the batch is published */
+static IoT_Error_t mergeIntoBatch(ShadowUpdateBatch_t *pBatch, const char *pJsonString) {
+	MergeSource_t batchSource;
+	MergeSource_t updateSource;
+	JsonWriter_t writer;
+
+	if(!parseMergeSource(&updateSource, pJsonString, updateTokens)) {
+		return JSON_PARSE_ERROR;
+	}
+	/* a batch with more tokens than can be parsed again is full */
+	if(!parseMergeSource(&batchSource, pBatch->document, batchTokens)) {
+		return SHADOW_JSON_BUFFER_TRUNCATED;
+	}
+
+	jsonWriterInit(&writer, mergedDocument, sizeof(mergedDocument) - MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE);
+	writeMergedValue(&writer, &batchSource, 0, &updateSource, 0, true);
+	jsonWriterTerminate(&writer);
+	if(isJsonWriterTruncated(&writer)) {
+		return SHADOW_JSON_BUFFER_TRUNCATED;
+	}
+
+	memcpy(pBatch->document, mergedDocument, writer.length + 1);
+	return SUCCESS;
+}
+
+static void onBatchResponse(const char *pThingName, ShadowActions_t action, Shadow_Ack_Status_t status,
+							const char *pReceivedJsonDocument, void *pContextData) {
+	ShadowUpdateBatch_t *pBatch = (ShadowUpdateBatch_t *) pContextData;
+	uint8_t i;
+
+	/* the batch stays in flight during the callbacks, an update they publish opens another one */
+	for(i = 0; i < pBatch->callerCount; i++) {
+		if(NULL != pBatch->callers[i].callback) {
+			pBatch->callers[i].callback(pThingName, action, status, pReceivedJsonDocument,
+										pBatch->callers[i].pContextData);
+		}
+	}
+	pBatch->state = BATCH_FREE;
+}
+
+static bool hasBatchCallback(const ShadowUpdateBatch_t *pBatch) {
+	uint8_t i;
+
+	for(i = 0; i < pBatch->callerCount; i++) {
+		if(NULL != pBatch->callers[i].callback) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void publishBatch(ShadowUpdateBatch_t *pBatch) {
+	JsonWriter_t writer;
+	size_t length = strlen(pBatch->document);
+	bool isTracked = hasBatchCallback(pBatch);
+	IoT_Error_t rc = SUCCESS;
+
+	// the closing brace of the document is replaced by the clientToken
+	jsonWriterInit(&writer, pBatch->document, sizeof(pBatch->document));
+	jsonWriterSeek(&writer, length - 1);
+	if(length > 2) {
+		jsonWriteChar(&writer, ',');
+	}
+	jsonWriteKey(&writer, SHADOW_CLIENT_TOKEN_STRING);
+	jsonWriteChar(&writer, '"');
+	writeClientToken(&writer);
+	jsonWriteRaw(&writer, "\"}", 2);
+	jsonWriterTerminate(&writer);
+
+	if(isJsonWriterTruncated(&writer)) {
+		rc = SHADOW_JSON_BUFFER_TRUNCATED;
+	} else {
+		pBatch->state = BATCH_IN_FLIGHT;
+		rc = aws_iot_shadow_internal_action(pBatch->thingName, SHADOW_UPDATE, pBatch->document, writer.length,
+											isTracked ? onBatchResponse : NULL, pBatch, pBatch->timeout_seconds,
+											pBatch->isPersistentSubscribe);
+	}
+
+	if(SUCCESS != rc) {
+		IOT_ERROR("Coalesced shadow update of %u updates failed: %d\n", pBatch->callerCount, rc);
+		/* the updates are lost, like updates whose response never came */
+		onBatchResponse(pBatch->thingName, SHADOW_UPDATE, SHADOW_ACK_TIMEOUT, "", pBatch);
+	} else if(!isTracked) {
+		pBatch->state = BATCH_FREE;
+	}
+}
+
+static ShadowUpdateBatch_t *findCollectingBatch(const char *pThingName) {
+	uint8_t i;
+
+	for(i = 0; i < SHADOW_COALESCE_MAX_BATCHES; i++) {
+		if(BATCH_COLLECTING == updateBatches[i].state && 0 == strcmp(updateBatches[i].thingName, pThingName)) {
+			return &updateBatches[i];
+		}
+	}
+	return NULL;
+}
+
+static ShadowUpdateBatch_t *openBatch(const char *pThingName, uint8_t timeout_seconds, bool isPersistentSubscribe) {
+	ShadowUpdateBatch_t *pBatch = NULL;
+	uint8_t i;
+
+	for(i = 0; i < SHADOW_COALESCE_MAX_BATCHES && NULL == pBatch; i++) {
+		if(BATCH_FREE == updateBatches[i].state) {
+			pBatch = &updateBatches[i];
+		}
+	}
+	if(NULL == pBatch) {
+		return NULL;
+	}
+
+	memcpy(pBatch->thingName, pThingName, strlen(pThingName) + 1);
+	memcpy(pBatch->document, "{}", 3);
+	pBatch->callerCount = 0;
+	pBatch->timeout_seconds = timeout_seconds;
+	pBatch->isPersistentSubscribe = isPersistentSubscribe;
+	pBatch->state = BATCH_COLLECTING;
+	init_timer(&pBatch->window);
+	countdown_ms(&pBatch->window, shadowCoalescingWindow_ms);
+	return pBatch;
+}
+
+IoT_Error_t coalesceShadowUpdate(const char *pThingName, const char *pJsonString, fpActionCallback_t callback,
+								 void *pContextData, uint8_t timeout_seconds, bool isPersistentSubscribe) {
+	ShadowUpdateBatch_t *pBatch;
+	IoT_Error_t rc = FAILURE;
+
+	FUNC_ENTRY;
+
+	if(NULL == pThingName || NULL == pJsonString) {
+		FUNC_EXIT_RC(NULL_VALUE_ERROR);
+	}
+
+	if(strlen(pThingName) < MAX_SIZE_OF_THING_NAME) {
+		pBatch = findCollectingBatch(pThingName);
+		if(NULL != pBatch && pBatch->callerCount < SHADOW_COALESCE_MAX_CALLERS) {
+			rc = mergeIntoBatch(pBatch, pJsonString);
+		}
+		if(NULL != pBatch && SUCCESS != rc) {
+			/* the batch goes first, so that its values do not overwrite the later ones of the update */
+			publishBatch(pBatch);
+			pBatch = NULL;
+		}
+		if(NULL == pBatch && JSON_PARSE_ERROR != rc) {
+			/* the batch was full, or there was none: the update opens the next one */
+			pBatch = openBatch(pThingName, timeout_seconds, isPersistentSubscribe);
+			if(NULL != pBatch) {
+				rc = mergeIntoBatch(pBatch, pJsonString);
+				if(SUCCESS != rc) {
+					pBatch->state = BATCH_FREE;
+				}
+			}
+		}
+		if(SUCCESS == rc) {
+			pBatch->callers[pBatch->callerCount].callback = callback;
+			pBatch->callers[pBatch->callerCount].pContextData = pContextData;
+			pBatch->callerCount++;
+			if(timeout_seconds > pBatch->timeout_seconds) {
+				pBatch->timeout_seconds = timeout_seconds;
+			}
+			pBatch->isPersistentSubscribe = pBatch->isPersistentSubscribe || isPersistentSubscribe;
+			FUNC_EXIT_RC(SUCCESS);
+		}
+	}
+
+	/* not mergeable (not a JSON object, too large) or no batch left: published on its own */
+	rc = aws_iot_shadow_internal_action(pThingName, SHADOW_UPDATE, pJsonString, strlen(pJsonString), callback,
+										pContextData, timeout_seconds, isPersistentSubscribe);
+	FUNC_EXIT_RC(rc);
+}
+
+void flushShadowUpdateBatches(bool isWindowIgnored) {
+	uint8_t i;
+
+	for(i = 0; i < SHADOW_COALESCE_MAX_BATCHES; i++) {
+		if(BATCH_COLLECTING == updateBatches[i].state
+		   && (isWindowIgnored || has_timer_expired(&updateBatches[i].window))) {
+			publishBatch(&updateBatches[i]);
+		}
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
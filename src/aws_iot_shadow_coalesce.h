@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_shadow_coalesce.h
+ * @brief Merging of shadow updates published within a window
+ *
+ * While coalescing is on, an update to a thing opens a batch that collects
+ * the updates to the same thing for the window. Each update is merged into
+ * the batch document, object by object, and a later value of a key replaces
+ * the earlier one. When the window closes the batch is published once, with
+ * one clientToken and one ack wait slot, and its response is passed to the
+ * callback of every update it holds.
+ */
+
+#ifndef SRC_SHADOW_AWS_IOT_SHADOW_COALESCE_H_
+#define SRC_SHADOW_AWS_IOT_SHADOW_COALESCE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "aws_iot_shadow_interface.h"
+
+extern uint32_t shadowCoalescingWindow_ms;
+
+void initShadowUpdateBatches(void);
+
+IoT_Error_t coalesceShadowUpdate(const char *pThingName, const char *pJsonString, fpActionCallback_t callback,
+								 void *pContextData, uint8_t timeout_seconds, bool isPersistentSubscribe);
+
+void flushShadowUpdateBatches(bool isWindowIgnored);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SRC_SHADOW_AWS_IOT_SHADOW_COALESCE_H_ */
@@ -73,6 +73,7 @@ typedef struct {
 	char *pMqttClientId; ///< Currently the Shadow uses MQTT to connect and it is important to ensure we have unique client id
 	uint16_t mqttClientIdLen; ///< Currently the Shadow uses MQTT to connect and it is important to ensure we have unique client id
 	pApplicationHandler_t deleteActionHandler;	///< Callback to be invoked when Thing shadow for this device is deleted
+	bool isWildcardAckSubscription;	///< Subscribe once, at connect, to $aws/things/{pMyThingName}/shadow/+/+ and route the acks and deltas of that thing from it: its actions then neither subscribe, wait for the subscription to settle nor unsubscribe
 } ShadowConnectParameters_t;
 
 /*!
@@ -154,7 +155,8 @@ IoT_Error_t aws_iot_shadow_disconnect(AWS_IoT_Client *pClient);
  *
  */
 typedef enum {
-	SHADOW_ACK_TIMEOUT, SHADOW_ACK_REJECTED, SHADOW_ACK_ACCEPTED
+	SHADOW_ACK_TIMEOUT, SHADOW_ACK_REJECTED, SHADOW_ACK_ACCEPTED,
+	SHADOW_ACK_ACCEPTED_STREAMED ///< Accepted, but the document was too large to be kept: the callback gets an empty one
 } Shadow_Ack_Status_t;
 
 /**
@@ -176,7 +178,9 @@ typedef enum {
  * @param pThingName Thing Name of the response received
  * @param action The response of the action
  * @param status Informs if the action was Accepted/Rejected or Timed out
- * @param pReceivedJsonDocument Received JSON document
+ * @param pReceivedJsonDocument Received JSON document. Empty for documents larger than the RX buffer or with more
+ *        than MAX_JSON_TOKEN_EXPECTED tokens: those are read in fragments and only their clientToken and version are
+ *        kept, an accepted one is reported as SHADOW_ACK_ACCEPTED_STREAMED
  * @param pContextData the void* data passed in during the action call(update, get or delete)
  *
  */
@@ -196,6 +200,7 @@ typedef void (*fpActionCallback_t)(const char *pThingName, ShadowActions_t actio
  * 3. Publish on the update topic - $aws/things/{thingName}/shadow/update
  * 4. In the \c aws_iot_shadow_yield() function the response will be handled. In case of timeout or if the response is received, the subscription to shadow response topics are un-subscribed from.
  *    On the contrary if the persistent subscription is set to true then the un-subscribe will not be done. The topics will always be listened to.
+ * Steps 1 and 2 and the un-subscribe are skipped for the Thing of a client connected with isWildcardAckSubscription, its acks already arrive.
  *
  * @param pClient	MQTT Client used as the protocol layer
  * @param pThingName Thing Name of the shadow that needs to be Updated
@@ -248,6 +253,9 @@ IoT_Error_t aws_iot_shadow_delete(AWS_IoT_Client *pClient, const char *pThingNam
  * @brief This function is used to listen on the delta topic of #AWS_IOT_MY_THING_NAME mentioned in the aws_iot_config.h file.
  *
  * Any time a delta is published the Json document will be delivered to the pStruct->cb. If you don't want the parsing done by the SDK then use the jsonStruct_t key set to "state". A good example of this is displayed in the sample_apps/shadow_console_echo.c
+ * A key with dots names a nested property below "state", e.g. "light.color" for {"state":{"light":{"color":...}}}.
+ * Registered keys are hashed, so each delta is matched in a single walk over its tokens whatever the number of keys.
+ * Deltas larger than the RX buffer, up to the 8 KB shadow limit, are tokenized as they arrive: the value given to the callback must then fit in SHADOW_MAX_SIZE_OF_RX_BUFFER.
  *
  * @param pClient MQTT Client used as the protocol layer
  * @param pStruct The struct used to parse JSON value
@@ -286,6 +294,27 @@ void aws_iot_shadow_enable_discard_old_delta_msgs(void);
  */
 void aws_iot_shadow_disable_discard_old_delta_msgs(void);
 
+/**
+ * @brief Merge the updates to a thing published within a window into one update
+ *
+ * The first update to a thing opens a window of window_ms. The updates to the same thing published until it closes
+ * are merged into its document, object by object, a later value of a key replacing an earlier one, and the merged
+ * update is published by the first \c aws_iot_shadow_yield() after the window. It takes one publish and one ack wait
+ * slot, and its response is passed to the callback of every merged update. Its timeout is the longest of theirs.
+ *
+ * \c aws_iot_shadow_update() then returns once the update is merged. Updates that are not a JSON object, do not fit
+ * in SHADOW_COALESCE_DOCUMENT_SIZE or find no free batch are published on their own, as without coalescing.
+ * Gets and deletes are never delayed, they can be published before updates requested earlier.
+ *
+ * @param window_ms Time an update waits for others to be merged with, 0 disables coalescing
+ */
+void aws_iot_shadow_enable_update_coalescing(uint32_t window_ms);
+
+/**
+ * @brief Publish each update right away again, the updates waiting in a window are published now
+ */
+void aws_iot_shadow_disable_update_coalescing(void);
+
 /**
  * @brief This function is used to enable or disable autoreconnect
  *
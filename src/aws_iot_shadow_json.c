@@ -28,6 +28,7 @@ extern "C" {
 #include <stdbool.h>
 
 #include "aws_iot_json_utils.h"
+#include "aws_iot_json_writer.h"
 #include "aws_iot_log.h"
 #include "aws_iot_shadow_key.h"
 #include "aws_iot_config.h"
@@ -36,60 +37,36 @@ extern char mqttClientID[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES];
 #define AWS_IOT_SHADOW_CLIENT_TOKEN_KEY "{\"clientToken\":\""
 static uint32_t clientTokenNum = 0;
 
-//helper functions
-static IoT_Error_t convertDataToString(char *pStringBuffer, size_t maxSizoStringBuffer, JsonPrimitiveType type,
-									   void *pData);
-
 void resetClientTokenSequenceNum(void) {
 	clientTokenNum = 0;
 }
 
+/* <client id>-<sequence number>, not quoted */
+void writeClientToken(JsonWriter_t *pWriter) {
+	jsonWriteText(pWriter, mqttClientID);
+	jsonWriteChar(pWriter, '-');
+	jsonWriteUint(pWriter, clientTokenNum++);
+}
+
 static IoT_Error_t emptyJsonWithClientToken(char *pBuffer, size_t bufferSize) {
+	JsonWriter_t writer;
+
+	if(pBuffer == NULL) {
+		IOT_ERROR("NULL buffer in emptyJsonWithClientToken\n");
+		return FAILURE;
+	}
 
-    IoT_Error_t rc = SUCCESS;
-    size_t dataLenInBuffer = 0;
-
-	if(pBuffer != NULL)
-    {
-        dataLenInBuffer = (size_t)snprintf(pBuffer, bufferSize, AWS_IOT_SHADOW_CLIENT_TOKEN_KEY);
-    }else
-	{
-	    IOT_ERROR("NULL buffer in emptyJsonWithClientToken\n");
-        rc = FAILURE;
-	}
-
-	if(rc == SUCCESS)
-	{
-	    if ( dataLenInBuffer < bufferSize )
-	    {
-	        dataLenInBuffer += (size_t)snprintf(pBuffer + dataLenInBuffer, bufferSize - dataLenInBuffer, "%s-%d", mqttClientID, ( int )clientTokenNum++);
-	    }
-	    else
-	    {
-	        rc = FAILURE;
-	        IOT_ERROR("Supplied buffer too small to create JSON file\n");
-	    }
-    }
-
-	if(rc == SUCCESS)
-	{
-	    if ( dataLenInBuffer < bufferSize )
-	    {
-	        dataLenInBuffer += (size_t)snprintf( pBuffer + dataLenInBuffer, bufferSize - dataLenInBuffer, "\"}" );
-	        if ( dataLenInBuffer > bufferSize )
-	        {
-	            rc = FAILURE;
-	            IOT_ERROR( "Supplied buffer too small to create JSON file\n" );
-	        }
-	    }
-	    else
-	    {
-	        rc = FAILURE;
-	        IOT_ERROR( "Supplied buffer too small to create JSON file\n" );
-	    }
-    }
-
-    FUNC_EXIT_RC(rc);
+	jsonWriterInit(&writer, pBuffer, bufferSize);
+	jsonWriteRaw(&writer, AWS_IOT_SHADOW_CLIENT_TOKEN_KEY, sizeof(AWS_IOT_SHADOW_CLIENT_TOKEN_KEY) - 1);
+	writeClientToken(&writer);
+	jsonWriteRaw(&writer, "\"}", 2);
+	jsonWriterTerminate(&writer);
+
+	if(isJsonWriterTruncated(&writer)) {
+		IOT_ERROR("Supplied buffer too small to create JSON file\n");
+		return FAILURE;
+	}
+	return SUCCESS;
 }
 
 IoT_Error_t aws_iot_shadow_internal_get_request_json(char *pBuffer, size_t bufferSize) {
@@ -100,287 +77,211 @@ IoT_Error_t aws_iot_shadow_internal_delete_request_json(char *pBuffer, size_t bu
 	return emptyJsonWithClientToken( pBuffer, bufferSize);
 }
 
-static inline IoT_Error_t checkReturnValueOfSnPrintf(int32_t snPrintfReturn, size_t maxSizeOfJsonDocument) {
-	if(snPrintfReturn < 0) {
-		return SHADOW_JSON_ERROR;
-	} else if((size_t) snPrintfReturn >= maxSizeOfJsonDocument) {
-		return SHADOW_JSON_BUFFER_TRUNCATED;
+/**
+ * The document functions below append to a document under construction. Its
+ * end is looked up once per call, then a writer keeps the cursor, instead of
+ * a strlen of the whole document before every field.
+ */
+static bool resumeJsonDocument(JsonWriter_t *pWriter, char *pJsonDocument, size_t maxSizeOfJsonDocument) {
+	size_t length = strlen(pJsonDocument);
+
+	if(length + 1 >= maxSizeOfJsonDocument) {
+		return false;
 	}
-	return SUCCESS;
+	jsonWriterInit(pWriter, pJsonDocument, maxSizeOfJsonDocument);
+	jsonWriterSeek(pWriter, length);
+	return true;
 }
 
-IoT_Error_t aws_iot_shadow_init_json_document(char *pJsonDocument, size_t maxSizeOfJsonDocument) {
+static IoT_Error_t terminateJsonDocument(JsonWriter_t *pWriter) {
+	jsonWriterTerminate(pWriter);
+	return isJsonWriterTruncated(pWriter) ? SHADOW_JSON_BUFFER_TRUNCATED : SUCCESS;
+}
 
-	IoT_Error_t ret_val = SUCCESS;
-	int32_t snPrintfReturn = 0;
+IoT_Error_t aws_iot_shadow_init_json_document(char *pJsonDocument, size_t maxSizeOfJsonDocument) {
+	JsonWriter_t writer;
 
 	if(pJsonDocument == NULL) {
 		return NULL_VALUE_ERROR;
 	}
-	snPrintfReturn = snprintf(pJsonDocument, maxSizeOfJsonDocument, "{\"state\":{");
 
-	ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, maxSizeOfJsonDocument);
-
-	return ret_val;
+	jsonWriterInit(&writer, pJsonDocument, maxSizeOfJsonDocument);
+	jsonWriteRaw(&writer, "{\"state\":{", 10);
+	return terminateJsonDocument(&writer);
+}
 
+void writeJsonData(JsonWriter_t *pWriter, JsonPrimitiveType type, void *pData) {
+	switch(type) {
+		case SHADOW_JSON_INT32:
+			jsonWriteInt(pWriter, *(int32_t *) (pData));
+			break;
+		case SHADOW_JSON_INT16:
+			jsonWriteInt(pWriter, *(int16_t *) (pData));
+			break;
+		case SHADOW_JSON_INT8:
+			jsonWriteInt(pWriter, *(int8_t *) (pData));
+			break;
+		case SHADOW_JSON_UINT32:
+			jsonWriteUint(pWriter, *(uint32_t *) (pData));
+			break;
+		case SHADOW_JSON_UINT16:
+			jsonWriteUint(pWriter, *(uint16_t *) (pData));
+			break;
+		case SHADOW_JSON_UINT8:
+			jsonWriteUint(pWriter, *(uint8_t *) (pData));
+			break;
+		case SHADOW_JSON_DOUBLE:
+			jsonWriteDouble(pWriter, *(double *) (pData));
+			break;
+		case SHADOW_JSON_FLOAT:
+			jsonWriteFloat(pWriter, *(float *) (pData));
+			break;
+		case SHADOW_JSON_BOOL:
+			jsonWriteBool(pWriter, *(bool *) (pData));
+			break;
+		case SHADOW_JSON_STRING:
+			jsonWriteString(pWriter, (const char *) (pData));
+			break;
+		case SHADOW_JSON_OBJECT:
+			jsonWriteText(pWriter, (const char *) (pData));
+			break;
+		default:
+			break;
+	}
 }
 
-IoT_Error_t aws_iot_shadow_add_desired(char *pJsonDocument, size_t maxSizeOfJsonDocument, uint8_t count, ...) {
-	IoT_Error_t ret_val = SUCCESS;
-	size_t tempSize = 0;
-	int8_t i;
-	size_t remSizeOfJsonBuffer = maxSizeOfJsonDocument;
-	int32_t snPrintfReturn = 0;
-	va_list pArgs;
-	jsonStruct_t *pTemporary = NULL;
-	va_start(pArgs, count);
+/* appends "<section>":{"key":value,...}, to the document */
+static IoT_Error_t addJsonSection(char *pJsonDocument, size_t maxSizeOfJsonDocument, const char *pSection,
+								  uint8_t count, va_list pArgs) {
+	JsonWriter_t writer;
+	jsonStruct_t *pTemporary;
+	uint8_t i;
 
 	if(pJsonDocument == NULL) {
-		va_end(pArgs);
 		return NULL_VALUE_ERROR;
 	}
-
-	tempSize = maxSizeOfJsonDocument - strlen(pJsonDocument);
-	if(tempSize <= 1) {
-		va_end(pArgs);
+	if(!resumeJsonDocument(&writer, pJsonDocument, maxSizeOfJsonDocument)) {
 		return SHADOW_JSON_ERROR;
 	}
-	remSizeOfJsonBuffer = tempSize;
-
-	snPrintfReturn = snprintf(pJsonDocument + strlen(pJsonDocument), remSizeOfJsonBuffer, "\"desired\":{");
-	ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, remSizeOfJsonBuffer);
-
-	if(ret_val != SUCCESS) {
-		va_end(pArgs);
-		return ret_val;
-	}
 
+	jsonWriteKey(&writer, pSection);
+	jsonWriteChar(&writer, '{');
 	for(i = 0; i < count; i++) {
-		tempSize = maxSizeOfJsonDocument - strlen(pJsonDocument);
-		if(tempSize <= 1) {
-			va_end(pArgs);
-			return SHADOW_JSON_ERROR;
-		}
-		remSizeOfJsonBuffer = tempSize;
 		pTemporary = va_arg (pArgs, jsonStruct_t *);
-		if(pTemporary != NULL) {
-			snPrintfReturn = snprintf(pJsonDocument + strlen(pJsonDocument), remSizeOfJsonBuffer, "\"%s\":",
-									  pTemporary->pKey);
-			ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, remSizeOfJsonBuffer);
-			if(ret_val != SUCCESS) {
-				va_end(pArgs);
-				return ret_val;
-			}
-			if(pTemporary->pKey != NULL && pTemporary->pData != NULL) {
-				ret_val = convertDataToString(pJsonDocument + strlen(pJsonDocument), remSizeOfJsonBuffer,
-											  pTemporary->type, pTemporary->pData);
-			} else {
-				va_end(pArgs);
-				return NULL_VALUE_ERROR;
-			}
-			if(ret_val != SUCCESS) {
-				va_end(pArgs);
-				return ret_val;
-			}
-		} else {
-			va_end(pArgs);
+		if(pTemporary == NULL || pTemporary->pKey == NULL || pTemporary->pData == NULL) {
+			jsonWriterTerminate(&writer);
 			return NULL_VALUE_ERROR;
 		}
+		if(i > 0) {
+			jsonWriteChar(&writer, ',');
+		}
+		jsonWriteKey(&writer, pTemporary->pKey);
+		writeJsonData(&writer, pTemporary->type, pTemporary->pData);
 	}
+	jsonWriteRaw(&writer, "},", 2);
 
-	va_end(pArgs);
-	snPrintfReturn = snprintf(pJsonDocument + strlen(pJsonDocument) - 1, remSizeOfJsonBuffer, "},");
-	ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, remSizeOfJsonBuffer);
-	return ret_val;
+	return terminateJsonDocument(&writer);
 }
 
-IoT_Error_t aws_iot_shadow_add_reported(char *pJsonDocument, size_t maxSizeOfJsonDocument, uint8_t count, ...) {
-	IoT_Error_t ret_val = SUCCESS;
-
-	int8_t i;
-	size_t remSizeOfJsonBuffer = maxSizeOfJsonDocument;
-	int32_t snPrintfReturn = 0;
-	size_t tempSize = 0;
-	jsonStruct_t *pTemporary;
+IoT_Error_t aws_iot_shadow_add_desired(char *pJsonDocument, size_t maxSizeOfJsonDocument, uint8_t count, ...) {
+	IoT_Error_t ret_val;
 	va_list pArgs;
-	va_start(pArgs, count);
-
-	if(pJsonDocument == NULL) {
-		va_end(pArgs);
-		return NULL_VALUE_ERROR;
-	}
-
-
-	tempSize = maxSizeOfJsonDocument - strlen(pJsonDocument);
-	if(tempSize <= 1) {
-		va_end(pArgs);
-		return SHADOW_JSON_ERROR;
-	}
-	remSizeOfJsonBuffer = tempSize;
 
-	snPrintfReturn = snprintf(pJsonDocument + strlen(pJsonDocument), remSizeOfJsonBuffer, "\"reported\":{");
-	ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, remSizeOfJsonBuffer);
-
-	if(ret_val != SUCCESS) {
-		va_end(pArgs);
-		return ret_val;
-	}
+	va_start(pArgs, count);
+	ret_val = addJsonSection(pJsonDocument, maxSizeOfJsonDocument, "desired", count, pArgs);
+	va_end(pArgs);
 
-	for(i = 0; i < count; i++) {
-		tempSize = maxSizeOfJsonDocument - strlen(pJsonDocument);
-		if(tempSize <= 1) {
-			va_end(pArgs);
-			return SHADOW_JSON_ERROR;
-		}
-		remSizeOfJsonBuffer = tempSize;
+	return ret_val;
+}
 
-		pTemporary = va_arg (pArgs, jsonStruct_t *);
-		if(pTemporary != NULL) {
-			snPrintfReturn = snprintf(pJsonDocument + strlen(pJsonDocument), remSizeOfJsonBuffer, "\"%s\":",
-									  pTemporary->pKey);
-			ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, remSizeOfJsonBuffer);
-			if(ret_val != SUCCESS) {
-				va_end(pArgs);
-				return ret_val;
-			}
-			if(pTemporary->pKey != NULL && pTemporary->pData != NULL) {
-				ret_val = convertDataToString(pJsonDocument + strlen(pJsonDocument), remSizeOfJsonBuffer,
-											  pTemporary->type, pTemporary->pData);
-			} else {
-				va_end(pArgs);
-				return NULL_VALUE_ERROR;
-			}
-			if(ret_val != SUCCESS) {
-				va_end(pArgs);
-				return ret_val;
-			}
-		} else {
-			va_end(pArgs);
-			return NULL_VALUE_ERROR;
-		}
-	}
+IoT_Error_t aws_iot_shadow_add_reported(char *pJsonDocument, size_t maxSizeOfJsonDocument, uint8_t count, ...) {
+	IoT_Error_t ret_val;
+	va_list pArgs;
 
+	va_start(pArgs, count);
+	ret_val = addJsonSection(pJsonDocument, maxSizeOfJsonDocument, "reported", count, pArgs);
 	va_end(pArgs);
-	snPrintfReturn = snprintf(pJsonDocument + strlen(pJsonDocument) - 1, remSizeOfJsonBuffer, "},");
-	ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, remSizeOfJsonBuffer);
+
 	return ret_val;
 }
 
-
 int32_t FillWithClientTokenSize(char *pBufferToBeUpdatedWithClientToken, size_t maxSizeOfJsonDocument) {
-	int32_t snPrintfReturn;
-	snPrintfReturn = snprintf(pBufferToBeUpdatedWithClientToken, maxSizeOfJsonDocument, "%s-%d", mqttClientID,
-				  (int) clientTokenNum++);
+	JsonWriter_t writer;
+
+	jsonWriterInit(&writer, pBufferToBeUpdatedWithClientToken, maxSizeOfJsonDocument);
+	writeClientToken(&writer);
 
-	return snPrintfReturn;
+	return (int32_t) jsonWriterTerminate(&writer);
 }
 
 IoT_Error_t aws_iot_fill_with_client_token(char *pBufferToBeUpdatedWithClientToken, size_t maxSizeOfJsonDocument) {
+	JsonWriter_t writer;
 
-	int32_t snPrintfRet = 0;
-	snPrintfRet = FillWithClientTokenSize(pBufferToBeUpdatedWithClientToken, maxSizeOfJsonDocument);
-	return checkReturnValueOfSnPrintf(snPrintfRet, maxSizeOfJsonDocument);
+	jsonWriterInit(&writer, pBufferToBeUpdatedWithClientToken, maxSizeOfJsonDocument);
+	writeClientToken(&writer);
 
+	return terminateJsonDocument(&writer);
 }
 
 IoT_Error_t aws_iot_finalize_json_document(char *pJsonDocument, size_t maxSizeOfJsonDocument) {
-	size_t remSizeOfJsonBuffer = maxSizeOfJsonDocument;
-	int32_t snPrintfReturn = 0;
-	size_t tempSize = 0;
-	IoT_Error_t ret_val = SUCCESS;
+	JsonWriter_t writer;
 
 	if(pJsonDocument == NULL) {
 		return NULL_VALUE_ERROR;
 	}
-
-	tempSize = maxSizeOfJsonDocument - strlen(pJsonDocument);
-	if(tempSize <= 1) {
+	if(!resumeJsonDocument(&writer, pJsonDocument, maxSizeOfJsonDocument) || 0 == writer.length) {
 		return SHADOW_JSON_ERROR;
 	}
-	remSizeOfJsonBuffer = tempSize;
 
-	// strlen(ShadowTxBuffer) - 1 is to ensure we remove the last ,(comma) that was added
-	snPrintfReturn = snprintf(pJsonDocument + strlen(pJsonDocument) - 1, remSizeOfJsonBuffer, "}, \"%s\":\"",
-							  SHADOW_CLIENT_TOKEN_STRING);
-	ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, remSizeOfJsonBuffer);
+	// the last ,(comma) that was added by the add functions is replaced
+	jsonWriterSeek(&writer, writer.length - 1);
+	jsonWriteRaw(&writer, "}, ", 3);
+	jsonWriteKey(&writer, SHADOW_CLIENT_TOKEN_STRING);
+	jsonWriteChar(&writer, '"');
+	writeClientToken(&writer);
+	jsonWriteRaw(&writer, "\"}", 2);
 
-	if(ret_val != SUCCESS) {
-		return ret_val;
-	}
-	// refactor this XXX repeated code
-	tempSize = maxSizeOfJsonDocument - strlen(pJsonDocument);
-	if(tempSize <= 1) {
-		return SHADOW_JSON_ERROR;
-	}
-	remSizeOfJsonBuffer = tempSize;
+	return terminateJsonDocument(&writer);
+}
 
+static jsmn_parser shadowJsonParser;
+static jsmntok_t jsonTokenStruct[MAX_JSON_TOKEN_EXPECTED];
 
-	snPrintfReturn = FillWithClientTokenSize(pJsonDocument + strlen(pJsonDocument), remSizeOfJsonBuffer);
-	ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, remSizeOfJsonBuffer);
+/* index of the first token after the value starting at valueIndex */
+static int32_t skipJsonValue(int32_t valueIndex, int32_t tokenCount) {
+	int32_t i = valueIndex + 1;
 
-	if(ret_val != SUCCESS) {
-		return ret_val;
-	}
-	tempSize = maxSizeOfJsonDocument - strlen(pJsonDocument);
-	if(tempSize <= 1) {
-		return SHADOW_JSON_ERROR;
+	while(i < tokenCount && jsonTokenStruct[i].start < jsonTokenStruct[valueIndex].end) {
+		i++;
 	}
-	remSizeOfJsonBuffer = tempSize;
-
-
-	snPrintfReturn = snprintf(pJsonDocument + strlen(pJsonDocument), remSizeOfJsonBuffer, "\"}");
-	ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, remSizeOfJsonBuffer);
-
-	return ret_val;
+	return i;
 }
 
-static IoT_Error_t convertDataToString(char *pStringBuffer, size_t maxSizoStringBuffer, JsonPrimitiveType type,
-									   void *pData) {
-	int32_t snPrintfReturn = 0;
-	IoT_Error_t ret_val = SUCCESS;
-
-	if(maxSizoStringBuffer == 0) {
-		return SHADOW_JSON_ERROR;
+static void indexTopLevelKeys(const char *pJsonDocument, int32_t tokenCount, ShadowJsonIndex_t *pIndex) {
+	int32_t i, next;
+
+	pIndex->versionIndex = -1;
+	pIndex->clientTokenIndex = -1;
+	pIndex->stateIndex = -1;
+	pIndex->stateEndIndex = -1;
+
+	for(i = 1; i + 1 < tokenCount; i = next) {
+		next = skipJsonValue(i + 1, tokenCount);
+		if(jsoneq(pJsonDocument, &jsonTokenStruct[i], SHADOW_VERSION_STRING) == 0) {
+			pIndex->versionIndex = i + 1;
+		} else if(jsoneq(pJsonDocument, &jsonTokenStruct[i], SHADOW_CLIENT_TOKEN_STRING) == 0) {
+			pIndex->clientTokenIndex = i + 1;
+		} else if(jsoneq(pJsonDocument, &jsonTokenStruct[i], SHADOW_STATE_STRING) == 0
+				  && jsonTokenStruct[i + 1].type == JSMN_OBJECT) {
+			pIndex->stateIndex = i + 1;
+			pIndex->stateEndIndex = next;
+		}
 	}
-
-	if(type == SHADOW_JSON_INT32) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%i,", *(int32_t *) (pData));
-	} else if(type == SHADOW_JSON_INT16) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%hi,", *(int16_t *) (pData));
-	} else if(type == SHADOW_JSON_INT8) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%hhi,", *(int8_t *) (pData));
-	} else if(type == SHADOW_JSON_UINT32) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%u,", *(uint32_t *) (pData));
-	} else if(type == SHADOW_JSON_UINT16) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%hu,", *(uint16_t *) (pData));
-	} else if(type == SHADOW_JSON_UINT8) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%hhu,", *(uint8_t *) (pData));
-	} else if(type == SHADOW_JSON_DOUBLE) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%f,", *(double *) (pData));
-	} else if(type == SHADOW_JSON_FLOAT) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%f,", *(float *) (pData));
-	} else if(type == SHADOW_JSON_BOOL) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%s,", *(bool *) (pData) ? "true" : "false");
-	} else if(type == SHADOW_JSON_STRING) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "\"%s\",", (char *) (pData));
-	} else if(type == SHADOW_JSON_OBJECT) {
-		snPrintfReturn = snprintf(pStringBuffer, maxSizoStringBuffer, "%s,", (char *) (pData));
-	}
-
-
-	ret_val = checkReturnValueOfSnPrintf(snPrintfReturn, maxSizoStringBuffer);
-
-	return ret_val;
 }
 
-static jsmn_parser shadowJsonParser;
-static jsmntok_t jsonTokenStruct[MAX_JSON_TOKEN_EXPECTED];
-
 bool isJsonValidAndParse(const char *pJsonDocument, size_t jsonSize, void *pJsonHandler, int32_t *pTokenCount) {
 	int32_t tokenCount;
 
-	IOT_UNUSED(pJsonHandler);
-
 	jsmn_init(&shadowJsonParser);
 
 	tokenCount = jsmn_parse(&shadowJsonParser, pJsonDocument, jsonSize, jsonTokenStruct,
@@ -397,6 +298,10 @@ bool isJsonValidAndParse(const char *pJsonDocument, size_t jsonSize, void *pJson
 		return false;
 	}
 
+	if(NULL != pJsonHandler) {
+		indexTopLevelKeys(pJsonDocument, tokenCount, (ShadowJsonIndex_t *) pJsonHandler);
+	}
+
 	*pTokenCount = tokenCount;
 
 	return true;
@@ -477,31 +382,189 @@ bool isJsonKeyMatchingAndUpdateValue(const char *pJsonDocument, void *pJsonHandl
 	return false;
 }
 
-bool isReceivedJsonValid(const char *pJsonDocument, size_t jsonSize ) {
-	int32_t tokenCount;
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
 
-	jsmn_init(&shadowJsonParser);
+static uint32_t hashAppend(uint32_t hash, const char *pData, size_t length) {
+	size_t i;
 
-	tokenCount = jsmn_parse(&shadowJsonParser, pJsonDocument, jsonSize, jsonTokenStruct,
-							sizeof(jsonTokenStruct) / sizeof(jsonTokenStruct[0]));
+	for(i = 0; i < length; i++) {
+		hash = (hash ^ (uint8_t) pData[i]) * FNV_PRIME;
+	}
+	return hash;
+}
 
-	if(tokenCount < 0) {
-		IOT_WARN("Failed to parse JSON: %d\n", tokenCount);
-		return false;
+void resetDeltaKeyIndex(ShadowDeltaKeyIndex_t *pKeyIndex) {
+	uint32_t i;
+
+	for(i = 0; i < SHADOW_DELTA_KEY_HASH_SIZE; i++) {
+		pKeyIndex->buckets[i] = -1;
 	}
+	pKeyIndex->count = 0;
+}
 
-	/* Assume the top-level element is an object */
-	if(tokenCount < 1 || jsonTokenStruct[0].type != JSMN_OBJECT) {
+bool addDeltaKey(ShadowDeltaKeyIndex_t *pKeyIndex, const char *pKey) {
+	uint32_t bucket;
+	size_t length = strlen(pKey);
+	uint16_t entry = pKeyIndex->count;
+
+	/* keep one bucket empty so that lookups terminate */
+	if(entry >= MAX_JSON_TOKEN_EXPECTED || entry >= SHADOW_DELTA_KEY_HASH_SIZE - 1 || length > UINT16_MAX) {
 		return false;
 	}
 
+	pKeyIndex->pKeys[entry] = pKey;
+	pKeyIndex->keyLengths[entry] = (uint16_t) length;
+	pKeyIndex->hashes[entry] = hashAppend(FNV_OFFSET_BASIS, pKey, length);
+	pKeyIndex->isPath[entry] = (NULL != strchr(pKey, '.'));
+
+	bucket = pKeyIndex->hashes[entry] & (SHADOW_DELTA_KEY_HASH_SIZE - 1);
+	while(pKeyIndex->buckets[bucket] >= 0) {
+		bucket = (bucket + 1) & (SHADOW_DELTA_KEY_HASH_SIZE - 1);
+	}
+	pKeyIndex->buckets[bucket] = (int16_t) entry;
+	pKeyIndex->count++;
+
 	return true;
 }
 
-bool extractClientToken(const char *pJsonDocument, size_t jsonSize, char *pExtractedClientToken, size_t clientTokenSize) {
-	int32_t tokenCount, i;
+typedef struct {
+	int32_t end;		/* end offset of the object */
+	int32_t keyToken;	/* key holding the object */
+	int32_t stateDepth;	/* 0 for "state", 1 for its children and so on, -1 outside of it */
+	uint32_t pathHash;	/* hash of the path below "state" */
+} DeltaPathFrame_t;
+
+static bool isPathMatching(const char *pJsonDocument, const ShadowDeltaKeyIndex_t *pKeyIndex, uint16_t entry,
+						   const DeltaPathFrame_t *pFrames, uint32_t depth, int32_t keyToken) {
+	const char *pPath = pKeyIndex->pKeys[entry];
+	const char *pPathEnd = pPath + pKeyIndex->keyLengths[entry];
+	const jsmntok_t *pToken;
 	size_t length;
-	jsmntok_t ClientJsonToken;
+	uint32_t i;
+
+	for(i = 0; i <= depth; i++) {
+		if(i < depth && pFrames[i].stateDepth < 1) {
+			continue;
+		}
+		pToken = &jsonTokenStruct[(i < depth) ? pFrames[i].keyToken : keyToken];
+		length = (size_t) (pToken->end - pToken->start);
+		if((size_t) (pPathEnd - pPath) < length || strncmp(pPath, pJsonDocument + pToken->start, length) != 0) {
+			return false;
+		}
+		pPath += length;
+		if(i < depth) {
+			if(pPath == pPathEnd || *pPath != '.') {
+				return false;
+			}
+			pPath++;
+		}
+	}
+	return pPath == pPathEnd;
+}
+
+static void matchKey(const char *pJsonDocument, const ShadowDeltaKeyIndex_t *pKeyIndex, uint32_t hash,
+					 bool isPath, const DeltaPathFrame_t *pFrames, uint32_t depth, int32_t keyToken,
+					 int32_t *pValueTokens) {
+	uint32_t bucket = hash & (SHADOW_DELTA_KEY_HASH_SIZE - 1);
+	int16_t entry;
+	jsmntok_t *pKey = &jsonTokenStruct[keyToken];
+
+	while((entry = pKeyIndex->buckets[bucket]) >= 0) {
+		if(pKeyIndex->hashes[entry] == hash && pKeyIndex->isPath[entry] == isPath && pValueTokens[entry] < 0) {
+			if(isPath ? isPathMatching(pJsonDocument, pKeyIndex, (uint16_t) entry, pFrames, depth, keyToken)
+					  : (jsoneq(pJsonDocument, pKey, pKeyIndex->pKeys[entry]) == 0)) {
+				pValueTokens[entry] = keyToken + 1;
+			}
+		}
+		bucket = (bucket + 1) & (SHADOW_DELTA_KEY_HASH_SIZE - 1);
+	}
+}
+
+/**
+ * One walk over the tokens of the parsed delta finds the value of every
+ * registered key: each key token is hashed once and looked up, instead of
+ * every registered key scanning all the tokens. pValueTokens[entry] is set to
+ * the value token of the entry, -1 when the delta does not contain it. The
+ * top-level "metadata" object is skipped, arrays are delivered whole.
+ */
+void matchDeltaKeys(const char *pJsonDocument, int32_t tokenCount, const ShadowDeltaKeyIndex_t *pKeyIndex,
+					int32_t *pValueTokens) {
+	DeltaPathFrame_t frames[SHADOW_DELTA_MAX_PATH_DEPTH + 1];
+	DeltaPathFrame_t *pFrame;
+	uint32_t depth = 1;
+	uint32_t keyHash, pathHash = 0;
+	int32_t i, value;
+	uint16_t entry;
+
+	for(entry = 0; entry < pKeyIndex->count; entry++) {
+		pValueTokens[entry] = -1;
+	}
+	if(tokenCount < 1 || 0 == pKeyIndex->count) {
+		return;
+	}
+
+	frames[0].end = jsonTokenStruct[0].end;
+	frames[0].keyToken = -1;
+	frames[0].stateDepth = -1;
+	frames[0].pathHash = FNV_OFFSET_BASIS;
+
+	for(i = 1; i + 1 < tokenCount; ) {
+		while(depth > 0 && jsonTokenStruct[i].start >= frames[depth - 1].end) {
+			depth--;
+		}
+		if(0 == depth || jsonTokenStruct[i].type != JSMN_STRING) {
+			break;
+		}
+		pFrame = &frames[depth - 1];
+		value = i + 1;
+
+		if(1 == depth && jsoneq(pJsonDocument, &jsonTokenStruct[i], "metadata") == 0) {
+			i = skipJsonValue(value, tokenCount);
+			continue;
+		}
+
+		keyHash = hashAppend(FNV_OFFSET_BASIS, pJsonDocument + jsonTokenStruct[i].start,
+							 (size_t) (jsonTokenStruct[i].end - jsonTokenStruct[i].start));
+		matchKey(pJsonDocument, pKeyIndex, keyHash, false, frames, depth, i, pValueTokens);
+
+		if(pFrame->stateDepth >= 1) {
+			pathHash = hashAppend(hashAppend(pFrame->pathHash, ".", 1), pJsonDocument + jsonTokenStruct[i].start,
+								  (size_t) (jsonTokenStruct[i].end - jsonTokenStruct[i].start));
+			matchKey(pJsonDocument, pKeyIndex, pathHash, true, frames, depth, i, pValueTokens);
+		}
+
+		if(jsonTokenStruct[value].type == JSMN_OBJECT && depth <= SHADOW_DELTA_MAX_PATH_DEPTH) {
+			frames[depth].end = jsonTokenStruct[value].end;
+			frames[depth].keyToken = i;
+			if(pFrame->stateDepth >= 0) {
+				frames[depth].stateDepth = pFrame->stateDepth + 1;
+			} else if(1 == depth && jsoneq(pJsonDocument, &jsonTokenStruct[i], SHADOW_STATE_STRING) == 0) {
+				frames[depth].stateDepth = 0;
+			} else {
+				frames[depth].stateDepth = -1;
+			}
+			frames[depth].pathHash = (pFrame->stateDepth >= 1) ? pathHash : keyHash;
+			depth++;
+			i = value + 1;
+		} else {
+			i = skipJsonValue(value, tokenCount);
+		}
+	}
+}
+
+void updateValueFromToken(const char *pJsonDocument, int32_t valueToken, jsonStruct_t *pDataStruct,
+						  uint32_t *pDataLength, int32_t *pDataPosition) {
+	jsmntok_t dataToken = jsonTokenStruct[valueToken];
+
+	UpdateValueIfNoObject(pJsonDocument, pDataStruct, dataToken);
+	*pDataPosition = dataToken.start;
+	*pDataLength = (uint32_t) (dataToken.end - dataToken.start);
+}
+
+bool isReceivedJsonValid(const char *pJsonDocument, size_t jsonSize ) {
+	int32_t tokenCount;
+
 	jsmn_init(&shadowJsonParser);
 
 	tokenCount = jsmn_parse(&shadowJsonParser, pJsonDocument, jsonSize, jsonTokenStruct,
@@ -517,30 +580,109 @@ bool extractClientToken(const char *pJsonDocument, size_t jsonSize, char *pExtra
 		return false;
 	}
 
-	for(i = 1; i < tokenCount; i++) {
-		if(jsoneq(pJsonDocument, &jsonTokenStruct[i], SHADOW_CLIENT_TOKEN_STRING) == 0) {
-			ClientJsonToken = jsonTokenStruct[i + 1];
-			length = (size_t) (ClientJsonToken.end - ClientJsonToken.start);
-            if (clientTokenSize >= length + 1)
-            {
-                strncpy( pExtractedClientToken, pJsonDocument + ClientJsonToken.start, length);
-                pExtractedClientToken[length] = '\0';
-                return true;
-            }else{
-                IOT_WARN( "Token size %zu too small for string %zu \n", clientTokenSize, length);
-                return false; 
-            }
+	return true;
+}
+
+static size_t skipJsonSpaces(const char *pJsonDocument, size_t jsonSize, size_t position) {
+	while(position < jsonSize && (pJsonDocument[position] == ' ' || pJsonDocument[position] == '\t'
+								  || pJsonDocument[position] == '\r' || pJsonDocument[position] == '\n')) {
+		position++;
+	}
+	return position;
+}
+
+/* position of the quote closing the string whose content starts at position, jsonSize if unterminated */
+static size_t skipJsonString(const char *pJsonDocument, size_t jsonSize, size_t position) {
+	while(position < jsonSize && pJsonDocument[position] != '"' && pJsonDocument[position] != '\0') {
+		position += (pJsonDocument[position] == '\\') ? 2 : 1;
+	}
+	return (position < jsonSize && pJsonDocument[position] == '"') ? position : jsonSize;
+}
+
+static bool copyClientToken(const char *pValue, size_t length, char *pExtractedClientToken, size_t clientTokenSize) {
+	if(clientTokenSize >= length + 1) {
+		strncpy(pExtractedClientToken, pValue, length);
+		pExtractedClientToken[length] = '\0';
+		return true;
+	}
+	IOT_WARN("Token size %zu too small for string %zu \n", clientTokenSize, length);
+	return false;
+}
+
+/**
+ * Outgoing documents are only searched for their top-level clientToken. A
+ * character scan does it without tokenizing, which also leaves the token set
+ * of the document being received untouched when an update is sent from a
+ * delta callback.
+ */
+bool extractClientToken(const char *pJsonDocument, size_t jsonSize, char *pExtractedClientToken, size_t clientTokenSize) {
+	size_t i, end, next;
+	int32_t depth = 0;
+	const size_t keyLength = strlen(SHADOW_CLIENT_TOKEN_STRING);
+
+	for(i = 0; i < jsonSize && pJsonDocument[i] != '\0'; i++) {
+		if(pJsonDocument[i] == '{' || pJsonDocument[i] == '[') {
+			depth++;
+		} else if(pJsonDocument[i] == '}' || pJsonDocument[i] == ']') {
+			depth--;
+		} else if(pJsonDocument[i] == '"') {
+			end = skipJsonString(pJsonDocument, jsonSize, i + 1);
+			if(end >= jsonSize) {
+				return false;
+			}
+			next = skipJsonSpaces(pJsonDocument, jsonSize, end + 1);
+			if(1 == depth && next < jsonSize && pJsonDocument[next] == ':' && end - i - 1 == keyLength
+			   && strncmp(pJsonDocument + i + 1, SHADOW_CLIENT_TOKEN_STRING, keyLength) == 0) {
+				i = skipJsonSpaces(pJsonDocument, jsonSize, next + 1);
+				if(i >= jsonSize || pJsonDocument[i] != '"') {
+					return false;
+				}
+				end = skipJsonString(pJsonDocument, jsonSize, i + 1);
+				if(end >= jsonSize) {
+					return false;
+				}
+				return copyClientToken(pJsonDocument + i + 1, end - i - 1, pExtractedClientToken, clientTokenSize);
+			}
+			i = end;
 		}
 	}
 
 	return false;
 }
 
+bool extractParsedClientToken(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount,
+							  char *pExtractedClientToken, size_t clientTokenSize) {
+	int32_t i = -1, key;
+	ShadowJsonIndex_t *pIndex = (ShadowJsonIndex_t *) pJsonHandler;
+
+	if(NULL != pIndex) {
+		i = pIndex->clientTokenIndex;
+	} else {
+		for(key = 1; key + 1 < tokenCount && i < 0; key++) {
+			if(jsoneq(pJsonDocument, &jsonTokenStruct[key], SHADOW_CLIENT_TOKEN_STRING) == 0) {
+				i = key + 1;
+			}
+		}
+	}
+
+	if(i < 0 || i >= tokenCount) {
+		return false;
+	}
+
+	return copyClientToken(pJsonDocument + jsonTokenStruct[i].start,
+						   (size_t) (jsonTokenStruct[i].end - jsonTokenStruct[i].start),
+						   pExtractedClientToken, clientTokenSize);
+}
+
 bool extractVersionNumber(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, uint32_t *pVersionNumber) {
 	int32_t i;
 	IoT_Error_t ret_val = SUCCESS;
+	ShadowJsonIndex_t *pIndex = (ShadowJsonIndex_t *) pJsonHandler;
 
-	IOT_UNUSED(pJsonHandler);
+	if(NULL != pIndex) {
+		return pIndex->versionIndex >= 0
+			   && parseUnsignedInteger32Value(pVersionNumber, pJsonDocument, &jsonTokenStruct[pIndex->versionIndex]) == SUCCESS;
+	}
 
 	for(i = 1; i < tokenCount; i++) {
 		if(jsoneq(pJsonDocument, &(jsonTokenStruct[i]), SHADOW_VERSION_STRING) == 0) {
@@ -553,7 +695,247 @@ bool extractVersionNumber(const char *pJsonDocument, void *pJsonHandler, int32_t
 	return false;
 }
 
+bool extractErrorCode(const char *pJsonDocument, int32_t tokenCount, uint32_t *pErrorCode) {
+	int32_t i;
+
+	for(i = 1; i + 1 < tokenCount; i = skipJsonValue(i + 1, tokenCount)) {
+		if(jsoneq(pJsonDocument, &jsonTokenStruct[i], SHADOW_ERROR_CODE_STRING) == 0) {
+			return parseUnsignedInteger32Value(pErrorCode, pJsonDocument, &jsonTokenStruct[i + 1]) == SUCCESS;
+		}
+	}
+	return false;
+}
+
+#define SHADOW_STREAM_VERSION 0x01
+#define SHADOW_STREAM_CLIENT_TOKEN 0x02
+
+static bool isStreamKey(const JsonStreamFrame_t *pFrame, const char *pKey) {
+	size_t length = strlen(pKey);
+
+	return length <= JSON_STREAM_MAX_KEY_LEN && pFrame->keyLen == length && strncmp(pFrame->key, pKey, length) == 0;
+}
+
+/* frames[0] holds "state", the path is made of the current keys of the frames below it */
+static bool isStreamPathMatching(const ShadowJsonStream_t *pShadowStream, uint16_t entry) {
+	const JsonStream_t *pStream = &pShadowStream->stream;
+	const char *pPath = pShadowStream->pKeyIndex->pKeys[entry];
+	const char *pPathEnd = pPath + pShadowStream->pKeyIndex->keyLengths[entry];
+	size_t length;
+	uint16_t i;
+
+	for(i = 1; i < pStream->depth; i++) {
+		length = pStream->frames[i].keyLen;
+		if((size_t) (pPathEnd - pPath) < length || strncmp(pPath, pStream->frames[i].key, length) != 0) {
+			return false;
+		}
+		pPath += length;
+		if(i + 1 < pStream->depth) {
+			if(pPath == pPathEnd || *pPath != '.') {
+				return false;
+			}
+			pPath++;
+		}
+	}
+	return pPath == pPathEnd;
+}
+
+/* entries matching the current key wait for its value, first occurrence only as in matchDeltaKeys */
+static void waitForStreamValue(ShadowJsonStream_t *pShadowStream, uint32_t hash, bool isPath) {
+	const ShadowDeltaKeyIndex_t *pKeyIndex = pShadowStream->pKeyIndex;
+	uint16_t depth = pShadowStream->stream.depth;
+	const JsonStreamFrame_t *pFrame = &pShadowStream->stream.frames[depth - 1];
+	uint32_t bucket = hash & (SHADOW_DELTA_KEY_HASH_SIZE - 1);
+	int16_t entry;
+	bool isMatching;
+
+	while((entry = pKeyIndex->buckets[bucket]) >= 0) {
+		if(pKeyIndex->hashes[entry] == hash && pKeyIndex->isPath[entry] == isPath
+		   && SHADOW_STREAM_NO_VALUE == pShadowStream->values[entry].start) {
+			isMatching = isPath ? isStreamPathMatching(pShadowStream, (uint16_t) entry)
+								: (pKeyIndex->keyLengths[entry] == pFrame->keyLen
+								   && strncmp(pKeyIndex->pKeys[entry], pFrame->key, pFrame->keyLen) == 0);
+			if(isMatching) {
+				pShadowStream->values[entry].start = SHADOW_STREAM_PENDING_VALUE;
+				pShadowStream->pendingNext[entry] = pShadowStream->pendingHead[depth];
+				pShadowStream->pendingHead[depth] = entry;
+			}
+		}
+		bucket = (bucket + 1) & (SHADOW_DELTA_KEY_HASH_SIZE - 1);
+	}
+}
+
+static bool onShadowStreamKey(ShadowJsonStream_t *pShadowStream) {
+	const JsonStream_t *pStream = &pShadowStream->stream;
+	uint16_t depth = pStream->depth;
+	const JsonStreamFrame_t *pFrame = &pStream->frames[depth - 1];
+	uint32_t pathHash;
+	uint16_t i;
+
+	if(pFrame->keyLen > JSON_STREAM_MAX_KEY_LEN) {
+		return false;
+	}
+
+	if(1 == depth) {
+		if(isStreamKey(pFrame, SHADOW_VERSION_STRING)) {
+			pShadowStream->pendingTopLevel = SHADOW_STREAM_VERSION;
+		} else if(isStreamKey(pFrame, SHADOW_CLIENT_TOKEN_STRING)) {
+			pShadowStream->pendingTopLevel = SHADOW_STREAM_CLIENT_TOKEN;
+		} else if(isStreamKey(pFrame, "metadata")) {
+			return false;
+		}
+	} else if(isStreamKey(&pStream->frames[0], "metadata")) {
+		return false;
+	}
+
+	/* arrays are delivered whole, their content is not searched */
+	for(i = 0; i + 1 < depth; i++) {
+		if(pStream->frames[i].isArray) {
+			return false;
+		}
+	}
+
+	if(NULL != pShadowStream->pKeyIndex) {
+		waitForStreamValue(pShadowStream, hashAppend(FNV_OFFSET_BASIS, pFrame->key, pFrame->keyLen), false);
+
+		if(depth >= 3 && isStreamKey(&pStream->frames[0], SHADOW_STATE_STRING)) {
+			pathHash = FNV_OFFSET_BASIS;
+			for(i = 1; i < depth && pStream->frames[i].keyLen <= JSON_STREAM_MAX_KEY_LEN; i++) {
+				if(i > 1) {
+					pathHash = hashAppend(pathHash, ".", 1);
+				}
+				pathHash = hashAppend(pathHash, pStream->frames[i].key, pStream->frames[i].keyLen);
+			}
+			if(i == depth) {
+				waitForStreamValue(pShadowStream, pathHash, true);
+			}
+		}
+	}
+
+	return pShadowStream->pendingHead[depth] >= 0 || (1 == depth && 0 != pShadowStream->pendingTopLevel);
+}
+
+static void storeStreamValue(const JsonStream_t *pStream, ShadowStreamValue_t *pValue) {
+	if(pStream->isValueTruncated || pStream->valueToken.end >= SHADOW_STREAM_PENDING_VALUE) {
+		pValue->start = SHADOW_STREAM_NO_VALUE;
+		return;
+	}
+	pValue->start = (uint16_t) pStream->valueToken.start;
+	pValue->end = (uint16_t) pStream->valueToken.end;
+	pValue->type = (uint8_t) pStream->valueToken.type;
+}
+
+static void onShadowStreamValue(ShadowJsonStream_t *pShadowStream) {
+	const JsonStream_t *pStream = &pShadowStream->stream;
+	uint16_t depth = pStream->depth;
+	int16_t entry = pShadowStream->pendingHead[depth];
+
+	if(pStream->isValueTruncated) {
+		IOT_WARN("Shadow value larger than the capture buffer, ignored");
+	}
+
+	while(entry >= 0) {
+		storeStreamValue(pStream, &pShadowStream->values[entry]);
+		entry = pShadowStream->pendingNext[entry];
+	}
+	pShadowStream->pendingHead[depth] = -1;
+
+	if(1 == depth) {
+		if(0 != (pShadowStream->pendingTopLevel & SHADOW_STREAM_VERSION)) {
+			storeStreamValue(pStream, &pShadowStream->version);
+		}
+		if(0 != (pShadowStream->pendingTopLevel & SHADOW_STREAM_CLIENT_TOKEN)) {
+			storeStreamValue(pStream, &pShadowStream->clientToken);
+		}
+		pShadowStream->pendingTopLevel = 0;
+	}
+}
+
+static bool onShadowStreamEvent(JsonStream_t *pStream, JsonStreamEvent_t event, void *pContext) {
+	ShadowJsonStream_t *pShadowStream = (ShadowJsonStream_t *) pContext;
+
+	(void) pStream;
+	if(JSON_STREAM_KEY == event) {
+		return onShadowStreamKey(pShadowStream);
+	}
+	onShadowStreamValue(pShadowStream);
+	return false;
+}
+
+/**
+ * The capture buffer receives the wanted values only, so a document of any
+ * size and any number of keys is read as long as those values fit in it.
+ * Fragments can be fed from the MQTT receive buffer as they arrive.
+ */
+void startShadowJsonStream(ShadowJsonStream_t *pShadowStream, char *pCapture, size_t captureSize,
+						   const ShadowDeltaKeyIndex_t *pKeyIndex) {
+	uint16_t i;
+	uint16_t count = (NULL != pKeyIndex) ? pKeyIndex->count : 0;
+
+	jsonStreamInit(&pShadowStream->stream, pCapture, captureSize, onShadowStreamEvent, pShadowStream);
+	pShadowStream->pKeyIndex = pKeyIndex;
+	for(i = 0; i < count; i++) {
+		pShadowStream->values[i].start = SHADOW_STREAM_NO_VALUE;
+	}
+	for(i = 0; i <= JSON_STREAM_MAX_DEPTH; i++) {
+		pShadowStream->pendingHead[i] = -1;
+	}
+	pShadowStream->version.start = SHADOW_STREAM_NO_VALUE;
+	pShadowStream->clientToken.start = SHADOW_STREAM_NO_VALUE;
+	pShadowStream->pendingTopLevel = 0;
+}
+
+bool feedShadowJsonStream(ShadowJsonStream_t *pShadowStream, const char *pFragment, size_t length) {
+	return SUCCESS == jsonStreamFeed(&pShadowStream->stream, pFragment, length);
+}
+
+bool isShadowJsonStreamComplete(const ShadowJsonStream_t *pShadowStream) {
+	return jsonStreamIsComplete(&pShadowStream->stream);
+}
+
+static bool getStreamValueToken(const ShadowStreamValue_t *pValue, jsmntok_t *pToken) {
+	if(pValue->start >= SHADOW_STREAM_PENDING_VALUE) {
+		return false;
+	}
+	memset(pToken, 0, sizeof(*pToken));
+	pToken->type = (jsmntype_t) pValue->type;
+	pToken->start = pValue->start;
+	pToken->end = pValue->end;
+	return true;
+}
+
+bool extractStreamedVersionNumber(const ShadowJsonStream_t *pShadowStream, uint32_t *pVersionNumber) {
+	jsmntok_t token;
+
+	return getStreamValueToken(&pShadowStream->version, &token)
+		   && parseUnsignedInteger32Value(pVersionNumber, pShadowStream->stream.pCapture, &token) == SUCCESS;
+}
+
+bool extractStreamedClientToken(const ShadowJsonStream_t *pShadowStream, char *pExtractedClientToken,
+								size_t clientTokenSize) {
+	jsmntok_t token;
+
+	if(!getStreamValueToken(&pShadowStream->clientToken, &token)) {
+		return false;
+	}
+	return copyClientToken(pShadowStream->stream.pCapture + token.start, (size_t) (token.end - token.start),
+						   pExtractedClientToken, clientTokenSize);
+}
+
+bool updateValueFromStream(const ShadowJsonStream_t *pShadowStream, uint16_t entry, jsonStruct_t *pDataStruct,
+						   uint32_t *pDataLength, int32_t *pDataPosition) {
+	jsmntok_t token;
+
+	if(NULL == pShadowStream->pKeyIndex || entry >= pShadowStream->pKeyIndex->count
+	   || !getStreamValueToken(&pShadowStream->values[entry], &token)) {
+		return false;
+	}
+
+	UpdateValueIfNoObject(pShadowStream->stream.pCapture, pDataStruct, token);
+	*pDataPosition = token.start;
+	*pDataLength = (uint32_t) (token.end - token.start);
+	return true;
+}
+
 #ifdef __cplusplus
 }
 #endif
-
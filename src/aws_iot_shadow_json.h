@@ -24,7 +24,98 @@ extern "C" {
 #include <stdarg.h>
 
 #include "aws_iot_error.h"
+#include "aws_iot_config.h"
 #include "aws_iot_shadow_json_data.h"
+#include "aws_iot_json_stream.h"
+#include "aws_iot_json_writer.h"
+
+/**
+ * @brief Top-level keys of a received shadow document
+ *
+ * Pass one as pJsonHandler to isJsonValidAndParse: the top-level keys are
+ * indexed while the document is tokenized, and the version, clientToken and
+ * delta lookups then read the same token set instead of scanning or parsing
+ * the document again. Indexes are token indexes, -1 when the key is absent.
+ */
+typedef struct {
+	int32_t versionIndex;		///< Value token of "version"
+	int32_t clientTokenIndex;	///< Value token of "clientToken"
+	int32_t stateIndex;			///< Object token of "state"
+	int32_t stateEndIndex;		///< First token after the "state" object
+} ShadowJsonIndex_t;
+
+/**
+ * @brief Hash index of the keys registered on the delta topic
+ *
+ * Keys without a dot match the first key of that name anywhere in the delta,
+ * as they always did. Keys with dots are paths below "state", e.g.
+ * "light.color" for {"state":{"light":{"color":...}}}. Entries are numbered
+ * in registration order.
+ */
+typedef struct {
+	int16_t buckets[SHADOW_DELTA_KEY_HASH_SIZE];	///< Entry of each bucket, -1 when empty
+	const char *pKeys[MAX_JSON_TOKEN_EXPECTED];		///< Registered key or path of each entry
+	uint32_t hashes[MAX_JSON_TOKEN_EXPECTED];		///< FNV-1a hash of each key
+	uint16_t keyLengths[MAX_JSON_TOKEN_EXPECTED];
+	bool isPath[MAX_JSON_TOKEN_EXPECTED];
+	uint16_t count;
+} ShadowDeltaKeyIndex_t;
+
+/**
+ * @brief Position of a value in the capture buffer of a ShadowJsonStream_t
+ */
+typedef struct {
+	uint16_t start;	///< Offset of the value, SHADOW_STREAM_NO_VALUE when it was not found
+	uint16_t end;	///< Offset after the value
+	uint8_t type;	///< jsmntype_t of the value
+} ShadowStreamValue_t;
+
+#define SHADOW_STREAM_NO_VALUE UINT16_MAX
+#define SHADOW_STREAM_PENDING_VALUE (UINT16_MAX - 1)
+
+/**
+ * @brief Shadow document read with the incremental tokenizer
+ *
+ * Used for documents received in fragments or with more tokens than
+ * MAX_JSON_TOKEN_EXPECTED. Only the version, the clientToken and the values of
+ * the keys of pKeyIndex are copied to the capture buffer while the fragments
+ * are tokenized, keys are matched as matchDeltaKeys does.
+ */
+typedef struct {
+	JsonStream_t stream;
+	const ShadowDeltaKeyIndex_t *pKeyIndex;				///< Keys whose value is captured, NULL for none
+	ShadowStreamValue_t values[MAX_JSON_TOKEN_EXPECTED];	///< Value of each entry of pKeyIndex
+	int16_t pendingNext[MAX_JSON_TOKEN_EXPECTED];		///< Next entry waiting for the same value
+	int16_t pendingHead[JSON_STREAM_MAX_DEPTH + 1];		///< First entry waiting for the value read at each depth, -1 if none
+	ShadowStreamValue_t version;						///< Top-level "version"
+	ShadowStreamValue_t clientToken;					///< Top-level "clientToken"
+	uint8_t pendingTopLevel;							///< Top-level keys waiting for their value
+} ShadowJsonStream_t;
+
+void startShadowJsonStream(ShadowJsonStream_t *pShadowStream, char *pCapture, size_t captureSize,
+						   const ShadowDeltaKeyIndex_t *pKeyIndex);
+
+bool feedShadowJsonStream(ShadowJsonStream_t *pShadowStream, const char *pFragment, size_t length);
+
+bool isShadowJsonStreamComplete(const ShadowJsonStream_t *pShadowStream);
+
+bool extractStreamedVersionNumber(const ShadowJsonStream_t *pShadowStream, uint32_t *pVersionNumber);
+
+bool extractStreamedClientToken(const ShadowJsonStream_t *pShadowStream, char *pExtractedClientToken,
+								size_t clientTokenSize);
+
+bool updateValueFromStream(const ShadowJsonStream_t *pShadowStream, uint16_t entry, jsonStruct_t *pDataStruct,
+						   uint32_t *pDataLength, int32_t *pDataPosition);
+
+void resetDeltaKeyIndex(ShadowDeltaKeyIndex_t *pKeyIndex);
+
+bool addDeltaKey(ShadowDeltaKeyIndex_t *pKeyIndex, const char *pKey);
+
+void matchDeltaKeys(const char *pJsonDocument, int32_t tokenCount, const ShadowDeltaKeyIndex_t *pKeyIndex,
+					int32_t *pValueTokens);
+
+void updateValueFromToken(const char *pJsonDocument, int32_t valueToken, jsonStruct_t *pDataStruct,
+						  uint32_t *pDataLength, int32_t *pDataPosition);
 
 bool isJsonValidAndParse(const char *pJsonDocument, size_t jsonSize, void *pJsonHandler, int32_t *pTokenCount);
 
@@ -37,13 +128,22 @@ IoT_Error_t aws_iot_shadow_internal_delete_request_json(char *pBuffer, size_t bu
 
 void resetClientTokenSequenceNum(void);
 
+void writeClientToken(JsonWriter_t *pWriter);
+
+void writeJsonData(JsonWriter_t *pWriter, JsonPrimitiveType type, void *pData);
+
 
 bool isReceivedJsonValid(const char *pJsonDocument, size_t jsonSize);
 
 bool extractClientToken(const char *pJsonDocument, size_t jsonSize, char *pExtractedClientToken, size_t clientTokenSize);
 
+bool extractParsedClientToken(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount,
+							  char *pExtractedClientToken, size_t clientTokenSize);
+
 bool extractVersionNumber(const char *pJsonDocument, void *pJsonHandler, int32_t tokenCount, uint32_t *pVersionNumber);
 
+bool extractErrorCode(const char *pJsonDocument, int32_t tokenCount, uint32_t *pErrorCode);
+
 #ifdef __cplusplus
 }
 #endif
@@ -71,7 +71,7 @@ struct jsonStruct {
 /**
  * @brief Initialize the JSON document with Shadow expected name/value
  *
- * This Function will fill the JSON Buffer with a null terminated string. Internally it uses snprintf
+ * This Function will fill the JSON Buffer with a null terminated string. Internally it uses the JSON writer of aws_iot_json_writer.h
  * This function should always be used First, followed by iot_shadow_add_reported and/or iot_shadow_add_desired.
  * Always finish the call sequence with iot_finalize_json_document
  *
@@ -89,6 +89,7 @@ IoT_Error_t aws_iot_shadow_init_json_document(char *pJsonDocument, size_t maxSiz
  *
  * This is a variadic function and please be careful with the usage. count is the number of jsonStruct_t types that you would like to add in the reported section
  * This function will add "reported":{<all the values that needs to be added>}
+ * Keys and SHADOW_JSON_STRING values are escaped, SHADOW_JSON_OBJECT values are copied as they are
  *
  * @note Ensure the size of the Buffer is enough to hold the reported section + the init section. Always use the same JSON document buffer used in the iot_shadow_init_json_document function. This function will accommodate the size of previous null terminated string, so pass teh max size of the buffer
  *
@@ -40,6 +40,8 @@ typedef struct {
 	fpActionCallback_t callback;
 	void *pCallbackContext;
 	bool isFree;
+	bool isIndexed;			///< Held in the slot of its sequence number
+	uint16_t heapPosition;	///< Position in ackExpiryHeap
 	Timer timer;
 } ToBeReceivedAckRecord_t;
 
@@ -61,7 +63,12 @@ typedef enum {
 	SHADOW_ACCEPTED, SHADOW_REJECTED, SHADOW_ACTION
 } ShadowAckTopicTypes_t;
 
+/* a record waits in the slot of the sequence number of its client token, modulo the
+ * size of the list, and the heap orders the waiting records by the expiry of their timer */
 ToBeReceivedAckRecord_t AckWaitList[MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME];
+static uint16_t ackExpiryHeap[MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME];
+static uint16_t ackWaitCount = 0;
+static uint16_t unindexedAckCount = 0;
 
 AWS_IoT_Client *pMqttClient;
 
@@ -69,6 +76,7 @@ char myThingName[MAX_SIZE_OF_THING_NAME];
 char mqttClientID[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES];
 
 char shadowDeltaTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
+static char shadowWildcardTopic[MAX_SHADOW_TOPIC_LENGTH_BYTES];
 
 #define MAX_TOPICS_AT_ANY_GIVEN_TIME 2*MAX_THINGNAME_HANDLED_AT_ANY_GIVEN_TIME
 SubscriptionRecord_t SubscriptionList[MAX_TOPICS_AT_ANY_GIVEN_TIME];
@@ -78,7 +86,13 @@ char shadowRxBuf[SHADOW_MAX_SIZE_OF_RX_BUFFER];
 
 static JsonTokenTable_t tokenTable[MAX_JSON_TOKEN_EXPECTED];
 static uint32_t tokenTableIndex = 0;
+static ShadowDeltaKeyIndex_t deltaKeyIndex;
+static int32_t deltaValueTokens[MAX_JSON_TOKEN_EXPECTED];
+static ShadowJsonStream_t shadowStream;
 static bool deltaTopicSubscribedFlag = false;
+static bool wildcardSubscribedFlag = false;
+static uint16_t wildcardTopicPrefixLen = 0;
+static pApplicationHandler_t deleteAcceptedHandler = NULL;
 uint32_t shadowJsonVersionNum = 0;
 bool shadowDiscardOldDeltaFlag = true;
 
@@ -94,7 +108,13 @@ static void topicNameFromThingAndAction(char *pTopic, const char *pThingName, Sh
 
 static int16_t getNextFreeIndexOfSubscriptionList(void);
 
-static void unsubscribeFromAcceptedAndRejected(uint8_t index);
+static void unsubscribeFromAcceptedAndRejected(uint16_t index);
+
+static int32_t findIndexOfAckWaitList(const char *pClientToken);
+
+static void removeFromAckWaitList(uint16_t index);
+
+static void updateAckWaitListDepth(void);
 
 void initDeltaTokens(void) {
 	uint32_t i;
@@ -102,6 +122,7 @@ void initDeltaTokens(void) {
 		tokenTable[i].isFree = true;
 	}
 	tokenTableIndex = 0;
+	resetDeltaKeyIndex(&deltaKeyIndex);
 	deltaTopicSubscribedFlag = false;
 }
 
@@ -109,14 +130,22 @@ IoT_Error_t registerJsonTokenOnDelta(jsonStruct_t *pStruct) {
 
 	IoT_Error_t rc = SUCCESS;
 
-	if(!deltaTopicSubscribedFlag) {
+	if(!deltaTopicSubscribedFlag && wildcardSubscribedFlag) {
+		/* the delta already arrives through the wildcard subscription */
+		deltaTopicSubscribedFlag = true;
+	} else if(!deltaTopicSubscribedFlag) {
 		snprintf(shadowDeltaTopic, MAX_SHADOW_TOPIC_LENGTH_BYTES, "$aws/things/%s/shadow/update/delta", myThingName);
 		rc = aws_iot_mqtt_subscribe(pMqttClient, shadowDeltaTopic, (uint16_t) strlen(shadowDeltaTopic), QOS0,
 									shadow_delta_callback, NULL);
+		if(SUCCESS == rc) {
+			rc = aws_iot_mqtt_set_fragmented_delivery(pMqttClient, shadowDeltaTopic,
+													  (uint16_t) strlen(shadowDeltaTopic), true);
+		}
 		deltaTopicSubscribedFlag = true;
 	}
 
-	if(tokenTableIndex >= MAX_JSON_TOKEN_EXPECTED) {
+	/* entries of the key index follow the token table */
+	if(tokenTableIndex >= MAX_JSON_TOKEN_EXPECTED || !addDeltaKey(&deltaKeyIndex, pStruct->pKey)) {
 		return FAILURE;
 	}
 
@@ -177,62 +206,105 @@ static bool isValidShadowVersionUpdate(const char *pTopicName) {
 	return false;
 }
 
+/**
+ * Documents larger than the RX buffer arrive in fragments, see
+ * aws_iot_mqtt_set_fragmented_delivery, and documents with more tokens than
+ * MAX_JSON_TOKEN_EXPECTED cannot be parsed by jsmn. Both are read with the
+ * incremental tokenizer, which captures the values of pKeyIndex, the version
+ * and the clientToken in shadowRxBuf. Returns true once the last fragment of
+ * a valid document has been read.
+ */
+static bool streamShadowDocument(IoT_Publish_Message_Params *params, const ShadowDeltaKeyIndex_t *pKeyIndex) {
+	bool isFed;
+
+	if(0 == params->payloadOffset) {
+		startShadowJsonStream(&shadowStream, shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pKeyIndex);
+	}
+
+	/* errors are sticky, the last fragment reports any of them */
+	isFed = feedShadowJsonStream(&shadowStream, (const char *) params->payload, params->payloadLen);
+	if(params->payloadOffset + params->payloadLen < params->totalPayloadLen) {
+		return false;
+	}
+
+	if(!isFed || !isShadowJsonStreamComplete(&shadowStream)) {
+		IOT_WARN("Received JSON is not valid");
+		return false;
+	}
+	return true;
+}
+
 static void AckStatusCallback(AWS_IoT_Client *pClient, char *topicName, uint16_t topicNameLen,
 							  IoT_Publish_Message_Params *params, void *pData) {
-	int32_t tokenCount;
-	uint8_t i;
-	void *pJsonHandler = NULL;
+	int32_t tokenCount = 0;
+	int32_t i;
+	ShadowJsonIndex_t jsonIndex;
+	void *pJsonHandler = &jsonIndex;
 	char temporaryClientToken[MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE];
+	bool isStreamed;
+	bool isClientTokenFound;
+	bool isAccepted;
+	Shadow_Ack_Status_t status;
 
 	IOT_UNUSED(pClient);
 	IOT_UNUSED(topicNameLen);
 	IOT_UNUSED(pData);
 
-	if(params->payloadLen >= SHADOW_MAX_SIZE_OF_RX_BUFFER) {
-		IOT_WARN("Payload larger than RX Buffer");
-		return;
-	}
+	isAccepted = (strstr(topicName, "accepted") != NULL);
 
-	memcpy(shadowRxBuf, params->payload, params->payloadLen);
-	shadowRxBuf[params->payloadLen] = '\0';    // jsmn_parse relies on a string
-
-	if(!isJsonValidAndParse(shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pJsonHandler, &tokenCount)) {
-		IOT_WARN("Received JSON is not valid");
+	isStreamed = (params->payloadLen != params->totalPayloadLen)
+				 || (params->payloadLen >= SHADOW_MAX_SIZE_OF_RX_BUFFER);
+	if(!isStreamed) {
+		memcpy(shadowRxBuf, params->payload, params->payloadLen);
+		shadowRxBuf[params->payloadLen] = '\0';    // jsmn_parse relies on a string
+		isStreamed = !isJsonValidAndParse(shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pJsonHandler, &tokenCount);
+	}
+	if(isStreamed && !streamShadowDocument(params, NULL)) {
 		return;
 	}
 
 	if(isValidShadowVersionUpdate(topicName)) {
 		uint32_t tempVersionNumber = 0;
-		if(extractVersionNumber(shadowRxBuf, pJsonHandler, tokenCount, &tempVersionNumber)) {
+		if(isStreamed ? extractStreamedVersionNumber(&shadowStream, &tempVersionNumber)
+					  : extractVersionNumber(shadowRxBuf, pJsonHandler, tokenCount, &tempVersionNumber)) {
 			if(tempVersionNumber > shadowJsonVersionNum) {
 				shadowJsonVersionNum = tempVersionNumber;
 			}
 		}
 	}
 
-	if(extractClientToken(shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, temporaryClientToken, MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE)) {
-		for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
-			if(!AckWaitList[i].isFree) {
-				if(strcmp(AckWaitList[i].clientTokenID, temporaryClientToken) == 0) {
-					Shadow_Ack_Status_t status = SHADOW_ACK_REJECTED;
-					if(strstr(topicName, "accepted") != NULL) {
-						status = SHADOW_ACK_ACCEPTED;
-					} else if(strstr(topicName, "rejected") != NULL) {
-						status = SHADOW_ACK_REJECTED;
-					}
-					if(status == SHADOW_ACK_ACCEPTED || status == SHADOW_ACK_REJECTED) {
-						if(AckWaitList[i].callback != NULL) {
-							AckWaitList[i].callback(AckWaitList[i].thingName, AckWaitList[i].action, status,
-													shadowRxBuf, AckWaitList[i].pCallbackContext);
-						}
-						unsubscribeFromAcceptedAndRejected(i);
-						AckWaitList[i].isFree = true;
-						return;
-					}
-				}
-			}
+	if(isStreamed) {
+		isClientTokenFound = extractStreamedClientToken(&shadowStream, temporaryClientToken,
+														MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE);
+	} else {
+		isClientTokenFound = extractParsedClientToken(shadowRxBuf, pJsonHandler, tokenCount, temporaryClientToken,
+													  MAX_SIZE_CLIENT_TOKEN_CLIENT_SEQUENCE);
+	}
+
+	if(!isClientTokenFound) {
+		return;
+	}
+	i = findIndexOfAckWaitList(temporaryClientToken);
+	if(i < 0) {
+		return;
+	}
+
+	status = isAccepted ? SHADOW_ACK_ACCEPTED : SHADOW_ACK_REJECTED;
+	if(isStreamed) {
+		/* a streamed document is not kept, the callback gets an empty one */
+		if(isAccepted) {
+			status = SHADOW_ACK_ACCEPTED_STREAMED;
 		}
+		shadowRxBuf[0] = '\0';
 	}
+	removeFromAckWaitList((uint16_t) i);
+	if(AckWaitList[i].callback != NULL) {
+		AckWaitList[i].callback(AckWaitList[i].thingName, AckWaitList[i].action, status, shadowRxBuf,
+								AckWaitList[i].pCallbackContext);
+	}
+	unsubscribeFromAcceptedAndRejected((uint16_t) i);
+	AckWaitList[i].isFree = true;
+	updateAckWaitListDepth();
 }
 
 static int16_t findIndexOfSubscriptionList(const char *pTopic) {
@@ -247,7 +319,7 @@ static int16_t findIndexOfSubscriptionList(const char *pTopic) {
 	return -1;
 }
 
-static void unsubscribeFromAcceptedAndRejected(uint8_t index) {
+static void unsubscribeFromAcceptedAndRejected(uint16_t index) {
 
 	char TemporaryTopicNameAccepted[MAX_SHADOW_TOPIC_LENGTH_BYTES];
 	char TemporaryTopicNameRejected[MAX_SHADOW_TOPIC_LENGTH_BYTES];
@@ -288,10 +360,15 @@ static void unsubscribeFromAcceptedAndRejected(uint8_t index) {
 }
 
 void initializeRecords(AWS_IoT_Client *pClient) {
-	uint8_t i;
+	uint32_t i;
+
+	wildcardSubscribedFlag = false;
+	deleteAcceptedHandler = NULL;
 	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
 		AckWaitList[i].isFree = true;
 	}
+	ackWaitCount = 0;
+	unindexedAckCount = 0;
 	for(i = 0; i < MAX_TOPICS_AT_ANY_GIVEN_TIME; i++) {
 		SubscriptionList[i].isFree = true;
 		SubscriptionList[i].count = 0;
@@ -301,6 +378,74 @@ void initializeRecords(AWS_IoT_Client *pClient) {
 	pMqttClient = pClient;
 }
 
+static bool isTopicSuffix(const char *pSuffix, uint16_t suffixLen, const char *pExpected) {
+	return suffixLen == strlen(pExpected) && 0 == strncmp(pSuffix, pExpected, suffixLen);
+}
+
+static bool isAckTopicSuffix(const char *pSuffix, uint16_t suffixLen) {
+	static const char *ackTopicSuffixes[] = {"update/accepted", "update/rejected", "get/accepted", "get/rejected",
+											 "delete/accepted", "delete/rejected"};
+	uint8_t i;
+
+	for(i = 0; i < sizeof(ackTopicSuffixes) / sizeof(ackTopicSuffixes[0]); i++) {
+		if(isTopicSuffix(pSuffix, suffixLen, ackTopicSuffixes[i])) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* routes the messages of $aws/things/<myThingName>/shadow/+/+ as their own subscriptions would */
+static void shadowWildcardCallback(AWS_IoT_Client *pClient, char *topicName, uint16_t topicNameLen,
+								   IoT_Publish_Message_Params *params, void *pData) {
+	const char *pSuffix;
+	uint16_t suffixLen;
+
+	if(topicNameLen <= wildcardTopicPrefixLen) {
+		return;
+	}
+	pSuffix = topicName + wildcardTopicPrefixLen;
+	suffixLen = (uint16_t) (topicNameLen - wildcardTopicPrefixLen);
+
+	if(isTopicSuffix(pSuffix, suffixLen, "update/delta")) {
+		if(deltaTopicSubscribedFlag) {
+			shadow_delta_callback(pClient, topicName, topicNameLen, params, pData);
+		}
+	} else if(isAckTopicSuffix(pSuffix, suffixLen)) {
+		/* the handler reads the message before the ack handler copies it to shadowRxBuf */
+		if(NULL != deleteAcceptedHandler && isTopicSuffix(pSuffix, suffixLen, "delete/accepted")) {
+			deleteAcceptedHandler(pClient, topicName, topicNameLen, params, (void *) myThingName);
+		}
+		AckStatusCallback(pClient, topicName, topicNameLen, params, pData);
+	}
+	/* update/documents is not used by the SDK */
+}
+
+IoT_Error_t subscribeToAllShadowTopics(pApplicationHandler_t deleteActionHandler) {
+	uint16_t wildcardTopicLen;
+	IoT_Error_t rc;
+
+	/* the MQTT client keeps a pointer to the topic filter */
+	snprintf(shadowWildcardTopic, MAX_SHADOW_TOPIC_LENGTH_BYTES, "$aws/things/%s/shadow/+/+", myThingName);
+	wildcardTopicLen = (uint16_t) strlen(shadowWildcardTopic);
+	wildcardTopicPrefixLen = (uint16_t) (wildcardTopicLen - 3);
+
+	rc = aws_iot_mqtt_subscribe(pMqttClient, shadowWildcardTopic, wildcardTopicLen, QOS0, shadowWildcardCallback,
+								NULL);
+	if(SUCCESS == rc) {
+		rc = aws_iot_mqtt_set_fragmented_delivery(pMqttClient, shadowWildcardTopic, wildcardTopicLen, true);
+	}
+	if(SUCCESS == rc) {
+		deleteAcceptedHandler = deleteActionHandler;
+		wildcardSubscribedFlag = true;
+	}
+	return rc;
+}
+
+bool isCoveredByWildcardSubscription(const char *pThingName) {
+	return wildcardSubscribedFlag && 0 == strcmp(pThingName, myThingName);
+}
+
 bool isSubscriptionPresent(const char *pThingName, ShadowActions_t action) {
 
 	uint8_t i = 0;
@@ -344,6 +489,10 @@ IoT_Error_t subscribeToShadowActionAcks(const char *pThingName, ShadowActions_t
 		ret_val = aws_iot_mqtt_subscribe(pMqttClient, SubscriptionList[indexAcceptedSubList].Topic,
 										 (uint16_t) strlen(SubscriptionList[indexAcceptedSubList].Topic), QOS0,
 										 AckStatusCallback, NULL);
+		if(ret_val == SUCCESS) {
+			ret_val = aws_iot_mqtt_set_fragmented_delivery(pMqttClient, SubscriptionList[indexAcceptedSubList].Topic,
+					(uint16_t) strlen(SubscriptionList[indexAcceptedSubList].Topic), true);
+		}
 		if(ret_val == SUCCESS) {
 			SubscriptionList[indexAcceptedSubList].count = 1;
 			SubscriptionList[indexAcceptedSubList].isSticky = isSticky;
@@ -352,6 +501,11 @@ IoT_Error_t subscribeToShadowActionAcks(const char *pThingName, ShadowActions_t
 			ret_val = aws_iot_mqtt_subscribe(pMqttClient, SubscriptionList[indexRejectedSubList].Topic,
 											 (uint16_t) strlen(SubscriptionList[indexRejectedSubList].Topic), QOS0,
 											 AckStatusCallback, NULL);
+			if(ret_val == SUCCESS) {
+				ret_val = aws_iot_mqtt_set_fragmented_delivery(pMqttClient,
+						SubscriptionList[indexRejectedSubList].Topic,
+						(uint16_t) strlen(SubscriptionList[indexRejectedSubList].Topic), true);
+			}
 			if(ret_val == SUCCESS) {
 				SubscriptionList[indexRejectedSubList].count = 1;
 				SubscriptionList[indexRejectedSubList].isSticky = isSticky;
@@ -422,28 +576,148 @@ IoT_Error_t publishToShadowAction(const char *pThingName, ShadowActions_t action
 	return ret_val;
 }
 
-bool getNextFreeIndexOfAckWaitList(uint8_t *pIndex) {
-	uint8_t i;
-	bool rc = false;
+/* client tokens made by the SDK are <clientId>-<sequence number> */
+static bool getClientTokenSequenceNum(const char *pClientToken, uint32_t *pSequenceNum) {
+	size_t clientIdLen = strlen(mqttClientID);
+	const char *pDigit;
+	uint32_t sequenceNum = 0;
+
+	if(0 != strncmp(pClientToken, mqttClientID, clientIdLen) || '-' != pClientToken[clientIdLen]) {
+		return false;
+	}
+	pDigit = &pClientToken[clientIdLen + 1];
+	if('\0' == *pDigit) {
+		return false;
+	}
+	for(; '\0' != *pDigit; pDigit++) {
+		if(*pDigit < '0' || *pDigit > '9') {
+			return false;
+		}
+		sequenceNum = sequenceNum * 10 + (uint32_t) (*pDigit - '0');
+	}
+	*pSequenceNum = sequenceNum;
+	return true;
+}
+
+static bool getHomeIndexOfAckWaitList(const char *pClientToken, uint16_t *pIndex) {
+	uint32_t sequenceNum;
 
-	if(NULL == pIndex) {
+	if(!getClientTokenSequenceNum(pClientToken, &sequenceNum)) {
 		return false;
 	}
+	*pIndex = (uint16_t) (sequenceNum % MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME);
+	return true;
+}
+
+static int32_t findIndexOfAckWaitList(const char *pClientToken) {
+	uint16_t index;
+	uint32_t i;
 
+	if(getHomeIndexOfAckWaitList(pClientToken, &index) && !AckWaitList[index].isFree
+	   && strcmp(AckWaitList[index].clientTokenID, pClientToken) == 0) {
+		return index;
+	}
+	/* only tokens made by the application, or whose slot was taken, need a search */
+	if(0 == unindexedAckCount) {
+		return -1;
+	}
 	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
-		if(AckWaitList[i].isFree) {
-			*pIndex = i;
-			rc = true;
+		if(!AckWaitList[i].isFree && !AckWaitList[i].isIndexed
+		   && strcmp(AckWaitList[i].clientTokenID, pClientToken) == 0) {
+			return (int32_t) i;
+		}
+	}
+	return -1;
+}
+
+static bool isExpiringBefore(uint16_t indexA, uint16_t indexB) {
+	return left_ms(&(AckWaitList[indexA].timer)) < left_ms(&(AckWaitList[indexB].timer));
+}
+
+static void placeInExpiryHeap(uint16_t position, uint16_t index) {
+	ackExpiryHeap[position] = index;
+	AckWaitList[index].heapPosition = position;
+}
+
+static void siftUpExpiryHeap(uint16_t position) {
+	uint16_t index = ackExpiryHeap[position];
+	uint16_t parent;
+
+	while(position > 0) {
+		parent = (uint16_t) ((position - 1) / 2);
+		if(!isExpiringBefore(index, ackExpiryHeap[parent])) {
 			break;
 		}
+		placeInExpiryHeap(position, ackExpiryHeap[parent]);
+		position = parent;
 	}
+	placeInExpiryHeap(position, index);
+}
 
-	return rc;
+static void siftDownExpiryHeap(uint16_t position) {
+	uint16_t index = ackExpiryHeap[position];
+	uint32_t child;
+
+	for(;;) {
+		child = 2 * (uint32_t) position + 1;
+		if(child >= ackWaitCount) {
+			break;
+		}
+		if(child + 1 < ackWaitCount && isExpiringBefore(ackExpiryHeap[child + 1], ackExpiryHeap[child])) {
+			child++;
+		}
+		if(!isExpiringBefore(ackExpiryHeap[child], index)) {
+			break;
+		}
+		placeInExpiryHeap(position, ackExpiryHeap[child]);
+		position = (uint16_t) child;
+	}
+	placeInExpiryHeap(position, index);
+}
+
+/* the record stays taken until its callback returned, so the callback cannot reuse it */
+static void removeFromAckWaitList(uint16_t index) {
+	uint16_t position = AckWaitList[index].heapPosition;
+
+	ackWaitCount--;
+	if(position != ackWaitCount) {
+		placeInExpiryHeap(position, ackExpiryHeap[ackWaitCount]);
+		siftUpExpiryHeap(position);
+		siftDownExpiryHeap(position);
+	}
+	if(!AckWaitList[index].isIndexed) {
+		unindexedAckCount--;
+	}
+}
+
+bool getNextFreeIndexOfAckWaitList(const char *pClientToken, uint16_t *pIndex) {
+	uint32_t i;
+
+	if(NULL == pClientToken || NULL == pIndex) {
+		return false;
+	}
+
+	if(getHomeIndexOfAckWaitList(pClientToken, pIndex) && AckWaitList[*pIndex].isFree) {
+		return true;
+	}
+	if(ackWaitCount >= MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME) {
+		return false;
+	}
+	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
+		if(AckWaitList[i].isFree) {
+			*pIndex = (uint16_t) i;
+			return true;
+		}
+	}
+
+	return false;
 }
 
-void addToAckWaitList(uint8_t indexAckWaitList, const char *pThingName, ShadowActions_t action,
+void addToAckWaitList(uint16_t indexAckWaitList, const char *pThingName, ShadowActions_t action,
 					  const char *pExtractedClientToken, fpActionCallback_t callback, void *pCallbackContext,
 					  uint32_t timeout_seconds) {
+	uint16_t homeIndex;
+
 	AckWaitList[indexAckWaitList].callback = callback;
 	memcpy(AckWaitList[indexAckWaitList].clientTokenID, pExtractedClientToken, MAX_SIZE_CLIENT_ID_WITH_SEQUENCE);
 	memcpy(AckWaitList[indexAckWaitList].thingName, pThingName, MAX_SIZE_OF_THING_NAME);
@@ -451,33 +725,51 @@ void addToAckWaitList(uint8_t indexAckWaitList, const char *pThingName, ShadowAc
 	AckWaitList[indexAckWaitList].action = action;
 	init_timer(&(AckWaitList[indexAckWaitList].timer));
 	countdown_sec(&(AckWaitList[indexAckWaitList].timer), timeout_seconds);
+	AckWaitList[indexAckWaitList].isIndexed = getHomeIndexOfAckWaitList(pExtractedClientToken, &homeIndex)
+											  && homeIndex == indexAckWaitList;
+	if(!AckWaitList[indexAckWaitList].isIndexed) {
+		unindexedAckCount++;
+	}
 	AckWaitList[indexAckWaitList].isFree = false;
+	placeInExpiryHeap(ackWaitCount, indexAckWaitList);
+	ackWaitCount++;
+	siftUpExpiryHeap((uint16_t) (ackWaitCount - 1));
+	updateAckWaitListDepth();
+}
+
+static void updateAckWaitListDepth(void) {
+#ifndef DISABLE_IOT_CLIENT_METRICS
+	aws_iot_mqtt_metrics_set_queue_depth(pMqttClient, ackWaitCount);
+#endif
 }
 
 void HandleExpiredResponseCallbacks(void) {
-	uint8_t i;
-	for(i = 0; i < MAX_ACKS_TO_COMEIN_AT_ANY_GIVEN_TIME; i++) {
-		if(!AckWaitList[i].isFree) {
-			if(has_timer_expired(&(AckWaitList[i].timer))) {
-				if(AckWaitList[i].callback != NULL) {
-					AckWaitList[i].callback(AckWaitList[i].thingName, AckWaitList[i].action, SHADOW_ACK_TIMEOUT,
-											shadowRxBuf, AckWaitList[i].pCallbackContext);
-				}
-				AckWaitList[i].isFree = true;
-				unsubscribeFromAcceptedAndRejected(i);
-			}
+	uint16_t index;
+
+	while(ackWaitCount > 0 && has_timer_expired(&(AckWaitList[ackExpiryHeap[0]].timer))) {
+		index = ackExpiryHeap[0];
+		removeFromAckWaitList(index);
+		if(AckWaitList[index].callback != NULL) {
+			AckWaitList[index].callback(AckWaitList[index].thingName, AckWaitList[index].action, SHADOW_ACK_TIMEOUT,
+										shadowRxBuf, AckWaitList[index].pCallbackContext);
 		}
+		AckWaitList[index].isFree = true;
+		unsubscribeFromAcceptedAndRejected(index);
+		updateAckWaitListDepth();
 	}
 }
 
 static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 								  uint16_t topicNameLen, IoT_Publish_Message_Params *params, void *pData) {
-	int32_t tokenCount;
+	int32_t tokenCount = 0;
 	uint32_t i = 0;
-	void *pJsonHandler = NULL;
+	ShadowJsonIndex_t jsonIndex;
+	void *pJsonHandler = &jsonIndex;
 	int32_t DataPosition;
 	uint32_t dataLength;
 	uint32_t tempVersionNumber = 0;
+	bool isStreamed;
+	bool isValueFound;
 
 	FUNC_ENTRY;
 
@@ -486,21 +778,20 @@ static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 	IOT_UNUSED(topicNameLen);
 	IOT_UNUSED(pData);
 
-	if(params->payloadLen >= SHADOW_MAX_SIZE_OF_RX_BUFFER) {
-		IOT_WARN("Payload larger than RX Buffer");
-		return;
+	isStreamed = (params->payloadLen != params->totalPayloadLen)
+				 || (params->payloadLen >= SHADOW_MAX_SIZE_OF_RX_BUFFER);
+	if(!isStreamed) {
+		memcpy(shadowRxBuf, params->payload, params->payloadLen);
+		shadowRxBuf[params->payloadLen] = '\0';    // jsmn_parse relies on a string
+		isStreamed = !isJsonValidAndParse(shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pJsonHandler, &tokenCount);
 	}
-
-	memcpy(shadowRxBuf, params->payload, params->payloadLen);
-	shadowRxBuf[params->payloadLen] = '\0';    // jsmn_parse relies on a string
-
-	if(!isJsonValidAndParse(shadowRxBuf, SHADOW_MAX_SIZE_OF_RX_BUFFER, pJsonHandler, &tokenCount)) {
-		IOT_WARN("Received JSON is not valid");
+	if(isStreamed && !streamShadowDocument(params, &deltaKeyIndex)) {
 		return;
 	}
 
 	if(shadowDiscardOldDeltaFlag) {
-		if(extractVersionNumber(shadowRxBuf, pJsonHandler, tokenCount, &tempVersionNumber)) {
+		if(isStreamed ? extractStreamedVersionNumber(&shadowStream, &tempVersionNumber)
+					  : extractVersionNumber(shadowRxBuf, pJsonHandler, tokenCount, &tempVersionNumber)) {
 			if(tempVersionNumber > shadowJsonVersionNum) {
 				shadowJsonVersionNum = tempVersionNumber;
 			} else {
@@ -511,10 +802,25 @@ static void shadow_delta_callback(AWS_IoT_Client *pClient, char *topicName,
 		}
 	}
 
+	if(!isStreamed) {
+		matchDeltaKeys(shadowRxBuf, tokenCount, &deltaKeyIndex, deltaValueTokens);
+	}
+
+	/* streamed values are in shadowRxBuf too, DataPosition is relative to it either way */
 	for(i = 0; i < tokenTableIndex; i++) {
 		if(!tokenTable[i].isFree) {
-			if(isJsonKeyMatchingAndUpdateValue(shadowRxBuf, pJsonHandler, tokenCount,
-											   (jsonStruct_t *) tokenTable[i].pStruct, &dataLength, &DataPosition)) {
+			if(isStreamed) {
+				isValueFound = updateValueFromStream(&shadowStream, (uint16_t) i,
+													 (jsonStruct_t *) tokenTable[i].pStruct, &dataLength,
+													 &DataPosition);
+			} else {
+				isValueFound = (deltaValueTokens[i] >= 0);
+				if(isValueFound) {
+					updateValueFromToken(shadowRxBuf, deltaValueTokens[i], (jsonStruct_t *) tokenTable[i].pStruct,
+										 &dataLength, &DataPosition);
+				}
+			}
+			if(isValueFound) {
 				if(tokenTable[i].callback != NULL) {
 					tokenTable[i].callback(shadowRxBuf + DataPosition, dataLength,
 										   (jsonStruct_t *) tokenTable[i].pStruct);
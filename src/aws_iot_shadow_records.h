@@ -35,15 +35,17 @@ extern char mqttClientID[MAX_SIZE_OF_UNIQUE_CLIENT_ID_BYTES];
 extern uint16_t mqttClientIDLen;
 
 void initializeRecords(AWS_IoT_Client *pClient);
+IoT_Error_t subscribeToAllShadowTopics(pApplicationHandler_t deleteActionHandler);
+bool isCoveredByWildcardSubscription(const char *pThingName);
 bool isSubscriptionPresent(const char *pThingName, ShadowActions_t action);
 IoT_Error_t subscribeToShadowActionAcks(const char *pThingName, ShadowActions_t action, bool isSticky);
 void incrementSubscriptionCnt(const char *pThingName, ShadowActions_t action, bool isSticky);
 
 IoT_Error_t publishToShadowAction(const char *pThingName, ShadowActions_t action, const char *pJsonDocumentToBeSent);
-void addToAckWaitList(uint8_t indexAckWaitList, const char *pThingName, ShadowActions_t action,
+void addToAckWaitList(uint16_t indexAckWaitList, const char *pThingName, ShadowActions_t action,
 					  const char *pExtractedClientToken, fpActionCallback_t callback, void *pCallbackContext,
 					  uint32_t timeout_seconds);
-bool getNextFreeIndexOfAckWaitList(uint8_t *pIndex);
+bool getNextFreeIndexOfAckWaitList(const char *pClientToken, uint16_t *pIndex);
 void HandleExpiredResponseCallbacks(void);
 void initDeltaTokens(void);
 IoT_Error_t registerJsonTokenOnDelta(jsonStruct_t *pStruct);
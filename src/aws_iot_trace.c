@@ -0,0 +1,291 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_trace.c
+ * @brief Per task ring buffers of binary trace events
+ *
+ * Each task claims a ring on its first event and is then its only writer, so
+ * recording needs no lock: the event is stored and the head index is published
+ * with a release store. The dump reads the rings while recording is stopped.
+ *
+ * A deleted task releases its ring through the deletion callback of a thread
+ * local storage pointer, or through aws_iot_trace_release. A released ring
+ * keeps its events and the task name for the dump until another task claims it.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef ENABLE_IOT_TRACE
+
+#include <string.h>
+
+#include "aws_iot_trace.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#if (IOT_TRACE_EVENTS_PER_TASK & (IOT_TRACE_EVENTS_PER_TASK - 1)) != 0
+#error "IOT_TRACE_EVENTS_PER_TASK must be a power of two"
+#endif
+
+/* Functions seen during one dump, ids of functions beyond that are re-announced on every event */
+#define IOT_TRACE_DUMP_MAX_FUNCTIONS 128
+
+/* Owner of a ring whose task was deleted */
+#define IOT_TRACE_RELEASED_OWNER ((void *) &traceDropped)
+
+#if defined(configTHREAD_LOCAL_STORAGE_DELETE_CALLBACKS) && configTHREAD_LOCAL_STORAGE_DELETE_CALLBACKS \
+	&& configNUM_THREAD_LOCAL_STORAGE_POINTERS > 0
+#define IOT_TRACE_RELEASE_ON_DELETE
+#ifndef IOT_TRACE_TLS_INDEX
+#define IOT_TRACE_TLS_INDEX (configNUM_THREAD_LOCAL_STORAGE_POINTERS - 1)
+#endif
+#endif
+
+typedef struct {
+	uint32_t timestampUs;
+	const char *pFunction;
+	int32_t rc;
+	uint16_t line;
+	uint8_t type;
+} TraceEvent_t;
+
+typedef struct {
+	void *pOwner;
+	uint32_t head;
+	char taskName[IOT_TRACE_TASK_NAME_LEN + 1];	///< Copied at claim time, the task may be gone by the dump
+	TraceEvent_t events[IOT_TRACE_EVENTS_PER_TASK];
+} TraceRing_t;
+
+static TraceRing_t traceRings[IOT_TRACE_MAX_TASKS];
+static volatile bool isTraceEnabled = true;
+static uint32_t traceDropped = 0;
+
+static void _aws_iot_trace_release_ring(TraceRing_t *pRing) {
+	__atomic_store_n(&pRing->pOwner, IOT_TRACE_RELEASED_OWNER, __ATOMIC_RELEASE);
+}
+
+#ifdef IOT_TRACE_RELEASE_ON_DELETE
+/* the value is the handle of the deleted task, it cannot belong to a new task before the callback returns */
+static void _aws_iot_trace_on_task_deleted(int index, void *pValue) {
+	(void) index;
+	aws_iot_trace_release(pValue);
+}
+#endif
+
+static TraceRing_t *_aws_iot_trace_claim_ring(TraceRing_t *pRing, void *pExpected, void *pTask) {
+	const char *pName;
+
+	if(!__atomic_compare_exchange_n(&pRing->pOwner, &pExpected, pTask, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		return NULL;
+	}
+
+	pRing->head = 0;
+	pName = pcTaskGetTaskName(NULL);
+	strncpy(pRing->taskName, (NULL != pName) ? pName : "?", IOT_TRACE_TASK_NAME_LEN);
+	pRing->taskName[IOT_TRACE_TASK_NAME_LEN] = '\0';
+#ifdef IOT_TRACE_RELEASE_ON_DELETE
+	/* the slot may belong to another user, e.g. pthread keys, the ring is then released by aws_iot_trace_release */
+	if(NULL == pvTaskGetThreadLocalStoragePointer(NULL, IOT_TRACE_TLS_INDEX)) {
+		vTaskSetThreadLocalStoragePointerAndDelCallback(NULL, IOT_TRACE_TLS_INDEX, pTask,
+														_aws_iot_trace_on_task_deleted);
+	}
+#endif
+	return pRing;
+}
+
+static TraceRing_t *_aws_iot_trace_get_ring(void) {
+	void *pTask = (void *) xTaskGetCurrentTaskHandle();
+	TraceRing_t *pRing;
+	uint8_t i;
+
+	for(i = 0; i < IOT_TRACE_MAX_TASKS; i++) {
+		if(__atomic_load_n(&traceRings[i].pOwner, __ATOMIC_ACQUIRE) == pTask) {
+			return &traceRings[i];
+		}
+	}
+
+	/* first event of this task, claim a free ring, else the ring of a deleted task */
+	for(i = 0; i < IOT_TRACE_MAX_TASKS; i++) {
+		if(NULL != (pRing = _aws_iot_trace_claim_ring(&traceRings[i], NULL, pTask))) {
+			return pRing;
+		}
+	}
+	for(i = 0; i < IOT_TRACE_MAX_TASKS; i++) {
+		if(NULL != (pRing = _aws_iot_trace_claim_ring(&traceRings[i], IOT_TRACE_RELEASED_OWNER, pTask))) {
+			return pRing;
+		}
+	}
+
+	return NULL;
+}
+
+void aws_iot_trace_record(IoT_Trace_Event_Type type, const char *pFunction, uint16_t line, int32_t rc) {
+	TraceRing_t *pRing;
+	TraceEvent_t *pEvent;
+	uint32_t head;
+
+	if(!isTraceEnabled) {
+		return;
+	}
+
+	pRing = _aws_iot_trace_get_ring();
+	if(NULL == pRing) {
+		__atomic_fetch_add(&traceDropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	head = pRing->head;
+	pEvent = &pRing->events[head & (IOT_TRACE_EVENTS_PER_TASK - 1)];
+	pEvent->timestampUs = (uint32_t) esp_timer_get_time();
+	pEvent->pFunction = pFunction;
+	pEvent->rc = rc;
+	pEvent->line = line;
+	pEvent->type = (uint8_t) type;
+	__atomic_store_n(&pRing->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void aws_iot_trace_enable(bool enable) {
+	isTraceEnabled = enable;
+}
+
+void aws_iot_trace_release(void *pTask) {
+	uint8_t i;
+
+	for(i = 0; i < IOT_TRACE_MAX_TASKS; i++) {
+		if(NULL != pTask && __atomic_load_n(&traceRings[i].pOwner, __ATOMIC_ACQUIRE) == pTask) {
+			_aws_iot_trace_release_ring(&traceRings[i]);
+		}
+	}
+}
+
+void aws_iot_trace_clear(void) {
+	uint8_t i;
+
+	for(i = 0; i < IOT_TRACE_MAX_TASKS; i++) {
+		__atomic_store_n(&traceRings[i].head, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&traceRings[i].pOwner, NULL, __ATOMIC_RELEASE);
+	}
+	traceDropped = 0;
+}
+
+static void _aws_iot_trace_put_u16(uint8_t *pBuf, uint16_t value) {
+	pBuf[0] = (uint8_t) value;
+	pBuf[1] = (uint8_t) (value >> 8);
+}
+
+static void _aws_iot_trace_put_u32(uint8_t *pBuf, uint32_t value) {
+	pBuf[0] = (uint8_t) value;
+	pBuf[1] = (uint8_t) (value >> 8);
+	pBuf[2] = (uint8_t) (value >> 16);
+	pBuf[3] = (uint8_t) (value >> 24);
+}
+
+static void _aws_iot_trace_write_name(pTraceWriter_t writer, void *pContext, uint8_t *pRecord, size_t recordLen,
+									  const char *pName, size_t maxLen) {
+	size_t nameLen = strlen(pName);
+
+	if(nameLen > maxLen) {
+		nameLen = maxLen;
+	}
+	pRecord[recordLen - 1] = (uint8_t) nameLen;
+	writer(pContext, pRecord, recordLen);
+	writer(pContext, (const uint8_t *) pName, nameLen);
+}
+
+uint32_t aws_iot_trace_dump(pTraceWriter_t writer, void *pContext) {
+	static const char *seenFunctions[IOT_TRACE_DUMP_MAX_FUNCTIONS];
+	uint8_t record[IOT_TRACE_EVENT_RECORD_LEN];
+	uint16_t nbSeen = 0;
+	uint16_t functionId;
+	uint32_t written = 0;
+	uint32_t head, first, idx;
+	uint8_t i, taskCount = 0;
+	TraceEvent_t *pEvent;
+
+	if(NULL == writer) {
+		return 0;
+	}
+
+	for(i = 0; i < IOT_TRACE_MAX_TASKS; i++) {
+		if(NULL != traceRings[i].pOwner) {
+			taskCount++;
+		}
+	}
+
+	memcpy(record, IOT_TRACE_MAGIC, 4);
+	_aws_iot_trace_put_u16(&record[4], IOT_TRACE_VERSION);
+	_aws_iot_trace_put_u16(&record[6], taskCount);
+	_aws_iot_trace_put_u32(&record[8], traceDropped);
+	writer(pContext, record, 12);
+
+	for(i = 0; i < IOT_TRACE_MAX_TASKS; i++) {
+		if(NULL == traceRings[i].pOwner) {
+			continue;
+		}
+
+		record[0] = IOT_TRACE_TAG_TASK;
+		record[1] = i;
+		_aws_iot_trace_write_name(writer, pContext, record, 3, traceRings[i].taskName, IOT_TRACE_TASK_NAME_LEN);
+
+		head = __atomic_load_n(&traceRings[i].head, __ATOMIC_ACQUIRE);
+		first = (head > IOT_TRACE_EVENTS_PER_TASK) ? head - IOT_TRACE_EVENTS_PER_TASK : 0;
+		for(idx = first; idx < head; idx++) {
+			pEvent = &traceRings[i].events[idx & (IOT_TRACE_EVENTS_PER_TASK - 1)];
+
+			for(functionId = 0; functionId < nbSeen; functionId++) {
+				if(seenFunctions[functionId] == pEvent->pFunction) {
+					break;
+				}
+			}
+			if(functionId == nbSeen) {
+				if(nbSeen < IOT_TRACE_DUMP_MAX_FUNCTIONS) {
+					seenFunctions[nbSeen++] = pEvent->pFunction;
+				} else {
+					/* table full, reuse the last id and announce the name again */
+					functionId = IOT_TRACE_DUMP_MAX_FUNCTIONS;
+				}
+				record[0] = IOT_TRACE_TAG_FUNCTION;
+				_aws_iot_trace_put_u16(&record[1], functionId);
+				_aws_iot_trace_write_name(writer, pContext, record, 4, pEvent->pFunction, UINT8_MAX);
+			}
+
+			record[0] = IOT_TRACE_TAG_EVENT;
+			record[1] = i;
+			record[2] = pEvent->type;
+			record[3] = 0;
+			_aws_iot_trace_put_u16(&record[4], functionId);
+			_aws_iot_trace_put_u16(&record[6], pEvent->line);
+			_aws_iot_trace_put_u32(&record[8], (uint32_t) pEvent->rc);
+			_aws_iot_trace_put_u32(&record[12], pEvent->timestampUs);
+			writer(pContext, record, IOT_TRACE_EVENT_RECORD_LEN);
+			written++;
+		}
+	}
+
+	record[0] = IOT_TRACE_TAG_END;
+	writer(pContext, record, 1);
+
+	return written;
+}
+
+#endif /* ENABLE_IOT_TRACE */
+
+#ifdef __cplusplus
+}
+#endif
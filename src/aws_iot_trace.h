@@ -0,0 +1,152 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/**
+ * @file aws_iot_trace.h
+ * @brief Binary function trace used by FUNC_ENTRY / FUNC_EXIT_RC
+ *
+ * When ENABLE_IOT_TRACE is defined every FUNC_ENTRY and FUNC_EXIT_RC stores a
+ * small binary event (timestamp, function, line, return code) in a ring buffer
+ * owned by the calling task. Recording takes no lock and does no formatting.
+ * The buffers are written out with aws_iot_trace_dump and turned into a
+ * timeline or a Chrome trace by the host decoder in extras/trace.
+ *
+ * This header only depends on stdint so that the host decoder can share the
+ * dump format definitions.
+ */
+
+#ifndef AWS_IOT_SDK_SRC_IOT_TRACE_H
+#define AWS_IOT_SDK_SRC_IOT_TRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Number of rings, each recording the events of one task
+ *
+ * The ring of a deleted task keeps its events for the dump until another
+ * task claims it. Events of tasks that find no ring are dropped and counted
+ */
+#ifndef IOT_TRACE_MAX_TASKS
+#define IOT_TRACE_MAX_TASKS 4
+#endif
+
+/**
+ * @brief Number of events kept per task, must be a power of two
+ */
+#ifndef IOT_TRACE_EVENTS_PER_TASK
+#define IOT_TRACE_EVENTS_PER_TASK 256
+#endif
+
+/**
+ * @brief Maximum length of a task name in the dump
+ */
+#define IOT_TRACE_TASK_NAME_LEN 16
+
+/* Dump format, all integers little endian.
+ *
+ * header:   "IOTT" uint16 version, uint16 taskCount, uint32 dropped
+ * then a sequence of records starting with a tag byte:
+ * 'T' task:     uint8 task, uint8 nameLen, name
+ * 'F' function: uint16 id, uint8 nameLen, name
+ * 'E' event:    uint8 task, uint8 type, uint8 reserved, uint16 function id,
+ *               uint16 line, int32 rc, uint32 timestamp (us)
+ * 'Z' end of dump
+ * A function record always precedes the first event referencing its id.
+ */
+#define IOT_TRACE_MAGIC "IOTT"
+#define IOT_TRACE_VERSION 1
+#define IOT_TRACE_TAG_TASK 'T'
+#define IOT_TRACE_TAG_FUNCTION 'F'
+#define IOT_TRACE_TAG_EVENT 'E'
+#define IOT_TRACE_TAG_END 'Z'
+#define IOT_TRACE_EVENT_RECORD_LEN 16
+
+/**
+ * @brief Type of a trace event
+ */
+typedef enum {
+	IOT_TRACE_ENTRY = 0,	///< FUNC_ENTRY
+	IOT_TRACE_EXIT = 1,	///< FUNC_EXIT, no return code
+	IOT_TRACE_EXIT_RC = 2	///< FUNC_EXIT_RC
+} IoT_Trace_Event_Type;
+
+/**
+ * @brief Output callback of aws_iot_trace_dump
+ *
+ * @param pContext Context given to aws_iot_trace_dump
+ * @param pData Bytes to write
+ * @param len Number of bytes
+ */
+typedef void (*pTraceWriter_t)(void *pContext, const uint8_t *pData, size_t len);
+
+/**
+ * @brief Record a trace event for the calling task
+ *
+ * Called by the FUNC_ENTRY / FUNC_EXIT / FUNC_EXIT_RC macros, not meant to be called directly
+ *
+ * @param type Event type
+ * @param pFunction Function name, must be a string with static storage (__func__)
+ * @param line Source line
+ * @param rc Return code, 0 for entry events
+ */
+void aws_iot_trace_record(IoT_Trace_Event_Type type, const char *pFunction, uint16_t line, int32_t rc);
+
+/**
+ * @brief Start or stop recording
+ *
+ * Recording is on by default. Stop it before dumping so the buffers are stable
+ *
+ * @param enable true to record events
+ */
+void aws_iot_trace_enable(bool enable);
+
+/**
+ * @brief Release the ring of a task about to be deleted
+ *
+ * Only needed where FreeRTOS has no thread local storage deletion callbacks,
+ * or when the task uses the last thread local storage pointer itself
+ *
+ * @param pTask Handle of the task
+ */
+void aws_iot_trace_release(void *pTask);
+
+/**
+ * @brief Forget all recorded events and release the task slots
+ */
+void aws_iot_trace_clear(void);
+
+/**
+ * @brief Write the recorded events in the binary dump format
+ *
+ * The events of each task are written oldest first
+ *
+ * @param writer Output callback, e.g. writing to a serial port or a file
+ * @param pContext Passed back to the writer
+ *
+ * @return uint32_t Number of events written
+ */
+uint32_t aws_iot_trace_dump(pTraceWriter_t writer, void *pContext);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AWS_IOT_SDK_SRC_IOT_TRACE_H */
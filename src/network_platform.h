@@ -16,6 +16,11 @@
 
 #ifndef IOTSDKC_NETWORK_MBEDTLS_PLATFORM_H_H
 
+#ifdef AWS_IOT_PLATFORM_HOST
+/* host build (extras/platform/host), see extras/CMakeLists.txt */
+#include "network_platform_host.h"
+#else
+
 #if !defined(MBEDTLS_CONFIG_FILE)
 #include "mbedtls/config.h"
 #else
@@ -61,4 +66,6 @@ typedef struct _TLSDataParams {
 }
 #endif
 
+#endif /* AWS_IOT_PLATFORM_HOST */
+
 #endif //IOTSDKC_NETWORK_MBEDTLS_PLATFORM_H_H
@@ -23,6 +23,11 @@
 extern "C" {
 #endif
 
+#ifdef AWS_IOT_PLATFORM_HOST
+/* host build (extras/platform/host), see extras/CMakeLists.txt */
+#include "threads_platform_host.h"
+#else
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 
@@ -36,6 +41,8 @@ struct _IoT_Mutex_t {
     SemaphoreHandle_t mutex;
 };
 
+#endif /* AWS_IOT_PLATFORM_HOST */
+
 #ifdef __cplusplus
 }
 #endif